@@ -0,0 +1,143 @@
+/*
+ *      protocol.c - socket plumbing shared by smoothpathd and its clients
+ *
+ *      Copyright 2026 agent
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ *      This program is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *
+ *      You should have received a copy of the GNU General Public License
+ *      along with this program; if not, write to the Free Software
+ *      Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ *      MA 02110-1301, USA.
+ */
+
+#include <errno.h>
+#include <math.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include "protocol.h"
+
+/*-----------------------------------------------------------------------------
+ *  smoothd_read, smoothd_write  --  all of size bytes, or FALSE
+ *-----------------------------------------------------------------------------
+ */
+gboolean smoothd_read(gint fd, gpointer data, gsize size)
+{
+    gchar   *p = data;
+    gssize   n;
+
+    while (size > 0) {
+        n = read(fd, p, size);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return FALSE;
+        p += n;
+        size -= n;
+    }
+    return TRUE;
+}
+
+gboolean smoothd_write(gint fd, gconstpointer data, gsize size)
+{
+    const gchar *p = data;
+    gssize       n;
+
+    while (size > 0) {
+        n = send(fd, p, size, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return FALSE;
+        p += n;
+        size -= n;
+    }
+    return TRUE;
+}
+
+/*-----------------------------------------------------------------------------
+ *  smoothd_send_fd, smoothd_recv_fd  --  data with pass_fd riding along as
+ *                                        SCM_RIGHTS; the receiving end gets
+ *                                        its own descriptor, or -1
+ *-----------------------------------------------------------------------------
+ */
+gboolean smoothd_send_fd(gint fd, gconstpointer data, gsize size,
+                         gint pass_fd)
+{
+    struct msghdr   msg;
+    struct iovec    iov;
+    struct cmsghdr *cmsg;
+    gchar           control[CMSG_SPACE(sizeof(gint))];
+
+    memset(&msg, 0, sizeof(msg));
+    memset(control, 0, sizeof(control));
+    iov.iov_base = (gpointer) data;
+    iov.iov_len = size;
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(gint));
+    memcpy(CMSG_DATA(cmsg), &pass_fd, sizeof(gint));
+
+    return sendmsg(fd, &msg, MSG_NOSIGNAL) == (gssize) size;
+}
+
+gint smoothd_recv_fd(gint fd, gpointer data, gsize size)
+{
+    struct msghdr   msg;
+    struct iovec    iov;
+    struct cmsghdr *cmsg;
+    gchar           control[CMSG_SPACE(sizeof(gint))];
+    gint            pass_fd = -1;
+
+    memset(&msg, 0, sizeof(msg));
+    iov.iov_base = data;
+    iov.iov_len = size;
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    if (recvmsg(fd, &msg, MSG_WAITALL) != (gssize) size)
+        return -1;
+    for (cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg))
+        if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS)
+            memcpy(&pass_fd, CMSG_DATA(cmsg), sizeof(gint));
+    return pass_fd;
+}
+
+static gint time_compare(gconstpointer a, gconstpointer b)
+{
+    gint64 x = *(const gint64 *) a, y = *(const gint64 *) b;
+
+    return (x > y) - (x < y);
+}
+
+/*-----------------------------------------------------------------------------
+ *  smoothd_percentile  --  the nearest rank p-th percentile of times
+ *-----------------------------------------------------------------------------
+ */
+gdouble smoothd_percentile(GArray *times, gdouble p)
+{
+    gint rank;
+
+    if (times->len == 0)
+        return 0;
+    g_array_sort(times, time_compare);
+    rank = (gint) ceil(p / 100 * times->len) - 1;
+    return g_array_index(times, gint64, CLAMP(rank, 0, (gint) times->len - 1));
+}
@@ -0,0 +1,93 @@
+/*
+ *      protocol.h - what smoothpathd and its clients say to each other
+ *
+ *      Copyright 2026 agent
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ *      This program is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *
+ *      You should have received a copy of the GNU General Public License
+ *      along with this program; if not, write to the Free Software
+ *      Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ *      MA 02110-1301, USA.
+ */
+
+#ifndef __SMOOTHPATHD_PROTOCOL_H__
+#define __SMOOTHPATHD_PROTOCOL_H__
+
+#include <glib.h>
+
+/* Both ends run on the same machine, so everything is in its byte order.
+ *
+ * On connecting, the client gets a SmoothdHello with the descriptor of the
+ * shared memory ring, which it maps. To smooth, it asks for room in the
+ * ring (SMOOTHD_ALLOC), writes the control points there, and sends
+ * SMOOTHD_SMOOTH followed by the num_strokes + 1 offsets of the strokes in
+ * the room, in doubles, as gint32, and num_strokes closed flags, one byte
+ * each. The reply comes once the points in the room are smoothed. A client
+ * has one room at a time: the next SMOOTHD_ALLOC, one of size 0, or
+ * hanging up gives it back. Rooms are handed out in turn, so one a client
+ * holds on to keeps the ring from moving past it; a SMOOTHD_ALLOC that
+ * finds no room for two seconds is answered with SMOOTHD_BUSY, and may be
+ * sent again. SMOOTHD_STATS answers with the latencies since the last
+ * SMOOTHD_STATS and starts counting anew. */
+#define SMOOTHD_SOCKET "/tmp/smoothpathd.sock"
+#define SMOOTHD_RING   (64 << 20)
+
+#define SMOOTHD_ALLOC  1
+#define SMOOTHD_SMOOTH 2
+#define SMOOTHD_STATS  3
+
+#define SMOOTHD_OK       0
+#define SMOOTHD_TOO_BIG  1
+#define SMOOTHD_INVALID  2
+#define SMOOTHD_BUSY     3
+
+typedef struct
+{
+    guint64  ring_size;
+} SmoothdHello;
+
+typedef struct
+{
+    gint32   type;
+    gint32   num_strokes;
+    guint64  size;
+    guint64  offset;
+    gint32   smooth_specified;
+    gdouble  ang_min;
+    gdouble  ang_max;
+    gdouble  smoothing;
+} SmoothdRequest;
+
+typedef struct
+{
+    gint32   status;
+    guint64  offset;
+    guint64  requests;
+    guint64  batches;
+    gdouble  p50;
+    gdouble  p99;
+} SmoothdReply;
+
+/* Reads or writes exactly size bytes, FALSE if the other end went away */
+gboolean smoothd_read(gint fd, gpointer data, gsize size);
+gboolean smoothd_write(gint fd, gconstpointer data, gsize size);
+
+/* Passes a descriptor along with data over a Unix socket */
+gboolean smoothd_send_fd(gint fd, gconstpointer data, gsize size,
+                         gint pass_fd);
+gint     smoothd_recv_fd(gint fd, gpointer data, gsize size);
+
+/* The p-th percentile, 0 to 100, of times in microseconds, which get
+ * sorted; 0 if there are none */
+gdouble  smoothd_percentile(GArray *times, gdouble p);
+
+#endif
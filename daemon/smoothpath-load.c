@@ -0,0 +1,346 @@
+/*
+ *      smoothpath-load.c - keeps smoothpathd busy from a number of clients
+ *                          at once, and reports the throughput and the
+ *                          latencies both ends saw
+ *
+ *      Copyright 2026 agent
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ *      This program is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *
+ *      You should have received a copy of the GNU General Public License
+ *      along with this program; if not, write to the Free Software
+ *      Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ *      MA 02110-1301, USA.
+ */
+
+#define SMOOTH_PATH_CORE
+#include "../smooth-path.c"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "protocol.h"
+
+/* How long to keep trying while the daemon starts up, in milliseconds */
+#define CONNECT_WAIT 5000
+
+/* What every client does */
+typedef struct
+{
+    const gchar *path;
+    gint         requests;
+    gint         strokes;
+    gint         anchors;
+    gdouble      smoothing;
+    gboolean     check;
+} LoadSettings;
+
+/* One client's share of the load, and what it saw */
+typedef struct
+{
+    const LoadSettings *settings;
+    gint                seed;
+    GArray             *times;
+    gint                failed;
+} LoadClient;
+
+static LoadSettings settings = { SMOOTHD_SOCKET, 1000, 8, 100, 0.0, FALSE };
+
+/*-----------------------------------------------------------------------------
+ *  load_connect  --  a socket connected to the daemon, waiting up to
+ *                    CONNECT_WAIT for it to start listening; -1 if it
+ *                    doesn't
+ *-----------------------------------------------------------------------------
+ */
+static gint load_connect(const gchar *path)
+{
+    struct sockaddr_un addr;
+    gint               fd, waited;
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    g_strlcpy(addr.sun_path, path, sizeof(addr.sun_path));
+    for (waited = 0; waited < CONNECT_WAIT; waited += 10) {
+        fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd < 0)
+            return -1;
+        if (connect(fd, (struct sockaddr *) &addr, sizeof(addr)) == 0)
+            return fd;
+        close(fd);
+        if (errno != ENOENT && errno != ECONNREFUSED)
+            return -1;
+        g_usleep(10000);
+    }
+    return -1;
+}
+
+/*-----------------------------------------------------------------------------
+ *  load_request  --  sends request and the strokes that go with it, if any,
+ *                    and waits for the reply
+ *-----------------------------------------------------------------------------
+ */
+static gboolean load_request(gint fd, const SmoothdRequest *request,
+                             const gint32 *offsets, const guint8 *closed,
+                             SmoothdReply *reply)
+{
+    if (!smoothd_write(fd, request, sizeof(SmoothdRequest)))
+        return FALSE;
+    if (request->type == SMOOTHD_SMOOTH &&
+        (!smoothd_write(fd, offsets,
+                        (request->num_strokes + 1) * sizeof(gint32)) ||
+         !smoothd_write(fd, closed, request->num_strokes)))
+        return FALSE;
+    return smoothd_read(fd, reply, sizeof(SmoothdReply));
+}
+
+/*-----------------------------------------------------------------------------
+ *  load_strokes  --  wobbly circles, like traced outlines, every other one
+ *                    closed, written straight into the room at ctlpts
+ *-----------------------------------------------------------------------------
+ */
+static void load_strokes(GRand *rand, gdouble *ctlpts, gint num_strokes,
+                         gint anchors, gint32 *offsets, guint8 *closed)
+{
+    gdouble r, cx, cy;
+    gint    n, k;
+
+    for (n = 0; n < num_strokes; n++) {
+        offsets[n] = n * anchors * 6;
+        closed[n] = n % 2;
+        cx = g_rand_double_range(rand, 0, 1000);
+        cy = g_rand_double_range(rand, 0, 1000);
+        for (k = 0; k < anchors; k++) {
+            r = 100 + g_rand_double_range(rand, -5, 5);
+            ctlpts[2] = cx + r * cos(2 * G_PI * k / anchors);
+            ctlpts[3] = cy + r * sin(2 * G_PI * k / anchors);
+            ctlpts[0] = ctlpts[4] = ctlpts[2];
+            ctlpts[1] = ctlpts[5] = ctlpts[3];
+            ctlpts += 6;
+        }
+    }
+    offsets[num_strokes] = num_strokes * anchors * 6;
+}
+
+/*-----------------------------------------------------------------------------
+ *  load_client  --  one client: connects, maps the ring, and sends its
+ *                   requests one after the other, timing each round trip;
+ *                   with check set, smooths the same strokes itself and
+ *                   counts the requests whose results differ
+ *-----------------------------------------------------------------------------
+ */
+static gpointer load_client(gpointer data)
+{
+    LoadClient         *client = data;
+    const LoadSettings *s = client->settings;
+    SmoothScratch       scratch = { NULL };
+    SmoothVals          vals = { FALSE, 60.0, 120.0, 0.0, REGION_ALL, 0, -1,
+                                 FILL_NONE, 0.0, JOIN_NONE, 0.0 };
+    SmoothdHello        hello;
+    SmoothdRequest      request;
+    SmoothdReply        reply;
+    GRand              *rand;
+    gdouble            *ring, *ctlpts, *expect = NULL;
+    gint32             *offsets;
+    guint8             *closed;
+    gint64              start, time;
+    gsize               size;
+    gint                fd, ring_fd, n, k;
+
+    fd = load_connect(s->path);
+    ring_fd = (fd < 0) ? -1 : smoothd_recv_fd(fd, &hello, sizeof(hello));
+    if (ring_fd < 0) {
+        g_printerr("smoothpath-load: can't reach smoothpathd at %s\n",
+                   s->path);
+        client->failed = s->requests;
+        return NULL;
+    }
+    ring = mmap(NULL, hello.ring_size, PROT_READ | PROT_WRITE, MAP_SHARED,
+                ring_fd, 0);
+    close(ring_fd);
+
+    rand = g_rand_new_with_seed(client->seed);
+    size = (gsize) s->strokes * s->anchors * 6;
+    offsets = g_new(gint32, s->strokes + 1);
+    closed = g_new(guint8, s->strokes + 1);
+    if (s->check)
+        expect = g_new(gdouble, size);
+    vals.smoothing = s->smoothing;
+    memset(&request, 0, sizeof(request));
+    request.smooth_specified = vals.smooth_specified;
+    request.ang_min = vals.ang_min;
+    request.ang_max = vals.ang_max;
+    request.smoothing = vals.smoothing;
+
+    for (n = 0; ring != MAP_FAILED && n < s->requests; n++) {
+        start = g_get_monotonic_time();
+        request.type = SMOOTHD_ALLOC;
+        request.size = size * sizeof(gdouble);
+        if (!load_request(fd, &request, NULL, NULL, &reply) ||
+            reply.status != SMOOTHD_OK)
+            break;
+        ctlpts = ring + reply.offset / sizeof(gdouble);
+        load_strokes(rand, ctlpts, s->strokes, s->anchors, offsets, closed);
+        if (s->check)
+            memcpy(expect, ctlpts, size * sizeof(gdouble));
+
+        request.type = SMOOTHD_SMOOTH;
+        request.num_strokes = s->strokes;
+        request.offset = reply.offset;
+        if (!load_request(fd, &request, offsets, closed, &reply) ||
+            reply.status != SMOOTHD_OK)
+            break;
+        time = g_get_monotonic_time() - start;
+        g_array_append_val(client->times, time);
+
+        if (s->check) {
+            for (k = 0; k < s->strokes; k++)
+                smooth_stroke(&vals, expect + offsets[k],
+                              offsets[k + 1] - offsets[k], closed[k], NULL,
+                              &scratch);
+            if (memcmp(expect, ctlpts, size * sizeof(gdouble)) != 0)
+                client->failed++;
+        }
+    }
+    client->failed += s->requests - n;
+
+    if (ring != MAP_FAILED)
+        munmap(ring, hello.ring_size);
+    close(fd);
+    g_rand_free(rand);
+    g_free(offsets);
+    g_free(closed);
+    g_free(expect);
+    scratch_free(&scratch);
+    return NULL;
+}
+
+/*-----------------------------------------------------------------------------
+ *  load_stats  --  the daemon's latencies since it was last asked
+ *-----------------------------------------------------------------------------
+ */
+static gboolean load_stats(const gchar *path, SmoothdReply *reply)
+{
+    SmoothdRequest request;
+    SmoothdHello   hello;
+    gint           fd, ring_fd;
+    gboolean       ok;
+
+    fd = load_connect(path);
+    ring_fd = (fd < 0) ? -1 : smoothd_recv_fd(fd, &hello, sizeof(hello));
+    if (ring_fd < 0)
+        return FALSE;
+    close(ring_fd);
+    memset(&request, 0, sizeof(request));
+    request.type = SMOOTHD_STATS;
+    ok = load_request(fd, &request, NULL, NULL, reply);
+    close(fd);
+    return ok;
+}
+
+static void usage(void)
+{
+    g_printerr("usage: smoothpath-load [-s socket] [-c clients] "
+               "[-n requests] [-k strokes] [-a anchors] [-S smoothing] "
+               "[-v]\n");
+    exit(2);
+}
+
+int main(int argc, char **argv)
+{
+    SmoothdReply  server;
+    LoadClient   *clients;
+    GThread     **threads;
+    GArray       *times;
+    gint64        start, wall;
+    gint          num_clients = 4, failed = 0, n, opt;
+
+    while ((opt = getopt(argc, argv, "s:c:n:k:a:S:v")) != -1) {
+        switch (opt) {
+        case 's':
+            settings.path = optarg;
+            break;
+        case 'c':
+            num_clients = atoi(optarg);
+            break;
+        case 'n':
+            settings.requests = atoi(optarg);
+            break;
+        case 'k':
+            settings.strokes = atoi(optarg);
+            break;
+        case 'a':
+            settings.anchors = atoi(optarg);
+            break;
+        case 'S':
+            settings.smoothing = g_ascii_strtod(optarg, NULL);
+            break;
+        case 'v':
+            settings.check = TRUE;
+            break;
+        default:
+            usage();
+        }
+    }
+    if (num_clients < 1 || settings.requests < 1 || settings.strokes < 1 ||
+        settings.anchors < 3)
+        usage();
+
+    /* Forget what the daemon saw before */
+    if (!load_stats(settings.path, &server)) {
+        g_printerr("smoothpath-load: can't reach smoothpathd at %s\n",
+                   settings.path);
+        return 1;
+    }
+
+    clients = g_new0(LoadClient, num_clients);
+    threads = g_new(GThread *, num_clients);
+    start = g_get_monotonic_time();
+    for (n = 0; n < num_clients; n++) {
+        clients[n].settings = &settings;
+        clients[n].seed = n;
+        clients[n].times = g_array_new(FALSE, FALSE, sizeof(gint64));
+        threads[n] = g_thread_new("load", load_client, &clients[n]);
+    }
+    times = g_array_new(FALSE, FALSE, sizeof(gint64));
+    for (n = 0; n < num_clients; n++) {
+        g_thread_join(threads[n]);
+        g_array_append_vals(times, clients[n].times->data,
+                            clients[n].times->len);
+        failed += clients[n].failed;
+        g_array_free(clients[n].times, TRUE);
+    }
+    wall = MAX(g_get_monotonic_time() - start, 1);
+
+    g_print("%d clients, %u requests of %d strokes of %d anchors, "
+            "smoothing %g\n", num_clients, times->len, settings.strokes,
+            settings.anchors, settings.smoothing);
+    g_print("%.1f requests/s, %.2f M anchors/s\n",
+            times->len * 1.0e6 / wall,
+            (gdouble) times->len * settings.strokes * settings.anchors / wall);
+    g_print("round trip: p50 %.0f us, p99 %.0f us\n",
+            smoothd_percentile(times, 50), smoothd_percentile(times, 99));
+    if (load_stats(settings.path, &server) && server.batches > 0)
+        g_print("daemon: p50 %.0f us, p99 %.0f us, %.2f requests per "
+                "batch\n", server.p50, server.p99,
+                (gdouble) server.requests / server.batches);
+    if (failed > 0)
+        g_print("%d requests failed%s\n", failed,
+                settings.check ? " or differ from smoothing here" : "");
+
+    g_array_free(times, TRUE);
+    g_free(clients);
+    g_free(threads);
+    return failed > 0;
+}
@@ -0,0 +1,601 @@
+/*
+ *      smoothpathd.c - smooths paths for other programs over a Unix socket,
+ *                      with the control points in a shared memory ring;
+ *                      requests that arrive while others are solved are
+ *                      solved together on the threaded engine
+ *
+ *      Copyright 2026 agent
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ *      This program is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *
+ *      You should have received a copy of the GNU General Public License
+ *      along with this program; if not, write to the Free Software
+ *      Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ *      MA 02110-1301, USA.
+ */
+
+#define _GNU_SOURCE
+#define SMOOTH_PATH_CORE
+#include "../smooth-path.c"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "protocol.h"
+
+/* How long a SMOOTHD_ALLOC waits for older rooms to be given back before
+ * it is answered with SMOOTHD_BUSY */
+#define ROOM_WAIT (2 * G_TIME_SPAN_SECOND)
+
+/* A room of the ring, in doubles from its start */
+typedef struct
+{
+    gsize    start;
+    gsize    size;
+    gboolean used;
+} RingRoom;
+
+/* The shared memory every client maps; rooms are handed out one after the
+ * other and come free in any order, but the ring only moves past the
+ * oldest room once it is given back */
+typedef struct
+{
+    gdouble *base;
+    gsize    size;
+    gint     fd;
+    gsize    head;
+    GQueue  *rooms;
+    GMutex   mutex;
+    GCond    freed;
+} Ring;
+
+/* One SMOOTHD_SMOOTH, from the client's thread to the solver and back */
+typedef struct
+{
+    SmoothVals  vals;
+    gsize       start;
+    gint        num_strokes;
+    gint       *offsets;
+    gboolean   *closed;
+    gint64      received;
+    gboolean    done;
+} SmoothJob;
+
+/* Latencies of requests solved, counted in bins a sixteenth of an octave
+ * wide, which places them within 2.2% from 1 us to over an hour in a
+ * fixed amount of memory */
+#define HISTOGRAM_STEPS 16
+#define HISTOGRAM_BINS  (32 * HISTOGRAM_STEPS)
+
+typedef struct
+{
+    guint64  counts[HISTOGRAM_BINS];
+    guint64  requests;
+    guint64  batches;
+} Histogram;
+
+/* The latencies since the last SMOOTHD_STATS and since the start */
+typedef struct
+{
+    GMutex     mutex;
+    Histogram  recent;
+    Histogram  all;
+} Latency;
+
+static Ring           ring;
+static Latency        latency;
+static GAsyncQueue   *jobs;
+static GMutex         jobs_mutex;
+static GCond          jobs_done;
+static volatile sig_atomic_t quit;
+
+/*-----------------------------------------------------------------------------
+ *  ring_init  --  creates and maps an anonymous shared memory ring of size
+ *                 bytes, whose descriptor clients are handed
+ *-----------------------------------------------------------------------------
+ */
+static gboolean ring_init(gsize size)
+{
+    gchar *name;
+
+    name = g_strdup_printf("/smoothpathd-%d", (gint) getpid());
+    ring.fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (ring.fd >= 0)
+        shm_unlink(name);
+    g_free(name);
+    if (ring.fd < 0 || ftruncate(ring.fd, size) < 0)
+        return FALSE;
+    ring.base = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED,
+                     ring.fd, 0);
+    if (ring.base == MAP_FAILED)
+        return FALSE;
+    ring.size = size / sizeof(gdouble);
+    ring.head = 0;
+    ring.rooms = g_queue_new();
+    g_mutex_init(&ring.mutex);
+    g_cond_init(&ring.freed);
+    return TRUE;
+}
+
+/*-----------------------------------------------------------------------------
+ *  ring_fits  --  where a room of size doubles would go now, if anywhere;
+ *                 the head never catches up with the oldest room from
+ *                 behind, so a full ring and an empty one can't be confused
+ *-----------------------------------------------------------------------------
+ */
+static gboolean ring_fits(gsize size, gsize *start)
+{
+    gsize tail;
+
+    if (g_queue_is_empty(ring.rooms)) {
+        *start = 0;
+        return TRUE;
+    }
+    tail = ((RingRoom *) g_queue_peek_head(ring.rooms))->start;
+    if (ring.head >= tail) {
+        if (ring.head + size <= ring.size) {
+            *start = ring.head;
+            return TRUE;
+        }
+        *start = 0;
+        return size < tail;
+    }
+    *start = ring.head;
+    return ring.head + size < tail;
+}
+
+/*-----------------------------------------------------------------------------
+ *  ring_alloc  --  a room of size doubles, waiting up to ROOM_WAIT for older
+ *                  rooms to be given back; NULL if they weren't, as when a
+ *                  client sits on the oldest room; size must fit the ring
+ *-----------------------------------------------------------------------------
+ */
+static RingRoom *ring_alloc(gsize size)
+{
+    RingRoom *room;
+    gboolean  fits;
+    gint64    end_time;
+
+    room = g_new(RingRoom, 1);
+    room->size = size;
+    room->used = TRUE;
+    end_time = g_get_monotonic_time() + ROOM_WAIT;
+    g_mutex_lock(&ring.mutex);
+    fits = ring_fits(size, &room->start);
+    while (!fits && g_cond_wait_until(&ring.freed, &ring.mutex, end_time))
+        fits = ring_fits(size, &room->start);
+    if (fits) {
+        ring.head = room->start + size;
+        g_queue_push_tail(ring.rooms, room);
+    } else {
+        g_free(room);
+        room = NULL;
+    }
+    g_mutex_unlock(&ring.mutex);
+    return room;
+}
+
+/*-----------------------------------------------------------------------------
+ *  ring_release  --  gives a room back, and frees the oldest rooms as far
+ *                    as they have all been given back
+ *-----------------------------------------------------------------------------
+ */
+static void ring_release(RingRoom *room)
+{
+    if (!room)
+        return;
+    g_mutex_lock(&ring.mutex);
+    room->used = FALSE;
+    while (!g_queue_is_empty(ring.rooms) &&
+           !((RingRoom *) g_queue_peek_head(ring.rooms))->used)
+        g_free(g_queue_pop_head(ring.rooms));
+    if (g_queue_is_empty(ring.rooms))
+        ring.head = 0;
+    g_cond_broadcast(&ring.freed);
+    g_mutex_unlock(&ring.mutex);
+}
+
+/*-----------------------------------------------------------------------------
+ *  job_compare  --  orders jobs by their settings, then by where they are
+ *                   in the ring, so jobs that can be solved together end up
+ *                   next to each other
+ *-----------------------------------------------------------------------------
+ */
+static gint job_compare(gconstpointer a, gconstpointer b)
+{
+    const SmoothJob *x = *(SmoothJob * const *) a;
+    const SmoothJob *y = *(SmoothJob * const *) b;
+    gint             order;
+
+    order = memcmp(&x->vals, &y->vals, sizeof(SmoothVals));
+    if (order != 0)
+        return order;
+    return (x->start > y->start) - (x->start < y->start);
+}
+
+/*-----------------------------------------------------------------------------
+ *  solve_run  --  smooths the num_jobs jobs of run, whose points lie back
+ *                 to back in the ring, as one batch on the threaded engine,
+ *                 in place; the batch only looks at the ring, as the
+ *                 engine reads no more of its arrays than data and len
+ *-----------------------------------------------------------------------------
+ */
+static void solve_run(SmoothJob **run, gint num_jobs, GArray *offsets,
+                      GArray *closed, GArray *angles, SmoothScratch *scratch)
+{
+    StrokeBatch view;
+    GArray      points;
+    gsize       start;
+    gint        n, k, base;
+
+    start = run[0]->start;
+    g_array_set_size(offsets, 0);
+    g_array_set_size(closed, 0);
+    for (n = 0; n < num_jobs; n++) {
+        base = run[n]->start - start;
+        for (k = 0; k < run[n]->num_strokes; k++) {
+            g_array_append_val(offsets, base);
+            g_array_index(offsets, gint, offsets->len - 1) +=
+                run[n]->offsets[k];
+        }
+        g_array_append_vals(closed, run[n]->closed, run[n]->num_strokes);
+    }
+    n = run[num_jobs - 1]->start - start +
+        run[num_jobs - 1]->offsets[run[num_jobs - 1]->num_strokes];
+    g_array_append_val(offsets, n);
+
+    points.data = (gchar *) (ring.base + start);
+    points.len = n;
+    view.points = &points;
+    view.offsets = offsets;
+    view.closed = closed;
+    stroke_batch_angles(&view, angles);
+    smooth_batch_threaded(&run[0]->vals, &view, (gdouble *) angles->data,
+                          NULL, scratch);
+}
+
+/*-----------------------------------------------------------------------------
+ *  histogram_add  --  counts one latency of time microseconds
+ *-----------------------------------------------------------------------------
+ */
+static void histogram_add(Histogram *histogram, gint64 time)
+{
+    gint bin;
+
+    bin = (time > 1) ? (gint) (log2(time) * HISTOGRAM_STEPS) : 0;
+    histogram->counts[MIN(bin, HISTOGRAM_BINS - 1)]++;
+    histogram->requests++;
+}
+
+/*-----------------------------------------------------------------------------
+ *  histogram_percentile  --  the nearest rank p-th percentile, as the
+ *                            middle of the bin it falls in; 0 if nothing
+ *                            was counted
+ *-----------------------------------------------------------------------------
+ */
+static gdouble histogram_percentile(const Histogram *histogram, gdouble p)
+{
+    guint64 rank, seen;
+    gint    bin;
+
+    if (histogram->requests == 0)
+        return 0;
+    rank = MAX((guint64) ceil(p / 100 * histogram->requests), 1);
+    seen = 0;
+    for (bin = 0; bin < HISTOGRAM_BINS - 1; bin++) {
+        seen += histogram->counts[bin];
+        if (seen >= rank)
+            break;
+    }
+    return exp2((bin + 0.5) / HISTOGRAM_STEPS);
+}
+
+/*-----------------------------------------------------------------------------
+ *  solver  --  takes every job waiting, solves those with the same settings
+ *              that lie back to back as one batch, and wakes their clients
+ *-----------------------------------------------------------------------------
+ */
+static gpointer solver(gpointer data)
+{
+    SmoothScratch  scratch = { NULL };
+    GPtrArray     *batch;
+    GArray        *offsets, *closed, *angles;
+    SmoothJob     *job, **queued;
+    gint64         now;
+    gint           n, m;
+
+    batch = g_ptr_array_new();
+    offsets = g_array_new(FALSE, FALSE, sizeof(gint));
+    closed = g_array_new(FALSE, FALSE, sizeof(gboolean));
+    angles = g_array_new(FALSE, FALSE, sizeof(gdouble));
+    for (;;) {
+        g_ptr_array_set_size(batch, 0);
+        g_ptr_array_add(batch, g_async_queue_pop(jobs));
+        while ((job = g_async_queue_try_pop(jobs)))
+            g_ptr_array_add(batch, job);
+        g_ptr_array_sort(batch, job_compare);
+
+        queued = (SmoothJob **) batch->pdata;
+        for (n = 0; n < (gint) batch->len; n = m) {
+            for (m = n + 1; m < (gint) batch->len; m++) {
+                job = queued[m - 1];
+                if (memcmp(&job->vals, &queued[m]->vals,
+                           sizeof(SmoothVals)) != 0 ||
+                    job->start + job->offsets[job->num_strokes] !=
+                    queued[m]->start)
+                    break;
+            }
+            solve_run(queued + n, m - n, offsets, closed, angles, &scratch);
+        }
+
+        now = g_get_monotonic_time();
+        g_mutex_lock(&latency.mutex);
+        for (n = 0; n < (gint) batch->len; n++) {
+            histogram_add(&latency.recent, now - queued[n]->received);
+            histogram_add(&latency.all, now - queued[n]->received);
+        }
+        latency.recent.batches++;
+        latency.all.batches++;
+        g_mutex_unlock(&latency.mutex);
+
+        g_mutex_lock(&jobs_mutex);
+        for (n = 0; n < (gint) batch->len; n++)
+            queued[n]->done = TRUE;
+        g_cond_broadcast(&jobs_done);
+        g_mutex_unlock(&jobs_mutex);
+    }
+    return NULL;
+}
+
+/*-----------------------------------------------------------------------------
+ *  strokes_valid  --  whether the strokes of a SMOOTHD_SMOOTH lie in order
+ *                     inside the room, each of whole anchors
+ *-----------------------------------------------------------------------------
+ */
+static gboolean strokes_valid(const gint32 *offsets, const guint8 *closed,
+                              gint num_strokes, const RingRoom *room)
+{
+    gint n;
+
+    if (offsets[0] != 0 || offsets[num_strokes] > (gint64) room->size)
+        return FALSE;
+    for (n = 0; n < num_strokes; n++)
+        if (offsets[n + 1] < offsets[n] || offsets[n + 1] % 6 != 0 ||
+            closed[n] > 1)
+            return FALSE;
+    return TRUE;
+}
+
+/*-----------------------------------------------------------------------------
+ *  smooth_request  --  reads the strokes of a SMOOTHD_SMOOTH, has them
+ *                      solved and waits for that; FALSE if the client
+ *                      broke the protocol and should be hung up on
+ *-----------------------------------------------------------------------------
+ */
+static gboolean smooth_request(gint fd, const SmoothdRequest *request,
+                               RingRoom *room, SmoothdReply *reply)
+{
+    SmoothJob  job;
+    gint32    *offsets;
+    guint8    *closed;
+    gboolean   ok;
+    gint       n;
+
+    if (!room || request->num_strokes < 0 ||
+        request->num_strokes > (gint64) room->size / 6 + 1)
+        return FALSE;
+    offsets = g_new(gint32, request->num_strokes + 1);
+    closed = g_new(guint8, request->num_strokes + 1);
+    ok = (smoothd_read(fd, offsets, (request->num_strokes + 1) *
+                                    sizeof(gint32)) &&
+          smoothd_read(fd, closed, request->num_strokes));
+    reply->status = SMOOTHD_INVALID;
+    if (ok && request->offset == room->start * sizeof(gdouble) &&
+        strokes_valid(offsets, closed, request->num_strokes, room)) {
+        memset(&job, 0, sizeof(job));
+        job.vals.smooth_specified = request->smooth_specified;
+        job.vals.ang_min = request->ang_min;
+        job.vals.ang_max = request->ang_max;
+        job.vals.smoothing = CLAMP(request->smoothing, 0.0, 100.0);
+        job.vals.region = REGION_ALL;
+        job.vals.last_anchor = -1;
+        job.start = room->start;
+        job.num_strokes = request->num_strokes;
+        job.offsets = g_new(gint, request->num_strokes + 1);
+        job.closed = g_new(gboolean, request->num_strokes + 1);
+        for (n = 0; n <= request->num_strokes; n++) {
+            job.offsets[n] = offsets[n];
+            job.closed[n] = (n < request->num_strokes) && closed[n];
+        }
+        job.received = g_get_monotonic_time();
+
+        g_async_queue_push(jobs, &job);
+        g_mutex_lock(&jobs_mutex);
+        while (!job.done)
+            g_cond_wait(&jobs_done, &jobs_mutex);
+        g_mutex_unlock(&jobs_mutex);
+        g_free(job.offsets);
+        g_free(job.closed);
+        reply->status = SMOOTHD_OK;
+    }
+    reply->offset = request->offset;
+    g_free(offsets);
+    g_free(closed);
+    return ok;
+}
+
+/*-----------------------------------------------------------------------------
+ *  latency_take  --  the latencies since the last SMOOTHD_STATS, or since
+ *                    the start, into reply; the former start over
+ *-----------------------------------------------------------------------------
+ */
+static void latency_take(SmoothdReply *reply, gboolean all)
+{
+    Histogram *histogram;
+
+    g_mutex_lock(&latency.mutex);
+    histogram = all ? &latency.all : &latency.recent;
+    reply->requests = histogram->requests;
+    reply->batches = histogram->batches;
+    reply->p50 = histogram_percentile(histogram, 50);
+    reply->p99 = histogram_percentile(histogram, 99);
+    if (!all)
+        memset(&latency.recent, 0, sizeof(latency.recent));
+    g_mutex_unlock(&latency.mutex);
+}
+
+/*-----------------------------------------------------------------------------
+ *  client  --  serves one connection until it hangs up
+ *-----------------------------------------------------------------------------
+ */
+static gpointer client(gpointer data)
+{
+    SmoothdHello    hello;
+    SmoothdRequest  request;
+    SmoothdReply    reply;
+    RingRoom       *room = NULL;
+    gint            fd = GPOINTER_TO_INT(data);
+    gboolean        ok;
+
+    hello.ring_size = ring.size * sizeof(gdouble);
+    ok = smoothd_send_fd(fd, &hello, sizeof(hello), ring.fd);
+    while (ok && smoothd_read(fd, &request, sizeof(request))) {
+        memset(&reply, 0, sizeof(reply));
+        switch (request.type) {
+        case SMOOTHD_ALLOC:
+            ring_release(room);
+            room = NULL;
+            if (request.size % sizeof(gdouble) != 0 ||
+                request.size / sizeof(gdouble) > ring.size) {
+                reply.status = SMOOTHD_TOO_BIG;
+            } else if (request.size > 0) {
+                room = ring_alloc(request.size / sizeof(gdouble));
+                if (room)
+                    reply.offset = room->start * sizeof(gdouble);
+                else
+                    reply.status = SMOOTHD_BUSY;
+            }
+            break;
+        case SMOOTHD_SMOOTH:
+            ok = smooth_request(fd, &request, room, &reply);
+            break;
+        case SMOOTHD_STATS:
+            latency_take(&reply, FALSE);
+            break;
+        default:
+            ok = FALSE;
+        }
+        ok = ok && smoothd_write(fd, &reply, sizeof(reply));
+    }
+    ring_release(room);
+    close(fd);
+    return NULL;
+}
+
+static void on_signal(gint signum)
+{
+    quit = 1;
+}
+
+static void usage(void)
+{
+    g_printerr("usage: smoothpathd [-s socket] [-r ring MB]\n");
+    exit(2);
+}
+
+int main(int argc, char **argv)
+{
+    struct sockaddr_un  addr;
+    struct sigaction    action;
+    struct pollfd       poll_fd;
+    SmoothdReply        report;
+    const gchar        *path = SMOOTHD_SOCKET;
+    sigset_t            blocked, old;
+    gsize               ring_size = SMOOTHD_RING;
+    gint                listen_fd, fd, opt;
+
+    while ((opt = getopt(argc, argv, "s:r:")) != -1) {
+        switch (opt) {
+        case 's':
+            path = optarg;
+            break;
+        case 'r':
+            ring_size = (gsize) atoi(optarg) << 20;
+            break;
+        default:
+            usage();
+        }
+    }
+    if (ring_size == 0 || strlen(path) >= sizeof(addr.sun_path))
+        usage();
+
+    if (!ring_init(ring_size)) {
+        g_printerr("smoothpathd: can't create the ring: %s\n",
+                   g_strerror(errno));
+        return 1;
+    }
+    listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path);
+    unlink(path);
+    if (listen_fd < 0 ||
+        bind(listen_fd, (struct sockaddr *) &addr, sizeof(addr)) < 0 ||
+        chmod(path, 0600) < 0 || listen(listen_fd, SOMAXCONN) < 0) {
+        g_printerr("smoothpathd: can't listen on %s: %s\n", path,
+                   g_strerror(errno));
+        return 1;
+    }
+
+    /* Only this thread takes the signals, and only while it waits */
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = on_signal;
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+    sigemptyset(&blocked);
+    sigaddset(&blocked, SIGINT);
+    sigaddset(&blocked, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &blocked, &old);
+
+    calibrate(&model);
+    g_mutex_init(&latency.mutex);
+    g_mutex_init(&jobs_mutex);
+    g_cond_init(&jobs_done);
+    jobs = g_async_queue_new();
+    g_thread_unref(g_thread_new("solver", solver, NULL));
+    g_print("smoothpathd: listening on %s, %lu MB ring, %u processors\n",
+            path, (gulong) (ring_size >> 20), g_get_num_processors());
+
+    poll_fd.fd = listen_fd;
+    poll_fd.events = POLLIN;
+    while (!quit) {
+        if (ppoll(&poll_fd, 1, NULL, &old) <= 0 ||
+            (fd = accept(listen_fd, NULL, NULL)) < 0)
+            continue;
+        g_thread_unref(g_thread_new("client", client, GINT_TO_POINTER(fd)));
+    }
+
+    latency_take(&report, TRUE);
+    g_print("smoothpathd: %" G_GUINT64_FORMAT " requests in %"
+            G_GUINT64_FORMAT " batches, latency p50 %.0f us, p99 %.0f us\n",
+            report.requests, report.batches, report.p50, report.p99);
+    unlink(path);
+    return 0;
+}
@@ -0,0 +1,105 @@
+#
+#       bench.py - times the smoothpath module against the same solve in
+#                  pure NumPy, on batches of open strokes of every shape
+#
+#       Copyright 2026 agent
+#
+#       This program is free software; you can redistribute it and/or modify
+#       it under the terms of the GNU General Public License as published by
+#       the Free Software Foundation; either version 2 of the License, or
+#       (at your option) any later version.
+#
+#       This program is distributed in the hope that it will be useful,
+#       but WITHOUT ANY WARRANTY; without even the implied warranty of
+#       MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#       GNU General Public License for more details.
+#
+#       You should have received a copy of the GNU General Public License
+#       along with this program; if not, write to the Free Software
+#       Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+#       MA 02110-1301, USA.
+
+import os
+import threading
+import time
+
+import numpy as np
+
+import reference
+import smoothpath
+from test_smoothpath import wobbly_strokes
+
+SHAPES = ((1, 100000), (100, 1000), (10000, 10))
+RUNS = 5
+PYTHON_THREADS = 4
+
+
+def best_time(solve, points):
+    """The best of RUNS solves of fresh copies of points, in ms, and the
+    result of the last"""
+    best = float("inf")
+    for run in range(RUNS):
+        work = points.copy()
+        start = time.perf_counter()
+        solve(work)
+        best = min(best, time.perf_counter() - start)
+    return best * 1000, work
+
+
+def one_by_one(points):
+    for stroke in points:
+        smoothpath.smooth_stroke(stroke)
+
+
+def in_threads(points):
+    """smooth_batch on one thread each from PYTHON_THREADS Python threads,
+    which only run at once because the GIL is let go while solving"""
+    strokes, anchors, _ = points.shape
+    offsets = np.arange(strokes + 1, dtype=np.int32) * anchors * 6
+    closed = np.zeros(strokes, dtype=bool)
+    share = max(1, -(-strokes // PYTHON_THREADS))
+    threads = [threading.Thread(target=smoothpath.smooth_batch,
+                                args=(points[n:n + share],
+                                      offsets[:len(points[n:n + share]) + 1],
+                                      closed[:len(points[n:n + share])]),
+                                kwargs={"threaded": False})
+               for n in range(0, strokes, share)]
+    for thread in threads:
+        thread.start()
+    for thread in threads:
+        thread.join()
+
+
+def main():
+    rng = np.random.default_rng(54)
+    smoothpath.calibrate()
+    print("%d processors; best of %d runs, in ms" % (os.cpu_count(), RUNS))
+    print("%8s %8s %10s %10s %10s %10s %10s %10s" %
+          ("strokes", "anchors", "numpy", "strokes", "batch",
+           "threaded", "%d pythons" % PYTHON_THREADS, "max diff"))
+    for strokes, anchors in SHAPES:
+        points = wobbly_strokes(rng, strokes, anchors)
+        offsets = np.arange(strokes + 1, dtype=np.int32) * anchors * 6
+        closed = np.zeros(strokes, dtype=bool)
+        times = []
+
+        numpy_time, expect = best_time(
+            lambda work: reference.smooth_strokes(work, False), points)
+        times.append(best_time(one_by_one, points)[0])
+        times.append(best_time(
+            lambda work: smoothpath.smooth_batch(work, offsets, closed,
+                                                 threaded=False),
+            points)[0])
+        threaded_time, result = best_time(
+            lambda work: smoothpath.smooth_batch(work, offsets, closed),
+            points)
+        times.append(threaded_time)
+        times.append(best_time(in_threads, points)[0])
+
+        print("%8d %8d %10.2f %10.2f %10.2f %10.2f %10.2f %10.1e" %
+              ((strokes, anchors, numpy_time) + tuple(times) +
+               (np.abs(result - expect).max(),)))
+
+
+if __name__ == "__main__":
+    main()
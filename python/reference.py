@@ -0,0 +1,74 @@
+#
+#       reference.py - the interpolating solve of Smooth Path in pure NumPy,
+#                      to check the module against and to time it by
+#
+#       Copyright 2026 agent
+#
+#       This program is free software; you can redistribute it and/or modify
+#       it under the terms of the GNU General Public License as published by
+#       the Free Software Foundation; either version 2 of the License, or
+#       (at your option) any later version.
+#
+#       This program is distributed in the hope that it will be useful,
+#       but WITHOUT ANY WARRANTY; without even the implied warranty of
+#       MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#       GNU General Public License for more details.
+#
+#       You should have received a copy of the GNU General Public License
+#       along with this program; if not, write to the Free Software
+#       Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+#       MA 02110-1301, USA.
+
+import numpy as np
+
+
+def smooth_strokes(points, closed):
+    """Smooths strokes of the same number of anchors in place, with every
+    corner smoothed and no smoothing, as smooth_stroke does: points has
+    the shape (strokes, anchors, 6). The tridiagonal system is the same
+    for every stroke, so it is solved for all of them at once, one row at
+    a time, in the same order of operations as the C code."""
+    strokes, anchors, _ = points.shape
+    if anchors < 3:
+        return
+
+    # Anchor points; prepend last point, and append first two if closed
+    k = points[:, :, 2:4]
+    if closed:
+        k = np.concatenate((k[:, -1:], k, k[:, :2]), axis=1)
+    m = k.shape[1]
+
+    # Solve for the B-spline points, the two ends are the anchors
+    b = np.empty_like(k)
+    b[:, 0] = k[:, 0]
+    b[:, m - 1] = k[:, m - 1]
+    if m == 3:
+        b[:, 1] = 1.50 * k[:, 1] - 0.25 * k[:, 0] - 0.25 * k[:, 2]
+    else:
+        d = 6 * k[:, 1:m - 1]
+        d[:, 0] -= k[:, 0]
+        d[:, -1] -= k[:, m - 1]
+        c = np.empty(m - 2)
+        c[0] = 0.25
+        d[:, 0] *= 0.25
+        for i in range(1, m - 2):
+            inverse = 4.0 - c[i - 1]
+            c[i] = 1.0 / inverse
+            d[:, i] = (d[:, i] - d[:, i - 1]) / inverse
+        for i in range(m - 4, -1, -1):
+            d[:, i] = d[:, i] - c[i] * d[:, i + 1]
+        b[:, 1:m - 1] = d
+
+    # The handles lie a third of the way along to the neighbouring B-spline
+    # points; the first anchor of a closed stroke takes its in handle from
+    # the padding at the end
+    if closed:
+        i = np.arange(anchors) + 1
+        points[:, :, 4:6] = 2 * b[:, i] / 3 + b[:, i + 1] / 3
+        i[0] = anchors + 1
+        points[:, :, 0:2] = b[:, i - 1] / 3 + 2 * b[:, i] / 3
+    else:
+        i = np.arange(1, anchors)
+        points[:, 1:, 0:2] = b[:, i - 1] / 3 + 2 * b[:, i] / 3
+        i = np.arange(anchors - 1)
+        points[:, :-1, 4:6] = 2 * b[:, i] / 3 + b[:, i + 1] / 3
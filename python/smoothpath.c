@@ -0,0 +1,490 @@
+/*
+ *      smoothpath.c - Python module around the smoothing of Smooth Path;
+ *                     smooths control points in place in any buffer, such
+ *                     as a NumPy array, without copying them, and without
+ *                     holding the GIL while it solves
+ *
+ *      Copyright 2026 agent
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ *      This program is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *
+ *      You should have received a copy of the GNU General Public License
+ *      along with this program; if not, write to the Free Software
+ *      Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ *      MA 02110-1301, USA.
+ */
+
+/* Python.h has to come before any system header */
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+
+#define SMOOTH_PATH_CORE
+#include "../smooth-path.c"
+
+/* The settings every function takes, as keywords, after its arguments */
+#define SETTINGS_FORMAT "$pddd"
+#define SETTINGS_KEYWORDS "smooth_specified", "ang_min", "ang_max", "smoothing"
+#define SETTINGS_ARGS(vals) &(vals).smooth_specified, &(vals).ang_min, \
+                            &(vals).ang_max, &(vals).smoothing
+
+/* The pool and frames keep the statistics of the core, which are shared,
+ * so only one of them runs at a time; single strokes, and batches on one
+ * thread, run side by side from as many Python threads as there are */
+static GMutex engine;
+
+/* A run of frames of an animation, smoothed one after the other */
+typedef struct
+{
+    PyObject_HEAD
+    SmoothVals    vals;
+    FrameState    state;
+    SmoothScratch scratch;
+} Frames;
+
+/*-----------------------------------------------------------------------------
+ *  vals_default  --  the settings of the plugin's dialog, on first use
+ *-----------------------------------------------------------------------------
+ */
+static SmoothVals vals_default(void)
+{
+    SmoothVals vals = { FALSE, 60.0, 120.0, 0.0, REGION_ALL, 0, -1,
+                        FILL_NONE, 0.0, JOIN_NONE, 0.0 };
+
+    return vals;
+}
+
+/*-----------------------------------------------------------------------------
+ *  vals_check  --  whether the settings are in the range the dialog allows
+ *-----------------------------------------------------------------------------
+ */
+static gboolean vals_check(const SmoothVals *vals)
+{
+    if (vals->ang_min < 0 || vals->ang_min > 180 ||
+        vals->ang_max < 0 || vals->ang_max > 180 ||
+        !(vals->smoothing >= 0 && vals->smoothing <= 100)) {
+        PyErr_SetString(PyExc_ValueError, "angles must lie in 0 .. 180, "
+                        "and smoothing in 0 .. 100");
+        return FALSE;
+    }
+    return TRUE;
+}
+
+/*-----------------------------------------------------------------------------
+ *  format_native  --  whether a buffer format is the single item code, in
+ *                     this machine's byte order
+ *-----------------------------------------------------------------------------
+ */
+static gboolean format_native(const gchar *format, gchar code)
+{
+    if (!format)
+        return code == 'B';
+    if (*format == '@' || *format == '=' ||
+        *format == (G_BYTE_ORDER == G_LITTLE_ENDIAN ? '<' : '>'))
+        format++;
+    return format[0] == code && format[1] == '\0';
+}
+
+/*-----------------------------------------------------------------------------
+ *  points_get  --  a view of obj, which must be a writable, contiguous
+ *                  buffer of doubles, six to an anchor as in GIMP; the
+ *                  points are smoothed right there
+ *-----------------------------------------------------------------------------
+ */
+static gboolean points_get(PyObject *obj, Py_buffer *view)
+{
+    if (PyObject_GetBuffer(obj, view, PyBUF_C_CONTIGUOUS | PyBUF_FORMAT |
+                                      PyBUF_WRITABLE) < 0)
+        return FALSE;
+    if (!format_native(view->format, 'd') ||
+        view->len / sizeof(gdouble) % 6 != 0 ||
+        view->len / sizeof(gdouble) > G_MAXINT) {
+        PyErr_SetString(PyExc_ValueError, "points must be float64, "
+                        "six to an anchor");
+        PyBuffer_Release(view);
+        return FALSE;
+    }
+    return TRUE;
+}
+
+/*-----------------------------------------------------------------------------
+ *  ints_get  --  the integers of obj, a buffer of any integer or bool type
+ *                or a sequence, each within 0 .. G_MAXINT; these are the
+ *                offsets and closed flags, one or two per stroke, so
+ *                unlike the points they are copied
+ *-----------------------------------------------------------------------------
+ */
+static gint *ints_get(PyObject *obj, const gchar *name, Py_ssize_t *count)
+{
+    Py_buffer  view;
+    PyObject  *seq;
+    gint      *ints;
+    gint64     value;
+    guint64    bits;
+    gchar      code;
+    gsize      size;
+    Py_ssize_t n;
+    gboolean   is_signed;
+
+    if (!PyObject_CheckBuffer(obj)) {
+        seq = PySequence_Fast(obj, name);
+        if (!seq)
+            return NULL;
+        *count = PySequence_Fast_GET_SIZE(seq);
+        ints = g_new(gint, *count + 1);
+        for (n = 0; n < *count; n++) {
+            value = PyLong_AsLongLong(PySequence_Fast_GET_ITEM(seq, n));
+            if (value == -1 && PyErr_Occurred())
+                break;
+            if (value < 0 || value > G_MAXINT) {
+                PyErr_Format(PyExc_ValueError, "%s out of range", name);
+                break;
+            }
+            ints[n] = value;
+        }
+        Py_DECREF(seq);
+        if (n < *count) {
+            g_free(ints);
+            return NULL;
+        }
+        return ints;
+    }
+
+    if (PyObject_GetBuffer(obj, &view,
+                           PyBUF_C_CONTIGUOUS | PyBUF_FORMAT) < 0)
+        return NULL;
+    code = view.format ? view.format[strlen(view.format) - 1] : 'B';
+    size = view.itemsize;
+    if (!format_native(view.format, code) ||
+        !strchr("?bBhHiIlLqQnN", code) || size > 8) {
+        PyErr_Format(PyExc_ValueError, "%s must be of an integer type", name);
+        PyBuffer_Release(&view);
+        return NULL;
+    }
+    is_signed = (strchr("bhilqn", code) != NULL);
+
+    *count = view.len / size;
+    ints = g_new(gint, *count + 1);
+    for (n = 0; n < *count; n++) {
+        bits = 0;
+        memcpy((guint8 *) &bits +
+               (G_BYTE_ORDER == G_LITTLE_ENDIAN ? 0 : 8 - size),
+               (const guint8 *) view.buf + n * size, size);
+        if ((is_signed && (bits >> (8 * size - 1)) & 1) || bits > G_MAXINT) {
+            PyErr_Format(PyExc_ValueError, "%s out of range", name);
+            PyBuffer_Release(&view);
+            g_free(ints);
+            return NULL;
+        }
+        value = bits;
+        ints[n] = value;
+    }
+    PyBuffer_Release(&view);
+    return ints;
+}
+
+/*-----------------------------------------------------------------------------
+ *  batch_get  --  a batch that looks at the points in view, with the stroke
+ *                 offsets, in doubles, and closed flags of offsets_obj and
+ *                 closed_obj; the core reads no more of the arrays of a
+ *                 batch than data and len, so arrays only has to hold them
+ *-----------------------------------------------------------------------------
+ */
+static gboolean batch_get(const Py_buffer *view, PyObject *offsets_obj,
+                          PyObject *closed_obj, StrokeBatch *batch,
+                          GArray arrays[3])
+{
+    gint       *offsets, *closed;
+    Py_ssize_t  num_offsets, num_closed, n;
+    gboolean    ok;
+
+    offsets = ints_get(offsets_obj, "offsets", &num_offsets);
+    if (!offsets)
+        return FALSE;
+    closed = ints_get(closed_obj, "closed", &num_closed);
+    if (!closed) {
+        g_free(offsets);
+        return FALSE;
+    }
+
+    ok = (num_offsets == num_closed + 1 && offsets[0] == 0);
+    for (n = 0; ok && n < num_closed; n++)
+        ok = (offsets[n + 1] >= offsets[n] && offsets[n + 1] % 6 == 0 &&
+              closed[n] <= 1);
+    if (!ok ||
+        offsets[num_closed] > view->len / (Py_ssize_t) sizeof(gdouble)) {
+        PyErr_SetString(PyExc_ValueError, "offsets must be one more than "
+                        "the closed flags, and rise from 0 in whole anchors "
+                        "within the points; the flags must be 0 or 1");
+        g_free(offsets);
+        g_free(closed);
+        return FALSE;
+    }
+
+    arrays[0].data = view->buf;
+    arrays[0].len = offsets[num_closed];
+    arrays[1].data = (gchar *) offsets;
+    arrays[1].len = num_offsets;
+    arrays[2].data = (gchar *) closed;
+    arrays[2].len = num_closed;
+    batch->points = &arrays[0];
+    batch->offsets = &arrays[1];
+    batch->closed = &arrays[2];
+    return TRUE;
+}
+
+static void batch_release(StrokeBatch *batch)
+{
+    g_free(batch->offsets->data);
+    g_free(batch->closed->data);
+}
+
+PyDoc_STRVAR(smooth_stroke_doc,
+"smooth_stroke(points, closed=False, *, smooth_specified=False,\n"
+"              ang_min=60.0, ang_max=120.0, smoothing=0.0)\n"
+"\n"
+"Smooths one stroke in place. points is a writable, contiguous buffer of\n"
+"float64, six to an anchor as GIMP lists them: in handle, anchor and out\n"
+"handle, each x, y. The settings are those of the plugin's dialog.");
+
+static PyObject *smooth_stroke_py(PyObject *self, PyObject *args,
+                                  PyObject *kwds)
+{
+    static char   *keywords[] = { "points", "closed", SETTINGS_KEYWORDS,
+                                  NULL };
+    SmoothScratch  scratch = { NULL };
+    SmoothVals     vals = vals_default();
+    Py_buffer      view;
+    PyObject      *points;
+    gint           closed = FALSE;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "O|p" SETTINGS_FORMAT,
+                                     keywords, &points, &closed,
+                                     SETTINGS_ARGS(vals)) ||
+        !vals_check(&vals) || !points_get(points, &view))
+        return NULL;
+
+    Py_BEGIN_ALLOW_THREADS
+    smooth_stroke(&vals, view.buf, view.len / sizeof(gdouble), closed, NULL,
+                  &scratch);
+    scratch_free(&scratch);
+    Py_END_ALLOW_THREADS
+
+    PyBuffer_Release(&view);
+    Py_RETURN_NONE;
+}
+
+PyDoc_STRVAR(smooth_batch_doc,
+"smooth_batch(points, offsets, closed, *, smooth_specified=False,\n"
+"             ang_min=60.0, ang_max=120.0, smoothing=0.0, threaded=True)\n"
+"\n"
+"Smooths many strokes, packed back to back in points, in place. Stroke n\n"
+"is points[offsets[n]:offsets[n + 1]], counted in float64s, and is closed\n"
+"if closed[n] is; offsets has one entry more than closed. With threaded,\n"
+"the strokes are spread over one thread per processor when the cost\n"
+"model, see calibrate(), expects that to be faster.");
+
+static PyObject *smooth_batch_py(PyObject *self, PyObject *args,
+                                 PyObject *kwds)
+{
+    static char   *keywords[] = { "points", "offsets", "closed",
+                                  SETTINGS_KEYWORDS, "threaded", NULL };
+    SmoothScratch  scratch = { NULL };
+    SmoothVals     vals = vals_default();
+    StrokeBatch    batch;
+    GArray         arrays[3], *angles;
+    Py_buffer      view;
+    PyObject      *points, *offsets, *closed;
+    gint           threaded = TRUE;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "OOO|" SETTINGS_FORMAT "p",
+                                     keywords, &points, &offsets, &closed,
+                                     SETTINGS_ARGS(vals), &threaded) ||
+        !vals_check(&vals) || !points_get(points, &view))
+        return NULL;
+    if (!batch_get(&view, offsets, closed, &batch, arrays)) {
+        PyBuffer_Release(&view);
+        return NULL;
+    }
+
+    Py_BEGIN_ALLOW_THREADS
+    angles = g_array_new(FALSE, FALSE, sizeof(gdouble));
+    stroke_batch_angles(&batch, angles);
+    if (threaded) {
+        g_mutex_lock(&engine);
+        smooth_batch_threaded(&vals, &batch, (gdouble *) angles->data, NULL,
+                              &scratch);
+        g_mutex_unlock(&engine);
+    } else {
+        smooth_batch(&vals, &batch, (gdouble *) angles->data, NULL,
+                     &scratch);
+    }
+    g_array_free(angles, TRUE);
+    scratch_free(&scratch);
+    Py_END_ALLOW_THREADS
+
+    batch_release(&batch);
+    PyBuffer_Release(&view);
+    Py_RETURN_NONE;
+}
+
+PyDoc_STRVAR(calibrate_doc,
+"calibrate()\n"
+"\n"
+"Measures what smoothing costs on one thread and on the pool on this\n"
+"machine, in a few tens of milliseconds, for smooth_batch to choose by.\n"
+"Until then, batches of 20000 anchors or more use the pool.");
+
+static PyObject *calibrate_py(PyObject *self, PyObject *args)
+{
+    Py_BEGIN_ALLOW_THREADS
+    g_mutex_lock(&engine);
+    calibrate(&model);
+    g_mutex_unlock(&engine);
+    Py_END_ALLOW_THREADS
+
+    Py_RETURN_NONE;
+}
+
+PyDoc_STRVAR(frames_doc,
+"Frames(*, smooth_specified=False, ang_min=60.0, ang_max=120.0,\n"
+"       smoothing=0.0)\n"
+"\n"
+"Smooths the frames of an animation one after the other. A frame whose\n"
+"strokes have as many anchors as those of the frame before only has the\n"
+"anchors near the ones that moved solved again, and stays within 0.01\n"
+"pixels of smoothing it on its own.");
+
+static int frames_init(Frames *self, PyObject *args, PyObject *kwds)
+{
+    static char *keywords[] = { SETTINGS_KEYWORDS, NULL };
+    SmoothVals   vals = vals_default();
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|" SETTINGS_FORMAT,
+                                     keywords, SETTINGS_ARGS(vals)) ||
+        !vals_check(&vals))
+        return -1;
+    self->vals = vals;
+    g_mutex_lock(&engine);
+    frame_state_free(&self->state);
+    frame_state_init(&self->state);
+    g_mutex_unlock(&engine);
+    return 0;
+}
+
+static PyObject *frames_new(PyTypeObject *type, PyObject *args,
+                            PyObject *kwds)
+{
+    Frames *self;
+
+    self = (Frames *) type->tp_alloc(type, 0);
+    if (self) {
+        self->vals = vals_default();
+        frame_state_init(&self->state);
+    }
+    return (PyObject *) self;
+}
+
+static void frames_dealloc(Frames *self)
+{
+    frame_state_free(&self->state);
+    scratch_free(&self->scratch);
+    Py_TYPE(self)->tp_free((PyObject *) self);
+}
+
+PyDoc_STRVAR(frames_smooth_doc,
+"smooth(points, offsets, closed)\n"
+"\n"
+"Smooths the next frame in place; the arguments are those of\n"
+"smooth_batch.");
+
+static PyObject *frames_smooth(Frames *self, PyObject *args)
+{
+    StrokeBatch  batch;
+    GArray       arrays[3];
+    Py_buffer    view;
+    PyObject    *points, *offsets, *closed;
+
+    if (!PyArg_ParseTuple(args, "OOO", &points, &offsets, &closed) ||
+        !points_get(points, &view))
+        return NULL;
+    if (!batch_get(&view, offsets, closed, &batch, arrays)) {
+        PyBuffer_Release(&view);
+        return NULL;
+    }
+
+    Py_BEGIN_ALLOW_THREADS
+    g_mutex_lock(&engine);
+    smooth_frame(&self->vals, &self->state, &batch, 0,
+                 stroke_batch_len(&batch), &self->scratch);
+    g_mutex_unlock(&engine);
+    Py_END_ALLOW_THREADS
+
+    batch_release(&batch);
+    PyBuffer_Release(&view);
+    Py_RETURN_NONE;
+}
+
+static PyMethodDef frames_methods[] =
+{
+    { "smooth", (PyCFunction) frames_smooth, METH_VARARGS,
+      frames_smooth_doc },
+    { NULL }
+};
+
+static PyTypeObject frames_type =
+{
+    PyVarObject_HEAD_INIT(NULL, 0)
+    .tp_name = "smoothpath.Frames",
+    .tp_basicsize = sizeof(Frames),
+    .tp_flags = Py_TPFLAGS_DEFAULT,
+    .tp_doc = frames_doc,
+    .tp_new = frames_new,
+    .tp_init = (initproc) frames_init,
+    .tp_dealloc = (destructor) frames_dealloc,
+    .tp_methods = frames_methods,
+};
+
+static PyMethodDef smoothpath_methods[] =
+{
+    { "smooth_stroke", (PyCFunction) smooth_stroke_py,
+      METH_VARARGS | METH_KEYWORDS, smooth_stroke_doc },
+    { "smooth_batch", (PyCFunction) smooth_batch_py,
+      METH_VARARGS | METH_KEYWORDS, smooth_batch_doc },
+    { "calibrate", calibrate_py, METH_NOARGS, calibrate_doc },
+    { NULL }
+};
+
+static struct PyModuleDef smoothpath_module =
+{
+    PyModuleDef_HEAD_INIT,
+    .m_name = "smoothpath",
+    .m_doc = "The Bezier smoothing of the Smooth Path GIMP plugin.",
+    .m_size = -1,
+    .m_methods = smoothpath_methods,
+};
+
+PyMODINIT_FUNC PyInit_smoothpath(void)
+{
+    PyObject *module;
+
+    if (PyType_Ready(&frames_type) < 0)
+        return NULL;
+    module = PyModule_Create(&smoothpath_module);
+    if (!module)
+        return NULL;
+    Py_INCREF(&frames_type);
+    if (PyModule_AddObject(module, "Frames", (PyObject *) &frames_type) < 0) {
+        Py_DECREF(&frames_type);
+        Py_DECREF(module);
+        return NULL;
+    }
+    return module;
+}
@@ -0,0 +1,165 @@
+#
+#       test_smoothpath.py - tests of the smoothpath module
+#
+#       Copyright 2026 agent
+#
+#       This program is free software; you can redistribute it and/or modify
+#       it under the terms of the GNU General Public License as published by
+#       the Free Software Foundation; either version 2 of the License, or
+#       (at your option) any later version.
+#
+#       This program is distributed in the hope that it will be useful,
+#       but WITHOUT ANY WARRANTY; without even the implied warranty of
+#       MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#       GNU General Public License for more details.
+#
+#       You should have received a copy of the GNU General Public License
+#       along with this program; if not, write to the Free Software
+#       Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+#       MA 02110-1301, USA.
+
+import threading
+import unittest
+
+import numpy as np
+
+import reference
+import smoothpath
+
+
+def wobbly_strokes(rng, strokes, anchors):
+    """Wobbly circles, like traced outlines, as (strokes, anchors, 6) with
+    the handles on their anchors"""
+    angle = np.linspace(0, 2 * np.pi, anchors, endpoint=False)
+    radius = 100 + rng.uniform(-5, 5, (strokes, anchors))
+    centre = rng.uniform(0, 1000, (strokes, 1, 2))
+    anchor = centre + radius[:, :, None] * np.stack(
+        (np.cos(angle), np.sin(angle)), axis=-1)
+    return np.tile(anchor, 3)
+
+
+def packed(rng, sizes):
+    """Strokes of the given numbers of anchors, packed back to back, with
+    their offsets and every other one closed"""
+    points = np.concatenate([wobbly_strokes(rng, 1, n).ravel()
+                             for n in sizes])
+    offsets = np.concatenate(([0], np.cumsum(sizes) * 6)).astype(np.int32)
+    closed = np.arange(len(sizes)) % 2 == 1
+    return points, offsets, closed
+
+
+def one_by_one(points, offsets, closed, **settings):
+    expect = points.copy()
+    for n in range(len(closed)):
+        smoothpath.smooth_stroke(expect[offsets[n]:offsets[n + 1]],
+                                 bool(closed[n]), **settings)
+    return expect
+
+
+class TestSmoothPath(unittest.TestCase):
+
+    def setUp(self):
+        self.rng = np.random.default_rng(54)
+
+    def test_stroke_matches_numpy(self):
+        for closed in (False, True):
+            for anchors in (3, 4, 50):
+                points = wobbly_strokes(self.rng, 5, anchors)
+                expect = points.copy()
+                reference.smooth_strokes(expect, closed)
+                for stroke in points:
+                    smoothpath.smooth_stroke(stroke, closed)
+                np.testing.assert_allclose(points, expect, rtol=0,
+                                           atol=1e-9)
+
+    def test_in_place(self):
+        points = wobbly_strokes(self.rng, 3, 20)
+        before = points.copy()
+        smoothpath.smooth_stroke(points[1], True)
+        self.assertTrue(np.array_equal(points[0], before[0]))
+        self.assertFalse(np.array_equal(points[1], before[1]))
+        self.assertTrue(np.array_equal(points[2], before[2]))
+
+    def test_refused_buffers(self):
+        points = wobbly_strokes(self.rng, 1, 10)
+        points.flags.writeable = False
+        self.assertRaises((BufferError, ValueError),
+                          smoothpath.smooth_stroke, points)
+        points = wobbly_strokes(self.rng, 2, 10)
+        self.assertRaises((BufferError, ValueError),
+                          smoothpath.smooth_stroke, points[:, ::2])
+        self.assertRaises(ValueError, smoothpath.smooth_stroke,
+                          points.astype(np.float32))
+        self.assertRaises(ValueError, smoothpath.smooth_stroke,
+                          points.ravel()[:-1])
+        self.assertRaises(ValueError, smoothpath.smooth_stroke, points,
+                          ang_min=-1)
+        self.assertRaises(ValueError, smoothpath.smooth_stroke, points,
+                          smoothing=-1)
+
+    def test_batch_matches_strokes(self):
+        # Enough anchors for the pool, until calibrate() says otherwise
+        points, offsets, closed = packed(self.rng,
+                                         [3, 40, 7, 1, 200, 12] + [400] * 50)
+        for settings in ({}, {"smoothing": 5.0},
+                         {"smooth_specified": True, "ang_min": 150.0,
+                          "ang_max": 179.0}):
+            expect = one_by_one(points, offsets, closed, **settings)
+            for threaded in (False, True):
+                result = points.copy()
+                smoothpath.smooth_batch(result, offsets, closed,
+                                        threaded=threaded, **settings)
+                self.assertTrue(np.array_equal(result, expect))
+
+    def test_batch_arguments(self):
+        points, offsets, closed = packed(self.rng, [5, 6])
+        expect = one_by_one(points, offsets, closed)
+        smoothpath.smooth_batch(points, [int(n) for n in offsets],
+                                [bool(c) for c in closed])
+        self.assertTrue(np.array_equal(points, expect))
+        for bad in ([0, 30], [0, 31, 66], [0, 66, 30], [6, 30, 66],
+                    [0, 30, 72], [-6, 30, 66]):
+            self.assertRaises(ValueError, smoothpath.smooth_batch, points,
+                              np.array(bad), closed)
+        self.assertRaises(ValueError, smoothpath.smooth_batch, points,
+                          offsets, [0, 2])
+        self.assertRaises(ValueError, smoothpath.smooth_batch, points,
+                          offsets.astype(np.float64), closed)
+
+    def test_threads(self):
+        batches = [packed(self.rng, [30] * 50) for n in range(4)]
+        expect = [one_by_one(*batch) for batch in batches]
+        threads = [threading.Thread(target=smoothpath.smooth_batch,
+                                    args=batch, kwargs={"threaded": False})
+                   for batch in batches]
+        for thread in threads:
+            thread.start()
+        for thread in threads:
+            thread.join()
+        for batch, result in zip(batches, expect):
+            self.assertTrue(np.array_equal(batch[0], result))
+
+
+    def test_calibrate(self):
+        smoothpath.calibrate()
+        points, offsets, closed = packed(self.rng, [500] * 60)
+        expect = one_by_one(points, offsets, closed)
+        smoothpath.smooth_batch(points, offsets, closed)
+        self.assertTrue(np.array_equal(points, expect))
+
+    def test_frames(self):
+        for smoothing in (0.0, 10.0):
+            points, offsets, closed = packed(self.rng, [60, 80, 25])
+            frames = smoothpath.Frames(smoothing=smoothing)
+            for frame in range(12):
+                points[6 * (frame * 7 % 160) + 2:][:2] += 3.0
+                result = points.copy()
+                frames.smooth(result, offsets, closed)
+                expect = one_by_one(points, offsets, closed,
+                                    smoothing=smoothing)
+                np.testing.assert_allclose(result, expect, rtol=0,
+                                           atol=0.01)
+
+
+if __name__ == "__main__":
+    unittest.main()
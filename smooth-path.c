@@ -19,16 +19,135 @@
  *      MA 02110-1301, USA.
  */
 
+/* SMOOTH_PATH_CORE builds only the smoothing code, on GLib alone, for
+ * programs other than GIMP to call */
+#ifdef SMOOTH_PATH_CORE
+#include <glib.h>
+#else
 #include <libgimp/gimp.h>
 #include <libgimp/gimpui.h>
+#endif
 #include <math.h>
+#include <string.h>
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+/* GIMP 3 replaced the procedural plug-in API with GimpPlugIn objects, and
+ * vectors with paths; the smoothing code itself is shared by both */
+#ifndef SMOOTH_PATH_CORE
+#if GIMP_CHECK_VERSION(2, 99, 0)
+#define SMOOTH_PATH_GIMP3 1
+#else
+#define SMOOTH_PATH_GIMP2 1
+#endif
+#endif
 
 #define rad_to_deg(angle) ((angle) * 360.0 / (2.0 * G_PI))
 
 #define PLUG_IN_PROC "plug-in-smooth-path"
 #define PLUG_IN_BINARY "smooth-path"
 #define SCALE_WIDTH 125
+#define CORNER_BINS 36
+
+#define REVERT_PROC "plug-in-smooth-path-revert"
+#define FRAMES_PROC "plug-in-smooth-path-frames"
+#define CALIBRATE_PROC "plug-in-smooth-path-calibrate"
+#define REFINE_PROC    "plug-in-smooth-path-refine"
+
+/* The file in the GIMP directory that the measured cost model is kept in,
+ * and the layout it has to have to be used */
+#define CALIBRATION_FILE    "smooth-path-calibration"
+#define CALIBRATION_VERSION 1
+/* The anchors calibration times the engines on, as CALIBRATION_STROKES
+ * strokes and again cut into strokes of CALIBRATION_SHORT anchors */
+#define CALIBRATION_STROKES 64
+#define CALIBRATION_ANCHORS 500
+#define CALIBRATION_SHORT   10
+
+/* Anchors closer than this, in pixels, to the first of a run of anchors
+ * are collapsed into it before solving */
+#define DEGENERATE_EPSILON 0.01
+
+/* Paths with this many strokes are written back with one import instead
+ * of a PDB call per stroke */
+#define BULK_MIN_STROKES 32
+
+/* Below this many anchors starting threads costs more than it saves */
+#define POOL_MIN_ANCHORS 20000
+/* Merging costs far more per anchor than solving, so threads pay off
+ * sooner */
+#define MERGE_POOL_MIN_ANCHORS 2000
+
+/* Segments merging may put into one cubic, and the points of each that
+ * the cubic has to pass near */
+#define MERGE_MAX_RUN 16
+#define MERGE_SAMPLES 8
+
+/* Weight that keeps an anchor in place when approximating */
+#define SMOOTHING_PIN 1.0e8
+
+/* Anchors that smoothing is restricted to */
+#define REGION_ALL       0
+#define REGION_SELECTION 1
+#define REGION_ANCHORS   2
+
+/* The B-spline points settle by a factor 2 - sqrt(3) = 0.27 per anchor away
+ * from a disturbance, so this far out the edge of a window doesn't show */
+#define REGION_MARGIN 16
+
+/* A frame keeps the handles of the previous one wherever a moved anchor
+ * would change them by less than this many pixels, and is solved whole
+ * every FRAME_REFRESH frames so that these leftovers can't add up */
+#define FRAME_TOLERANCE 1.0e-4
+#define FRAME_REFRESH   100
+
+/* How strokes whose ends touch are smoothed: each on its own, joined
+ * into one, or joined and then cut apart again where they were */
+#define JOIN_NONE  0
+#define JOIN_KEEP  1
+#define JOIN_SPLIT 2
+/* Ends of strokes closer than this, in pixels, touch */
+#define JOIN_TOLERANCE 0.01
+
+/* What join_batch notes about each stroke: which of its ends it joined,
+ * and whether it runs backwards in the joined stroke */
+#define JOINED_START    1
+#define JOINED_END      2
+#define JOINED_REVERSED 4
+
+/* How well a stroke was smoothed with a deadline: solved as asked, given
+ * handles from its neighbouring anchors only, or left as it was */
+#define QUALITY_EXACT 0
+#define QUALITY_LOCAL 1
+#define QUALITY_NONE  2
+/* What an anchor is taken to cost in microseconds, solved and with local
+ * handles, until a deadline run has timed some */
+#define DEADLINE_GUESS_EXACT 0.2
+#define DEADLINE_GUESS_LOCAL 0.02
+
+/* Fill rules for rasterising the smoothed path into a channel */
+#define FILL_NONE    0
+#define FILL_NONZERO 1
+#define FILL_EVENODD 2
+
+/* Curves are flattened until they stray less than this from their lines */
+#define FLATTEN_TOLERANCE 0.1
+/* Rows of coverage rasterised together by one thread */
+#define RASTER_BAND 64
 
+/* Parasite with the control points a path had before it was smoothed */
+#define ORIGINAL_PARASITE "smooth-path-original"
+#define ORIGINAL_MAGIC    0x534d5033
+/* Parasite with the strokes a deadline left for refining, and the settings
+ * to refine them with */
+#define DEGRADED_PARASITE "smooth-path-degraded"
+#define DEGRADED_MAGIC    0x534d5045
+
+#ifdef SMOOTH_PATH_GIMP2
 static void query(void);
 static void run(const gchar      *name,
                 gint              nparams,
@@ -43,22 +162,223 @@ GimpPlugInInfo PLUG_IN_INFO =
     query,
     run
 };
+#endif
 
 typedef struct
 {
     gint32   smooth_specified;
     gdouble  ang_min;
     gdouble  ang_max;
+    gdouble  smoothing;
+    gint32   region;
+    gint32   first_anchor;
+    gint32   last_anchor;
+    gint32   fill;
+    gdouble  merge;
+    gint32   join;
+    gdouble  deadline;
 } SmoothVals;
 
+#ifdef SMOOTH_PATH_GIMP2
 static SmoothVals svals =
 {
     FALSE,
      60.0,
-    120.0
+    120.0,
+      0.0,
+    REGION_ALL,
+      0,
+     -1,
+    FILL_NONE,
+      0.0,
+    JOIN_NONE,
+      0.0
+};
+#endif
+
+typedef struct
+{
+    GString *out;
+    gint     precision;
+    gchar    format[8];
+} PathWriter;
+
+/* A double as f * 2^e, with all 64 bits of f to work in */
+typedef struct
+{
+    guint64 f;
+    gint    e;
+} DiyFp;
+
+/* Work arrays reused for every stroke of a path */
+typedef struct
+{
+    gdouble *kx, *ky;
+    gdouble *bx, *by;
+    gdouble *c;
+    gdouble *angles;
+    gdouble *d, *e, *f;
+    gint     size;
+    gdouble *window;
+    gint     window_size;
+    gdouble *factors;
+    gboolean factored;
+} SmoothScratch;
+
+/* Hardware events counted around the solve when SMOOTH_PATH_STATS=perf */
+#define COUNTER_COUNT 5
+
+static const gchar *counter_names[COUNTER_COUNT] =
+{
+    "cycles", "instructions", "L1d misses", "LLC misses", "branch misses"
 };
 
+/* The counters of one thread, opened as one group so that they are all
+ * counted over the same stretch of time, and what they have counted */
+typedef struct
+{
+    gint         leader;
+    gint         fd[COUNTER_COUNT];
+    gboolean     counted[COUNTER_COUNT];
+    guint64      value[COUNTER_COUNT];
+} CounterGroup;
+
+/* Where the time goes, printed when SMOOTH_PATH_STATS is set */
+typedef struct
+{
+    gboolean     enabled;
+    gboolean     counters;
+    const gchar *engine;
+    const gchar *transport;
+    gboolean     from_original;
+    gint         threads;
+    gint         strokes;
+    gint         anchors;
+    gint         pdb_calls;
+    gint64       solve_time;
+    gint64       total_time;
+    gint         raster_lines;
+    gint64       raster_time;
+    gint         frames;
+    gint         resolved;
+    gint         segments_in;
+    gint         segments_out;
+    gint64       merge_time;
+    gint64       predicted_time;
+    gboolean     calibrated;
+    gint         collapsed;
+    gint         joins;
+    gint         joined;
+    gdouble      deadline;
+    gint         quality[3];
+    gboolean     counting;
+    CounterGroup group;
+} SmoothStats;
+
+static SmoothStats stats;
+
+/* What an anchor and a stroke cost to solve on one thread of this
+ * machine, interpolating ([0]) and approximating ([1]), in microseconds,
+ * how many times faster the pool is with all processors busy, and what
+ * starting it costs; version 0 means nothing was measured, and the fixed
+ * POOL_MIN_ANCHORS decides */
+typedef struct
+{
+    gint32   version;
+    gint32   processors;
+    gdouble  anchor[2];
+    gdouble  stroke[2];
+    gdouble  speedup[2];
+    gdouble  pool_start;
+} SmoothModel;
+
+static SmoothModel model;
+
+/* Control points of many strokes, packed back to back; stroke n owns the
+ * entries offsets[n] .. offsets[n + 1] - 1 of points */
+typedef struct
+{
+    GArray *points;
+    GArray *offsets;
+    GArray *closed;
+} StrokeBatch;
+
+/* A batch with its runs of anchors on one another collapsed, and the angles
+ * and mask to smooth it with */
+typedef struct
+{
+    StrokeBatch  reduced;
+    GArray      *map;
+    GArray      *angles;
+    GArray      *mask;
+    gint         removed;
+} CollapsedBatch;
+
+/* What smooth_frame remembers of the previous frame of an animation */
+typedef struct
+{
+    StrokeBatch  input;
+    StrokeBatch  output;
+    GArray      *angles;
+    GArray      *factors;
+    GArray      *factored;
+    GArray      *reach;
+    GArray      *mask;
+    gint         frames;
+} FrameState;
+
+/* One worker thread's share of a batch: strokes first .. last - 1 */
+typedef struct
+{
+    const SmoothVals *vals;
+    StrokeBatch      *batch;
+    const gdouble    *angles;
+    const guint8     *mask;
+    gint             *sizes;
+    gint              first;
+    gint              last;
+    CounterGroup      group;
+} SmoothTask;
+
+/* Called on the calling thread with each finished run of bands */
+typedef void (*RasterWriter)(const guint8 *coverage, gint x, gint y,
+                             gint width, gint height, gpointer data);
+
+/* A path flattened to lines, bucketed by band: band b uses the lines
+ * band_lines[band_start[b]] .. band_lines[band_start[b + 1] - 1] */
+typedef struct
+{
+    GArray *lines;
+    gint   *band_start;
+    gint   *band_lines;
+    gint    fill;
+    gint    x, y;
+    gint    width, height;
+} Raster;
+
+/* One worker thread's band of a raster, handed back on done when it has
+ * been computed */
+typedef struct
+{
+    const Raster *raster;
+    gint          band;
+    guint8       *out;
+    GAsyncQueue  *done;
+} RasterTask;
+
+#ifndef SMOOTH_PATH_CORE
+/* The corners of the path being smoothed, for the dialog's live count */
+typedef struct
+{
+    const GArray *corners;
+    gint          bins[CORNER_BINS];
+    gint          max_bin;
+    GtkWidget    *area;
+    GtkWidget    *label;
+} CornerPreview;
+#endif
 
+#ifdef SMOOTH_PATH_GIMP2
 MAIN()
 
 /*----------------------------------------------------------------------------- 
@@ -75,6 +395,61 @@ static void query (void)
         {GIMP_PDB_INT32,    "smooth",    "Smooth specified corners"},
         {GIMP_PDB_FLOAT,    "angle_min", "Minimum angle to be smoothed"},
         {GIMP_PDB_FLOAT,    "angle_max", "Maximum angle to be smoothed"},
+        {GIMP_PDB_FLOAT,    "smoothing", "How far anchors may move to make "
+                                         "the path smoother, 0 to keep them"},
+        {GIMP_PDB_INT32,    "region",    "Anchors that may change: 0 all, "
+                                         "1 inside the selection, 2 the "
+                                         "range below"},
+        {GIMP_PDB_INT32,    "first_anchor", "First anchor of the range, "
+                                            "counting through all strokes"},
+        {GIMP_PDB_INT32,    "last_anchor", "Last anchor of the range, -1 for "
+                                           "the end of the path"},
+        {GIMP_PDB_INT32,    "fill",      "Fill the smoothed path into a new "
+                                         "channel: 0 no, 1 nonzero, "
+                                         "2 even-odd"},
+        {GIMP_PDB_FLOAT,    "merge_tolerance", "Merge segments that one "
+                                               "cubic fits this close, in "
+                                               "pixels, 0 to keep them all"},
+        {GIMP_PDB_INT32,    "join",      "Strokes whose ends touch: 0 smooth "
+                                         "each on its own, 1 join them, "
+                                         "2 join them and split them again "
+                                         "after smoothing"},
+        {GIMP_PDB_FLOAT,    "deadline",  "Milliseconds smoothing may take: "
+                                         "the largest strokes are solved "
+                                         "first, one at a time on one "
+                                         "thread and without joining, the "
+                                         "rest get quicker handles or "
+                                         "none, 0 for no limit"},
+    };
+    static GimpParamDef revert_args[] =
+    {
+        {GIMP_PDB_INT32,    "run-mode",  "Interactive, non-interactive"},
+        {GIMP_PDB_IMAGE,    "image",     "Input image"},
+        {GIMP_PDB_VECTORS,  "path",      "Input path"},
+    };
+    static GimpParamDef frames_args[] =
+    {
+        {GIMP_PDB_INT32,      "run-mode",  "Interactive, non-interactive"},
+        {GIMP_PDB_IMAGE,      "image",     "Input image"},
+        {GIMP_PDB_INT32,      "num_paths", "Number of paths"},
+        {GIMP_PDB_INT32ARRAY, "paths",     "The paths, one per frame, in "
+                                           "order"},
+        {GIMP_PDB_INT32,      "smooth",    "Smooth specified corners"},
+        {GIMP_PDB_FLOAT,      "angle_min", "Minimum angle to be smoothed"},
+        {GIMP_PDB_FLOAT,      "angle_max", "Maximum angle to be smoothed"},
+        {GIMP_PDB_FLOAT,      "smoothing", "How far anchors may move to "
+                                           "make the path smoother, 0 to "
+                                           "keep them"},
+    };
+    static GimpParamDef refine_args[] =
+    {
+        {GIMP_PDB_INT32,    "run-mode",  "Interactive, non-interactive"},
+        {GIMP_PDB_IMAGE,    "image",     "Input image"},
+        {GIMP_PDB_VECTORS,  "path",      "Input path"},
+    };
+    static GimpParamDef calibrate_args[] =
+    {
+        {GIMP_PDB_INT32,      "run-mode",  "Interactive, non-interactive"},
     };
 
     gimp_install_procedure(
@@ -91,320 +466,4578 @@ static void query (void)
         args, NULL);
 
     gimp_plugin_menu_register("plug-in-smooth-path", "<Vectors>");
+
+    gimp_install_procedure(
+        REVERT_PROC,
+        "Undo the smoothing of a path",
+        "Restores the control points a path had before Smooth Path was "
+        "first run on it",
+        "agent",
+        "agent",
+        "October 2026",
+        "Revert Smoothing",
+        "*",
+        GIMP_PLUGIN,
+        G_N_ELEMENTS(revert_args), 0,
+        revert_args, NULL);
+
+    gimp_plugin_menu_register(REVERT_PROC, "<Vectors>");
+
+    gimp_install_procedure(
+        FRAMES_PROC,
+        "Smooth paths that are the frames of an animation",
+        "Like plug-in-smooth-path on each path in turn, but a path whose "
+        "strokes have the same number of anchors as the one before only "
+        "has the anchors near the ones that moved solved again",
+        "agent",
+        "agent",
+        "October 2026",
+        NULL,
+        "*",
+        GIMP_PLUGIN,
+        G_N_ELEMENTS(frames_args), 0,
+        frames_args, NULL);
+
+    gimp_install_procedure(
+        REFINE_PROC,
+        "Finish smoothing a path that ran out of time",
+        "Solves the strokes that plug-in-smooth-path left unsolved when it "
+        "was given a deadline, with the settings it was given, on all "
+        "threads but, like that run, without joining touching strokes",
+        "agent",
+        "agent",
+        "October 2026",
+        NULL,
+        "*",
+        GIMP_PLUGIN,
+        G_N_ELEMENTS(refine_args), 0,
+        refine_args, NULL);
+
+    gimp_install_procedure(
+        CALIBRATE_PROC,
+        "Measure how fast paths are smoothed on this computer",
+        "Times smoothing on one thread and on several, which Smooth Path "
+        "otherwise only does when it has no measurements yet, and keeps "
+        "the result in the GIMP directory to choose between them by the "
+        "size of each path",
+        "agent",
+        "agent",
+        "October 2026",
+        NULL,
+        NULL,
+        GIMP_PLUGIN,
+        G_N_ELEMENTS(calibrate_args), 0,
+        calibrate_args, NULL);
 }
+#endif
 
 /*----------------------------------------------------------------------------- 
- *  angle_between  --  determines the abs(angle) between two vectors formed by
- *                     the points va, vb, vc (i.e. va-->vb, vb-->vc) in degrees
+ *  corner_angle  --  determines the abs(angle) between two vectors formed by
+ *                    the points va, vb, vc (i.e. va-->vb, vb-->vc) in degrees
  *-----------------------------------------------------------------------------
  */
-gboolean angle_between(gdouble vax, gdouble vay, gdouble vbx, gdouble vby,
-                       gdouble vcx, gdouble vcy)
+gdouble corner_angle(gdouble vax, gdouble vay, gdouble vbx, gdouble vby,
+                     gdouble vcx, gdouble vcy)
 {
-    gdouble v1x, v1y, v2x, v2y, ret;
-    /* Ugly I know, but laziness comes before beauty */
-    if (!svals.smooth_specified) return -1;
+    gdouble v1x, v1y, v2x, v2y;
     v1x = vbx - vax;
     v1y = vby - vay;
     v2x = vcx - vbx;
     v2y = vcy - vby;
-    ret = 180 - ABS(rad_to_deg(atan2(-v1y*v2x + v1x*v2y, v1x*v2x + v1y*v2y)));
-    if (svals.ang_max > svals.ang_min)
-        return (ret < svals.ang_max && ret > svals.ang_min);
+    return 180 - ABS(rad_to_deg(atan2(-v1y*v2x + v1x*v2y, v1x*v2x + v1y*v2y)));
+}
+
+/*-----------------------------------------------------------------------------
+ *  anchor_smoothed  --  decides whether the handles of an anchor with the
+ *                       given corner angle get replaced; the ends of an open
+ *                       stroke have no angle (-1) and are only smoothed when
+ *                       all corners are
+ *-----------------------------------------------------------------------------
+ */
+gboolean anchor_smoothed(const SmoothVals *vals, gdouble angle)
+{
+    if (!vals->smooth_specified)
+        return TRUE;
+    if (angle < 0)
+        return FALSE;
+    if (vals->ang_max > vals->ang_min)
+        return (angle < vals->ang_max && angle > vals->ang_min);
     else
-        return (ret < svals.ang_max || ret > svals.ang_min);
+        return (angle < vals->ang_max || angle > vals->ang_min);
+}
+
+/*-----------------------------------------------------------------------------
+ *  stroke_corner_angle  --  the corner angle at anchor n of a stroke of len
+ *                           anchors, -1 for the ends of an open stroke
+ *-----------------------------------------------------------------------------
+ */
+gdouble stroke_corner_angle(const gdouble *ctlpts, gint len, gboolean closed,
+                            gint n)
+{
+    gint prev, next;
+
+    if (!closed && (n == 0 || n == len - 1))
+        return -1;
+    prev = (n == 0) ? len - 1 : n - 1;
+    next = (n == len - 1) ? 0 : n + 1;
+    return corner_angle(ctlpts[prev * 6 + 2], ctlpts[prev * 6 + 3],
+                        ctlpts[n * 6 + 2], ctlpts[n * 6 + 3],
+                        ctlpts[next * 6 + 2], ctlpts[next * 6 + 3]);
+}
+
+/*-----------------------------------------------------------------------------
+ *  stroke_corner_angles  --  measures the corner angle at every anchor of a
+ *                            stroke, -1 for the ends of an open stroke
+ *-----------------------------------------------------------------------------
+ */
+void stroke_corner_angles(const gdouble *ctlpts, gint num_points,
+                          gboolean closed, gdouble *angles)
+{
+    gint n, len;
+
+    len = num_points / 6;
+    for (n = 0; n < len; n++)
+        angles[n] = stroke_corner_angle(ctlpts, len, closed, n);
+}
+
+/*-----------------------------------------------------------------------------
+ *  scratch_reserve  --  makes sure the scratch arrays hold size entries; they
+ *                       only ever grow, so a whole path is smoothed with a
+ *                       handful of allocations
+ *-----------------------------------------------------------------------------
+ */
+void scratch_reserve(SmoothScratch *scratch, gint size)
+{
+    if (size <= scratch->size)
+        return;
+    scratch->size = MAX(size, 2 * scratch->size);
+    g_free(scratch->kx);
+    scratch->kx = g_new(gdouble, 9 * scratch->size);
+    scratch->ky = scratch->kx + scratch->size;
+    scratch->bx = scratch->ky + scratch->size;
+    scratch->by = scratch->bx + scratch->size;
+    scratch->c  = scratch->by + scratch->size;
+    scratch->angles = scratch->c + scratch->size;
+    scratch->d = scratch->angles + scratch->size;
+    scratch->e = scratch->d + scratch->size;
+    scratch->f = scratch->e + scratch->size;
+}
+
+void scratch_free(SmoothScratch *scratch)
+{
+    g_free(scratch->kx);
+    scratch->kx = scratch->ky = scratch->bx = scratch->by = scratch->c = NULL;
+    scratch->angles = scratch->d = scratch->e = scratch->f = NULL;
+    scratch->size = 0;
+    g_free(scratch->window);
+    scratch->window = NULL;
+    scratch->window_size = 0;
+}
+
+/*-----------------------------------------------------------------------------
+ *  triagonal_solve  --  solves a tridiagonal system of simultaneous equations
+ *                       for x and y at once; dx and dy hold the right hand
+ *                       sides on entry and the solutions on return
+ *-----------------------------------------------------------------------------
+ */
+void triagonal_solve(gdouble *dx, gdouble *dy, gdouble *c, gint len)
+{
+    gdouble id;
+    gint i;
+
+    c[0] = 0.25;
+    dx[0] *= 0.25;
+    dy[0] *= 0.25;
+    for (i = 1; i < len; i++) {
+        id = 4.0 - c[i - 1];
+        c[i] = 1.0 / id;
+        dx[i] = (dx[i] - dx[i - 1]) / id;
+        dy[i] = (dy[i] - dy[i - 1]) / id;
+    }
+    for (i = len - 2; i >= 0; i--) {
+        dx[i] = dx[i] - c[i] * dx[i + 1];
+        dy[i] = dy[i] - c[i] * dy[i + 1];
+    }
+}
+
+/*-----------------------------------------------------------------------------
+ *  pentadiagonal_factor  --  factorises a symmetric positive definite matrix
+ *                            with two bands either side of the diagonal as
+ *                            LDL'; d, e and f hold the diagonal and the
+ *                            entries one and two to its right, and are
+ *                            overwritten by the factors
+ *-----------------------------------------------------------------------------
+ */
+void pentadiagonal_factor(gdouble *d, gdouble *e, gdouble *f, gint len)
+{
+    gint i;
+
+    for (i = 0; i < len; i++) {
+        if (i >= 2)
+            d[i] -= f[i - 2] * f[i - 2] * d[i - 2];
+        if (i >= 1)
+            d[i] -= e[i - 1] * e[i - 1] * d[i - 1];
+        if (i < len - 1) {
+            if (i >= 1)
+                e[i] -= f[i - 1] * d[i - 1] * e[i - 1];
+            e[i] /= d[i];
+        }
+        if (i < len - 2)
+            f[i] /= d[i];
+    }
+}
+
+/*-----------------------------------------------------------------------------
+ *  pentadiagonal_substitute  --  solves for x and y at once with the factors
+ *                                from pentadiagonal_factor, which are left
+ *                                as they are for the next right hand side;
+ *                                dx and dy hold the right hand sides on
+ *                                entry and the solutions on return
+ *-----------------------------------------------------------------------------
+ */
+void pentadiagonal_substitute(gdouble *dx, gdouble *dy, const gdouble *d,
+                              const gdouble *e, const gdouble *f, gint len)
+{
+    gint i;
+
+    for (i = 0; i < len; i++) {
+        if (i >= 2) {
+            dx[i] -= f[i - 2] * dx[i - 2];
+            dy[i] -= f[i - 2] * dy[i - 2];
+        }
+        if (i >= 1) {
+            dx[i] -= e[i - 1] * dx[i - 1];
+            dy[i] -= e[i - 1] * dy[i - 1];
+        }
+    }
+    for (i = len - 1; i >= 0; i--) {
+        dx[i] /= d[i];
+        dy[i] /= d[i];
+        if (i < len - 1) {
+            dx[i] -= e[i] * dx[i + 1];
+            dy[i] -= e[i] * dy[i + 1];
+        }
+        if (i < len - 2) {
+            dx[i] -= f[i] * dx[i + 2];
+            dy[i] -= f[i] * dy[i + 2];
+        }
+    }
+}
+
+/*-----------------------------------------------------------------------------
+ *  approximate_margin  --  how many anchors away from an anchor the
+ *                          approximation still feels it; the influence dies
+ *                          off roughly as exp(-0.7 n / smoothing^1/4)
+ *-----------------------------------------------------------------------------
+ */
+gint approximate_margin(const SmoothVals *vals)
+{
+    if (vals->smoothing <= 0)
+        return 0;
+    return 4 + (gint) (20 * pow(vals->smoothing, 0.25));
+}
+
+/*-----------------------------------------------------------------------------
+ *  approximate_size  --  number of scratch entries approximate_anchors needs
+ *                        for a stroke of len anchors; a closed stroke is
+ *                        unrolled with enough of itself on either side that
+ *                        the ends of the unrolled system no longer matter in
+ *                        the middle
+ *-----------------------------------------------------------------------------
+ */
+gint approximate_size(const SmoothVals *vals, gint len, gboolean closed)
+{
+    if (vals->smoothing <= 0)
+        return 0;
+    if (!closed)
+        return len;
+    return len + 2 * approximate_margin(vals);
+}
+
+/*-----------------------------------------------------------------------------
+ *  approximate_anchors  --  moves the anchors of a stroke onto a smoothing
+ *                           spline, i.e. minimises the squared distance to
+ *                           the old anchors plus vals->smoothing times the
+ *                           squared second differences; anchors that won't
+ *                           be smoothed, and the ends of an open stroke,
+ *                           stay where they are; if scratch->factors is set
+ *                           the matrix is factorised there instead, or, with
+ *                           scratch->factored set too, taken from there as
+ *                           it is
+ *-----------------------------------------------------------------------------
+ */
+void approximate_anchors(const SmoothVals *vals, gdouble *ctlpts,
+                         gint num_points, gboolean closed,
+                         const gdouble *angles, SmoothScratch *scratch)
+{
+    gdouble *kx, *ky, *d, *e, *f;
+    gdouble  lambda, w;
+    gint     n, i, len, m, margin;
+
+    lambda = vals->smoothing;
+    len = num_points / 6;
+    m = approximate_size(vals, len, closed);
+    margin = (m - len) / 2;
+    scratch_reserve(scratch, m);
+    kx = scratch->kx;
+    ky = scratch->ky;
+    d = scratch->factors ? scratch->factors : scratch->d;
+    e = scratch->factors ? scratch->factors + m : scratch->e;
+    f = scratch->factors ? scratch->factors + 2 * m : scratch->f;
+
+    /* Pinned anchors get a weight so heavy they can't move noticeably, and
+     * are put back exactly afterwards */
+    for (n = 0; n < m; n++) {
+        i = ((n - margin) % len + len) % len;
+        w = anchor_smoothed(vals, angles[i]) ? 1.0 : SMOOTHING_PIN;
+        if (!closed && (n == 0 || n == m - 1))
+            w = SMOOTHING_PIN;
+        kx[n] = w * ctlpts[i * 6 + 2];
+        ky[n] = w * ctlpts[i * 6 + 3];
+        if (!(scratch->factors && scratch->factored)) {
+            d[n] = w;
+            e[n] = 0;
+            f[n] = 0;
+        }
+    }
+    if (!(scratch->factors && scratch->factored)) {
+        for (n = 0; n < m - 2; n++) {
+            d[n] += lambda;
+            d[n + 1] += 4 * lambda;
+            d[n + 2] += lambda;
+            e[n] -= 2 * lambda;
+            e[n + 1] -= 2 * lambda;
+            f[n] += lambda;
+        }
+        pentadiagonal_factor(d, e, f, m);
+    }
+    pentadiagonal_substitute(kx, ky, d, e, f, m);
+
+    for (n = 0; n < len; n++) {
+        if (!anchor_smoothed(vals, angles[n]) ||
+            (!closed && (n == 0 || n == len - 1)))
+            continue;
+        ctlpts[n * 6 + 2] = kx[n + margin];
+        ctlpts[n * 6 + 3] = ky[n + margin];
+    }
+}
+
+/*-----------------------------------------------------------------------------
+ *  smooth_stroke  --  starting from a set of control points in a GIMP stroke
+ *                     generate a new set of control points, in place, such
+ *                     that the Bezier curves are smoothly interpolated
+ *                     between each other; angles holds the corner angles
+ *                     if they are already known, or is NULL
+ *-----------------------------------------------------------------------------
+ */
+void smooth_stroke(const SmoothVals *vals, gdouble *ctlpts, gint num_points,
+                   gboolean closed, const gdouble *angles,
+                   SmoothScratch *scratch)
+{
+    gdouble *kx, *ky, *bx, *by;
+    gint     n, i, len, m, first;
+
+    /* Must have at least 3 anchor points, i.e. 18 array entries */
+    if (num_points < 18)
+        return;
+
+    len = num_points / 6;
+    m = closed ? len + 3 : len;
+    scratch_reserve(scratch, MAX(m, approximate_size(vals, len, closed)));
+    kx = scratch->kx;
+    ky = scratch->ky;
+    bx = scratch->bx;
+    by = scratch->by;
+    if (!angles) {
+        stroke_corner_angles(ctlpts, num_points, closed, scratch->angles);
+        angles = scratch->angles;
+    }
+    if (vals->smoothing > 0)
+        approximate_anchors(vals, ctlpts, num_points, closed, angles,
+                            scratch);
+
+    /* Anchor points; prepend last point, and append first two if closed */
+    first = closed ? 1 : 0;
+    for (n = 0; n < len; n++) {
+        kx[n + first] = ctlpts[n * 6 + 2];
+        ky[n + first] = ctlpts[n * 6 + 3];
+    }
+    if (closed) {
+        kx[0] = ctlpts[num_points - 4];
+        ky[0] = ctlpts[num_points - 3];
+        kx[len + 1] = ctlpts[2];
+        ky[len + 1] = ctlpts[3];
+        kx[len + 2] = ctlpts[8];
+        ky[len + 2] = ctlpts[9];
+    }
+
+    /* Solve for the B-spline points, the two ends are the anchors */
+    bx[0] = kx[0];
+    by[0] = ky[0];
+    bx[m - 1] = kx[m - 1];
+    by[m - 1] = ky[m - 1];
+    if (m == 3) {
+        bx[1] = 1.50 * kx[1] - 0.25 * kx[0] - 0.25 * kx[2];
+        by[1] = 1.50 * ky[1] - 0.25 * ky[0] - 0.25 * ky[2];
+    } else {
+        for (n = 1; n < m - 1; n++) {
+            bx[n] = 6 * kx[n];
+            by[n] = 6 * ky[n];
+        }
+        bx[1] -= kx[0];
+        by[1] -= ky[0];
+        bx[m - 2] -= kx[m - 1];
+        by[m - 2] -= ky[m - 1];
+        triagonal_solve(bx + 1, by + 1, scratch->c, m - 2);
+    }
+
+    /* The handles lie a third of the way along to the neighbouring B-spline
+     * points; the first anchor of a closed stroke takes its in handle from
+     * the padding at the end */
+    for (n = 0; n < len; n++) {
+        if (!anchor_smoothed(vals, angles[n]))
+            continue;
+        if (closed || n > 0) {
+            i = (closed && n == 0) ? len + 1 : n + first;
+            ctlpts[n * 6 + 0] = bx[i - 1] / 3 + 2 * bx[i] / 3;
+            ctlpts[n * 6 + 1] = by[i - 1] / 3 + 2 * by[i] / 3;
+        }
+        if (closed || n < len - 1) {
+            i = n + first;
+            ctlpts[n * 6 + 4] = 2 * bx[i] / 3 + bx[i + 1] / 3;
+            ctlpts[n * 6 + 5] = 2 * by[i] / 3 + by[i + 1] / 3;
+        }
+    }
+}
+
+/*-----------------------------------------------------------------------------
+ *  smooth_stroke_region  --  like smooth_stroke, but only the anchors whose
+ *                            mask entry is set may change; each run of them
+ *                            is copied out with a margin of its neighbours
+ *                            on either side and smoothed as an open stroke
+ *                            of its own, so the work follows the size of
+ *                            the region rather than the length of the stroke
+ *-----------------------------------------------------------------------------
+ */
+void smooth_stroke_region(const SmoothVals *vals, gdouble *ctlpts,
+                          gint num_points, gboolean closed,
+                          const gdouble *angles, const guint8 *mask,
+                          SmoothScratch *scratch)
+{
+    SmoothVals  window_vals;
+    gdouble    *stroke_angles, *window, *window_angles;
+    gint        len, margin, first, last, next, n, k;
+
+    /* Must have at least 3 anchor points, i.e. 18 array entries */
+    if (num_points < 18)
+        return;
+
+    len = num_points / 6;
+    if (scratch->window_size < 8 * len) {
+        g_free(scratch->window);
+        scratch->window_size = MAX(8 * len, 2 * scratch->window_size);
+        scratch->window = g_new(gdouble, scratch->window_size);
+    }
+    stroke_angles = scratch->window;
+    window_angles = stroke_angles + len;
+    window = window_angles + len;
+    if (!angles) {
+        stroke_corner_angles(ctlpts, num_points, closed, stroke_angles);
+        angles = stroke_angles;
+    }
+
+    /* Every window is smoothed with settings that take the anchors marked 90
+     * and leave the ones marked -1 alone */
+    window_vals = *vals;
+    window_vals.smooth_specified = TRUE;
+    window_vals.ang_min = 0;
+    window_vals.ang_max = 180;
+    margin = MAX(REGION_MARGIN, approximate_margin(vals));
+    for (n = 0; n < len; n++)
+        window_angles[n] = (mask[n] && anchor_smoothed(vals, angles[n])) ?
+                           90 : -1;
+
+    /* A closed stroke is solved with its ends wrapped round, so when the
+     * region comes near them the whole stroke is solved after all */
+    if (closed) {
+        for (n = 0; n < len; n++)
+            if (window_angles[n] > 0 && (n < margin || n >= len - margin))
+                break;
+        if (n < len) {
+            smooth_stroke(&window_vals, ctlpts, num_points, TRUE,
+                          window_angles, scratch);
+            return;
+        }
+    }
+
+    for (first = 0; first < len; first = next) {
+        if (window_angles[first] < 0) {
+            next = first + 1;
+            continue;
+        }
+
+        /* Take in the runs that follow closer than two margins, then add a
+         * margin either side, as far as the stroke goes */
+        last = first;
+        for (k = first + 1; k < len && k <= last + 2 * margin + 1; k++)
+            if (window_angles[k] > 0)
+                last = k;
+        next = last + 1;
+        first = MAX(first - margin, 0);
+        last = MIN(last + margin, len - 1);
+
+        memcpy(window, ctlpts + first * 6,
+               (last - first + 1) * 6 * sizeof(gdouble));
+        smooth_stroke(&window_vals, window, (last - first + 1) * 6, FALSE,
+                      window_angles + first, scratch);
+        for (k = first; k <= last; k++)
+            if (window_angles[k] > 0)
+                memcpy(ctlpts + k * 6, window + (k - first) * 6,
+                       6 * sizeof(gdouble));
+    }
+}
+
+/*-----------------------------------------------------------------------------
+ *  smooth_strokes  --  smooths num_strokes strokes packed back to back in a
+ *                      caller owned buffer; stroke n spans the entries
+ *                      offsets[n] .. offsets[n + 1] - 1 of points, which
+ *                      are updated in place without being copied, and its
+ *                      corner angles and mask entries start at
+ *                      angles[offsets[n] / 6] and mask[offsets[n] / 6]; a
+ *                      NULL mask lets every anchor change
+ *-----------------------------------------------------------------------------
+ */
+void smooth_strokes(const SmoothVals *vals, gdouble *points,
+                    const gint *offsets, const gboolean *closed,
+                    const gdouble *angles, const guint8 *mask,
+                    gint num_strokes, SmoothScratch *scratch)
+{
+    gint n;
+
+    for (n = 0; n < num_strokes; n++) {
+        if (mask)
+            smooth_stroke_region(vals, points + offsets[n],
+                                 offsets[n + 1] - offsets[n], closed[n],
+                                 angles ? angles + offsets[n] / 6 : NULL,
+                                 mask + offsets[n] / 6, scratch);
+        else
+            smooth_stroke(vals, points + offsets[n],
+                          offsets[n + 1] - offsets[n], closed[n],
+                          angles ? angles + offsets[n] / 6 : NULL, scratch);
+    }
+}
+
+/*-----------------------------------------------------------------------------
+ *  diy_fp_multiply  --  x times y, rounded to the upper 64 bits
+ *-----------------------------------------------------------------------------
+ */
+static DiyFp diy_fp_multiply(DiyFp x, DiyFp y)
+{
+    guint64 a, b, c, d, middle;
+    DiyFp   product;
+
+    a = x.f >> 32;
+    b = x.f & 0xffffffff;
+    c = y.f >> 32;
+    d = y.f & 0xffffffff;
+    middle = (b * d >> 32) + (a * d & 0xffffffff) + (b * c & 0xffffffff) +
+             (1u << 31);
+    product.f = a * c + (a * d >> 32) + (b * c >> 32) + (middle >> 32);
+    product.e = x.e + y.e + 64;
+    return product;
+}
+
+static DiyFp diy_fp_normalize(DiyFp x)
+{
+    while (!(x.f & G_GUINT64_CONSTANT(0x8000000000000000))) {
+        x.f <<= 1;
+        x.e--;
+    }
+    return x;
+}
+
+/*-----------------------------------------------------------------------------
+ *  shortest_round_weed  --  moves the last digit down towards w while the
+ *                           digits stay inside the safe interval, and
+ *                           says whether they are then certainly the
+ *                           closest to w; all distances are from the top
+ *                           of the unsafe interval, in units of unit
+ *-----------------------------------------------------------------------------
+ */
+static gboolean shortest_round_weed(gchar *digits, gint length,
+                                    guint64 distance_too_high_w,
+                                    guint64 unsafe_interval, guint64 rest,
+                                    guint64 ten_kappa, guint64 unit)
+{
+    guint64 small_distance, big_distance;
+
+    small_distance = distance_too_high_w - unit;
+    big_distance = distance_too_high_w + unit;
+    while (rest < small_distance && unsafe_interval - rest >= ten_kappa &&
+           (rest + ten_kappa < small_distance ||
+            small_distance - rest >= rest + ten_kappa - small_distance)) {
+        digits[length - 1]--;
+        rest += ten_kappa;
+    }
+
+    /* If moving once more would also have been right for some w inside
+     * the error bounds, the rounding can't be decided here */
+    if (rest < big_distance && unsafe_interval - rest >= ten_kappa &&
+        (rest + ten_kappa < big_distance ||
+         big_distance - rest > rest + ten_kappa - big_distance))
+        return FALSE;
+    return 2 * unit <= rest && rest <= unsafe_interval - 4 * unit;
+}
+
+/*-----------------------------------------------------------------------------
+ *  shortest_digits  --  the fewest decimal digits that read back as the
+ *                       positive finite value, as value = digits *
+ *                       10^exponent, found with Loitsch's Grisu3 in 64
+ *                       bit integers; returns FALSE for the one value in
+ *                       a few hundred whose digits it can't be sure of,
+ *                       which the caller then has to find some other way
+ *-----------------------------------------------------------------------------
+ */
+gboolean shortest_digits(gdouble value, gchar *digits, gint *length,
+                         gint *exponent)
+{
+    /* 10^-348, 10^-340, ... 10^340 as normalized f * 2^e */
+    static const DiyFp powers[] = {
+    { G_GUINT64_CONSTANT(0xfa8fd5a0081c0288), -1220 },
+    { G_GUINT64_CONSTANT(0xbaaee17fa23ebf76), -1193 },
+    { G_GUINT64_CONSTANT(0x8b16fb203055ac76), -1166 },
+    { G_GUINT64_CONSTANT(0xcf42894a5dce35ea), -1140 },
+    { G_GUINT64_CONSTANT(0x9a6bb0aa55653b2d), -1113 },
+    { G_GUINT64_CONSTANT(0xe61acf033d1a45df), -1087 },
+    { G_GUINT64_CONSTANT(0xab70fe17c79ac6ca), -1060 },
+    { G_GUINT64_CONSTANT(0xff77b1fcbebcdc4f), -1034 },
+    { G_GUINT64_CONSTANT(0xbe5691ef416bd60c), -1007 },
+    { G_GUINT64_CONSTANT(0x8dd01fad907ffc3c),  -980 },
+    { G_GUINT64_CONSTANT(0xd3515c2831559a83),  -954 },
+    { G_GUINT64_CONSTANT(0x9d71ac8fada6c9b5),  -927 },
+    { G_GUINT64_CONSTANT(0xea9c227723ee8bcb),  -901 },
+    { G_GUINT64_CONSTANT(0xaecc49914078536d),  -874 },
+    { G_GUINT64_CONSTANT(0x823c12795db6ce57),  -847 },
+    { G_GUINT64_CONSTANT(0xc21094364dfb5637),  -821 },
+    { G_GUINT64_CONSTANT(0x9096ea6f3848984f),  -794 },
+    { G_GUINT64_CONSTANT(0xd77485cb25823ac7),  -768 },
+    { G_GUINT64_CONSTANT(0xa086cfcd97bf97f4),  -741 },
+    { G_GUINT64_CONSTANT(0xef340a98172aace5),  -715 },
+    { G_GUINT64_CONSTANT(0xb23867fb2a35b28e),  -688 },
+    { G_GUINT64_CONSTANT(0x84c8d4dfd2c63f3b),  -661 },
+    { G_GUINT64_CONSTANT(0xc5dd44271ad3cdba),  -635 },
+    { G_GUINT64_CONSTANT(0x936b9fcebb25c996),  -608 },
+    { G_GUINT64_CONSTANT(0xdbac6c247d62a584),  -582 },
+    { G_GUINT64_CONSTANT(0xa3ab66580d5fdaf6),  -555 },
+    { G_GUINT64_CONSTANT(0xf3e2f893dec3f126),  -529 },
+    { G_GUINT64_CONSTANT(0xb5b5ada8aaff80b8),  -502 },
+    { G_GUINT64_CONSTANT(0x87625f056c7c4a8b),  -475 },
+    { G_GUINT64_CONSTANT(0xc9bcff6034c13053),  -449 },
+    { G_GUINT64_CONSTANT(0x964e858c91ba2655),  -422 },
+    { G_GUINT64_CONSTANT(0xdff9772470297ebd),  -396 },
+    { G_GUINT64_CONSTANT(0xa6dfbd9fb8e5b88f),  -369 },
+    { G_GUINT64_CONSTANT(0xf8a95fcf88747d94),  -343 },
+    { G_GUINT64_CONSTANT(0xb94470938fa89bcf),  -316 },
+    { G_GUINT64_CONSTANT(0x8a08f0f8bf0f156b),  -289 },
+    { G_GUINT64_CONSTANT(0xcdb02555653131b6),  -263 },
+    { G_GUINT64_CONSTANT(0x993fe2c6d07b7fac),  -236 },
+    { G_GUINT64_CONSTANT(0xe45c10c42a2b3b06),  -210 },
+    { G_GUINT64_CONSTANT(0xaa242499697392d3),  -183 },
+    { G_GUINT64_CONSTANT(0xfd87b5f28300ca0e),  -157 },
+    { G_GUINT64_CONSTANT(0xbce5086492111aeb),  -130 },
+    { G_GUINT64_CONSTANT(0x8cbccc096f5088cc),  -103 },
+    { G_GUINT64_CONSTANT(0xd1b71758e219652c),   -77 },
+    { G_GUINT64_CONSTANT(0x9c40000000000000),   -50 },
+    { G_GUINT64_CONSTANT(0xe8d4a51000000000),   -24 },
+    { G_GUINT64_CONSTANT(0xad78ebc5ac620000),     3 },
+    { G_GUINT64_CONSTANT(0x813f3978f8940984),    30 },
+    { G_GUINT64_CONSTANT(0xc097ce7bc90715b3),    56 },
+    { G_GUINT64_CONSTANT(0x8f7e32ce7bea5c70),    83 },
+    { G_GUINT64_CONSTANT(0xd5d238a4abe98068),   109 },
+    { G_GUINT64_CONSTANT(0x9f4f2726179a2245),   136 },
+    { G_GUINT64_CONSTANT(0xed63a231d4c4fb27),   162 },
+    { G_GUINT64_CONSTANT(0xb0de65388cc8ada8),   189 },
+    { G_GUINT64_CONSTANT(0x83c7088e1aab65db),   216 },
+    { G_GUINT64_CONSTANT(0xc45d1df942711d9a),   242 },
+    { G_GUINT64_CONSTANT(0x924d692ca61be758),   269 },
+    { G_GUINT64_CONSTANT(0xda01ee641a708dea),   295 },
+    { G_GUINT64_CONSTANT(0xa26da3999aef774a),   322 },
+    { G_GUINT64_CONSTANT(0xf209787bb47d6b85),   348 },
+    { G_GUINT64_CONSTANT(0xb454e4a179dd1877),   375 },
+    { G_GUINT64_CONSTANT(0x865b86925b9bc5c2),   402 },
+    { G_GUINT64_CONSTANT(0xc83553c5c8965d3d),   428 },
+    { G_GUINT64_CONSTANT(0x952ab45cfa97a0b3),   455 },
+    { G_GUINT64_CONSTANT(0xde469fbd99a05fe3),   481 },
+    { G_GUINT64_CONSTANT(0xa59bc234db398c25),   508 },
+    { G_GUINT64_CONSTANT(0xf6c69a72a3989f5c),   534 },
+    { G_GUINT64_CONSTANT(0xb7dcbf5354e9bece),   561 },
+    { G_GUINT64_CONSTANT(0x88fcf317f22241e2),   588 },
+    { G_GUINT64_CONSTANT(0xcc20ce9bd35c78a5),   614 },
+    { G_GUINT64_CONSTANT(0x98165af37b2153df),   641 },
+    { G_GUINT64_CONSTANT(0xe2a0b5dc971f303a),   667 },
+    { G_GUINT64_CONSTANT(0xa8d9d1535ce3b396),   694 },
+    { G_GUINT64_CONSTANT(0xfb9b7cd9a4a7443c),   720 },
+    { G_GUINT64_CONSTANT(0xbb764c4ca7a44410),   747 },
+    { G_GUINT64_CONSTANT(0x8bab8eefb6409c1a),   774 },
+    { G_GUINT64_CONSTANT(0xd01fef10a657842c),   800 },
+    { G_GUINT64_CONSTANT(0x9b10a4e5e9913129),   827 },
+    { G_GUINT64_CONSTANT(0xe7109bfba19c0c9d),   853 },
+    { G_GUINT64_CONSTANT(0xac2820d9623bf429),   880 },
+    { G_GUINT64_CONSTANT(0x80444b5e7aa7cf85),   907 },
+    { G_GUINT64_CONSTANT(0xbf21e44003acdd2d),   933 },
+    { G_GUINT64_CONSTANT(0x8e679c2f5e44ff8f),   960 },
+    { G_GUINT64_CONSTANT(0xd433179d9c8cb841),   986 },
+    { G_GUINT64_CONSTANT(0x9e19db92b4e31ba9),  1013 },
+    { G_GUINT64_CONSTANT(0xeb96bf6ebadf77d9),  1039 },
+    { G_GUINT64_CONSTANT(0xaf87023b9bf0ee6b),  1066 }
+    };
+    DiyFp    w, plus, minus, scaled_w, too_low, too_high, one;
+    guint64  bits, unsafe_interval, fractionals, rest, unit;
+    guint32  integrals, divisor;
+    gdouble  dk;
+    gint     k, index, kappa;
+
+    memcpy(&bits, &value, sizeof(bits));
+    w.f = bits & G_GUINT64_CONSTANT(0xfffffffffffff);
+    w.e = (bits >> 52) & 0x7ff;
+    if (value <= 0 || w.e == 0x7ff)
+        return FALSE;
+
+    /* The halfway points to the neighbouring doubles, of which the lower
+     * one is closer if value is a power of two */
+    if (w.e > 0) {
+        w.f |= G_GUINT64_CONSTANT(0x10000000000000);
+        w.e -= 1075;
+    } else {
+        w.e = -1074;
+    }
+    plus.f = (w.f << 1) + 1;
+    plus.e = w.e - 1;
+    plus = diy_fp_normalize(plus);
+    if (w.f == G_GUINT64_CONSTANT(0x10000000000000) && w.e > -1074) {
+        minus.f = (w.f << 2) - 1;
+        minus.e = w.e - 2;
+    } else {
+        minus.f = (w.f << 1) - 1;
+        minus.e = w.e - 1;
+    }
+    minus.f <<= minus.e - plus.e;
+    minus.e = plus.e;
+    w = diy_fp_normalize(w);
+
+    /* Scale by the cached power of ten that puts the binary exponent
+     * between -60 and -32, so the integral part fits 32 bits */
+    dk = (-61 - plus.e) * 0.30102999566398114 + 347;
+    k = (gint) dk;
+    if (dk - k > 0.0)
+        k++;
+    index = (k >> 3) + 1;
+    *exponent = 348 - index * 8;
+    scaled_w = diy_fp_multiply(w, powers[index]);
+    too_low = diy_fp_multiply(minus, powers[index]);
+    too_high = diy_fp_multiply(plus, powers[index]);
+
+    /* Each product is off by at most half a unit, so the digits are only
+     * safe well inside the interval, and certainly wrong outside of it */
+    unit = 1;
+    too_low.f -= unit;
+    too_high.f += unit;
+    unsafe_interval = too_high.f - too_low.f;
+    one.f = (guint64) 1 << -scaled_w.e;
+    one.e = scaled_w.e;
+    integrals = too_high.f >> -one.e;
+    fractionals = too_high.f & (one.f - 1);
+
+    divisor = 1;
+    kappa = 1;
+    while (integrals / divisor >= 10) {
+        divisor *= 10;
+        kappa++;
+    }
+
+    /* Generate digits of the top of the interval until the rest fits in
+     * it, then round the last one down towards w */
+    *length = 0;
+    while (kappa > 0) {
+        digits[(*length)++] = '0' + integrals / divisor;
+        integrals %= divisor;
+        kappa--;
+        rest = ((guint64) integrals << -one.e) + fractionals;
+        if (rest < unsafe_interval) {
+            *exponent += kappa;
+            return shortest_round_weed(digits, *length,
+                                       too_high.f - scaled_w.f,
+                                       unsafe_interval, rest,
+                                       (guint64) divisor << -one.e, unit);
+        }
+        divisor /= 10;
+    }
+    for (;;) {
+        fractionals *= 10;
+        unit *= 10;
+        unsafe_interval *= 10;
+        digits[(*length)++] = '0' + (fractionals >> -one.e);
+        fractionals &= one.f - 1;
+        kappa--;
+        if (fractionals < unsafe_interval) {
+            *exponent += kappa;
+            return shortest_round_weed(digits, *length,
+                                       (too_high.f - scaled_w.f) * unit,
+                                       unsafe_interval, fractionals, one.f,
+                                       unit);
+        }
+    }
+}
+
+/*-----------------------------------------------------------------------------
+ *  path_writer_init  --  prepares a writer that appends SVG path data to out;
+ *                        precision is a fixed number of decimals, or -1 for
+ *                        the shortest string that reads back exactly
+ *-----------------------------------------------------------------------------
+ */
+void path_writer_init(PathWriter *writer, GString *out, gint precision)
+{
+    writer->out = out;
+    writer->precision = MIN(precision, 15);
+    if (writer->precision >= 0)
+        g_snprintf(writer->format, sizeof(writer->format), "%%.%df",
+                   writer->precision);
+}
+
+/*-----------------------------------------------------------------------------
+ *  path_writer_number  --  appends one coordinate, formatted without locale
+ *                          and without any heap allocation
+ *-----------------------------------------------------------------------------
+ */
+void path_writer_number(PathWriter *writer, gdouble value)
+{
+    static const gchar *shortest[] = { "%.15g", "%.16g", "%.17g" };
+    gchar  buf[G_ASCII_DTOSTR_BUF_SIZE];
+    gchar  digits[20];
+    gchar *end;
+    gint   n, length, exponent, point;
+
+    /* Don't write "-0" */
+    if (value == 0.0)
+        value = 0.0;
+
+    if (writer->precision >= 0 && ABS(value) < 1e15) {
+        g_ascii_formatd(buf, sizeof(buf), writer->format, value);
+        /* Trailing zeros carry no information, strip them */
+        if (writer->precision > 0) {
+            end = buf + strlen(buf) - 1;
+            while (*end == '0')
+                *end-- = '\0';
+            if (*end == '.')
+                *end = '\0';
+        }
+        if (strcmp(buf, "-0") == 0)
+            strcpy(buf, "0");
+    } else if (value == 0.0) {
+        strcpy(buf, "0");
+    } else if (shortest_digits(ABS(value), digits, &length, &exponent)) {
+        /* Lay the digits out the way %g would, with the point where it
+         * falls, or after the first digit and an exponent if that would
+         * take more than a few zeros before it or any after it */
+        end = buf;
+        if (value < 0)
+            *end++ = '-';
+        point = length + exponent;
+        if (point > 0 && point <= 17) {
+            for (n = 0; n < MAX(length, point); n++) {
+                if (n == point)
+                    *end++ = '.';
+                *end++ = n < length ? digits[n] : '0';
+            }
+            *end = '\0';
+        } else if (point > -4 && point <= 0) {
+            *end++ = '0';
+            *end++ = '.';
+            for (n = point; n < 0; n++)
+                *end++ = '0';
+            memcpy(end, digits, length);
+            end[length] = '\0';
+        } else {
+            *end++ = digits[0];
+            if (length > 1) {
+                *end++ = '.';
+                memcpy(end, digits + 1, length - 1);
+                end += length - 1;
+            }
+            g_snprintf(end, buf + sizeof(buf) - end, "e%d", point - 1);
+        }
+    } else {
+        /* Every double with a 15 digit decimal form prints as exactly that
+         * form with %.15g, so at most three tries are needed to find the
+         * shortest string that round-trips */
+        for (n = 0; n < 2; n++) {
+            g_ascii_formatd(buf, sizeof(buf), shortest[n], value);
+            if (g_ascii_strtod(buf, NULL) == value)
+                break;
+        }
+        if (n == 2)
+            g_ascii_formatd(buf, sizeof(buf), shortest[2], value);
+    }
+    g_string_append(writer->out, buf);
+}
+
+/*-----------------------------------------------------------------------------
+ *  path_writer_stroke  --  appends a stroke as SVG path data, in the same
+ *                          layout that GIMP itself uses for exported paths
+ *-----------------------------------------------------------------------------
+ */
+void path_writer_stroke(PathWriter *writer, const gdouble *ctlpts,
+                        gint num_points, gboolean closed)
+{
+    gint n, last;
+
+    if (num_points < 6)
+        return;
+
+    g_string_append(writer->out, "M ");
+    path_writer_number(writer, ctlpts[2]);
+    g_string_append_c(writer->out, ',');
+    path_writer_number(writer, ctlpts[3]);
+    if (num_points == 6)
+        return;
+
+    /* Out handle, in handle, anchor; wrapping round to the start if closed */
+    g_string_append(writer->out, " C");
+    last = closed ? num_points + 4 : num_points - 2;
+    for (n = 4; n < last; n += 2) {
+        g_string_append_c(writer->out, ' ');
+        path_writer_number(writer, ctlpts[n % num_points]);
+        g_string_append_c(writer->out, ',');
+        path_writer_number(writer, ctlpts[n % num_points + 1]);
+    }
+    if (closed)
+        g_string_append(writer->out, " Z");
+}
+
+/*-----------------------------------------------------------------------------
+ *  path_writer_lossless  --  checks that writing a stroke with path_writer
+ *                            and importing it gives it back exactly: the
+ *                            path data has no room for the outer handles
+ *                            of an open stroke, nor for the handles of a
+ *                            lone anchor or whether it is closed, so those
+ *                            must lie on their anchors and it must be open,
+ *                            and the import drops the last anchor of a
+ *                            closed stroke if it repeats the first
+ *-----------------------------------------------------------------------------
+ */
+gboolean path_writer_lossless(const gdouble *ctlpts, gint num_points,
+                              gboolean closed)
+{
+    if (num_points < 6)
+        return TRUE;
+    if (closed && num_points == 6)
+        return FALSE;
+    if (closed)
+        return (ctlpts[num_points - 4] != ctlpts[2] ||
+                ctlpts[num_points - 3] != ctlpts[3]);
+    return (ctlpts[0] == ctlpts[2] && ctlpts[1] == ctlpts[3] &&
+            ctlpts[num_points - 2] == ctlpts[num_points - 4] &&
+            ctlpts[num_points - 1] == ctlpts[num_points - 3]);
+}
+
+/*-----------------------------------------------------------------------------
+ *  stroke_batch_init, stroke_batch_free  --  an empty batch, and its release
+ *-----------------------------------------------------------------------------
+ */
+void stroke_batch_init(StrokeBatch *batch)
+{
+    gint zero = 0;
+
+    batch->points = g_array_new(FALSE, FALSE, sizeof(gdouble));
+    batch->offsets = g_array_new(FALSE, FALSE, sizeof(gint));
+    batch->closed = g_array_new(FALSE, FALSE, sizeof(gboolean));
+    g_array_append_val(batch->offsets, zero);
+}
+
+void stroke_batch_free(StrokeBatch *batch)
+{
+    g_array_free(batch->points, TRUE);
+    g_array_free(batch->offsets, TRUE);
+    g_array_free(batch->closed, TRUE);
+}
+
+#define stroke_batch_len(batch) ((gint) (batch)->closed->len)
+#define stroke_batch_size(batch, n) \
+    (g_array_index((batch)->offsets, gint, (n) + 1) - \
+     g_array_index((batch)->offsets, gint, (n)))
+#define stroke_batch_points(batch, n) \
+    (&g_array_index((batch)->points, gdouble, \
+                    g_array_index((batch)->offsets, gint, (n))))
+#define stroke_batch_closed(batch, n) \
+    g_array_index((batch)->closed, gboolean, (n))
+
+#define smooth_batch(vals, batch, angles, mask, scratch) \
+    smooth_strokes((vals), (gdouble *) (batch)->points->data, \
+                   (gint *) (batch)->offsets->data, \
+                   (gboolean *) (batch)->closed->data, (angles), (mask), \
+                   stroke_batch_len(batch), (scratch))
+
+/*-----------------------------------------------------------------------------
+ *  stroke_batch_clear  --  empties the batch, keeping its memory
+ *-----------------------------------------------------------------------------
+ */
+void stroke_batch_clear(StrokeBatch *batch)
+{
+    g_array_set_size(batch->points, 0);
+    g_array_set_size(batch->offsets, 1);
+    g_array_set_size(batch->closed, 0);
+}
+
+/*-----------------------------------------------------------------------------
+ *  stroke_batch_copy  --  makes dest an exact copy of src
+ *-----------------------------------------------------------------------------
+ */
+void stroke_batch_copy(StrokeBatch *dest, const StrokeBatch *src)
+{
+    g_array_set_size(dest->points, src->points->len);
+    g_array_set_size(dest->offsets, src->offsets->len);
+    g_array_set_size(dest->closed, src->closed->len);
+    memcpy(dest->points->data, src->points->data,
+           src->points->len * sizeof(gdouble));
+    memcpy(dest->offsets->data, src->offsets->data,
+           src->offsets->len * sizeof(gint));
+    memcpy(dest->closed->data, src->closed->data,
+           src->closed->len * sizeof(gboolean));
+}
+
+/*-----------------------------------------------------------------------------
+ *  stroke_batch_add  --  appends a whole stroke to the batch
+ *-----------------------------------------------------------------------------
+ */
+void stroke_batch_add(StrokeBatch *batch, const gdouble *ctlpts,
+                      gint num_points, gboolean closed)
+{
+    g_array_append_vals(batch->points, ctlpts, num_points);
+    g_array_append_val(batch->offsets, batch->points->len);
+    g_array_append_val(batch->closed, closed);
+}
+
+/*-----------------------------------------------------------------------------
+ *  stroke_batch_angles  --  measures the corner angles of all anchors in the
+ *                           batch, in the layout smooth_strokes expects
+ *-----------------------------------------------------------------------------
+ */
+void stroke_batch_angles(const StrokeBatch *batch, GArray *angles)
+{
+    gint n;
+
+    g_array_set_size(angles, batch->points->len / 6);
+    for (n = 0; n < stroke_batch_len(batch); n++)
+        stroke_corner_angles(stroke_batch_points(batch, n),
+                             stroke_batch_size(batch, n),
+                             stroke_batch_closed(batch, n),
+                             &g_array_index(angles, gdouble,
+                                   g_array_index(batch->offsets, gint, n) / 6));
+}
+
+static gint angle_compare(gconstpointer a, gconstpointer b)
+{
+    gdouble x = *(const gdouble *) a;
+    gdouble y = *(const gdouble *) b;
+
+    return (x > y) - (x < y);
+}
+
+/*-----------------------------------------------------------------------------
+ *  corner_angles_sorted  --  collects the angles of all anchors that are
+ *                            corners, i.e. not the ends of an open stroke
+ *                            and not in a stroke too short to smooth, in
+ *                            ascending order
+ *-----------------------------------------------------------------------------
+ */
+void corner_angles_sorted(const StrokeBatch *batch, const GArray *angles,
+                          GArray *corners)
+{
+    gdouble angle;
+    gint    n, i, first, last;
+
+    g_array_set_size(corners, 0);
+    for (n = 0; n < stroke_batch_len(batch); n++) {
+        if (stroke_batch_size(batch, n) < 18)
+            continue;
+        first = g_array_index(batch->offsets, gint, n) / 6;
+        last = first + stroke_batch_size(batch, n) / 6;
+        for (i = first; i < last; i++) {
+            angle = g_array_index(angles, gdouble, i);
+            if (angle >= 0)
+                g_array_append_val(corners, angle);
+        }
+    }
+    g_array_sort(corners, angle_compare);
+}
+
+/*-----------------------------------------------------------------------------
+ *  corners_below  --  counts the sorted corner angles less than angle, or
+ *                     less than or equal to it if inclusive is set
+ *-----------------------------------------------------------------------------
+ */
+gint corners_below(const GArray *corners, gdouble angle, gboolean inclusive)
+{
+    const gdouble *a = (const gdouble *) corners->data;
+    gint           lo = 0, hi = corners->len, mid;
+
+    while (lo < hi) {
+        mid = (lo + hi) / 2;
+        if (a[mid] < angle || (inclusive && a[mid] == angle))
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+/*-----------------------------------------------------------------------------
+ *  corners_smoothed  --  counts the corners anchor_smoothed would pass, with
+ *                        two binary searches instead of a pass over them
+ *-----------------------------------------------------------------------------
+ */
+gint corners_smoothed(const SmoothVals *vals, const GArray *corners)
+{
+    gint below_max, above_min;
+
+    if (!vals->smooth_specified)
+        return corners->len;
+    below_max = corners_below(corners, vals->ang_max, FALSE);
+    above_min = corners->len - corners_below(corners, vals->ang_min, TRUE);
+    if (vals->ang_max > vals->ang_min)
+        return MAX(below_max + above_min - (gint) corners->len, 0);
+    else
+        return below_max + above_min;
+}
+
+/*-----------------------------------------------------------------------------
+ *  counter_group_open  --  starts counting hardware events in this thread,
+ *                          while counters_start has the counters running;
+ *                          events the kernel won't count (no PMU,
+ *                          perf_event_paranoid, not Linux) are left out
+ *-----------------------------------------------------------------------------
+ */
+void counter_group_open(CounterGroup *group)
+{
+#ifdef __linux__
+    static const guint32 types[COUNTER_COUNT] =
+    {
+        PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HW_CACHE,
+        PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE
+    };
+    static const guint64 configs[COUNTER_COUNT] =
+    {
+        PERF_COUNT_HW_CPU_CYCLES,
+        PERF_COUNT_HW_INSTRUCTIONS,
+        PERF_COUNT_HW_CACHE_L1D |
+            (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+            (PERF_COUNT_HW_CACHE_RESULT_MISS << 16),
+        PERF_COUNT_HW_CACHE_MISSES,
+        PERF_COUNT_HW_BRANCH_MISSES
+    };
+    struct perf_event_attr attr;
+#endif
+    gint n;
+
+    group->leader = -1;
+    for (n = 0; n < COUNTER_COUNT; n++)
+        group->fd[n] = -1;
+    if (!stats.counting)
+        return;
+
+#ifdef __linux__
+    /* The first event that opens leads the group; the others only run
+     * when it does */
+    for (n = 0; n < COUNTER_COUNT; n++) {
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = types[n];
+        attr.config = configs[n];
+        attr.read_format = PERF_FORMAT_GROUP |
+                           PERF_FORMAT_TOTAL_TIME_ENABLED |
+                           PERF_FORMAT_TOTAL_TIME_RUNNING;
+        attr.disabled = (group->leader < 0);
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        group->fd[n] = syscall(__NR_perf_event_open, &attr, 0, -1,
+                               group->leader, 0);
+        if (group->leader < 0)
+            group->leader = group->fd[n];
+    }
+    if (group->leader >= 0) {
+        ioctl(group->leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+        ioctl(group->leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    }
+#endif
+}
+
+/*-----------------------------------------------------------------------------
+ *  counter_group_close  --  stops the counters counter_group_open started
+ *                           and adds what they counted to the group; when
+ *                           the kernel had more events to count than the
+ *                           PMU has counters, the group only ran part of
+ *                           the time, so the counts are scaled up to all
+ *                           of it
+ *-----------------------------------------------------------------------------
+ */
+void counter_group_close(CounterGroup *group)
+{
+#ifdef __linux__
+    /* Number of events, time enabled, time running, then the events */
+    guint64 data[3 + COUNTER_COUNT];
+    gint    n, k;
+
+    if (group->leader < 0)
+        return;
+
+    ioctl(group->leader, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+    if (read(group->leader, data, sizeof(data)) >=
+        (gssize) (3 * sizeof(guint64)) && data[2] > 0) {
+        k = 0;
+        for (n = 0; n < COUNTER_COUNT && k < (gint) data[0]; n++) {
+            if (group->fd[n] < 0)
+                continue;
+            group->value[n] += (guint64) ((gdouble) data[3 + k++] *
+                                          data[1] / data[2] + 0.5);
+            group->counted[n] = TRUE;
+        }
+    }
+    for (n = COUNTER_COUNT - 1; n >= 0; n--)
+        if (group->fd[n] >= 0) {
+            close(group->fd[n]);
+            group->fd[n] = -1;
+        }
+    group->leader = -1;
+#endif
+}
+
+/*-----------------------------------------------------------------------------
+ *  counter_group_add  --  adds what the counters of group counted to sum
+ *-----------------------------------------------------------------------------
+ */
+void counter_group_add(CounterGroup *sum, const CounterGroup *group)
+{
+    gint n;
+
+    for (n = 0; n < COUNTER_COUNT; n++) {
+        sum->value[n] += group->value[n];
+        sum->counted[n] |= group->counted[n];
+    }
+}
+
+/*-----------------------------------------------------------------------------
+ *  counters_start  --  starts counting hardware events, if the counters
+ *                      were asked for, in this thread and in the pool
+ *                      tasks started before counters_stop, which each
+ *                      count their own thread
+ *-----------------------------------------------------------------------------
+ */
+void counters_start(void)
+{
+    if (!stats.counters)
+        return;
+    stats.counting = TRUE;
+    counter_group_open(&stats.group);
+}
+
+/*-----------------------------------------------------------------------------
+ *  counters_stop  --  stops the counters counters_start opened and adds
+ *                     what they counted to stats
+ *-----------------------------------------------------------------------------
+ */
+void counters_stop(void)
+{
+    if (!stats.counting)
+        return;
+    counter_group_close(&stats.group);
+    stats.counting = FALSE;
+}
+
+/*-----------------------------------------------------------------------------
+ *  smooth_task  --  worker thread body, smooths one run of strokes with its
+ *                   own scratch arrays
+ *-----------------------------------------------------------------------------
+ */
+static void smooth_task(gpointer data, gpointer user_data)
+{
+    SmoothTask    *task = data;
+    SmoothScratch  scratch = { NULL };
+    StrokeBatch   *batch = task->batch;
+
+    counter_group_open(&task->group);
+    smooth_strokes(task->vals, (gdouble *) batch->points->data,
+                   (gint *) batch->offsets->data + task->first,
+                   (gboolean *) batch->closed->data + task->first,
+                   task->angles, task->mask, task->last - task->first,
+                   &scratch);
+    counter_group_close(&task->group);
+    scratch_free(&scratch);
+}
+
+/*-----------------------------------------------------------------------------
+ *  model_time  --  the time the cost model predicts for solving anchors
+ *                  anchors in strokes strokes, in microseconds, on one
+ *                  thread or over threads threads of the pool
+ *-----------------------------------------------------------------------------
+ */
+gdouble model_time(const SmoothVals *vals, gint anchors, gint strokes,
+                   gint threads)
+{
+    gint    kind = (vals->smoothing > 0);
+    gdouble time;
+
+    time = model.anchor[kind] * anchors + model.stroke[kind] * strokes;
+    if (threads < 2)
+        return time;
+    return model.pool_start + time * model.processors /
+           (model.speedup[kind] * threads);
+}
+
+/*-----------------------------------------------------------------------------
+ *  model_threads  --  how many threads the batch is best solved on: one,
+ *                     or one per processor as far as there are strokes
+ *-----------------------------------------------------------------------------
+ */
+gint model_threads(const SmoothVals *vals, const StrokeBatch *batch)
+{
+    gint anchors, strokes, threads;
+
+    anchors = batch->points->len / 6;
+    strokes = stroke_batch_len(batch);
+    threads = MIN((gint) g_get_num_processors(), strokes);
+    if (threads < 2)
+        return 1;
+    if (model.version != CALIBRATION_VERSION)
+        return (anchors < POOL_MIN_ANCHORS) ? 1 : threads;
+    return (model_time(vals, anchors, strokes, threads) <
+            model_time(vals, anchors, strokes, 1)) ? threads : 1;
+}
+
+/*-----------------------------------------------------------------------------
+ *  batch_pool_run  --  runs func on runs of consecutive strokes of the batch
+ *                      in proto, with about equal anchor counts, one thread
+ *                      per processor, and waits for them; returns how many
+ *                      threads there were
+ *-----------------------------------------------------------------------------
+ */
+gint batch_pool_run(const SmoothTask *proto, GFunc func)
+{
+    GThreadPool *pool;
+    SmoothTask  *tasks;
+    gint        *offsets;
+    gint         n, num_tasks, num_strokes, share, first, last;
+
+#if !GLIB_CHECK_VERSION(2, 32, 0)
+    if (!g_thread_supported())
+        g_thread_init(NULL);
+#endif
+
+    /* Hand out runs of consecutive strokes with about equal anchor counts */
+    num_strokes = stroke_batch_len(proto->batch);
+    num_tasks = MIN((gint) g_get_num_processors(), num_strokes);
+    offsets = (gint *) proto->batch->offsets->data;
+    share = proto->batch->points->len / num_tasks;
+    tasks = g_new(SmoothTask, num_tasks);
+    pool = g_thread_pool_new(func, NULL, num_tasks, TRUE, NULL);
+    first = 0;
+    for (n = 0; n < num_tasks && first < num_strokes; n++) {
+        last = first + 1;
+        while (last < num_strokes &&
+               (n == num_tasks - 1 || offsets[last] < (n + 1) * share))
+            last++;
+        tasks[n] = *proto;
+        tasks[n].first = first;
+        tasks[n].last = last;
+        memset(&tasks[n].group, 0, sizeof(CounterGroup));
+        g_thread_pool_push(pool, &tasks[n], NULL);
+        first = last;
+    }
+
+    /* Waits for all tasks to finish; the threads may live on, so the
+     * tasks hand in their counts themselves */
+    g_thread_pool_free(pool, FALSE, TRUE);
+    num_tasks = n;
+    for (n = 0; n < num_tasks; n++)
+        counter_group_add(&stats.group, &tasks[n].group);
+    g_free(tasks);
+
+    return num_tasks;
+}
+
+/*-----------------------------------------------------------------------------
+ *  smooth_batch_threaded  --  like smooth_batch, but spreads the strokes over
+ *                             one thread per processor when there are enough
+ *                             anchors to make that worthwhile
+ *-----------------------------------------------------------------------------
+ */
+void smooth_batch_threaded(const SmoothVals *vals, StrokeBatch *batch,
+                           const gdouble *angles, const guint8 *mask,
+                           SmoothScratch *scratch)
+{
+    SmoothTask task;
+    gint       threads;
+
+    threads = model_threads(vals, batch);
+    if (model.version == CALIBRATION_VERSION && vals->region == REGION_ALL)
+        stats.predicted_time += model_time(vals, batch->points->len / 6,
+                                           stroke_batch_len(batch), threads);
+    if (threads < 2) {
+        stats.threads = 1;
+        smooth_batch(vals, batch, angles, mask, scratch);
+        return;
+    }
+
+    task.vals = vals;
+    task.batch = batch;
+    task.angles = angles;
+    task.mask = mask;
+    task.sizes = NULL;
+    stats.threads = batch_pool_run(&task, smooth_task);
+}
+
+/*-----------------------------------------------------------------------------
+ *  anchors_near  --  whether anchors a and b of a stroke lie within
+ *                    DEGENERATE_EPSILON of each other
+ *-----------------------------------------------------------------------------
+ */
+gboolean anchors_near(const gdouble *ctlpts, gint a, gint b)
+{
+    gdouble dx, dy;
+
+    dx = ctlpts[a * 6 + 2] - ctlpts[b * 6 + 2];
+    dy = ctlpts[a * 6 + 3] - ctlpts[b * 6 + 3];
+    return (dx * dx + dy * dy <= DEGENERATE_EPSILON * DEGENERATE_EPSILON);
+}
+
+/*-----------------------------------------------------------------------------
+ *  collapse_batch  --  copies batch into reduced with every run of anchors
+ *                      that lie on the first of the run collapsed into that
+ *                      one, which takes the out-handle of the last; map gets
+ *                      the anchor of reduced that each anchor of batch went
+ *                      into, and the return value is how many were removed.
+ *                      Strokes that would be left with fewer than two
+ *                      anchors are copied as they are
+ *-----------------------------------------------------------------------------
+ */
+gint collapse_batch(const StrokeBatch *batch, StrokeBatch *reduced,
+                    GArray *map)
+{
+    const gdouble *ctlpts;
+    gdouble       *out;
+    gint          *to;
+    gint           n, m, k, len, start, rep, r, first, count, removed;
+    gboolean       closed;
+
+    stroke_batch_clear(reduced);
+    g_array_set_size(map, batch->points->len / 6);
+    removed = 0;
+    for (n = 0; n < stroke_batch_len(batch); n++) {
+        ctlpts = stroke_batch_points(batch, n);
+        len = stroke_batch_size(batch, n) / 6;
+        closed = stroke_batch_closed(batch, n);
+        to = &g_array_index(map, gint,
+                            g_array_index(batch->offsets, gint, n) / 6);
+        first = reduced->points->len / 6;
+
+        /* A closed stroke is walked from an anchor that doesn't lie on the
+         * one before it, so that no run wraps around its end */
+        start = 0;
+        while (closed && start < len &&
+               anchors_near(ctlpts, start, (start + len - 1) % len))
+            start++;
+        count = 0;
+        for (m = 0, rep = start; start < len && m < len; m++) {
+            k = (start + m) % len;
+            if (m == 0 || !anchors_near(ctlpts, k, rep)) {
+                rep = k;
+                count++;
+            }
+        }
+        if (count == len || count < 2) {
+            stroke_batch_add(reduced, ctlpts, len * 6, closed);
+            for (k = 0; k < len; k++)
+                to[k] = first + k;
+            continue;
+        }
+
+        removed += len - count;
+        g_array_set_size(reduced->points, (first + count) * 6);
+        out = &g_array_index(reduced->points, gdouble, first * 6);
+        for (m = 0, rep = start, r = -1; m < len; m++) {
+            k = (start + m) % len;
+            if (m == 0 || !anchors_near(ctlpts, k, rep)) {
+                rep = k;
+                r++;
+                memcpy(out + r * 6, ctlpts + k * 6, 6 * sizeof(gdouble));
+            } else {
+                out[r * 6 + 4] = ctlpts[k * 6 + 4] - ctlpts[k * 6 + 2] +
+                                 ctlpts[rep * 6 + 2];
+                out[r * 6 + 5] = ctlpts[k * 6 + 5] - ctlpts[k * 6 + 3] +
+                                 ctlpts[rep * 6 + 3];
+            }
+            to[k] = first + r;
+        }
+        g_array_append_val(reduced->offsets, reduced->points->len);
+        g_array_append_val(reduced->closed, closed);
+    }
+
+    return removed;
+}
+
+/*-----------------------------------------------------------------------------
+ *  expand_batch  --  puts the smoothed reduced batch back into batch, which
+ *                    still holds what collapse_batch was given: each run
+ *                    moves with the anchor it went into, its first anchor
+ *                    takes that one's in-handle and its last the out-handle,
+ *                    and the handles in between lie on their anchors.
+ *                    Anchors mask leaves out keep what they had
+ *-----------------------------------------------------------------------------
+ */
+void expand_batch(StrokeBatch *batch, const StrokeBatch *reduced,
+                  const GArray *map, const guint8 *mask)
+{
+    const gdouble *from;
+    GArray        *copy;
+    gdouble       *ctlpts, *orig;
+    const gint    *to;
+    const guint8  *keep;
+    gdouble        dx, dy;
+    gint           n, m, k, len, rep, next;
+    gboolean       closed;
+
+    copy = g_array_new(FALSE, FALSE, sizeof(gdouble));
+    for (n = 0; n < stroke_batch_len(batch); n++) {
+        ctlpts = stroke_batch_points(batch, n);
+        len = stroke_batch_size(batch, n) / 6;
+        closed = stroke_batch_closed(batch, n);
+        k = g_array_index(batch->offsets, gint, n) / 6;
+        to = &g_array_index(map, gint, k);
+        keep = mask ? mask + k : NULL;
+
+        g_array_set_size(copy, len * 6);
+        orig = (gdouble *) copy->data;
+        memcpy(orig, ctlpts, len * 6 * sizeof(gdouble));
+
+        for (rep = 0; rep < len; rep++) {
+            /* Each run is handled from its first anchor */
+            if ((rep > 0 || (closed && len > 1)) &&
+                to[(rep + len - 1) % len] == to[rep])
+                continue;
+            from = &g_array_index(reduced->points, gdouble, to[rep] * 6);
+            dx = from[2] - orig[rep * 6 + 2];
+            dy = from[3] - orig[rep * 6 + 3];
+            for (m = 0, k = rep; m < len; m++, k = next) {
+                next = (k + 1) % len;
+                if (m > 0 && to[k] != to[rep])
+                    break;
+                if (keep && !keep[k])
+                    continue;
+                if (m == 0) {
+                    memcpy(ctlpts + k * 6, from, 4 * sizeof(gdouble));
+                } else {
+                    ctlpts[k * 6 + 2] = orig[k * 6 + 2] + dx;
+                    ctlpts[k * 6 + 3] = orig[k * 6 + 3] + dy;
+                    ctlpts[k * 6] = ctlpts[k * 6 + 2];
+                    ctlpts[k * 6 + 1] = ctlpts[k * 6 + 3];
+                }
+                if (m == len - 1 || (next == 0 && !closed) ||
+                    to[next] != to[rep]) {
+                    ctlpts[k * 6 + 4] = from[4] + ctlpts[k * 6 + 2] - from[2];
+                    ctlpts[k * 6 + 5] = from[5] + ctlpts[k * 6 + 3] - from[3];
+                } else {
+                    ctlpts[k * 6 + 4] = ctlpts[k * 6 + 2];
+                    ctlpts[k * 6 + 5] = ctlpts[k * 6 + 3];
+                }
+            }
+        }
+    }
+    g_array_free(copy, TRUE);
+}
+
+/*-----------------------------------------------------------------------------
+ *  collapsed_batch_init  --  collapses batch into c, and gives the reduced
+ *                            batch its corner angles and, if there is a
+ *                            mask, a mask that only lets a run be smoothed
+ *                            when all of its anchors may be; returns how
+ *                            many anchors were removed
+ *-----------------------------------------------------------------------------
+ */
+gint collapsed_batch_init(CollapsedBatch *c, const StrokeBatch *batch,
+                          const guint8 *mask)
+{
+    const gint *to;
+    guint8     *keep;
+    guint       k;
+
+    stroke_batch_init(&c->reduced);
+    c->map = g_array_new(FALSE, FALSE, sizeof(gint));
+    c->angles = g_array_new(FALSE, FALSE, sizeof(gdouble));
+    c->mask = g_array_new(FALSE, FALSE, sizeof(guint8));
+    c->removed = collapse_batch(batch, &c->reduced, c->map);
+    if (c->removed == 0)
+        return 0;
+
+    stroke_batch_angles(&c->reduced, c->angles);
+    if (mask) {
+        g_array_set_size(c->mask, c->reduced.points->len / 6);
+        keep = (guint8 *) c->mask->data;
+        memset(keep, 1, c->mask->len);
+        to = (const gint *) c->map->data;
+        for (k = 0; k < c->map->len; k++)
+            keep[to[k]] &= mask[k];
+    }
+    return c->removed;
+}
+
+/*-----------------------------------------------------------------------------
+ *  collapsed_batch_expand  --  expands the smoothed c back into batch; a
+ *                              run whose anchor smoothing left alone, for
+ *                              its angle, its mask, or because quality
+ *                              says its stroke wasn't touched, keeps all
+ *                              the handles it had, as a single anchor would
+ *-----------------------------------------------------------------------------
+ */
+void collapsed_batch_expand(const SmoothVals *vals, const CollapsedBatch *c,
+                            StrokeBatch *batch, const GArray *quality)
+{
+    const gdouble *angles;
+    const guint8  *mask;
+    const gint    *to;
+    guint8        *keep;
+    gint           n, k, end;
+
+    angles = (const gdouble *) c->angles->data;
+    mask = (c->mask->len > 0) ? (const guint8 *) c->mask->data : NULL;
+    to = (const gint *) c->map->data;
+    keep = g_new(guint8, c->map->len);
+    for (n = 0, k = 0; n < stroke_batch_len(batch); n++) {
+        end = g_array_index(batch->offsets, gint, n + 1) / 6;
+        for (; k < end; k++)
+            keep[k] = (!(quality && g_array_index(quality, guint8, n) ==
+                                    QUALITY_NONE) &&
+                       (!mask || mask[to[k]]) &&
+                       anchor_smoothed(vals, angles[to[k]]));
+    }
+    expand_batch(batch, &c->reduced, c->map, keep);
+    g_free(keep);
+}
+
+void collapsed_batch_free(CollapsedBatch *c)
+{
+    stroke_batch_free(&c->reduced);
+    g_array_free(c->map, TRUE);
+    g_array_free(c->angles, TRUE);
+    g_array_free(c->mask, TRUE);
+}
+
+/*-----------------------------------------------------------------------------
+ *  smooth_batch_collapsed  --  like smooth_batch_threaded, but first
+ *                              collapses anchors that lie on the one before,
+ *                              whose zero length segments make their corner
+ *                              angles meaningless and only cost solving
+ *-----------------------------------------------------------------------------
+ */
+void smooth_batch_collapsed(const SmoothVals *vals, StrokeBatch *batch,
+                            const gdouble *angles, const guint8 *mask,
+                            SmoothScratch *scratch)
+{
+    CollapsedBatch c;
+
+    if (collapsed_batch_init(&c, batch, mask) == 0) {
+        smooth_batch_threaded(vals, batch, angles, mask, scratch);
+        collapsed_batch_free(&c);
+        return;
+    }
+    stats.collapsed += c.removed;
+
+    smooth_batch_threaded(vals, &c.reduced, (gdouble *) c.angles->data,
+                          mask ? (guint8 *) c.mask->data : NULL, scratch);
+    collapsed_batch_expand(vals, &c, batch, NULL);
+    collapsed_batch_free(&c);
+}
+
+/*-----------------------------------------------------------------------------
+ *  join_end  --  the anchor at end e of a batch: the start of stroke e / 2
+ *                if e is even, its end if odd
+ *-----------------------------------------------------------------------------
+ */
+const gdouble *join_end(const StrokeBatch *batch, gint e)
+{
+    return stroke_batch_points(batch, e / 2) +
+           ((e % 2) ? stroke_batch_size(batch, e / 2) - 6 : 0);
+}
+
+/*-----------------------------------------------------------------------------
+ *  join_hash  --  the bucket of cell x, y, out of mask + 1 buckets
+ *-----------------------------------------------------------------------------
+ */
+guint join_hash(gint64 x, gint64 y, guint mask)
+{
+    return ((guint) x * 73856093u ^ (guint) y * 19349663u) & mask;
+}
+
+/*-----------------------------------------------------------------------------
+ *  join_partners  --  pairs up the ends of the open strokes of a batch that
+ *                     touch, through a hash of JOIN_TOLERANCE sized cells;
+ *                     partner gets the other end for each end, or -1. Ends
+ *                     only pair within a group, and only when neither
+ *                     touches a third, since three or more strokes meeting
+ *                     are a junction rather than one curve
+ *-----------------------------------------------------------------------------
+ */
+void join_partners(const StrokeBatch *batch, const gint *group, gint *partner)
+{
+    const gdouble *at, *other;
+    gint          *heads, *next, *candidate;
+    gint64        *cells;
+    guint          buckets, b;
+    gdouble        dx, dy;
+    gint           num_ends, e, f, x, y, found;
+
+    num_ends = 2 * stroke_batch_len(batch);
+    for (buckets = 1; buckets < 2 * (guint) num_ends; buckets *= 2)
+        ;
+    heads = g_new(gint, buckets);
+    next = g_new(gint, num_ends);
+    candidate = g_new(gint, num_ends);
+    cells = g_new(gint64, 2 * num_ends);
+    for (b = 0; b < buckets; b++)
+        heads[b] = -1;
+
+    for (e = 0; e < num_ends; e++) {
+        partner[e] = -1;
+        candidate[e] = -1;
+        if (stroke_batch_closed(batch, e / 2) ||
+            stroke_batch_size(batch, e / 2) < 12)
+            continue;
+        at = join_end(batch, e);
+        cells[2 * e] = (gint64) floor(at[2] / JOIN_TOLERANCE);
+        cells[2 * e + 1] = (gint64) floor(at[3] / JOIN_TOLERANCE);
+        b = join_hash(cells[2 * e], cells[2 * e + 1], buckets - 1);
+        next[e] = heads[b];
+        heads[b] = e;
+    }
+
+    /* Touching ends lie in the same or a neighbouring cell; a bucket can
+     * hold several cells, so ends are only counted from their own */
+    for (e = 0; e < num_ends; e++) {
+        if (stroke_batch_closed(batch, e / 2) ||
+            stroke_batch_size(batch, e / 2) < 12)
+            continue;
+        at = join_end(batch, e);
+        found = 0;
+        for (x = -1; x <= 1; x++)
+            for (y = -1; y <= 1; y++) {
+                b = join_hash(cells[2 * e] + x, cells[2 * e + 1] + y,
+                              buckets - 1);
+                for (f = heads[b]; f >= 0; f = next[f]) {
+                    if (f == e || cells[2 * f] != cells[2 * e] + x ||
+                        cells[2 * f + 1] != cells[2 * e + 1] + y ||
+                        group[f / 2] != group[e / 2])
+                        continue;
+                    /* A stroke only closes on itself with three anchors */
+                    if (f / 2 == e / 2 && stroke_batch_size(batch, e / 2) < 18)
+                        continue;
+                    other = join_end(batch, f);
+                    dx = other[2] - at[2];
+                    dy = other[3] - at[3];
+                    if (dx * dx + dy * dy > JOIN_TOLERANCE * JOIN_TOLERANCE)
+                        continue;
+                    candidate[e] = f;
+                    found++;
+                }
+            }
+        if (found > 1)
+            candidate[e] = -1;
+    }
+    for (e = 0; e < num_ends; e++)
+        if (candidate[e] >= 0 && candidate[candidate[e]] == e)
+            partner[e] = candidate[e];
+
+    g_free(heads);
+    g_free(next);
+    g_free(candidate);
+    g_free(cells);
+}
+
+/*-----------------------------------------------------------------------------
+ *  join_append  --  appends the len anchors of ctlpts to the stroke being
+ *                   built at the end of joined, backwards if reversed; with
+ *                   onto_last the first of them goes into the last anchor
+ *                   there, which takes its out-handle. to gets where each
+ *                   anchor went
+ *-----------------------------------------------------------------------------
+ */
+void join_append(StrokeBatch *joined, const gdouble *ctlpts, gint len,
+                 gboolean reversed, gboolean onto_last, gint *to)
+{
+    const gdouble *src;
+    gdouble       *out;
+    gint           k, n, base;
+
+    base = joined->points->len / 6 - (onto_last ? 1 : 0);
+    g_array_set_size(joined->points, (base + len) * 6);
+    out = &g_array_index(joined->points, gdouble, base * 6);
+    for (k = 0; k < len; k++) {
+        n = reversed ? len - 1 - k : k;
+        src = ctlpts + n * 6;
+        to[n] = base + k;
+        if (k == 0 && onto_last) {
+            out[4] = (reversed ? src[0] : src[4]) - src[2] + out[2];
+            out[5] = (reversed ? src[1] : src[5]) - src[3] + out[3];
+        } else if (reversed) {
+            out[k * 6] = src[4];
+            out[k * 6 + 1] = src[5];
+            out[k * 6 + 2] = src[2];
+            out[k * 6 + 3] = src[3];
+            out[k * 6 + 4] = src[0];
+            out[k * 6 + 5] = src[1];
+        } else {
+            memcpy(out + k * 6, src, 6 * sizeof(gdouble));
+        }
+    }
+}
+
+/*-----------------------------------------------------------------------------
+ *  join_batch  --  copies batch into joined with the open strokes whose ends
+ *                  touch chained into one, turned around where needed, and
+ *                  closed where a chain comes back to where it started.
+ *                  Strokes only join others in the same group of ends, the
+ *                  stroke indices where groups end, or all if that is NULL;
+ *                  joined_ends, if not NULL, gets them for joined. map gets
+ *                  the anchor of joined each anchor of batch went into,
+ *                  pieces the JOINED_ flags of each stroke; returns the
+ *                  number of joins
+ *-----------------------------------------------------------------------------
+ */
+gint join_batch(const StrokeBatch *batch, const GArray *ends,
+                StrokeBatch *joined, GArray *map, GArray *pieces,
+                GArray *joined_ends)
+{
+    const gdouble *last;
+    gdouble       *first;
+    gint          *partner, *group, *to, *flags;
+    gboolean      *visited, cycle;
+    gint           num_strokes, s, t, g, e, f, head, cur, len, joins;
+
+    num_strokes = stroke_batch_len(batch);
+    group = g_new(gint, num_strokes);
+    for (s = 0, g = 0; s < num_strokes; s++) {
+        while (ends && g + 1 < (gint) ends->len &&
+               s >= g_array_index(ends, gint, g))
+            g++;
+        group[s] = g;
+    }
+    partner = g_new(gint, 2 * num_strokes);
+    join_partners(batch, group, partner);
+
+    stroke_batch_clear(joined);
+    g_array_set_size(map, batch->points->len / 6);
+    g_array_set_size(pieces, num_strokes);
+    flags = (gint *) pieces->data;
+    if (joined_ends) {
+        g_array_set_size(joined_ends, ends->len);
+        memset(joined_ends->data, 0, ends->len * sizeof(gint));
+    }
+    visited = g_new0(gboolean, num_strokes);
+    joins = 0;
+    for (s = 0; s < num_strokes; s++) {
+        if (visited[s])
+            continue;
+
+        /* Back to the head of the chain s is in, unless it is a loop */
+        head = s;
+        e = 2 * s;
+        cycle = FALSE;
+        while (!cycle && partner[e] >= 0) {
+            t = partner[e] / 2;
+            cycle = (t == s);
+            head = cycle ? s : t;
+            e = cycle ? 2 * s : (partner[e] ^ 1);
+        }
+
+        /* Then along it, entering each stroke at end e */
+        for (cur = head; ; cur = f / 2, e = f) {
+            len = stroke_batch_size(batch, cur) / 6;
+            to = &g_array_index(map, gint,
+                                g_array_index(batch->offsets, gint, cur) / 6);
+            flags[cur] = (partner[2 * cur] >= 0 ? JOINED_START : 0) |
+                         (partner[2 * cur + 1] >= 0 ? JOINED_END : 0) |
+                         (e % 2 ? JOINED_REVERSED : 0);
+            join_append(joined, stroke_batch_points(batch, cur), len, e % 2,
+                        cur != head, to);
+            visited[cur] = TRUE;
+            joins += (cur != head);
+            f = partner[e ^ 1];
+            if (f < 0 || f / 2 == head)
+                break;
+        }
+
+        /* A loop's last anchor goes into its first, which takes its
+         * in-handle */
+        if (cycle) {
+            first = &g_array_index(joined->points, gdouble,
+                                   g_array_index(joined->offsets, gint,
+                                                 stroke_batch_len(joined)));
+            last = &g_array_index(joined->points, gdouble,
+                                  joined->points->len - 6);
+            first[0] = last[0] - last[2] + first[2];
+            first[1] = last[1] - last[3] + first[3];
+            to[(e % 2) ? 0 : len - 1] = g_array_index(joined->offsets, gint,
+                                            stroke_batch_len(joined)) / 6;
+            g_array_set_size(joined->points, joined->points->len - 6);
+            joins++;
+        }
+        g_array_append_val(joined->offsets, joined->points->len);
+        cycle = cycle || stroke_batch_closed(batch, head);
+        g_array_append_val(joined->closed, cycle);
+        if (joined_ends)
+            g_array_index(joined_ends, gint, group[head]) =
+                stroke_batch_len(joined);
+    }
+
+    /* Groups that were empty end where the one before did */
+    for (g = 1; joined_ends && g < joined_ends->len; g++)
+        g_array_index(joined_ends, gint, g) =
+            MAX(g_array_index(joined_ends, gint, g),
+                g_array_index(joined_ends, gint, g - 1));
+
+    g_free(group);
+    g_free(partner);
+    g_free(visited);
+
+    return joins;
+}
+
+/*-----------------------------------------------------------------------------
+ *  split_batch  --  cuts the smoothed joined batch apart again into the
+ *                   strokes of batch, which still holds what join_batch was
+ *                   given; where two strokes were joined each takes the
+ *                   handle on its own side, and keeps the one facing away,
+ *                   moved along with the anchor. Anchors mask leaves out
+ *                   keep what they had
+ *-----------------------------------------------------------------------------
+ */
+void split_batch(StrokeBatch *batch, const StrokeBatch *joined,
+                 const GArray *map, const GArray *pieces, const guint8 *mask)
+{
+    const gdouble *from, *in, *out;
+    gdouble       *ctlpts;
+    const gint    *to;
+    const guint8  *keep;
+    gdouble        dx, dy;
+    gint           n, k, len, flags;
+
+    for (n = 0; n < stroke_batch_len(batch); n++) {
+        ctlpts = stroke_batch_points(batch, n);
+        len = stroke_batch_size(batch, n) / 6;
+        k = g_array_index(batch->offsets, gint, n) / 6;
+        to = &g_array_index(map, gint, k);
+        keep = mask ? mask + k : NULL;
+        flags = g_array_index(pieces, gint, n);
+        for (k = 0; k < len; k++, ctlpts += 6) {
+            if (keep && !keep[k])
+                continue;
+            from = &g_array_index(joined->points, gdouble, to[k] * 6);
+            in = (flags & JOINED_REVERSED) ? from + 4 : from;
+            out = (flags & JOINED_REVERSED) ? from : from + 4;
+            dx = from[2] - ctlpts[2];
+            dy = from[3] - ctlpts[3];
+            if (k == 0 && (flags & JOINED_START)) {
+                ctlpts[0] += dx;
+                ctlpts[1] += dy;
+            } else {
+                ctlpts[0] = in[0];
+                ctlpts[1] = in[1];
+            }
+            if (k == len - 1 && (flags & JOINED_END)) {
+                ctlpts[4] += dx;
+                ctlpts[5] += dy;
+            } else {
+                ctlpts[4] = out[0];
+                ctlpts[5] = out[1];
+            }
+            ctlpts[2] = from[2];
+            ctlpts[3] = from[3];
+        }
+    }
+}
+
+/*-----------------------------------------------------------------------------
+ *  smooth_batch_joined  --  like smooth_batch_collapsed, but with strokes
+ *                           whose ends touch joined, so that they meet
+ *                           smoothly, as vals->join says. With JOIN_KEEP,
+ *                           batch, mask (empty for none) and ends (as for
+ *                           join_batch) describe the joined strokes after;
+ *                           with JOIN_SPLIT they are cut apart again
+ *-----------------------------------------------------------------------------
+ */
+void smooth_batch_joined(const SmoothVals *vals, StrokeBatch *batch,
+                         const gdouble *angles, GArray *mask, GArray *ends,
+                         SmoothScratch *scratch)
+{
+    StrokeBatch  joined;
+    GArray      *map, *pieces, *joined_angles, *joined_mask, *joined_ends;
+    const gint  *to;
+    guint8      *keep;
+    gint         k, joins;
+
+    if (vals->join == JOIN_NONE) {
+        smooth_batch_collapsed(vals, batch, angles,
+                               mask->len ? (guint8 *) mask->data : NULL,
+                               scratch);
+        return;
+    }
+
+    stroke_batch_init(&joined);
+    map = g_array_new(FALSE, FALSE, sizeof(gint));
+    pieces = g_array_new(FALSE, FALSE, sizeof(gint));
+    joined_ends = g_array_new(FALSE, FALSE, sizeof(gint));
+    joins = join_batch(batch, ends, &joined, map, pieces,
+                       ends ? joined_ends : NULL);
+    stats.joins += joins;
+    stats.joined += stroke_batch_len(&joined);
+    if (joins == 0) {
+        smooth_batch_collapsed(vals, batch, angles,
+                               mask->len ? (guint8 *) mask->data : NULL,
+                               scratch);
+        stroke_batch_free(&joined);
+        g_array_free(map, TRUE);
+        g_array_free(pieces, TRUE);
+        g_array_free(joined_ends, TRUE);
+        return;
+    }
+
+    /* Where two ends became one anchor, it may change if both could */
+    joined_angles = g_array_new(FALSE, FALSE, sizeof(gdouble));
+    stroke_batch_angles(&joined, joined_angles);
+    joined_mask = g_array_new(FALSE, FALSE, sizeof(guint8));
+    if (mask->len) {
+        g_array_set_size(joined_mask, joined.points->len / 6);
+        keep = (guint8 *) joined_mask->data;
+        memset(keep, 1, joined_mask->len);
+        to = (const gint *) map->data;
+        for (k = 0; k < map->len; k++)
+            keep[to[k]] &= g_array_index(mask, guint8, k);
+    }
+
+    smooth_batch_collapsed(vals, &joined, (gdouble *) joined_angles->data,
+                           mask->len ? (guint8 *) joined_mask->data : NULL,
+                           scratch);
+
+    if (vals->join == JOIN_SPLIT) {
+        split_batch(batch, &joined, map, pieces,
+                    mask->len ? (guint8 *) mask->data : NULL);
+    } else {
+        stroke_batch_copy(batch, &joined);
+        if (mask->len) {
+            g_array_set_size(mask, joined_mask->len);
+            memcpy(mask->data, joined_mask->data, joined_mask->len);
+        }
+        if (ends)
+            memcpy(ends->data, joined_ends->data, ends->len * sizeof(gint));
+    }
+
+    stroke_batch_free(&joined);
+    g_array_free(map, TRUE);
+    g_array_free(pieces, TRUE);
+    g_array_free(joined_ends, TRUE);
+    g_array_free(joined_angles, TRUE);
+    g_array_free(joined_mask, TRUE);
+}
+
+/*-----------------------------------------------------------------------------
+ *  smooth_stroke_local  --  the cheap stand-in for smooth_stroke when there
+ *                           is no time to solve: each smoothed anchor gets
+ *                           handles along the line between its neighbours,
+ *                           a sixth of its length, as a Catmull-Rom spline
+ *                           through the anchors would; anchors don't move,
+ *                           and mask, if not NULL, says which may change
+ *-----------------------------------------------------------------------------
+ */
+void smooth_stroke_local(const SmoothVals *vals, gdouble *ctlpts,
+                         gint num_points, gboolean closed,
+                         const gdouble *angles, const guint8 *mask)
+{
+    gdouble tx, ty;
+    gint    n, len, prev, next;
+
+    if (num_points < 18)
+        return;
+
+    len = num_points / 6;
+    for (n = 0; n < len; n++) {
+        if (!anchor_smoothed(vals, angles[n]) || (mask && !mask[n]))
+            continue;
+        prev = (n > 0) ? n - 1 : (closed ? len - 1 : n);
+        next = (n < len - 1) ? n + 1 : (closed ? 0 : n);
+        /* The ends of an open stroke only have one neighbour */
+        tx = (ctlpts[next * 6 + 2] - ctlpts[prev * 6 + 2]) /
+             ((prev == n || next == n) ? 3 : 6);
+        ty = (ctlpts[next * 6 + 3] - ctlpts[prev * 6 + 3]) /
+             ((prev == n || next == n) ? 3 : 6);
+        if (closed || n > 0) {
+            ctlpts[n * 6] = ctlpts[n * 6 + 2] - tx;
+            ctlpts[n * 6 + 1] = ctlpts[n * 6 + 3] - ty;
+        }
+        if (closed || n < len - 1) {
+            ctlpts[n * 6 + 4] = ctlpts[n * 6 + 2] + tx;
+            ctlpts[n * 6 + 5] = ctlpts[n * 6 + 3] + ty;
+        }
+    }
+}
+
+/*-----------------------------------------------------------------------------
+ *  stroke_size_compare  --  orders stroke indices by the size of the strokes
+ *                           in the batch, largest first
+ *-----------------------------------------------------------------------------
+ */
+static gint stroke_size_compare(gconstpointer a, gconstpointer b,
+                                gpointer data)
+{
+    const StrokeBatch *batch = data;
+    gint               x = *(const gint *) a, y = *(const gint *) b;
+
+    if (stroke_batch_size(batch, x) != stroke_batch_size(batch, y))
+        return stroke_batch_size(batch, y) - stroke_batch_size(batch, x);
+    return x - y;
+}
+
+/*-----------------------------------------------------------------------------
+ *  deadline_run  --  smooths the strokes of a batch, largest first, as far
+ *                    as vals->deadline milliseconds allow: solved while the
+ *                    time left is enough, given local handles once it
+ *                    isn't, and left alone once not even that fits. The
+ *                    cost of a stroke comes from the cost model if it was
+ *                    measured, else from the strokes done so far; quality
+ *                    gets the QUALITY_ level of each stroke
+ *-----------------------------------------------------------------------------
+ */
+static void deadline_run(const SmoothVals *vals, StrokeBatch *batch,
+                         const gdouble *angles, const guint8 *mask,
+                         SmoothScratch *scratch, GArray *quality)
+{
+    gdouble  *ctlpts;
+    gint     *order, *offsets;
+    gint64    start, begun, spent[2] = { 0, 0 };
+    gdouble   left, exact, local;
+    gint      done[2] = { 0, 0 };
+    gint      num_strokes, k, n, len, level;
+
+    num_strokes = stroke_batch_len(batch);
+    offsets = (gint *) batch->offsets->data;
+    g_array_set_size(quality, num_strokes);
+    order = g_new(gint, num_strokes);
+    for (n = 0; n < num_strokes; n++)
+        order[n] = n;
+    g_qsort_with_data(order, num_strokes, sizeof(gint), stroke_size_compare,
+                      batch);
+
+    stats.deadline = vals->deadline;
+    stats.threads = 1;
+    start = g_get_monotonic_time();
+    for (k = 0; k < num_strokes; k++) {
+        n = order[k];
+        len = stroke_batch_size(batch, n) / 6;
+        ctlpts = stroke_batch_points(batch, n);
+
+        left = vals->deadline * 1000 - (g_get_monotonic_time() - start);
+        if (model.version == CALIBRATION_VERSION)
+            exact = model_time(vals, len, 1, 1);
+        else
+            exact = len * (done[0] > 0 ? (gdouble) spent[0] / done[0] :
+                                         DEADLINE_GUESS_EXACT);
+        local = len * (done[1] > 0 ? (gdouble) spent[1] / done[1] :
+                                     DEADLINE_GUESS_LOCAL);
+        level = (exact <= left) ? QUALITY_EXACT :
+                (local <= left) ? QUALITY_LOCAL : QUALITY_NONE;
+
+        begun = g_get_monotonic_time();
+        if (level == QUALITY_EXACT)
+            smooth_strokes(vals, (gdouble *) batch->points->data, offsets + n,
+                           &stroke_batch_closed(batch, n), angles, mask, 1,
+                           scratch);
+        else if (level == QUALITY_LOCAL)
+            smooth_stroke_local(vals, ctlpts, len * 6,
+                                stroke_batch_closed(batch, n),
+                                angles + offsets[n] / 6,
+                                mask ? mask + offsets[n] / 6 : NULL);
+        if (level != QUALITY_NONE) {
+            spent[level] += g_get_monotonic_time() - begun;
+            done[level] += len;
+        }
+        g_array_index(quality, guint8, n) = level;
+        stats.quality[level]++;
+    }
+
+    g_free(order);
+}
+
+/*-----------------------------------------------------------------------------
+ *  smooth_batch_deadline  --  deadline_run on the batch with its runs of
+ *                             anchors collapsed, as smooth_batch_collapsed
+ *                             does; strokes the deadline left alone keep
+ *                             their runs as they were
+ *-----------------------------------------------------------------------------
+ */
+void smooth_batch_deadline(const SmoothVals *vals, StrokeBatch *batch,
+                           const gdouble *angles, const guint8 *mask,
+                           SmoothScratch *scratch, GArray *quality)
+{
+    CollapsedBatch c;
+
+    /* Collapsing keeps every stroke, so quality applies to both batches */
+    if (collapsed_batch_init(&c, batch, mask) == 0) {
+        deadline_run(vals, batch, angles, mask, scratch, quality);
+        collapsed_batch_free(&c);
+        return;
+    }
+    stats.collapsed += c.removed;
+
+    deadline_run(vals, &c.reduced, (gdouble *) c.angles->data,
+                 mask ? (guint8 *) c.mask->data : NULL, scratch, quality);
+    collapsed_batch_expand(vals, &c, batch, quality);
+    collapsed_batch_free(&c);
+}
+
+/*-----------------------------------------------------------------------------
+ *  calibrate  --  times the solve on this machine and fills in m: on one
+ *                 thread, over long strokes and over short ones of the same
+ *                 anchors, to tell what a stroke costs from what an anchor
+ *                 does, and over the pool, on the long strokes and on one
+ *                 short stroke per processor, which is nearly all start up;
+ *                 each the best of three runs, a few tens of milliseconds
+ *-----------------------------------------------------------------------------
+ */
+void calibrate(SmoothModel *m)
+{
+    SmoothScratch  scratch = { NULL };
+    SmoothVals     vals = { FALSE, 60.0, 120.0, 0.0, REGION_ALL, 0, -1,
+                            FILL_NONE, 0.0, JOIN_NONE, 0.0 };
+    SmoothTask     task;
+    StrokeBatch    strokes[2], batch;
+    GArray        *angles[2];
+    GRand         *rand;
+    gdouble       *ctlpts;
+    gdouble        best[4], r;
+    gint64         start;
+    gint           n, k, len, kind, engine, run, shape, counts[2];
+
+    /* Wobbly circles, like traced outlines */
+    rand = g_rand_new_with_seed(CALIBRATION_VERSION);
+    ctlpts = g_new(gdouble, CALIBRATION_ANCHORS * 6);
+    for (k = 0; k < CALIBRATION_ANCHORS; k++) {
+        r = 100 + g_rand_double_range(rand, -5, 5);
+        ctlpts[k * 6 + 2] = r * cos(2 * G_PI * k / CALIBRATION_ANCHORS);
+        ctlpts[k * 6 + 3] = r * sin(2 * G_PI * k / CALIBRATION_ANCHORS);
+        memcpy(ctlpts + k * 6, ctlpts + k * 6 + 2, 2 * sizeof(gdouble));
+        memcpy(ctlpts + k * 6 + 4, ctlpts + k * 6 + 2, 2 * sizeof(gdouble));
+    }
+    for (shape = 0; shape < 2; shape++) {
+        len = shape ? CALIBRATION_SHORT : CALIBRATION_ANCHORS;
+        stroke_batch_init(&strokes[shape]);
+        for (n = 0; n < CALIBRATION_STROKES; n++)
+            for (k = 0; k < CALIBRATION_ANCHORS; k += len)
+                stroke_batch_add(&strokes[shape], ctlpts + k * 6, len * 6,
+                                 (k / len) % 2);
+        counts[shape] = stroke_batch_len(&strokes[shape]);
+        angles[shape] = g_array_new(FALSE, FALSE, sizeof(gdouble));
+        stroke_batch_angles(&strokes[shape], angles[shape]);
+    }
+    stroke_batch_init(&batch);
+
+    task.vals = &vals;
+    task.batch = &batch;
+    task.mask = NULL;
+    task.sizes = NULL;
+
+    m->processors = g_get_num_processors();
+    for (kind = 0; kind < 2; kind++) {
+        vals.smoothing = kind ? 10.0 : 0.0;
+        for (engine = 0; engine < 4; engine++) {
+            shape = (engine == 1 || engine == 3);
+            task.angles = (const gdouble *) angles[shape]->data;
+            best[engine] = G_MAXDOUBLE;
+            for (run = 0; run < 3; run++) {
+                stroke_batch_copy(&batch, &strokes[shape]);
+                if (engine == 3) {
+                    g_array_set_size(batch.points,
+                                     m->processors * CALIBRATION_SHORT * 6);
+                    g_array_set_size(batch.closed, m->processors);
+                    g_array_set_size(batch.offsets, m->processors + 1);
+                }
+                start = g_get_monotonic_time();
+                if (engine < 2)
+                    smooth_batch(&vals, &batch, task.angles, NULL, &scratch);
+                else
+                    batch_pool_run(&task, smooth_task);
+                best[engine] = MIN(best[engine],
+                                   g_get_monotonic_time() - start);
+            }
+        }
+        m->stroke[kind] = MAX(best[1] - best[0], 0) /
+                          (counts[1] - counts[0]);
+        m->anchor[kind] = MAX(best[0] - m->stroke[kind] * counts[0], 0) /
+                          (CALIBRATION_STROKES * CALIBRATION_ANCHORS);
+        m->speedup[kind] = best[0] / MAX(best[2] - best[3], 1);
+        m->pool_start = kind ? MIN(m->pool_start, best[3]) : best[3];
+    }
+    m->version = CALIBRATION_VERSION;
+
+    for (shape = 0; shape < 2; shape++) {
+        stroke_batch_free(&strokes[shape]);
+        g_array_free(angles[shape], TRUE);
+    }
+    stroke_batch_free(&batch);
+    g_rand_free(rand);
+    g_free(ctlpts);
+    scratch_free(&scratch);
+}
+
+/*-----------------------------------------------------------------------------
+ *  bezier_point  --  the point at t on the cubic with control points p, and
+ *                    the first and second derivatives there if d1 and d2
+ *                    aren't NULL; all as x, y pairs
+ *-----------------------------------------------------------------------------
+ */
+void bezier_point(const gdouble *p, gdouble t, gdouble *pt, gdouble *d1,
+                  gdouble *d2)
+{
+    gdouble u = 1 - t;
+    gint    k;
+
+    for (k = 0; k < 2; k++) {
+        pt[k] = u * u * u * p[k] + 3 * u * u * t * p[2 + k] +
+                3 * u * t * t * p[4 + k] + t * t * t * p[6 + k];
+        if (d1)
+            d1[k] = 3 * (u * u * (p[2 + k] - p[k]) +
+                         2 * u * t * (p[4 + k] - p[2 + k]) +
+                         t * t * (p[6 + k] - p[4 + k]));
+        if (d2)
+            d2[k] = 6 * (u * (p[4 + k] - 2 * p[2 + k] + p[k]) +
+                         t * (p[6 + k] - 2 * p[4 + k] + p[2 + k]));
+    }
+}
+
+/*-----------------------------------------------------------------------------
+ *  merge_fit  --  tries to replace count segments of a stroke of len
+ *                 anchors, from anchor first on, by one cubic that keeps
+ *                 the end anchors and the directions of their handles; the
+ *                 handle lengths are fitted by least squares to points
+ *                 along the segments (after Schneider, Graphics Gems), and
+ *                 if no point is further than tolerance from where the
+ *                 cubic puts it, p gets its control points and TRUE is
+ *                 returned
+ *-----------------------------------------------------------------------------
+ */
+gboolean merge_fit(const gdouble *ctlpts, gint len, gint first, gint count,
+                   gdouble tolerance, gdouble *p)
+{
+    gdouble  pts[(MERGE_MAX_RUN * MERGE_SAMPLES + 1) * 2];
+    gdouble  u[MERGE_MAX_RUN * MERGE_SAMPLES + 1];
+    gdouble  seg[8], t0[2], t1[2], pt[2], d1[2], d2[2];
+    gdouble  c00, c01, c11, x0, x1, det, b0, b1, b2, b3, a1, a2, r, dot, den;
+    gdouble  alpha0, alpha1, err, norm;
+    gint     num, m, n, k, a, b, pass;
+
+    /* Points along the segments, spaced by their chords */
+    num = count * MERGE_SAMPLES + 1;
+    for (n = 0; n < count; n++) {
+        a = (first + n) % len;
+        b = (a + 1) % len;
+        memcpy(seg, ctlpts + a * 6 + 2, 4 * sizeof(gdouble));
+        memcpy(seg + 4, ctlpts + b * 6, 4 * sizeof(gdouble));
+        for (k = 0; k < MERGE_SAMPLES + (n == count - 1); k++)
+            bezier_point(seg, (gdouble) k / MERGE_SAMPLES,
+                         pts + (n * MERGE_SAMPLES + k) * 2, NULL, NULL);
+    }
+    u[0] = 0;
+    for (m = 1; m < num; m++)
+        u[m] = u[m - 1] + hypot(pts[m * 2] - pts[m * 2 - 2],
+                                pts[m * 2 + 1] - pts[m * 2 - 1]);
+    if (u[num - 1] <= 0)
+        return FALSE;
+    for (m = 1; m < num; m++)
+        u[m] /= u[num - 1];
+
+    /* The directions of the outer handles, or of the curve where a handle
+     * is missing */
+    a = first % len;
+    b = (first + count) % len;
+    t0[0] = ctlpts[a * 6 + 4] - ctlpts[a * 6 + 2];
+    t0[1] = ctlpts[a * 6 + 5] - ctlpts[a * 6 + 3];
+    if (t0[0] == 0 && t0[1] == 0) {
+        t0[0] = pts[2] - pts[0];
+        t0[1] = pts[3] - pts[1];
+    }
+    t1[0] = ctlpts[b * 6 + 0] - ctlpts[b * 6 + 2];
+    t1[1] = ctlpts[b * 6 + 1] - ctlpts[b * 6 + 3];
+    if (t1[0] == 0 && t1[1] == 0) {
+        t1[0] = pts[(num - 2) * 2] - pts[(num - 1) * 2];
+        t1[1] = pts[(num - 2) * 2 + 1] - pts[(num - 1) * 2 + 1];
+    }
+    norm = hypot(t0[0], t0[1]);
+    if (norm == 0)
+        return FALSE;
+    t0[0] /= norm;
+    t0[1] /= norm;
+    norm = hypot(t1[0], t1[1]);
+    if (norm == 0)
+        return FALSE;
+    t1[0] /= norm;
+    t1[1] /= norm;
+
+    p[0] = pts[0];
+    p[1] = pts[1];
+    p[6] = pts[(num - 1) * 2];
+    p[7] = pts[(num - 1) * 2 + 1];
+
+    /* A second try after moving each point's parameter a Newton step
+     * closer to the nearest point of the first fit */
+    for (pass = 0; pass < 2; pass++) {
+        c00 = c01 = c11 = x0 = x1 = 0;
+        for (m = 0; m < num; m++) {
+            b0 = (1 - u[m]) * (1 - u[m]) * (1 - u[m]);
+            b1 = 3 * u[m] * (1 - u[m]) * (1 - u[m]);
+            b2 = 3 * u[m] * u[m] * (1 - u[m]);
+            b3 = u[m] * u[m] * u[m];
+            c00 += b1 * b1;
+            c01 += b1 * b2 * (t0[0] * t1[0] + t0[1] * t1[1]);
+            c11 += b2 * b2;
+            for (k = 0; k < 2; k++) {
+                r = pts[m * 2 + k] - p[k] * (b0 + b1) - p[6 + k] * (b2 + b3);
+                a1 = b1 * t0[k];
+                a2 = b2 * t1[k];
+                x0 += a1 * r;
+                x1 += a2 * r;
+            }
+        }
+        det = c00 * c11 - c01 * c01;
+        if (det <= 1e-12 * c00 * c11)
+            return FALSE;
+        alpha0 = (x0 * c11 - x1 * c01) / det;
+        alpha1 = (c00 * x1 - c01 * x0) / det;
+        if (alpha0 <= 0 || alpha1 <= 0)
+            return FALSE;
+        for (k = 0; k < 2; k++) {
+            p[2 + k] = p[k] + alpha0 * t0[k];
+            p[4 + k] = p[6 + k] + alpha1 * t1[k];
+        }
+
+        err = 0;
+        for (m = 0; m < num; m++) {
+            bezier_point(p, u[m], pt, d1, d2);
+            pt[0] -= pts[m * 2];
+            pt[1] -= pts[m * 2 + 1];
+            err = MAX(err, hypot(pt[0], pt[1]));
+            dot = pt[0] * d1[0] + pt[1] * d1[1];
+            den = d1[0] * d1[0] + d1[1] * d1[1] + pt[0] * d2[0] +
+                  pt[1] * d2[1];
+            if (den != 0)
+                u[m] = CLAMP(u[m] - dot / den, 0, 1);
+        }
+        if (err <= tolerance)
+            return TRUE;
+    }
+    return FALSE;
+}
+
+/*-----------------------------------------------------------------------------
+ *  merge_stroke  --  greedily replaces runs of up to MERGE_MAX_RUN segments
+ *                    of a smoothed stroke by single cubics, in place, as
+ *                    long as they stay within vals->merge pixels of it;
+ *                    only anchors with their handles in line, and with
+ *                    their mask entry set if there is a mask, are dropped,
+ *                    so corners stay; returns the new number of entries
+ *-----------------------------------------------------------------------------
+ */
+gint merge_stroke(const SmoothVals *vals, gdouble *ctlpts, gint num_points,
+                  gboolean closed, const guint8 *mask)
+{
+    gdouble  p[8], best[8] = { 0 };
+    gdouble  in[2], anchor[2], out[2], ux, uy, vx, vy;
+    gint     len, segs, i, j, a, kept, end;
+
+    len = num_points / 6;
+    if (len < 3)
+        return num_points;
+
+    /* Anchors are written back at or before where they were read, so the
+     * stroke can be merged in place; anchor 0 stays first, and takes the
+     * in handle the last run gives it when the stroke is closed */
+    segs = closed ? len : len - 1;
+    in[0] = ctlpts[0];
+    in[1] = ctlpts[1];
+    kept = 0;
+    for (i = 0; i < segs; i = end) {
+        end = i + 1;
+        for (j = i + 2; j <= segs && j - i <= MERGE_MAX_RUN &&
+                        (!closed || j - i < len - 1); j++) {
+            a = j - 1;
+            ux = ctlpts[a * 6 + 2] - ctlpts[a * 6 + 0];
+            uy = ctlpts[a * 6 + 3] - ctlpts[a * 6 + 1];
+            vx = ctlpts[a * 6 + 4] - ctlpts[a * 6 + 2];
+            vy = ctlpts[a * 6 + 5] - ctlpts[a * 6 + 3];
+            if ((mask && !mask[a]) || ux * vx + uy * vy <= 0 ||
+                ABS(ux * vy - uy * vx) > 1e-3 * hypot(ux, uy) * hypot(vx, vy))
+                break;
+            if (!merge_fit(ctlpts, len, i, j - i, vals->merge, p))
+                break;
+            memcpy(best, p, sizeof(best));
+            end = j;
+        }
+
+        anchor[0] = ctlpts[i * 6 + 2];
+        anchor[1] = ctlpts[i * 6 + 3];
+        if (end == i + 1) {
+            out[0] = ctlpts[i * 6 + 4];
+            out[1] = ctlpts[i * 6 + 5];
+        } else {
+            out[0] = best[2];
+            out[1] = best[3];
+        }
+        ctlpts[kept * 6 + 0] = in[0];
+        ctlpts[kept * 6 + 1] = in[1];
+        ctlpts[kept * 6 + 2] = anchor[0];
+        ctlpts[kept * 6 + 3] = anchor[1];
+        ctlpts[kept * 6 + 4] = out[0];
+        ctlpts[kept * 6 + 5] = out[1];
+        kept++;
+        if (end == i + 1) {
+            in[0] = ctlpts[(end % len) * 6 + 0];
+            in[1] = ctlpts[(end % len) * 6 + 1];
+        } else {
+            in[0] = best[4];
+            in[1] = best[5];
+        }
+    }
+
+    if (closed) {
+        ctlpts[0] = in[0];
+        ctlpts[1] = in[1];
+    } else {
+        memmove(ctlpts + kept * 6 + 2, ctlpts + (len - 1) * 6 + 2,
+                4 * sizeof(gdouble));
+        ctlpts[kept * 6 + 0] = in[0];
+        ctlpts[kept * 6 + 1] = in[1];
+        kept++;
+    }
+    return kept * 6;
+}
+
+/*-----------------------------------------------------------------------------
+ *  merge_task  --  worker thread body, merges one run of strokes
+ *-----------------------------------------------------------------------------
+ */
+static void merge_task(gpointer data, gpointer user_data)
+{
+    SmoothTask  *task = data;
+    StrokeBatch *batch = task->batch;
+    gint         n, offset;
+
+    for (n = task->first; n < task->last; n++) {
+        offset = g_array_index(batch->offsets, gint, n);
+        task->sizes[n] = merge_stroke(task->vals,
+                                      stroke_batch_points(batch, n),
+                                      stroke_batch_size(batch, n),
+                                      stroke_batch_closed(batch, n),
+                                      task->mask ? task->mask + offset / 6 :
+                                                   NULL);
+    }
+}
+
+/*-----------------------------------------------------------------------------
+ *  merge_batch  --  merges the segments of every stroke of a smoothed batch
+ *                   with merge_stroke, over one thread per processor when
+ *                   there are enough anchors, and closes up the gaps; mask
+ *                   is the one smoothing went by, or NULL
+ *-----------------------------------------------------------------------------
+ */
+void merge_batch(const SmoothVals *vals, StrokeBatch *batch,
+                 const guint8 *mask)
+{
+    SmoothTask  task;
+    gdouble    *points;
+    gint       *offsets, *sizes;
+    gint        n, num_strokes, to, size;
+    gint64      start;
+
+    start = g_get_monotonic_time();
+    num_strokes = stroke_batch_len(batch);
+    sizes = g_new(gint, num_strokes);
+    task.vals = vals;
+    task.batch = batch;
+    task.angles = NULL;
+    task.mask = mask;
+    task.sizes = sizes;
+    task.first = 0;
+    task.last = num_strokes;
+    if (batch->points->len / 6 < MERGE_POOL_MIN_ANCHORS ||
+        MIN((gint) g_get_num_processors(), num_strokes) < 2)
+        merge_task(&task, NULL);
+    else
+        batch_pool_run(&task, merge_task);
+
+    points = (gdouble *) batch->points->data;
+    offsets = (gint *) batch->offsets->data;
+    to = 0;
+    for (n = 0; n < num_strokes; n++) {
+        size = offsets[n + 1] - offsets[n];
+        if (size >= 6) {
+            stats.segments_in += size / 6 - !stroke_batch_closed(batch, n);
+            stats.segments_out += sizes[n] / 6 -
+                                  !stroke_batch_closed(batch, n);
+        }
+        memmove(points + to, points + offsets[n], sizes[n] * sizeof(gdouble));
+        offsets[n] = to;
+        to += sizes[n];
+    }
+    offsets[num_strokes] = to;
+    g_array_set_size(batch->points, to);
+    g_free(sizes);
+    stats.merge_time += g_get_monotonic_time() - start;
+}
+
+/*-----------------------------------------------------------------------------
+ *  frame_state_init, frame_state_free  --  a state with no previous frame,
+ *                                          and its release
+ *-----------------------------------------------------------------------------
+ */
+void frame_state_init(FrameState *state)
+{
+    stroke_batch_init(&state->input);
+    stroke_batch_init(&state->output);
+    state->angles = g_array_new(FALSE, FALSE, sizeof(gdouble));
+    state->factors = g_array_new(FALSE, FALSE, sizeof(gdouble));
+    state->factored = g_array_new(FALSE, FALSE, sizeof(gboolean));
+    state->reach = g_array_new(FALSE, FALSE, sizeof(gint));
+    state->mask = g_array_new(FALSE, FALSE, sizeof(guint8));
+    state->frames = 0;
+}
+
+void frame_state_free(FrameState *state)
+{
+    stroke_batch_free(&state->input);
+    stroke_batch_free(&state->output);
+    g_array_free(state->angles, TRUE);
+    g_array_free(state->factors, TRUE);
+    g_array_free(state->factored, TRUE);
+    g_array_free(state->reach, TRUE);
+    g_array_free(state->mask, TRUE);
+}
+
+/*-----------------------------------------------------------------------------
+ *  frame_reach  --  how many anchors either side of one that moved by the
+ *                   given distance end up changed by more than
+ *                   FRAME_TOLERANCE; a disturbance dies off by 2 - sqrt(3)
+ *                   per anchor when interpolating, and roughly as
+ *                   exp(-0.7 n / smoothing^1/4) when approximating
+ *-----------------------------------------------------------------------------
+ */
+gint frame_reach(const SmoothVals *vals, gdouble moved)
+{
+    gdouble rate;
+
+    if (moved <= FRAME_TOLERANCE)
+        return 0;
+    rate = log(2 + sqrt(3));
+    if (vals->smoothing > 0)
+        rate = MIN(rate, 0.7 / pow(vals->smoothing, 0.25));
+    return (gint) ceil(log(moved / FRAME_TOLERANCE) / rate);
+}
+
+/*-----------------------------------------------------------------------------
+ *  frame_stroke  --  smooths ctlpts, stroke k of a frame, from the same
+ *                    stroke of the previous frame: the anchors near the ones
+ *                    that moved are solved again, with the rest held where
+ *                    they ended up last time, which is where a full solve
+ *                    would put them too; brings the state up to date, and
+ *                    returns FALSE if so much changed that the stroke is
+ *                    better solved whole
+ *-----------------------------------------------------------------------------
+ */
+gboolean frame_stroke(const SmoothVals *vals, FrameState *state, gint k,
+                      gdouble *ctlpts, SmoothScratch *scratch)
+{
+    gdouble  *input, *output, *angles;
+    gint     *reach;
+    guint8   *mask;
+    gboolean  closed;
+    gdouble   moved, angle;
+    gint      n, i, j, len, left, count, runs, margin, prev, next;
+
+    input = stroke_batch_points(&state->input, k);
+    output = stroke_batch_points(&state->output, k);
+    angles = &g_array_index(state->angles, gdouble,
+                            g_array_index(state->input.offsets, gint, k) / 6);
+    len = stroke_batch_size(&state->input, k) / 6;
+    closed = stroke_batch_closed(&state->input, k);
+    g_array_set_size(state->reach, len);
+    g_array_set_size(state->mask, len);
+    reach = (gint *) state->reach->data;
+    mask = (guint8 *) state->mask->data;
+
+    /* Find what moved, and measure the corners next to it again; a corner
+     * that changes between smoothed and not only changes its own handles
+     * when interpolating, but when approximating it is pinned back where it
+     * was read, or let go to move about as far as the middle of its
+     * neighbours, and the factors of the whole stroke are out of date */
+    for (n = 0; n < len; n++)
+        reach[n] = -1;
+    for (n = 0; n < len; n++) {
+        if (memcmp(ctlpts + n * 6, input + n * 6, 6 * sizeof(gdouble)) == 0)
+            continue;
+        moved = MAX(ABS(ctlpts[n * 6 + 2] - input[n * 6 + 2]),
+                    ABS(ctlpts[n * 6 + 3] - input[n * 6 + 3]));
+        reach[n] = MAX(reach[n], frame_reach(vals, moved));
+        memcpy(input + n * 6, ctlpts + n * 6, 6 * sizeof(gdouble));
+        if (moved == 0)
+            continue;
+        for (i = n - 1; i <= n + 1; i++) {
+            if (!closed && (i < 0 || i >= len))
+                continue;
+            j = (i + len) % len;
+            angle = stroke_corner_angle(ctlpts, len, closed, j);
+            if (anchor_smoothed(vals, angle) !=
+                anchor_smoothed(vals, angles[j])) {
+                moved = 0;
+                if (vals->smoothing > 0) {
+                    prev = (j + len - 1) % len;
+                    next = (j + 1) % len;
+                    if (anchor_smoothed(vals, angle))
+                        moved = MAX(ABS(ctlpts[j * 6 + 2] -
+                                        (output[prev * 6 + 2] +
+                                         output[next * 6 + 2]) / 2),
+                                    ABS(ctlpts[j * 6 + 3] -
+                                        (output[prev * 6 + 3] +
+                                         output[next * 6 + 3]) / 2));
+                    else
+                        moved = MAX(ABS(ctlpts[j * 6 + 2] -
+                                        output[j * 6 + 2]),
+                                    ABS(ctlpts[j * 6 + 3] -
+                                        output[j * 6 + 3]));
+                    g_array_index(state->factored, gboolean, k) = FALSE;
+                }
+                reach[j] = MAX(reach[j], frame_reach(vals, moved));
+            }
+            angles[j] = angle;
+        }
+    }
+
+    /* Spread each change over its reach, both ways, and round the end of a
+     * closed stroke */
+    memset(mask, 0, len);
+    left = -1;
+    for (i = 0; i < (closed ? 2 * len : len); i++) {
+        left = MAX(left - 1, reach[i % len]);
+        if (left >= 0)
+            mask[i % len] = 1;
+    }
+    left = -1;
+    for (i = (closed ? 2 * len : len) - 1; i >= 0; i--) {
+        left = MAX(left - 1, reach[i % len]);
+        if (left >= 0)
+            mask[i % len] = 1;
+    }
+
+    count = runs = 0;
+    for (n = 0; n < len; n++) {
+        count += mask[n];
+        runs += (mask[n] && (n == 0 || !mask[n - 1]));
+    }
+    if (count == 0) {
+        memcpy(ctlpts, output, len * 6 * sizeof(gdouble));
+        return TRUE;
+    }
+    margin = MAX(REGION_MARGIN, approximate_margin(vals));
+    if (len < 3 || count + 2 * margin * runs >= len)
+        return FALSE;
+
+    for (n = 0; n < len; n++)
+        if (!mask[n])
+            memcpy(ctlpts + n * 6, output + n * 6, 6 * sizeof(gdouble));
+    smooth_stroke_region(vals, ctlpts, len * 6, closed, angles, mask,
+                         scratch);
+    for (n = 0; n < len; n++)
+        if (mask[n])
+            memcpy(output + n * 6, ctlpts + n * 6, 6 * sizeof(gdouble));
+    stats.resolved += count;
+
+    return TRUE;
+}
+
+/*-----------------------------------------------------------------------------
+ *  smooth_frame  --  smooths strokes first .. last - 1 of batch as the next
+ *                    frame of an animation; a frame with the same strokes
+ *                    as the one before, and the same number of anchors in
+ *                    each, costs about as much as what moved, otherwise it
+ *                    starts a new run of frames and is solved whole
+ *-----------------------------------------------------------------------------
+ */
+void smooth_frame(const SmoothVals *vals, FrameState *state,
+                  StrokeBatch *batch, gint first, gint last,
+                  SmoothScratch *scratch)
+{
+    gdouble  *ctlpts;
+    gboolean *factored;
+    gboolean  same;
+    gint      n, k, size, offset, m;
+
+    same = (state->frames % FRAME_REFRESH != 0 &&
+            stroke_batch_len(&state->input) == last - first);
+    for (n = first; same && n < last; n++)
+        same = (stroke_batch_size(batch, n) ==
+                stroke_batch_size(&state->input, n - first) &&
+                stroke_batch_closed(batch, n) ==
+                stroke_batch_closed(&state->input, n - first));
+    if (!same) {
+        state->frames = 0;
+        stroke_batch_clear(&state->input);
+        for (n = first; n < last; n++)
+            stroke_batch_add(&state->input, stroke_batch_points(batch, n),
+                             stroke_batch_size(batch, n),
+                             stroke_batch_closed(batch, n));
+        stroke_batch_copy(&state->output, &state->input);
+        stroke_batch_angles(&state->input, state->angles);
+        g_array_set_size(state->factored, last - first);
+        memset(state->factored->data, 0, (last - first) * sizeof(gboolean));
+        m = 0;
+        for (n = first; n < last; n++)
+            m += 3 * approximate_size(vals, stroke_batch_size(batch, n) / 6,
+                                      stroke_batch_closed(batch, n));
+        g_array_set_size(state->factors, m);
+    }
+
+    /* Strokes that have to be solved whole reuse the factors of their last
+     * full solve while their corners stay as they were */
+    offset = 0;
+    for (n = first; n < last; n++) {
+        k = n - first;
+        ctlpts = stroke_batch_points(batch, n);
+        size = stroke_batch_size(batch, n);
+        m = 3 * approximate_size(vals, size / 6,
+                                 stroke_batch_closed(batch, n));
+        if (!same || !frame_stroke(vals, state, k, ctlpts, scratch)) {
+            factored = &g_array_index(state->factored, gboolean, k);
+            scratch->factors = (m > 0) ?
+                &g_array_index(state->factors, gdouble, offset) : NULL;
+            scratch->factored = *factored;
+            smooth_stroke(vals, ctlpts, size, stroke_batch_closed(batch, n),
+                          &g_array_index(state->angles, gdouble,
+                              g_array_index(state->input.offsets, gint, k)
+                              / 6),
+                          scratch);
+            scratch->factors = NULL;
+            *factored = (m > 0 && size >= 18);
+            memcpy(stroke_batch_points(&state->output, k), ctlpts,
+                   size * sizeof(gdouble));
+            stats.resolved += size / 6;
+        }
+        offset += m;
+    }
+    state->frames++;
+    stats.frames++;
+}
+
+/*-----------------------------------------------------------------------------
+ *  engine_name  --  describes the kind of solve vals asks for, for the stats
+ *-----------------------------------------------------------------------------
+ */
+const gchar *engine_name(const SmoothVals *vals)
+{
+    if (vals->region != REGION_ALL)
+        return (vals->smoothing > 0) ? "approximating, windowed" :
+                                       "interpolating, windowed";
+    return (vals->smoothing > 0) ? "approximating" : "interpolating";
+}
+
+/*-----------------------------------------------------------------------------
+ *  stroke_batch_bounds  --  the box around all control points of strokes
+ *                           first .. last - 1, which holds their curves too;
+ *                           returns FALSE if there are no points
+ *-----------------------------------------------------------------------------
+ */
+gboolean stroke_batch_bounds(const StrokeBatch *batch, gint first, gint last,
+                             gdouble *x1, gdouble *y1, gdouble *x2,
+                             gdouble *y2)
+{
+    const gdouble *ctlpts;
+    gint           n, end;
+
+    n = g_array_index(batch->offsets, gint, first);
+    end = g_array_index(batch->offsets, gint, last);
+    if (n == end)
+        return FALSE;
+    ctlpts = (const gdouble *) batch->points->data;
+    *x1 = *x2 = ctlpts[n];
+    *y1 = *y2 = ctlpts[n + 1];
+    for (; n < end; n += 2) {
+        *x1 = MIN(*x1, ctlpts[n]);
+        *x2 = MAX(*x2, ctlpts[n]);
+        *y1 = MIN(*y1, ctlpts[n + 1]);
+        *y2 = MAX(*y2, ctlpts[n + 1]);
+    }
+    return TRUE;
+}
+
+/*-----------------------------------------------------------------------------
+ *  raster_line  --  adds the signed area a line covers in each pixel, and
+ *                   the cover it passes on to the pixels right of it, to
+ *                   acc, which has width + 2 cells per row; x0 and x1 must
+ *                   lie within 0 .. width, y is clipped to 0 .. height
+ *-----------------------------------------------------------------------------
+ */
+void raster_line(gfloat *acc, gint width, gint height, gdouble x0, gdouble y0,
+                 gdouble x1, gdouble y1)
+{
+    gfloat  *row;
+    gdouble  dir, dxdy, x, xnext, dy, d, xa, xb, s, fa, fb, a0, a1, a2, am;
+    gint     y, yend, ia, ib, i;
+
+    if (y0 == y1)
+        return;
+    dir = 1;
+    if (y0 > y1) {
+        dir = x0;
+        x0 = x1;
+        x1 = dir;
+        dir = y0;
+        y0 = y1;
+        y1 = dir;
+        dir = -1;
+    }
+    dxdy = (x1 - x0) / (y1 - y0);
+    x = (y0 < 0) ? x0 - y0 * dxdy : x0;
+    yend = MIN((gint) ceil(y1), height);
+
+    for (y = MAX((gint) floor(y0), 0); y < yend; y++) {
+        row = acc + y * (width + 2);
+        dy = MIN(y + 1, y1) - MAX(y, y0);
+        xnext = x + dxdy * dy;
+        d = dy * dir;
+        xa = MIN(x, xnext);
+        xb = MAX(x, xnext);
+        ia = (gint) floor(xa);
+        ib = (gint) ceil(xb);
+        if (ib <= ia + 1) {
+            /* Within one pixel: split by where the line crosses it */
+            s = 0.5 * (x + xnext) - ia;
+            row[ia] += d - d * s;
+            row[ia + 1] += d * s;
+        } else {
+            /* Across several: a triangle, a ramp, and a triangle */
+            s = 1.0 / (xb - xa);
+            fa = xa - ia;
+            a0 = 0.5 * s * (1 - fa) * (1 - fa);
+            fb = xb - ib + 1;
+            am = 0.5 * s * fb * fb;
+            row[ia] += d * a0;
+            if (ib == ia + 2) {
+                row[ia + 1] += d * (1 - a0 - am);
+            } else {
+                a1 = s * (1.5 - fa);
+                row[ia + 1] += d * (a1 - a0);
+                for (i = ia + 2; i < ib - 1; i++)
+                    row[i] += d * s;
+                a2 = a1 + (ib - ia - 3) * s;
+                row[ib - 1] += d * (1 - a2 - am);
+            }
+            row[ib] += d * am;
+        }
+        x = xnext;
+    }
+}
+
+/*-----------------------------------------------------------------------------
+ *  raster_clip_line  --  raster_line for lines that may leave 0 .. width;
+ *                        the parts left of it still cover everything to
+ *                        their right, so they run down its left edge, and
+ *                        the parts right of it cover nothing
+ *-----------------------------------------------------------------------------
+ */
+void raster_clip_line(gfloat *acc, gint width, gint height, gdouble x0,
+                      gdouble y0, gdouble x1, gdouble y1)
+{
+    gdouble t[4], xa, ya, xb, yb, mid;
+    gint    n = 0, i;
+
+    t[n++] = 0;
+    if ((x0 < 0) != (x1 < 0))
+        t[n++] = -x0 / (x1 - x0);
+    if ((x0 < width) != (x1 < width))
+        t[n++] = (width - x0) / (x1 - x0);
+    if (n == 3 && t[1] > t[2]) {
+        mid = t[1];
+        t[1] = t[2];
+        t[2] = mid;
+    }
+    t[n++] = 1;
+
+    xb = x0;
+    yb = y0;
+    for (i = 1; i < n; i++) {
+        xa = xb;
+        ya = yb;
+        xb = (i == n - 1) ? x1 : x0 + t[i] * (x1 - x0);
+        yb = (i == n - 1) ? y1 : y0 + t[i] * (y1 - y0);
+        mid = 0.5 * (xa + xb);
+        if (mid >= width)
+            continue;
+        if (mid < 0)
+            raster_line(acc, width, height, 0, ya, 0, yb);
+        else
+            raster_line(acc, width, height, CLAMP(xa, 0, width), ya,
+                        CLAMP(xb, 0, width), yb);
+    }
+}
+
+/*-----------------------------------------------------------------------------
+ *  raster_add_line  --  keeps a line of the flattened path, in coordinates
+ *                       relative to the raster, unless it can't matter
+ *-----------------------------------------------------------------------------
+ */
+void raster_add_line(Raster *raster, gdouble x0, gdouble y0, gdouble x1,
+                     gdouble y1)
+{
+    gdouble line[4];
+
+    line[0] = x0 - raster->x;
+    line[1] = y0 - raster->y;
+    line[2] = x1 - raster->x;
+    line[3] = y1 - raster->y;
+    if (line[1] == line[3] ||
+        MAX(line[1], line[3]) <= 0 || MIN(line[1], line[3]) >= raster->height ||
+        MIN(line[0], line[2]) >= raster->width)
+        return;
+    g_array_append_vals(raster->lines, line, 4);
+}
+
+/*-----------------------------------------------------------------------------
+ *  raster_flatten  --  turns strokes first .. last - 1 into lines; each
+ *                      Bezier segment gets just enough of them to stay
+ *                      within FLATTEN_TOLERANCE of the curve, and an open
+ *                      stroke is closed with a straight line, as filling
+ *                      it does in GIMP
+ *-----------------------------------------------------------------------------
+ */
+void raster_flatten(Raster *raster, const StrokeBatch *batch, gint first,
+                    gint last)
+{
+    const gdouble *c;
+    gdouble        p[8], ddx, ddy, dd, t, u, x, y, px, py;
+    gint           n, k, i, len, next, segs;
+
+    for (n = first; n < last; n++) {
+        c = stroke_batch_points(batch, n);
+        len = stroke_batch_size(batch, n) / 6;
+        for (i = 0; i < len; i++) {
+            next = (i + 1) % len;
+            if (next == 0 && !stroke_batch_closed(batch, n)) {
+                raster_add_line(raster, c[i * 6 + 2], c[i * 6 + 3],
+                                c[2], c[3]);
+                break;
+            }
+            p[0] = c[i * 6 + 2];
+            p[1] = c[i * 6 + 3];
+            p[2] = c[i * 6 + 4];
+            p[3] = c[i * 6 + 5];
+            p[4] = c[next * 6 + 0];
+            p[5] = c[next * 6 + 1];
+            p[6] = c[next * 6 + 2];
+            p[7] = c[next * 6 + 3];
+
+            ddx = MAX(ABS(p[0] - 2 * p[2] + p[4]), ABS(p[2] - 2 * p[4] + p[6]));
+            ddy = MAX(ABS(p[1] - 2 * p[3] + p[5]), ABS(p[3] - 2 * p[5] + p[7]));
+            dd = sqrt(ddx * ddx + ddy * ddy);
+            segs = CLAMP((gint) ceil(sqrt(0.75 * dd / FLATTEN_TOLERANCE)),
+                         1, 1024);
+
+            px = p[0];
+            py = p[1];
+            for (k = 1; k <= segs; k++) {
+                t = (gdouble) k / segs;
+                u = 1 - t;
+                x = u * u * u * p[0] + 3 * u * u * t * p[2] +
+                    3 * u * t * t * p[4] + t * t * t * p[6];
+                y = u * u * u * p[1] + 3 * u * u * t * p[3] +
+                    3 * u * t * t * p[5] + t * t * t * p[7];
+                raster_add_line(raster, px, py, x, y);
+                px = x;
+                py = y;
+            }
+        }
+    }
+}
+
+/*-----------------------------------------------------------------------------
+ *  raster_band  --  computes the coverage of one band of rows of the
+ *                   raster from the lines that reach into it
+ *-----------------------------------------------------------------------------
+ */
+void raster_band(const Raster *raster, gint band, guint8 *out)
+{
+    const gdouble *line;
+    gfloat        *acc, *row;
+    gdouble        cover, v;
+    gint           top, rows, width, i, x, y;
+
+    top = band * RASTER_BAND;
+    rows = MIN(RASTER_BAND, raster->height - top);
+    width = raster->width;
+    acc = g_new0(gfloat, rows * (width + 2));
+
+    for (i = raster->band_start[band]; i < raster->band_start[band + 1]; i++) {
+        line = &g_array_index(raster->lines, gdouble,
+                              raster->band_lines[i] * 4);
+        raster_clip_line(acc, width, rows, line[0], line[1] - top,
+                         line[2], line[3] - top);
+    }
+
+    /* Running sums along each row give the winding number, fractional at
+     * the edges */
+    for (y = 0; y < rows; y++) {
+        row = acc + y * (width + 2);
+        cover = 0;
+        for (x = 0; x < width; x++) {
+            cover += row[x];
+            v = ABS(cover);
+            if (raster->fill == FILL_EVENODD) {
+                v = fmod(v, 2);
+                if (v > 1)
+                    v = 2 - v;
+            } else if (v > 1) {
+                v = 1;
+            }
+            out[y * width + x] = (guint8) (v * 255 + 0.5);
+        }
+    }
+    g_free(acc);
+}
+
+static void raster_task(gpointer data, gpointer user_data)
+{
+    RasterTask *task = data;
+
+    raster_band(task->raster, task->band, task->out);
+    g_async_queue_push(task->done, task);
+}
+
+/*-----------------------------------------------------------------------------
+ *  rasterize_strokes  --  fills strokes first .. last - 1 with an anti-
+ *                         aliased scanline rasteriser over the box x, y,
+ *                         width, height, and hands the coverage to writer
+ *                         a few bands at a time; the bands are spread over
+ *                         one pool of threads for the whole fill, only the
+ *                         writer runs on the calling thread
+ *-----------------------------------------------------------------------------
+ */
+void rasterize_strokes(const StrokeBatch *batch, gint first, gint last,
+                       gint fill, gint x, gint y, gint width, gint height,
+                       RasterWriter writer, gpointer data)
+{
+    GThreadPool *pool = NULL;
+    GAsyncQueue *done = NULL;
+    RasterTask  *tasks;
+    Raster       raster;
+    guint8      *out;
+    gdouble     *line;
+    gint         num_bands, num_tasks, band, n, b0, b1, rows;
+    guint        i;
+
+    raster.fill = fill;
+    raster.x = x;
+    raster.y = y;
+    raster.width = width;
+    raster.height = height;
+    raster.lines = g_array_new(FALSE, FALSE, sizeof(gdouble));
+    raster_flatten(&raster, batch, first, last);
+    stats.raster_lines += raster.lines->len / 4;
+
+    /* Bucket the lines by the bands they reach into */
+    num_bands = (height + RASTER_BAND - 1) / RASTER_BAND;
+    raster.band_start = g_new0(gint, num_bands + 1);
+    raster.band_lines = NULL;
+    for (n = 0; n < 2; n++) {
+        for (i = 0; i < raster.lines->len; i += 4) {
+            line = &g_array_index(raster.lines, gdouble, i);
+            b0 = CLAMP((gint) floor(MIN(line[1], line[3]) / RASTER_BAND),
+                       0, num_bands - 1);
+            b1 = CLAMP((gint) floor(MAX(line[1], line[3]) / RASTER_BAND),
+                       0, num_bands - 1);
+            for (band = b0; band <= b1; band++) {
+                if (n == 0)
+                    raster.band_start[band + 1]++;
+                else
+                    raster.band_lines[raster.band_start[band]++] = i / 4;
+            }
+        }
+        if (n == 0) {
+            for (band = 0; band < num_bands; band++)
+                raster.band_start[band + 1] += raster.band_start[band];
+            raster.band_lines = g_new(gint, raster.band_start[num_bands]);
+        } else {
+            /* Filling moved every start up to the next band's */
+            for (band = num_bands; band > 0; band--)
+                raster.band_start[band] = raster.band_start[band - 1];
+            raster.band_start[0] = 0;
+        }
+    }
+
+    /* The threads are started once and kept for every group of bands; each
+     * group is waited for by taking back as many tasks as were pushed */
+    num_tasks = MIN((gint) g_get_num_processors(), num_bands);
+    tasks = g_new(RasterTask, num_tasks);
+    out = g_new(guint8, num_tasks * RASTER_BAND * width);
+    if (num_tasks > 1) {
+#if !GLIB_CHECK_VERSION(2, 32, 0)
+        if (!g_thread_supported())
+            g_thread_init(NULL);
+#endif
+        done = g_async_queue_new();
+        pool = g_thread_pool_new(raster_task, NULL, num_tasks, TRUE, NULL);
+    }
+    for (band = 0; band < num_bands; band += num_tasks) {
+        n = MIN(num_tasks, num_bands - band);
+        rows = MIN(n * RASTER_BAND, height - band * RASTER_BAND);
+        if (n == 1) {
+            raster_band(&raster, band, out);
+        } else {
+            for (i = 0; i < (guint) n; i++) {
+                tasks[i].raster = &raster;
+                tasks[i].band = band + i;
+                tasks[i].out = out + i * RASTER_BAND * width;
+                tasks[i].done = done;
+                g_thread_pool_push(pool, &tasks[i], NULL);
+            }
+            for (i = 0; i < (guint) n; i++)
+                g_async_queue_pop(done);
+        }
+        writer(out, x, y + band * RASTER_BAND, width, rows, data);
+    }
+
+    if (pool) {
+        g_thread_pool_free(pool, FALSE, TRUE);
+        g_async_queue_unref(done);
+    }
+    g_free(out);
+    g_free(tasks);
+    g_free(raster.band_start);
+    g_free(raster.band_lines);
+    g_array_free(raster.lines, TRUE);
+}
+
+#ifdef SMOOTH_PATH_GIMP2
+/*-----------------------------------------------------------------------------
+ *  path_fetch  --  reads the strokes of vectors_id into batch, one call per
+ *                  stroke: GIMP's export rounds coordinates to two decimals
+ *                  and leaves out the outer handles of open strokes, so it
+ *                  can't stand in for reading the points
+ *-----------------------------------------------------------------------------
+ */
+void path_fetch(gint32 vectors_id, const gint *strokes, gint num_strokes,
+                StrokeBatch *batch)
+{
+    gboolean closed;
+    gdouble *ctlpts;
+    gint     n, num_points;
+
+    for (n = 0; n < num_strokes; n++) {
+        gimp_vectors_stroke_get_points(vectors_id, strokes[n], &num_points,
+                                       &ctlpts, &closed);
+        stroke_batch_add(batch, ctlpts, num_points, closed);
+        g_free(ctlpts);
+    }
+    stats.pdb_calls += num_strokes;
+}
+
+/*-----------------------------------------------------------------------------
+ *  path_import  --  creates a path from batch with a single import call and
+ *                   moves it right next to vectors_id with one reorder;
+ *                   returns -1 if the import failed, or wouldn't give the
+ *                   batch back exactly
+ *-----------------------------------------------------------------------------
+ */
+gint32 path_import(gint32 image_id, gint32 vectors_id,
+                   const StrokeBatch *batch)
+{
+    PathWriter  writer;
+    GString    *out;
+    gint32     *vectors_ids;
+    gint32      new_vectors_id = -1;
+    gint        n, num_vectors, width, height;
+
+    for (n = 0; n < stroke_batch_len(batch); n++)
+        if (!path_writer_lossless(stroke_batch_points(batch, n),
+                                  stroke_batch_size(batch, n),
+                                  stroke_batch_closed(batch, n)))
+            return -1;
+
+    width = gimp_image_width(image_id);
+    height = gimp_image_height(image_id);
+    out = g_string_sized_new(batch->points->len * 8 + 256);
+    g_string_append_printf(out,
+                           "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+                           "<svg xmlns=\"http://www.w3.org/2000/svg\"\n"
+                           "     width=\"%d\" height=\"%d\" "
+                           "viewBox=\"0 0 %d %d\">\n"
+                           "  <path d=\"",
+                           width, height, width, height);
+    path_writer_init(&writer, out, -1);
+    for (n = 0; n < stroke_batch_len(batch); n++) {
+        if (n > 0)
+            g_string_append_c(out, '\n');
+        path_writer_stroke(&writer, stroke_batch_points(batch, n),
+                           stroke_batch_size(batch, n),
+                           stroke_batch_closed(batch, n));
+    }
+    g_string_append(out, "\" />\n</svg>\n");
+
+    if (gimp_vectors_import_from_string(image_id, out->str, out->len,
+                                        TRUE, FALSE,
+                                        &num_vectors, &vectors_ids)) {
+        stats.pdb_calls++;
+        if (num_vectors == 1)
+            new_vectors_id = vectors_ids[0];
+        else
+            for (n = 0; n < num_vectors; n++)
+                gimp_image_remove_vectors(image_id, vectors_ids[n]);
+        g_free(vectors_ids);
+    }
+    g_string_free(out, TRUE);
+
+    /* The import puts the path wherever it likes; move it right next to
+     * the old one, so that it takes its place when that is removed */
+    if (new_vectors_id != -1) {
+        gimp_image_reorder_item(image_id, new_vectors_id, -1,
+                                gimp_image_get_vectors_position(image_id,
+                                                                vectors_id));
+        stats.pdb_calls += 2;
+    }
+
+    return new_vectors_id;
+}
+
+/*-----------------------------------------------------------------------------
+ *  path_store  --  creates a new path from batch, in the place of vectors_id
+ *                  in the path stack, and returns it
+ *-----------------------------------------------------------------------------
+ */
+gint32 path_store(gint32 image_id, gint32 vectors_id, const gchar *name,
+                  gboolean bulk, const StrokeBatch *batch)
+{
+    gint32 new_vectors_id = -1;
+    gint   n;
+
+    if (bulk)
+        new_vectors_id = path_import(image_id, vectors_id, batch);
+    if (new_vectors_id != -1) {
+        stats.transport = "per-stroke read, bulk write";
+        return new_vectors_id;
+    }
+
+    new_vectors_id = gimp_vectors_new(image_id, name);
+    for (n = 0; n < stroke_batch_len(batch); n++)
+        gimp_vectors_stroke_new_from_points(new_vectors_id,
+                                            GIMP_VECTORS_STROKE_TYPE_BEZIER,
+                                            stroke_batch_size(batch, n),
+                                            stroke_batch_points(batch, n),
+                                            stroke_batch_closed(batch, n));
+    gimp_image_add_vectors(image_id, new_vectors_id,
+                           gimp_image_get_vectors_position(image_id,
+                                                           vectors_id));
+    stats.pdb_calls += stroke_batch_len(batch) + 3;
+
+    return new_vectors_id;
+}
+#endif
+
+#ifndef SMOOTH_PATH_CORE
+/*-----------------------------------------------------------------------------
+ *  path_parasite_attach, path_parasite_find, parasite_bytes  --  the
+ *      parasite calls of the two versions of GIMP; GIMP 3 keeps parasites on
+ *      items rather than vectors, but still numbers paths, so the parasite
+ *      code below works on path numbers with both
+ *-----------------------------------------------------------------------------
+ */
+static void path_parasite_attach(gint32 vectors_id,
+                                 const GimpParasite *parasite)
+{
+#ifdef SMOOTH_PATH_GIMP3
+    gimp_item_attach_parasite(gimp_item_get_by_id(vectors_id), parasite);
+#else
+    gimp_vectors_parasite_attach(vectors_id, parasite);
+#endif
+}
+
+static GimpParasite *path_parasite_find(gint32 vectors_id, const gchar *name)
+{
+#ifdef SMOOTH_PATH_GIMP3
+    return gimp_item_get_parasite(gimp_item_get_by_id(vectors_id), name);
+#else
+    return gimp_vectors_parasite_find(vectors_id, name);
+#endif
+}
+
+static const guint8 *parasite_bytes(const GimpParasite *parasite, gsize *size)
+{
+#ifdef SMOOTH_PATH_GIMP3
+    gconstpointer data;
+    guint32       num_bytes;
+
+    data = gimp_parasite_get_data(parasite, &num_bytes);
+    *size = num_bytes;
+    return data;
+#else
+    *size = gimp_parasite_data_size(parasite);
+    return gimp_parasite_data(parasite);
+#endif
+}
+
+/*-----------------------------------------------------------------------------
+ *  parasite_put_*, parasite_get_*  --  parasites are saved with the image,
+ *                                      so their numbers are kept as fixed
+ *                                      size little-endian values, to read
+ *                                      back the same on any machine
+ *-----------------------------------------------------------------------------
+ */
+static void parasite_put_uint32(GByteArray *data, guint32 value)
+{
+    value = GUINT32_TO_LE(value);
+    g_byte_array_append(data, (guint8 *) &value, sizeof(value));
+}
+
+static void parasite_put_float(GByteArray *data, gfloat value)
+{
+    guint32 bits;
+
+    memcpy(&bits, &value, sizeof(bits));
+    parasite_put_uint32(data, bits);
+}
+
+static void parasite_put_double(GByteArray *data, gdouble value)
+{
+    guint64 bits;
+
+    memcpy(&bits, &value, sizeof(bits));
+    bits = GUINT64_TO_LE(bits);
+    g_byte_array_append(data, (guint8 *) &bits, sizeof(bits));
+}
+
+static guint32 parasite_get_uint32(const guint8 **data)
+{
+    guint32 value;
+
+    memcpy(&value, *data, sizeof(value));
+    *data += sizeof(value);
+    return GUINT32_FROM_LE(value);
+}
+
+static gfloat parasite_get_float(const guint8 **data)
+{
+    guint32 bits;
+    gfloat  value;
+
+    bits = parasite_get_uint32(data);
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+static gdouble parasite_get_double(const guint8 **data)
+{
+    guint64 bits;
+    gdouble value;
+
+    memcpy(&bits, *data, sizeof(bits));
+    *data += sizeof(bits);
+    bits = GUINT64_FROM_LE(bits);
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+/*-----------------------------------------------------------------------------
+ *  parasite_put_strokes  --  writes the stroke offsets of batch, divided by
+ *                            divisor, and its closed flags, one byte each
+ *-----------------------------------------------------------------------------
+ */
+static void parasite_put_strokes(GByteArray *data, const StrokeBatch *batch,
+                                 gint divisor)
+{
+    guint8 closed;
+    guint  n;
+
+    for (n = 0; n < batch->offsets->len; n++)
+        parasite_put_uint32(data, g_array_index(batch->offsets, gint, n) /
+                                  divisor);
+    for (n = 0; n < batch->closed->len; n++) {
+        closed = (g_array_index(batch->closed, gboolean, n) != FALSE);
+        g_byte_array_append(data, &closed, 1);
+    }
+}
+
+/*-----------------------------------------------------------------------------
+ *  parasite_get_strokes  --  reads back what parasite_put_strokes wrote for
+ *                            num_strokes strokes into the offsets and closed
+ *                            flags of batch; the offsets have to start at 0,
+ *                            never go down, be multiples of stride, and end
+ *                            at num_points, and the flags have to be 0 or 1
+ *-----------------------------------------------------------------------------
+ */
+static gboolean parasite_get_strokes(const guint8 **data, guint32 num_strokes,
+                                     guint32 num_points, gint stride,
+                                     StrokeBatch *batch)
+{
+    guint32 offset, last;
+    guint   n;
+
+    g_array_set_size(batch->offsets, num_strokes + 1);
+    g_array_set_size(batch->closed, num_strokes);
+    last = 0;
+    for (n = 0; n <= num_strokes; n++) {
+        offset = parasite_get_uint32(data);
+        if ((n == 0 && offset != 0) || offset < last ||
+            offset % stride != 0 || offset > num_points ||
+            (n == num_strokes && offset != num_points))
+            return FALSE;
+        g_array_index(batch->offsets, gint, n) = offset;
+        last = offset;
+    }
+    for (n = 0; n < num_strokes; n++) {
+        if (**data > 1)
+            return FALSE;
+        g_array_index(batch->closed, gboolean, n) = **data;
+        (*data)++;
+    }
+    return TRUE;
+}
+
+/*-----------------------------------------------------------------------------
+ *  original_attach  --  keeps the control points a path had before it was
+ *                       first smoothed, and their corner angles, in a
+ *                       parasite on the smoothed path; if smoothing moved
+ *                       or merged the anchors, or joined strokes, result is
+ *                       the smoothed path and its strokes and anchors are
+ *                       kept too, otherwise it is NULL
+ *-----------------------------------------------------------------------------
+ */
+void original_attach(gint32 vectors_id, const StrokeBatch *original,
+                     const GArray *angles, const StrokeBatch *result)
+{
+    GimpParasite *parasite;
+    GByteArray   *data;
+    guint32       header[5];
+    guint         n;
+
+    if (result && result->points->len == 0)
+        result = NULL;
+    header[0] = ORIGINAL_MAGIC;
+    header[1] = stroke_batch_len(original);
+    header[2] = original->points->len;
+    header[3] = result ? stroke_batch_len(result) : 0;
+    header[4] = result ? result->points->len / 3 : 0;
+
+    data = g_byte_array_sized_new(sizeof(header) +
+                                  (header[1] + 1) * 4 + header[1] +
+                                  header[2] * 8 + header[2] / 6 * 4 +
+                                  (result ? (header[3] + 1) * 4 + header[3] :
+                                   0) + header[4] * 8);
+    for (n = 0; n < G_N_ELEMENTS(header); n++)
+        parasite_put_uint32(data, header[n]);
+    parasite_put_strokes(data, original, 1);
+    for (n = 0; n < original->points->len; n++)
+        parasite_put_double(data, g_array_index(original->points, gdouble, n));
+    /* Single precision is plenty to compare against the angle settings */
+    for (n = 0; n < angles->len; n++)
+        parasite_put_float(data, g_array_index(angles, gdouble, n));
+    if (result) {
+        parasite_put_strokes(data, result, 3);
+        for (n = 2; n < result->points->len; n += 6) {
+            parasite_put_double(data, g_array_index(result->points,
+                                                    gdouble, n));
+            parasite_put_double(data, g_array_index(result->points,
+                                                    gdouble, n + 1));
+        }
+    }
+
+    parasite = gimp_parasite_new(ORIGINAL_PARASITE,
+                                 GIMP_PARASITE_PERSISTENT |
+                                 GIMP_PARASITE_UNDOABLE,
+                                 data->len, data->data);
+    path_parasite_attach(vectors_id, parasite);
+    gimp_parasite_free(parasite);
+    g_byte_array_free(data, TRUE);
+    stats.pdb_calls++;
+}
+
+/*-----------------------------------------------------------------------------
+ *  original_find  --  reads back what original_attach stored on a path;
+ *                     smoothed gets the strokes of the smoothed path with
+ *                     only the x, y pairs of their anchors as points, or no
+ *                     points at all if smoothing left the path's strokes
+ *                     and anchors alone; returns FALSE if there is nothing
+ *                     (usable) there
+ *-----------------------------------------------------------------------------
+ */
+gboolean original_find(gint32 vectors_id, StrokeBatch *original,
+                       GArray *angles, StrokeBatch *smoothed)
+{
+    GimpParasite *parasite;
+    const guint8 *data;
+    guint32       header[5];
+    guint64       expected;
+    gsize         size;
+    guint         n;
+    gboolean      valid;
+
+    parasite = path_parasite_find(vectors_id, ORIGINAL_PARASITE);
+    stats.pdb_calls++;
+    if (!parasite)
+        return FALSE;
+
+    data = parasite_bytes(parasite, &size);
+    valid = (size >= sizeof(header));
+    for (n = 0; valid && n < G_N_ELEMENTS(header); n++)
+        header[n] = parasite_get_uint32(&data);
+    if (valid) {
+        expected = sizeof(header) + ((guint64) header[1] + 1) * 4 +
+                   header[1] + (guint64) header[2] * 8 + header[2] / 6 * 4 +
+                   (header[4] > 0 ? ((guint64) header[3] + 1) * 4 +
+                                    header[3] : 0) +
+                   (guint64) header[4] * 8;
+        valid = (header[0] == ORIGINAL_MAGIC &&
+                 header[1] < G_MAXINT && header[3] < G_MAXINT &&
+                 header[2] % 6 == 0 && header[2] <= G_MAXINT &&
+                 header[4] % 2 == 0 && header[4] <= header[2] / 3 &&
+                 (header[4] > 0 || header[3] == 0) && size == expected);
+    }
+    valid = valid &&
+            parasite_get_strokes(&data, header[1], header[2], 6, original);
+    if (valid) {
+        g_array_set_size(original->points, header[2]);
+        for (n = 0; n < header[2]; n++)
+            g_array_index(original->points, gdouble, n) =
+                parasite_get_double(&data);
+        g_array_set_size(angles, header[2] / 6);
+        for (n = 0; n < angles->len; n++)
+            g_array_index(angles, gdouble, n) = parasite_get_float(&data);
+        stroke_batch_clear(smoothed);
+    }
+    if (valid && header[4] > 0) {
+        valid = parasite_get_strokes(&data, header[3], header[4], 2,
+                                     smoothed);
+        g_array_set_size(smoothed->points, header[4]);
+        for (n = 0; valid && n < header[4]; n++)
+            g_array_index(smoothed->points, gdouble, n) =
+                parasite_get_double(&data);
+    }
+
+    gimp_parasite_free(parasite);
+    return valid;
+}
+
+/*-----------------------------------------------------------------------------
+ *  original_matches  --  checks that a path still has the strokes and
+ *                        anchors it was given by smoothing, i.e. that
+ *                        nobody edited it since; those are the original
+ *                        ones unless smoothed holds others, which may be
+ *                        fewer if segments were merged, and in fewer
+ *                        strokes if strokes were joined; points are read
+ *                        and written without rounding, so they have to
+ *                        match exactly
+ *-----------------------------------------------------------------------------
+ */
+gboolean original_matches(const StrokeBatch *original,
+                          const StrokeBatch *smoothed,
+                          const StrokeBatch *current)
+{
+    const StrokeBatch *expected;
+    const gdouble     *a, *b;
+    gint               stride, n;
+    guint              k;
+
+    /* smoothed keeps two values per anchor, paths six */
+    expected = (smoothed->points->len > 0) ? smoothed : original;
+    stride = (smoothed->points->len > 0) ? 3 : 1;
+    if (stroke_batch_len(expected) != stroke_batch_len(current) ||
+        memcmp(expected->closed->data, current->closed->data,
+               expected->closed->len * sizeof(gboolean)) != 0)
+        return FALSE;
+    for (n = 0; n <= stroke_batch_len(current); n++)
+        if (g_array_index(expected->offsets, gint, n) * stride !=
+            g_array_index(current->offsets, gint, n))
+            return FALSE;
+
+    a = (const gdouble *) expected->points->data;
+    b = (const gdouble *) current->points->data;
+    for (k = 2; k < current->points->len; k += 6) {
+        if (stride == 3) {
+            if (a[0] != b[k] || a[1] != b[k + 1])
+                return FALSE;
+            a += 2;
+        } else if (a[k] != b[k] || a[k + 1] != b[k + 1]) {
+            return FALSE;
+        }
+    }
+    return TRUE;
+}
+#endif
+
+#ifdef SMOOTH_PATH_GIMP2
+/*-----------------------------------------------------------------------------
+ *  region_mask  --  marks the anchors of batch that smoothing may change,
+ *                   one byte each: the ones inside the selection, or the
+ *                   ones whose index in the path lies in the range given
+ *                   through the PDB
+ *-----------------------------------------------------------------------------
+ */
+void region_mask(const SmoothVals *vals, gint32 image_id,
+                 const StrokeBatch *batch, GArray *mask)
+{
+    GimpDrawable *drawable;
+    GimpPixelRgn  rgn;
+    gboolean      non_empty;
+    guint8        value;
+    gint          x1, y1, x2, y2, x, y;
+    gint          n, len;
+
+    len = batch->points->len / 6;
+    g_array_set_size(mask, len);
+    if (vals->region == REGION_ANCHORS) {
+        for (n = 0; n < len; n++)
+            g_array_index(mask, guint8, n) =
+                (n >= vals->first_anchor &&
+                 (vals->last_anchor < 0 || n <= vals->last_anchor));
+        return;
+    }
+
+    /* Without a selection the whole path is inside it, as usual in GIMP */
+    gimp_selection_bounds(image_id, &non_empty, &x1, &y1, &x2, &y2);
+    stats.pdb_calls++;
+    if (!non_empty) {
+        memset(mask->data, 1, len);
+        return;
+    }
+
+    /* Only the tiles under anchors get read, one row of them is cached */
+    drawable = gimp_drawable_get(gimp_image_get_selection(image_id));
+    stats.pdb_calls += 2;
+    gimp_tile_cache_ntiles(2 * ((x2 - x1) / gimp_tile_width() + 1));
+    gimp_pixel_rgn_init(&rgn, drawable, x1, y1, x2 - x1, y2 - y1,
+                        FALSE, FALSE);
+    for (n = 0; n < len; n++) {
+        x = (gint) floor(g_array_index(batch->points, gdouble, n * 6 + 2));
+        y = (gint) floor(g_array_index(batch->points, gdouble, n * 6 + 3));
+        value = 0;
+        if (x >= x1 && x < x2 && y >= y1 && y < y2)
+            gimp_pixel_rgn_get_pixel(&rgn, &value, x, y);
+        g_array_index(mask, guint8, n) = (value > 127);
+    }
+    gimp_drawable_detach(drawable);
+}
+
+/*-----------------------------------------------------------------------------
+ *  channel_write  --  RasterWriter that copies coverage into a pixel region
+ *-----------------------------------------------------------------------------
+ */
+static void channel_write(const guint8 *coverage, gint x, gint y, gint width,
+                          gint height, gpointer data)
+{
+    gimp_pixel_rgn_set_rect((GimpPixelRgn *) data, coverage, x, y,
+                            width, height);
+}
+
+/*-----------------------------------------------------------------------------
+ *  path_rasterize  --  fills the strokes of batch into a new channel named
+ *                      after the path, anti-aliased, without going through
+ *                      a selection; returns the channel
+ *-----------------------------------------------------------------------------
+ */
+gint32 path_rasterize(gint32 image_id, const gchar *name,
+                      const StrokeBatch *batch, gint fill)
+{
+    GimpDrawable *drawable;
+    GimpPixelRgn  rgn;
+    GimpRGB       black = { 0.0, 0.0, 0.0, 1.0 };
+    gint32        channel_id;
+    gdouble       bx1, by1, bx2, by2;
+    gint          x1, y1, x2, y2, width, height;
+    gint64        start;
+
+    start = g_get_monotonic_time();
+    width = gimp_image_width(image_id);
+    height = gimp_image_height(image_id);
+    channel_id = gimp_channel_new(image_id, name, width, height, 50.0,
+                                  &black);
+    gimp_image_add_channel(image_id, channel_id, 0);
+    stats.pdb_calls += 4;
+
+    /* A new channel is already empty; only the box around the path is
+     * written */
+    if (stroke_batch_bounds(batch, 0, stroke_batch_len(batch),
+                            &bx1, &by1, &bx2, &by2)) {
+        x1 = CLAMP((gint) floor(bx1), 0, width);
+        y1 = CLAMP((gint) floor(by1), 0, height);
+        x2 = CLAMP((gint) ceil(bx2), 0, width);
+        y2 = CLAMP((gint) ceil(by2), 0, height);
+        if (x2 > x1 && y2 > y1) {
+            drawable = gimp_drawable_get(channel_id);
+            gimp_pixel_rgn_init(&rgn, drawable, x1, y1, x2 - x1, y2 - y1,
+                                TRUE, FALSE);
+            rasterize_strokes(batch, 0, stroke_batch_len(batch), fill,
+                              x1, y1, x2 - x1, y2 - y1, channel_write, &rgn);
+            gimp_drawable_flush(drawable);
+            gimp_drawable_update(channel_id, x1, y1, x2 - x1, y2 - y1);
+            gimp_drawable_detach(drawable);
+            stats.pdb_calls += 2;
+        }
+    }
+    stats.raster_time += g_get_monotonic_time() - start;
+
+    return channel_id;
+}
+
+/*-----------------------------------------------------------------------------
+ *  path_read  --  reads vectors_id into batch, and sets *bulk if it has
+ *                 enough strokes to be written back in one go; a path that
+ *                 was smoothed before, and not edited since, is smoothed
+ *                 again from its original points and angles instead of its
+ *                 current ones, so that different angle settings can be
+ *                 tried one after the other: then original and angles hold
+ *                 them, batch is a copy, and TRUE is returned
+ *-----------------------------------------------------------------------------
+ */
+gboolean path_read(gint32 image_id, gint32 vectors_id, gboolean *bulk,
+                   StrokeBatch *batch, StrokeBatch *original, GArray *angles)
+{
+    StrokeBatch  smoothed;
+    gint         num_strokes;
+    gint        *strokes;
+    gboolean     found;
+
+    strokes = gimp_vectors_get_strokes(vectors_id, &num_strokes);
+    stats.pdb_calls++;
+
+    /* Many strokes are cheaper to write back as a single SVG string */
+    *bulk = (num_strokes >= BULK_MIN_STROKES);
+    stats.transport = "per-stroke";
+    stats.strokes += num_strokes;
+
+    stroke_batch_init(&smoothed);
+    path_fetch(vectors_id, strokes, num_strokes, batch);
+    found = (original_find(vectors_id, original, angles, &smoothed) &&
+             original_matches(original, &smoothed, batch));
+    if (found) {
+        stroke_batch_copy(batch, original);
+        stats.from_original = TRUE;
+    }
+    stats.anchors += batch->points->len / 6;
+
+    stroke_batch_free(&smoothed);
+    g_free(strokes);
+
+    return found;
+}
+
+/*-----------------------------------------------------------------------------
+ *  path_write  --  puts the smoothed batch in the place of vectors_id, keeps
+ *                  original and its angles with it, and fills it into a
+ *                  channel if asked to; returns the new path
+ *-----------------------------------------------------------------------------
+ */
+gint32 path_write(const SmoothVals *vals, gint32 image_id, gint32 vectors_id,
+                  const gchar *name, gboolean bulk, const StrokeBatch *batch,
+                  const StrokeBatch *original, const GArray *angles)
+{
+    gint32 new_vectors_id;
+
+    /* We create a new vector and delete the old one (undo doesn't
+     * work if you simply change the strokes of an existing vector) */
+    new_vectors_id = path_store(image_id, vectors_id, name, bulk, batch);
+    original_attach(new_vectors_id, original, angles,
+                    (vals->smoothing > 0 || vals->merge > 0 ||
+                     vals->join != JOIN_NONE) ? batch : NULL);
+    gimp_image_remove_vectors(image_id, vectors_id);
+    gimp_vectors_set_name(new_vectors_id, name);
+    if (vals->fill != FILL_NONE)
+        path_rasterize(image_id, name, batch, vals->fill);
+
+    return new_vectors_id;
+}
+#endif
+
+#ifndef SMOOTH_PATH_CORE
+/*-----------------------------------------------------------------------------
+ *  degraded_attach  --  keeps the settings of a run with a deadline, the
+ *                       strokes it didn't solve, and the mask it had for
+ *                       their anchors if there was one, in a parasite on
+ *                       the path, for refine_path; quality holds the
+ *                       QUALITY_ level of every stroke of original, and
+ *                       nothing is kept if all are solved
+ *-----------------------------------------------------------------------------
+ */
+void degraded_attach(gint32 vectors_id, const SmoothVals *vals,
+                     const StrokeBatch *original, const GArray *quality,
+                     const GArray *mask)
+{
+    GimpParasite *parasite;
+    GByteArray   *data, *kept;
+    guint32       num_strokes;
+    guint         n;
+
+    kept = g_byte_array_new();
+    num_strokes = 0;
+    for (n = 0; n < quality->len; n++) {
+        if (g_array_index(quality, guint8, n) == QUALITY_EXACT)
+            continue;
+        num_strokes++;
+        if (mask->len > 0)
+            g_byte_array_append(kept, &g_array_index(mask, guint8,
+                                    g_array_index(original->offsets, gint,
+                                                  n) / 6),
+                                stroke_batch_size(original, n) / 6);
+    }
+    if (num_strokes == 0) {
+        g_byte_array_free(kept, TRUE);
+        return;
+    }
+
+    data = g_byte_array_new();
+    parasite_put_uint32(data, DEGRADED_MAGIC);
+    parasite_put_uint32(data, num_strokes);
+    parasite_put_uint32(data, kept->len);
+    parasite_put_uint32(data, vals->smooth_specified != FALSE);
+    parasite_put_double(data, vals->ang_min);
+    parasite_put_double(data, vals->ang_max);
+    parasite_put_double(data, vals->smoothing);
+    parasite_put_uint32(data, vals->region);
+    parasite_put_uint32(data, vals->first_anchor);
+    parasite_put_uint32(data, vals->last_anchor);
+    parasite_put_uint32(data, vals->fill);
+    parasite_put_double(data, vals->merge);
+    parasite_put_uint32(data, vals->join);
+    for (n = 0; n < quality->len; n++)
+        if (g_array_index(quality, guint8, n) != QUALITY_EXACT)
+            parasite_put_uint32(data, n);
+    g_byte_array_append(data, kept->data, kept->len);
+
+    parasite = gimp_parasite_new(DEGRADED_PARASITE,
+                                 GIMP_PARASITE_PERSISTENT |
+                                 GIMP_PARASITE_UNDOABLE,
+                                 data->len, data->data);
+    path_parasite_attach(vectors_id, parasite);
+    gimp_parasite_free(parasite);
+    stats.pdb_calls++;
+    g_byte_array_free(data, TRUE);
+    g_byte_array_free(kept, TRUE);
+}
+
+/*-----------------------------------------------------------------------------
+ *  degraded_find  --  reads back what degraded_attach stored on a path, with
+ *                     the deadline taken out of the settings; mask gets
+ *                     the mask of the anchors of those strokes, in order,
+ *                     or nothing if the run had none. Returns FALSE if
+ *                     there is nothing (usable) there
+ *-----------------------------------------------------------------------------
+ */
+gboolean degraded_find(gint32 vectors_id, SmoothVals *vals, GArray *strokes,
+                       GArray *mask)
+{
+    GimpParasite *parasite;
+    const guint8 *data;
+    guint32       header[3];
+    gsize         size;
+    guint         n;
+    gboolean      valid;
+
+    parasite = path_parasite_find(vectors_id, DEGRADED_PARASITE);
+    stats.pdb_calls++;
+    if (!parasite)
+        return FALSE;
+
+    /* The header, then 6 uint32 and 4 double settings */
+    data = parasite_bytes(parasite, &size);
+    valid = (size >= sizeof(header));
+    for (n = 0; valid && n < G_N_ELEMENTS(header); n++)
+        header[n] = parasite_get_uint32(&data);
+    valid = (valid && header[0] == DEGRADED_MAGIC &&
+             header[1] < G_MAXINT / 4 &&
+             size == sizeof(header) + 6 * 4 + 4 * 8 +
+                     (guint64) header[1] * 4 + header[2]);
+    if (valid) {
+        memset(vals, 0, sizeof(SmoothVals));
+        vals->smooth_specified = (parasite_get_uint32(&data) != 0);
+        vals->ang_min = parasite_get_double(&data);
+        vals->ang_max = parasite_get_double(&data);
+        vals->smoothing = parasite_get_double(&data);
+        vals->region = parasite_get_uint32(&data);
+        vals->first_anchor = parasite_get_uint32(&data);
+        vals->last_anchor = parasite_get_uint32(&data);
+        vals->fill = parasite_get_uint32(&data);
+        vals->merge = parasite_get_double(&data);
+        vals->join = parasite_get_uint32(&data);
+        g_array_set_size(strokes, header[1]);
+        for (n = 0; n < header[1]; n++)
+            g_array_index(strokes, guint32, n) = parasite_get_uint32(&data);
+        g_array_set_size(mask, header[2]);
+        memcpy(mask->data, data, header[2]);
+        for (n = 0; valid && n < header[2]; n++)
+            valid = (data[n] <= 1);
+    }
+
+    gimp_parasite_free(parasite);
+    return valid;
+}
+
+/*-----------------------------------------------------------------------------
+ *  refine_batch  --  solves the strokes a run with a deadline didn't, from
+ *                    their original points; batch holds the strokes path
+ *                    vectors_id has now, and result gets them with the
+ *                    solved ones in the place of what that run left, vals
+ *                    its settings, and original and angles what
+ *                    original_find reads. Returns FALSE if there is nothing
+ *                    to refine, or the path was edited since
+ *-----------------------------------------------------------------------------
+ */
+gboolean refine_batch(gint32 vectors_id, const StrokeBatch *batch,
+                      SmoothVals *vals, StrokeBatch *original, GArray *angles,
+                      StrokeBatch *result)
+{
+    SmoothScratch  scratch = { NULL };
+    StrokeBatch    smoothed, refined;
+    GArray        *degraded, *refined_angles, *refined_mask;
+    gint           n, k, len, offset, anchors;
+    gint64         start;
+    gboolean       found;
+
+    stroke_batch_init(&smoothed);
+    degraded = g_array_new(FALSE, FALSE, sizeof(guint32));
+    refined_mask = g_array_new(FALSE, FALSE, sizeof(guint8));
+    found = (degraded_find(vectors_id, vals, degraded, refined_mask) &&
+             original_find(vectors_id, original, angles, &smoothed) &&
+             original_matches(original, &smoothed, batch) &&
+             stroke_batch_len(original) == stroke_batch_len(batch));
+    /* Indices must be rising and name strokes of the path, and a mask has
+     * to cover their anchors */
+    anchors = 0;
+    for (k = 0; found && k < (gint) degraded->len; k++) {
+        n = g_array_index(degraded, guint32, k);
+        found = (n >= 0 && n < stroke_batch_len(batch) &&
+                 (k == 0 || (guint32) n >
+                            g_array_index(degraded, guint32, k - 1)));
+        if (found)
+            anchors += stroke_batch_size(original, n) / 6;
+    }
+    found = (found && (refined_mask->len == 0 ||
+                       (gint) refined_mask->len == anchors));
+    stroke_batch_free(&smoothed);
+    if (!found) {
+        g_array_free(degraded, TRUE);
+        g_array_free(refined_mask, TRUE);
+        return FALSE;
+    }
+
+    /* Take the strokes out of the original with their angles, and solve
+     * them as the first run would have without a deadline, with the mask
+     * it had rather than the selection there is now, and with runs of
+     * anchors collapsed */
+    stroke_batch_init(&refined);
+    refined_angles = g_array_new(FALSE, FALSE, sizeof(gdouble));
+    for (k = 0; k < (gint) degraded->len; k++) {
+        n = g_array_index(degraded, guint32, k);
+        offset = g_array_index(original->offsets, gint, n);
+        len = stroke_batch_size(original, n) / 6;
+        stroke_batch_add(&refined, stroke_batch_points(original, n),
+                         len * 6, stroke_batch_closed(original, n));
+        g_array_append_vals(refined_angles,
+                            &g_array_index(angles, gdouble, offset / 6), len);
+    }
+    stats.strokes += degraded->len;
+    stats.anchors += anchors;
+    stats.engine = engine_name(vals);
+    start = g_get_monotonic_time();
+    counters_start();
+    smooth_batch_collapsed(vals, &refined, (gdouble *) refined_angles->data,
+                           (refined_mask->len > 0) ?
+                           (guint8 *) refined_mask->data : NULL, &scratch);
+    counters_stop();
+    stats.solve_time += g_get_monotonic_time() - start;
+    if (vals->merge > 0)
+        merge_batch(vals, &refined, (refined_mask->len > 0) ?
+                                    (guint8 *) refined_mask->data : NULL);
+
+    /* The degraded strokes are listed in order, as degraded_attach wrote
+     * them, so the refined ones come in the same order */
+    stroke_batch_clear(result);
+    for (n = 0, k = 0; n < stroke_batch_len(batch); n++) {
+        if (k < (gint) degraded->len &&
+            g_array_index(degraded, guint32, k) == (guint32) n) {
+            stroke_batch_add(result, stroke_batch_points(&refined, k),
+                             stroke_batch_size(&refined, k),
+                             stroke_batch_closed(&refined, k));
+            k++;
+        } else {
+            stroke_batch_add(result, stroke_batch_points(batch, n),
+                             stroke_batch_size(batch, n),
+                             stroke_batch_closed(batch, n));
+        }
+    }
+
+    stroke_batch_free(&refined);
+    g_array_free(degraded, TRUE);
+    g_array_free(refined_angles, TRUE);
+    g_array_free(refined_mask, TRUE);
+    scratch_free(&scratch);
+
+    return TRUE;
+}
+#endif
+
+#ifdef SMOOTH_PATH_GIMP2
+/*-----------------------------------------------------------------------------
+ *  refine_path  --  refine_batch on vectors_id, putting the result in its
+ *                   place; returns FALSE if there is nothing to refine, or
+ *                   the path was edited since
+ *-----------------------------------------------------------------------------
+ */
+gboolean refine_path(gint32 image_id, gint32 vectors_id)
+{
+    SmoothVals   vals;
+    StrokeBatch  batch, original, result;
+    GArray      *angles;
+    gint         num_strokes;
+    gint        *strokes;
+    gchar       *v_name;
+    gboolean     bulk, found;
+
+    strokes = gimp_vectors_get_strokes(vectors_id, &num_strokes);
+    stats.pdb_calls++;
+    bulk = (num_strokes >= BULK_MIN_STROKES);
+    stroke_batch_init(&batch);
+    path_fetch(vectors_id, strokes, num_strokes, &batch);
+    g_free(strokes);
+
+    stroke_batch_init(&original);
+    angles = g_array_new(FALSE, FALSE, sizeof(gdouble));
+    stroke_batch_init(&result);
+    found = refine_batch(vectors_id, &batch, &vals, &original, angles,
+                         &result);
+    if (found) {
+        /* The fill channel of the first run is left to the caller */
+        vals.fill = FILL_NONE;
+        v_name = gimp_vectors_get_name(vectors_id);
+        path_write(&vals, image_id, vectors_id, v_name, bulk, &result,
+                   &original, angles);
+        g_free(v_name);
+    }
+
+    stroke_batch_free(&batch);
+    stroke_batch_free(&original);
+    stroke_batch_free(&result);
+    g_array_free(angles, TRUE);
+
+    return found;
+}
+
+/*-----------------------------------------------------------------------------
+ *  model_load  --  reads the cost model measured earlier from its file, or
+ *                  measures and saves it when there is none, it was made
+ *                  for another version or number of processors, or force
+ *                  is set; the file describes this machine, so it is kept
+ *                  in its byte order
+ *-----------------------------------------------------------------------------
+ */
+void model_load(gboolean force)
+{
+    gchar *filename, *contents = NULL;
+    gsize  length;
+
+    filename = g_build_filename(gimp_directory(), CALIBRATION_FILE, NULL);
+    if (!force && g_file_get_contents(filename, &contents, &length, NULL) &&
+        length == sizeof(SmoothModel))
+        memcpy(&model, contents, sizeof(SmoothModel));
+    g_free(contents);
+    if (force || model.version != CALIBRATION_VERSION ||
+        model.processors != (gint) g_get_num_processors()) {
+        calibrate(&model);
+        g_file_set_contents(filename, (const gchar *) &model,
+                            sizeof(SmoothModel), NULL);
+        stats.calibrated = TRUE;
+    }
+    g_free(filename);
+}
+
+/*-----------------------------------------------------------------------------
+ *  smooth_path  --  manipulates the vectors with Bezier smoothing algorithm
+ *-----------------------------------------------------------------------------
+ */
+gboolean smooth_path(const SmoothVals *vals, gint32 image_id,
+                     gint32 vectors_id)
+{
+    SmoothScratch scratch = { NULL };
+    StrokeBatch   batch, original;
+    GArray       *angles, *mask, *quality;
+    gint32        new_vectors_id;
+    gchar        *v_name;
+    gboolean      bulk;
+    gint64        start;
+
+    v_name = gimp_vectors_get_name(vectors_id);
+    stats.pdb_calls++;
+
+    stroke_batch_init(&batch);
+    stroke_batch_init(&original);
+    angles = g_array_new(FALSE, FALSE, sizeof(gdouble));
+    if (!path_read(image_id, vectors_id, &bulk, &batch, &original, angles)) {
+        stroke_batch_copy(&original, &batch);
+        stroke_batch_angles(&original, angles);
+    }
+
+    mask = g_array_new(FALSE, FALSE, sizeof(guint8));
+    if (vals->region != REGION_ALL)
+        region_mask(vals, image_id, &batch, mask);
+
+    stats.engine = engine_name(vals);
+    quality = g_array_new(FALSE, FALSE, sizeof(guint8));
+    start = g_get_monotonic_time();
+    counters_start();
+    /* Joining takes time that a deadline doesn't allow for */
+    if (vals->deadline > 0)
+        smooth_batch_deadline(vals, &batch, (gdouble *) angles->data,
+                              (mask->len > 0) ? (guint8 *) mask->data : NULL,
+                              &scratch, quality);
+    else
+        smooth_batch_joined(vals, &batch, (gdouble *) angles->data, mask,
+                            NULL, &scratch);
+    counters_stop();
+    stats.solve_time += g_get_monotonic_time() - start;
+    if (vals->merge > 0)
+        merge_batch(vals, &batch, (vals->region != REGION_ALL) ?
+                                  (guint8 *) mask->data : NULL);
+
+    new_vectors_id = path_write(vals, image_id, vectors_id, v_name, bulk,
+                                &batch, &original, angles);
+    if (quality->len > 0)
+        degraded_attach(new_vectors_id, vals, &original, quality, mask);
+
+    stroke_batch_free(&batch);
+    stroke_batch_free(&original);
+    g_array_free(angles, TRUE);
+    g_array_free(mask, TRUE);
+    g_array_free(quality, TRUE);
+    scratch_free(&scratch);
+    g_free(v_name);
+    
+    return TRUE;
+}
+
+/*-----------------------------------------------------------------------------
+ *  smooth_frames  --  smooths paths that are the frames of an animation, in
+ *                     order; each frame starts from the one before, so one
+ *                     that differs from it in a few anchors costs about as
+ *                     much as those anchors
+ *-----------------------------------------------------------------------------
+ */
+gboolean smooth_frames(const SmoothVals *vals, gint32 image_id,
+                       const gint32 *paths, gint num_paths)
+{
+    SmoothScratch scratch = { NULL };
+    FrameState    state;
+    StrokeBatch   batch, original;
+    GArray       *angles;
+    gchar        *v_name;
+    gboolean      bulk;
+    gint64        start;
+    gint          n;
+
+    stroke_batch_init(&batch);
+    stroke_batch_init(&original);
+    angles = g_array_new(FALSE, FALSE, sizeof(gdouble));
+    frame_state_init(&state);
+    stats.engine = engine_name(vals);
+    stats.threads = 1;
+
+    for (n = 0; n < num_paths; n++) {
+        v_name = gimp_vectors_get_name(paths[n]);
+        stats.pdb_calls++;
+        stroke_batch_clear(&batch);
+        if (!path_read(image_id, paths[n], &bulk, &batch, &original, angles))
+            stroke_batch_copy(&original, &batch);
+
+        /* The corner angles are kept up to date by the frame state */
+        start = g_get_monotonic_time();
+        counters_start();
+        smooth_frame(vals, &state, &batch, 0, stroke_batch_len(&batch),
+                     &scratch);
+        counters_stop();
+        stats.solve_time += g_get_monotonic_time() - start;
+
+        path_write(vals, image_id, paths[n], v_name, bulk, &batch, &original,
+                   state.angles);
+        g_free(v_name);
+    }
+
+    frame_state_free(&state);
+    stroke_batch_free(&batch);
+    stroke_batch_free(&original);
+    g_array_free(angles, TRUE);
+    scratch_free(&scratch);
+
+    return TRUE;
+}
+
+/*-----------------------------------------------------------------------------
+ *  revert_path  --  puts back the control points a path had before it was
+ *                   smoothed; returns FALSE if there is nothing to revert
+ *-----------------------------------------------------------------------------
+ */
+gboolean revert_path(gint32 image_id, gint32 vectors_id)
+{
+    StrokeBatch  batch, original, smoothed;
+    GArray      *angles;
+    gint32       new_vectors_id = -1;
+    gint         num_strokes;
+    gint        *strokes;
+    gchar       *v_name;
+    gboolean     bulk;
+
+    strokes = gimp_vectors_get_strokes(vectors_id, &num_strokes);
+    bulk = (num_strokes >= BULK_MIN_STROKES);
+
+    stroke_batch_init(&batch);
+    stroke_batch_init(&original);
+    angles = g_array_new(FALSE, FALSE, sizeof(gdouble));
+    stroke_batch_init(&smoothed);
+    if (original_find(vectors_id, &original, angles, &smoothed)) {
+        path_fetch(vectors_id, strokes, num_strokes, &batch);
+        if (original_matches(&original, &smoothed, &batch)) {
+            v_name = gimp_vectors_get_name(vectors_id);
+            new_vectors_id = path_store(image_id, vectors_id, v_name, bulk,
+                                        &original);
+            gimp_image_remove_vectors(image_id, vectors_id);
+            gimp_vectors_set_name(new_vectors_id, v_name);
+            g_free(v_name);
+        }
+    }
+
+    stroke_batch_free(&batch);
+    stroke_batch_free(&original);
+    g_array_free(angles, TRUE);
+    stroke_batch_free(&smoothed);
+    g_free(strokes);
+
+    return (new_vectors_id != -1);
+}
+
+/*-----------------------------------------------------------------------------
+ *  path_corner_angles  --  collects the sorted corner angles smooth_path
+ *                          would go by for a path, for the dialog
+ *-----------------------------------------------------------------------------
+ */
+void path_corner_angles(gint32 image_id, gint32 vectors_id, GArray *corners)
+{
+    StrokeBatch  batch, original, smoothed;
+    GArray      *angles;
+    gint         num_strokes;
+    gint        *strokes;
+
+    strokes = gimp_vectors_get_strokes(vectors_id, &num_strokes);
+    stats.pdb_calls++;
+
+    stroke_batch_init(&batch);
+    stroke_batch_init(&original);
+    angles = g_array_new(FALSE, FALSE, sizeof(gdouble));
+    stroke_batch_init(&smoothed);
+    path_fetch(vectors_id, strokes, num_strokes, &batch);
+    if (original_find(vectors_id, &original, angles, &smoothed) &&
+        original_matches(&original, &smoothed, &batch)) {
+        corner_angles_sorted(&original, angles, corners);
+    } else {
+        stroke_batch_angles(&batch, angles);
+        corner_angles_sorted(&batch, angles, corners);
+    }
+
+    stroke_batch_free(&batch);
+    stroke_batch_free(&original);
+    g_array_free(angles, TRUE);
+    stroke_batch_free(&smoothed);
+    g_free(strokes);
 }
 
-/*----------------------------------------------------------------------------- 
- *  triagonal_solve  --  solves a tridiagonal system of simultaneous equations
+#endif
+
+/*-----------------------------------------------------------------------------
+ *  model_report  --  prints the cost model, if it was measured in this run
+ *                    and statistics are enabled
  *-----------------------------------------------------------------------------
  */
-void triagonal_solve(GArray *asb, GArray *asd)
+void model_report(void)
 {
-    gdouble x = 1.0;
-    gdouble id;
-    gint i;
-    GArray *asc;
-    asc = g_array_new(FALSE, FALSE, sizeof(gdouble));
-    for (i = 0; i < asb->len; i++)
-        g_array_append_val(asc, x);
-    g_array_index(asc, gdouble, 0) *= 0.25;
-    g_array_index(asd, gdouble, 0) *= 0.25;
-    for (i = 1; i < asb->len; i++) {
-        id = 4.0 - g_array_index(asc, gdouble, i - 1);
-        g_array_index(asc, gdouble, i) /= id;
-        g_array_index(asd, gdouble, i) = (g_array_index(asd, gdouble, i) - 
-                                      g_array_index(asd, gdouble, i - 1)) / id;
-    }
-    g_array_index(asb, gdouble, asb->len - 1) = g_array_index(asd, gdouble, 
-                                                           asb->len - 1);
-    for (i = asb->len - 2; i >= 0; i--)
-        g_array_index(asb, gdouble, i) = g_array_index(asd, gdouble, i) -
-                                      g_array_index(asc, gdouble, i) *
-                                      g_array_index(asb, gdouble, i + 1);
-    g_array_free(asc, TRUE);
+    if (stats.enabled && stats.calibrated)
+        g_printerr("%s: calibrated interpolating / approximating %.1f / "
+                   "%.1f ns per anchor, %.1f / %.1f ns per stroke, "
+                   "%.2f / %.2f times faster on %d threads, %.3f ms to "
+                   "start them\n",
+                   PLUG_IN_BINARY, model.anchor[0] * 1000.0,
+                   model.anchor[1] * 1000.0, model.stroke[0] * 1000.0,
+                   model.stroke[1] * 1000.0, model.speedup[0],
+                   model.speedup[1], model.processors,
+                   model.pool_start / 1000.0);
 }
 
-/*----------------------------------------------------------------------------- 
- *  set_bezier_path  --  starting from a set of control points in a GIMP stroke
- *                       generate a new set of control points, and hence a new
- *                       path such that the Bezier curves are smoothly
- *                       interpolated between each other
+/*-----------------------------------------------------------------------------
+ *  stats_report  --  prints what smooth_path counted and timed, so the cost
+ *                    of a run can be followed from a terminal or batch job
  *-----------------------------------------------------------------------------
  */
-void set_bezier_path(gint32 new_vectors_id, gint32 vectors_id, gint stroke_id)
+void stats_report(void)
 {
-    gboolean closed;
-    gdouble *ctlpts;
-    GArray *asd;
-    GArray *asb;
-    GArray *acx;
-    GArray *acy;
-    GArray *aconx1;
-    GArray *aconx2;
-    GArray *acony1;
-    GArray *acony2;
-    gint n, num_points, len;
-    gdouble hx, hy;
-    
-    gimp_vectors_stroke_get_points(vectors_id, stroke_id, &num_points,
-                                   &ctlpts, &closed);
-                                   
-    /* Must have at least 3 anchor points, i.e. 18 array entries */
-    if (num_points < 18) {
-        gimp_vectors_stroke_new_from_points(new_vectors_id, 
-                                            GIMP_VECTORS_STROKE_TYPE_BEZIER,
-                                            num_points, ctlpts, closed);
-        g_free(ctlpts);
+    gint n;
+
+    if (!stats.enabled)
+        return;
+    g_printerr("%s: %d strokes, %d anchors, %s transport%s\n",
+               PLUG_IN_BINARY, stats.strokes, stats.anchors, stats.transport,
+               stats.from_original ? ", from original" : "");
+    g_printerr("%s: %d PDB calls, %s solve %.3f ms on %d threads, "
+               "total %.3f ms\n",
+               PLUG_IN_BINARY, stats.pdb_calls, stats.engine,
+               stats.solve_time / 1000.0, stats.threads,
+               stats.total_time / 1000.0);
+    if (stats.anchors > 0)
+        g_printerr("%s: %.1f ns per anchor solving, %.1f ns end to end\n",
+                   PLUG_IN_BINARY, stats.solve_time * 1000.0 / stats.anchors,
+                   stats.total_time * 1000.0 / stats.anchors);
+    if (stats.joins > 0)
+        g_printerr("%s: made %d joins, leaving %d strokes to smooth\n",
+                   PLUG_IN_BINARY, stats.joins, stats.joined);
+    if (stats.collapsed > 0)
+        g_printerr("%s: collapsed %d anchors lying on the one before\n",
+                   PLUG_IN_BINARY, stats.collapsed);
+    if (stats.deadline > 0)
+        g_printerr("%s: deadline %.1f ms: %d strokes solved, %d given local "
+                   "handles, %d left as they were\n",
+                   PLUG_IN_BINARY, stats.deadline,
+                   stats.quality[QUALITY_EXACT], stats.quality[QUALITY_LOCAL],
+                   stats.quality[QUALITY_NONE]);
+    model_report();
+    if (stats.predicted_time > 0)
+        g_printerr("%s: solve predicted %.3f ms, took %.3f ms\n",
+                   PLUG_IN_BINARY, stats.predicted_time / 1000.0,
+                   stats.solve_time / 1000.0);
+    if (stats.frames > 0)
+        g_printerr("%s: %d frames, %d of %d anchors solved again\n",
+                   PLUG_IN_BINARY, stats.frames, stats.resolved,
+                   stats.anchors);
+    if (stats.segments_in > 0)
+        g_printerr("%s: merged %d segments into %d (%.2f:1) in %.3f ms\n",
+                   PLUG_IN_BINARY, stats.segments_in, stats.segments_out,
+                   stats.segments_out > 0 ?
+                   (gdouble) stats.segments_in / stats.segments_out : 0.0,
+                   stats.merge_time / 1000.0);
+    if (stats.raster_lines > 0)
+        g_printerr("%s: filled %d lines into a channel in %.3f ms\n",
+                   PLUG_IN_BINARY, stats.raster_lines,
+                   stats.raster_time / 1000.0);
+
+    if (!stats.counters)
+        return;
+    for (n = 0; n < COUNTER_COUNT && !stats.group.counted[n]; n++)
+        ;
+    if (n == COUNTER_COUNT) {
+        g_printerr("%s: hardware counters unavailable\n", PLUG_IN_BINARY);
         return;
     }
-    /* Look how many arrays we create, very wasteful! */
-    asd = g_array_new(FALSE, TRUE, sizeof(gdouble));
-    asb = g_array_new(FALSE, TRUE, sizeof(gdouble));
-    acx = g_array_new(FALSE, TRUE, sizeof(gdouble));
-    acy = g_array_new(FALSE, TRUE, sizeof(gdouble));
-    aconx1 = g_array_new(FALSE, TRUE, sizeof(gdouble));
-    aconx2 = g_array_new(FALSE, TRUE, sizeof(gdouble));
-    acony1 = g_array_new(FALSE, TRUE, sizeof(gdouble));
-    acony2 = g_array_new(FALSE, TRUE, sizeof(gdouble));
-    
-    /* Initialise anchor point array */
-    len = num_points / 6;
-    g_array_set_size(acx, len);
-    g_array_set_size(acy, len);
-    for (n = 0; n < acx->len; n++) {
-        g_array_index(acx, gdouble, n) = ctlpts[n * 6 + 2];
-        g_array_index(acy, gdouble, n) = ctlpts[n * 6 + 3];
-    }
-    
-    /* Prepend last point, and append first two points if closed */
-    if (closed) {
-        g_array_prepend_val(acx, ctlpts[num_points - 4]);
-        g_array_prepend_val(acy, ctlpts[num_points - 3]);
-        g_array_append_val(acx, ctlpts[2]);
-        g_array_append_val(acy, ctlpts[3]);
-        g_array_append_val(acx, ctlpts[8]);
-        g_array_append_val(acy, ctlpts[9]);
-    }
-    
-    /* First for x */
-    g_array_set_size(asd, acx->len - 2);
-    g_array_set_size(asb, acx->len - 2);
-    if (asd->len == 1) {
-        g_array_index(asb, gdouble, 0) = 1.50 * g_array_index(acx, gdouble, 1) 
-                                    - 0.25 * g_array_index(acx, gdouble, 0) 
-                                    - 0.25 * g_array_index(acx, gdouble, 2);
-    } else {
-        g_array_index(asd, gdouble, 0) = 6 * g_array_index(acx, gdouble, 1) - 
-                                       g_array_index(acx, gdouble, 0);
-        for (n = 1; n < acx->len - 3; n++)
-            g_array_index(asd, gdouble, n) = 6 * g_array_index(acx, gdouble, 
-                                                               n + 1);
-        g_array_index(asd, gdouble, acx->len - 3) 
-                = 6 * g_array_index(acx, gdouble, acx->len - 2) - 
-                  g_array_index(acx, gdouble, acx->len - 1);
-        triagonal_solve(asb, asd);
-    }
-    g_array_prepend_val(asb, g_array_index(acx, gdouble, 0));
-    g_array_append_val(asb, g_array_index(acx, gdouble, acx->len - 1));
-    
-    /* These will hold the interior control points, for x */
-    for (n = 1; n < acx->len; n++) {
-        hx = 2 * g_array_index(asb, gdouble, n - 1) / 3 +
-             g_array_index(asb, gdouble, n) / 3;
-        g_array_append_val(aconx1, hx);
-        hx = g_array_index(asb, gdouble, n - 1) / 3 +
-             2 * g_array_index(asb, gdouble, n) / 3;
-        g_array_append_val(aconx2, hx);
-    }
-    
-    /* Now for y */
-    g_array_set_size(asd, acy->len - 2);
-    g_array_set_size(asb, acy->len - 2);
-    if (asd->len == 1) {
-        g_array_index(asb, gdouble, 0) = 1.50 * g_array_index(acy, gdouble, 1) 
-                                    - 0.25 * g_array_index(acy, gdouble, 0) 
-                                    - 0.25 * g_array_index(acy, gdouble, 2);
-    } else {
-        g_array_index(asd, gdouble, 0) = 6 * g_array_index(acy, gdouble, 1) - 
-                                       g_array_index(acy, gdouble, 0);
-        for (n = 1; n < acy->len - 3; n++)
-            g_array_index(asd, gdouble, n) = 6 * g_array_index(acy, gdouble, 
-                                                               n + 1);
-        g_array_index(asd, gdouble, acy->len - 3) 
-                = 6 * g_array_index(acy, gdouble, acy->len - 2) - 
-                  g_array_index(acy, gdouble, acy->len - 1);
-        triagonal_solve(asb, asd);
-    }
-    g_array_prepend_val(asb, g_array_index(acy, gdouble, 0));
-    g_array_append_val(asb, g_array_index(acy, gdouble, acy->len - 1));
-    
-    /* These will hold the interior control points, for y */
-    for (n = 1; n < acy->len; n++) {
-        hy = 2 * g_array_index(asb, gdouble, n - 1) / 3 +
-             g_array_index(asb, gdouble, n) / 3;
-        g_array_append_val(acony1, hy);
-        hy = g_array_index(asb, gdouble, n - 1) / 3 +
-             2 * g_array_index(asb, gdouble, n) / 3;
-        g_array_append_val(acony2, hy);
-    }
-    
-    /* Remove first two and last two control points if closed */
-    if (closed) {
-        g_array_remove_index(aconx1, aconx1->len - 1);
-        g_array_remove_index(aconx1, 0);
-        g_array_remove_index(aconx2, aconx2->len - 1);
-        g_array_remove_index(aconx2, 0);
-        g_array_remove_index(acony1, acony1->len - 1);
-        g_array_remove_index(acony1, 0);
-        g_array_remove_index(acony2, acony2->len - 1);
-        g_array_remove_index(acony2, 0);
-    }
-    
-    /* Now update our original ctlpts array */
-    /* First two points are last aconx,y2 if closed, otherwise stay the same */
-    if (closed) {
-        if (angle_between(ctlpts[num_points-4], ctlpts[num_points-3], 
-                          ctlpts[2], ctlpts[3], ctlpts[8], ctlpts[9])) {
-            ctlpts[0] = g_array_index(aconx2, gdouble, aconx2->len - 1);
-            ctlpts[1] = g_array_index(acony2, gdouble, acony2->len - 1);
-        }
-    }
-    /* The interior points */
-    for (n = 0; n < len - 1; n++) {
-        if (n == 0) {
-            if (closed && angle_between(ctlpts[num_points-4], 
-                                        ctlpts[num_points-3], 
-                                        ctlpts[2], ctlpts[3],
-                                        ctlpts[8], ctlpts[9])) {
-                ctlpts[n * 6 + 4] = g_array_index(aconx1, gdouble, n);
-                ctlpts[n * 6 + 5] = g_array_index(acony1, gdouble, n);
-            } else if (!closed && !svals.smooth_specified) {
-                ctlpts[n * 6 + 4] = g_array_index(aconx1, gdouble, n);
-                ctlpts[n * 6 + 5] = g_array_index(acony1, gdouble, n);
-            }
-        } else {
-            if (angle_between(ctlpts[n * 6 - 4], ctlpts[n * 6 - 3], 
-                              ctlpts[n * 6 + 2], ctlpts[n * 6 + 3], 
-                              ctlpts[n * 6 + 8], ctlpts[n * 6 + 9])) {
-                ctlpts[n * 6 + 4] = g_array_index(aconx1, gdouble, n);
-                ctlpts[n * 6 + 5] = g_array_index(acony1, gdouble, n);
-            }
-        }
-        if (n == len - 2) {
-            if (closed && angle_between(ctlpts[num_points-10], 
-                                        ctlpts[num_points-9], 
-                                        ctlpts[num_points-4], 
-                                        ctlpts[num_points-3], 
-                                        ctlpts[2], ctlpts[3])) {
-                ctlpts[n * 6 + 6] = g_array_index(aconx2, gdouble, n);
-                ctlpts[n * 6 + 7] = g_array_index(acony2, gdouble, n);
-            } else if (!closed && !svals.smooth_specified) {
-                ctlpts[n * 6 + 6] = g_array_index(aconx2, gdouble, n);
-                ctlpts[n * 6 + 7] = g_array_index(acony2, gdouble, n);
-            }
-        } else {
-            if (angle_between(ctlpts[n * 6 + 2], ctlpts[n * 6 + 3],
-                              ctlpts[n * 6 + 8], ctlpts[n * 6 + 9],
-                              ctlpts[n * 6 + 14], ctlpts[n * 6 + 15])) {
-                ctlpts[n * 6 + 6] = g_array_index(aconx2, gdouble, n);
-                ctlpts[n * 6 + 7] = g_array_index(acony2, gdouble, n);
-            }
-        }
-    }
-    /* Last two points are last aconx,y1 if closed, otherwise stay the same */
-    if (closed) {
-        if (angle_between(ctlpts[num_points-10], ctlpts[num_points-9], 
-                          ctlpts[num_points-4], ctlpts[num_points-3], 
-                          ctlpts[2], ctlpts[3])) {
-            ctlpts[num_points-2] = g_array_index(aconx1, gdouble, 
-                                                 aconx1->len - 1);
-            ctlpts[num_points-1] = g_array_index(acony1, gdouble, 
-                                                 acony1->len - 1);
-        }
+    g_printerr("%s: per anchor solving:", PLUG_IN_BINARY);
+    for (n = 0; n < COUNTER_COUNT; n++)
+        if (stats.group.counted[n] && stats.anchors > 0)
+            g_printerr(" %.2f %s",
+                       (gdouble) stats.group.value[n] / stats.anchors,
+                       counter_names[n]);
+    g_printerr("\n");
+    if (stats.group.counted[0] && stats.group.counted[1] &&
+        stats.group.value[0] > 0)
+        g_printerr("%s: %.2f instructions per cycle\n", PLUG_IN_BINARY,
+                   (gdouble) stats.group.value[1] / stats.group.value[0]);
+}
+
+#ifdef SMOOTH_PATH_GIMP2
+/*-----------------------------------------------------------------------------
+ *  corner_preview_expose  --  draws the histogram of corner angles, in 5
+ *                             degree bins, highlighting the bins that the
+ *                             current settings smooth
+ *-----------------------------------------------------------------------------
+ */
+gboolean corner_preview_expose(GtkWidget      *widget,
+                               GdkEventExpose *event,
+                               CornerPreview  *preview)
+{
+    cairo_t *cr;
+    gdouble  width, height, bar;
+    gint     n;
+
+    if (preview->max_bin == 0)
+        return FALSE;
+
+    cr = gdk_cairo_create(widget->window);
+    width = widget->allocation.width;
+    height = widget->allocation.height;
+    bar = width / CORNER_BINS;
+    for (n = 0; n < CORNER_BINS; n++) {
+        if (anchor_smoothed(&svals, (n + 0.5) * 180.0 / CORNER_BINS))
+            gdk_cairo_set_source_color(cr,
+                &widget->style->bg[GTK_STATE_SELECTED]);
+        else
+            gdk_cairo_set_source_color(cr,
+                &widget->style->dark[GTK_STATE_NORMAL]);
+        cairo_rectangle(cr, n * bar + 1,
+                        height * (1 - (gdouble) preview->bins[n] /
+                                      preview->max_bin),
+                        bar - 2,
+                        height * preview->bins[n] / preview->max_bin);
+        cairo_fill(cr);
     }
-    
-    /* Create a new stroke based on new ctlpts */
-    gimp_vectors_stroke_new_from_points(new_vectors_id, 
-                                        GIMP_VECTORS_STROKE_TYPE_BEZIER,
-                                        num_points, ctlpts, closed);
-    
-    g_array_free(asd, TRUE);
-    g_array_free(asb, TRUE);
-    g_array_free(acx, TRUE);
-    g_array_free(acy, TRUE);
-    g_array_free(aconx1, TRUE);
-    g_array_free(aconx2, TRUE);
-    g_array_free(acony1, TRUE);
-    g_array_free(acony2, TRUE);
-    g_free(ctlpts);
+    cairo_destroy(cr);
+
+    return FALSE;
 }
 
-/*----------------------------------------------------------------------------- 
- *  smooth_path  --  manipulates the vectors with Bezier smoothing algorithm
+/*-----------------------------------------------------------------------------
+ *  corner_preview_update  --  recounts the corners that will be smoothed
+ *                             after a setting changed
  *-----------------------------------------------------------------------------
  */
-gboolean smooth_path(gint32 image_id, gint32 vectors_id)
+void corner_preview_update(GtkWidget *widget, CornerPreview *preview)
 {
-    gint32  new_vectors_id;
-    gint    n, num_strokes;
-    gint   *strokes;
-    gchar  *v_name;
-    
-    /* We create a new vector and delete the old one (undo doesn't
-     * work if you simply change the strokes of an existing vector) */
-    strokes = gimp_vectors_get_strokes(vectors_id, &num_strokes);
-    v_name = gimp_vectors_get_name(vectors_id);
-    new_vectors_id = gimp_vectors_new(image_id, v_name);
-    
-    /* The bezier smoothing algorithm is applied to each stroke */
-    for (n = 0; n < num_strokes; n++) 
-      set_bezier_path(new_vectors_id, vectors_id, strokes[n]);
-      
-    gimp_image_add_vectors(image_id, new_vectors_id, 
-                           gimp_image_get_vectors_position(image_id, 
-                                                           vectors_id));
-    gimp_image_remove_vectors(image_id, vectors_id);
-    gimp_vectors_set_name(new_vectors_id, v_name);
-    g_free(v_name);
-    g_free(strokes);
-    
-    return TRUE;
+    gchar text[64];
+
+    g_snprintf(text, sizeof(text), "%d of %d corners will be smoothed",
+               corners_smoothed(&svals, preview->corners),
+               preview->corners->len);
+    gtk_label_set_text(GTK_LABEL(preview->label), text);
+    gtk_widget_queue_draw(preview->area);
 }
 
 /*----------------------------------------------------------------------------- 
- *  smooth_dialog  --  dialog that allows user to set some algorithm parameters
+ *  smooth_dialog  --  dialog that allows user to set some algorithm
+ *                     parameters; corners holds the sorted corner angles
+ *                     of the path, to show how many a setting affects
  *-----------------------------------------------------------------------------
  */
-gboolean smooth_dialog(void)
+gboolean smooth_dialog(const GArray *corners)
 {
+    CornerPreview preview;
     GtkWidget *dialog;
     GtkWidget *vbox;
     GtkWidget *toggle;
+    GtkWidget *region_toggle;
+    GtkWidget *fill_combo;
+    GtkWidget *join_combo;
     GtkWidget *table;
     GtkObject *scale1_data;
     GtkObject *scale2_data;
+    GtkObject *scale3_data;
+    GtkObject *scale4_data;
     gboolean   run;
+    guint      n;
     
     gimp_ui_init (PLUG_IN_BINARY, FALSE);
     
@@ -437,7 +5070,7 @@ gboolean smooth_dialog(void)
     gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(toggle),
                                  (svals.smooth_specified == TRUE));
                      
-    table = gtk_table_new(2, 3, FALSE);
+    table = gtk_table_new(6, 3, FALSE);
     gtk_table_set_col_spacings(GTK_TABLE(table), 6);
     gtk_table_set_row_spacings(GTK_TABLE(table), 6);
     gtk_table_set_row_spacing(GTK_TABLE(table), 0, 4);
@@ -459,6 +5092,92 @@ gboolean smooth_dialog(void)
     g_signal_connect(scale2_data, "value-changed",
                      G_CALLBACK(gimp_double_adjustment_update),
                      &svals.ang_max);
+
+    scale3_data = gimp_scale_entry_new(GTK_TABLE(table), 0, 2,
+                                       "Smoo_thing:", SCALE_WIDTH, 6,
+                                       svals.smoothing, 0.0, 100.0, 0.5, 10.0,
+                                       1, FALSE, 0.0, 10000.0,
+                                       "0 keeps the anchors where they are, "
+                                       "larger values move them onto a "
+                                       "smoother curve", NULL);
+    g_signal_connect(scale3_data, "value-changed",
+                     G_CALLBACK(gimp_double_adjustment_update),
+                     &svals.smoothing);
+
+    scale4_data = gimp_scale_entry_new(GTK_TABLE(table), 0, 3,
+                                       "_Merge within:", SCALE_WIDTH, 6,
+                                       svals.merge, 0.0, 2.0, 0.05, 0.25,
+                                       2, FALSE, 0.0, 100.0,
+                                       "Replace runs of segments by a single "
+                                       "one where that stays this many "
+                                       "pixels from the path, 0 to keep "
+                                       "them all", NULL);
+    g_signal_connect(scale4_data, "value-changed",
+                     G_CALLBACK(gimp_double_adjustment_update),
+                     &svals.merge);
+
+    fill_combo = gimp_int_combo_box_new("None",     FILL_NONE,
+                                        "Nonzero",  FILL_NONZERO,
+                                        "Even-odd", FILL_EVENODD,
+                                        NULL);
+    gimp_int_combo_box_set_active(GIMP_INT_COMBO_BOX(fill_combo), svals.fill);
+    gimp_table_attach_aligned(GTK_TABLE(table), 0, 4, "_Fill channel:",
+                              0.0, 0.5, fill_combo, 2, FALSE);
+    g_signal_connect(fill_combo, "changed",
+                     G_CALLBACK(gimp_int_combo_box_get_active), &svals.fill);
+
+    join_combo = gimp_int_combo_box_new("Keep apart",         JOIN_NONE,
+                                        "Join",               JOIN_KEEP,
+                                        "Join, then split",   JOIN_SPLIT,
+                                        NULL);
+    gimp_int_combo_box_set_active(GIMP_INT_COMBO_BOX(join_combo), svals.join);
+    gimp_table_attach_aligned(GTK_TABLE(table), 0, 5, "_Touching strokes:",
+                              0.0, 0.5, join_combo, 2, FALSE);
+    g_signal_connect(join_combo, "changed",
+                     G_CALLBACK(gimp_int_combo_box_get_active), &svals.join);
+
+    region_toggle
+      = gtk_check_button_new_with_mnemonic("Only _inside the selection");
+    gtk_box_pack_start(GTK_BOX(vbox), region_toggle, FALSE, FALSE, 0);
+    gtk_widget_show(region_toggle);
+    if (svals.region != REGION_SELECTION)
+        svals.region = REGION_ALL;
+    g_signal_connect(region_toggle, "toggled",
+                     G_CALLBACK(gimp_toggle_button_update),
+                     &svals.region);
+    gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(region_toggle),
+                                 (svals.region == REGION_SELECTION));
+
+    /* Histogram of the corner angles, with a count underneath */
+    preview.corners = corners;
+    preview.max_bin = 0;
+    memset(preview.bins, 0, sizeof(preview.bins));
+    for (n = 0; n < corners->len; n++)
+        preview.bins[MIN((gint) (g_array_index(corners, gdouble, n) *
+                                 CORNER_BINS / 180.0), CORNER_BINS - 1)]++;
+    for (n = 0; n < CORNER_BINS; n++)
+        preview.max_bin = MAX(preview.max_bin, preview.bins[n]);
+
+    preview.area = gtk_drawing_area_new();
+    gtk_widget_set_size_request(preview.area, -1, 48);
+    gtk_box_pack_start(GTK_BOX(vbox), preview.area, FALSE, FALSE, 0);
+    gtk_widget_show(preview.area);
+    g_signal_connect(preview.area, "expose-event",
+                     G_CALLBACK(corner_preview_expose), &preview);
+
+    preview.label = gtk_label_new(NULL);
+    gtk_misc_set_alignment(GTK_MISC(preview.label), 0.0, 0.5);
+    gtk_box_pack_start(GTK_BOX(vbox), preview.label, FALSE, FALSE, 0);
+    gtk_widget_show(preview.label);
+
+    /* Connected after the handlers above, so svals is already updated */
+    g_signal_connect(toggle, "toggled",
+                     G_CALLBACK(corner_preview_update), &preview);
+    g_signal_connect(scale1_data, "value-changed",
+                     G_CALLBACK(corner_preview_update), &preview);
+    g_signal_connect(scale2_data, "value-changed",
+                     G_CALLBACK(corner_preview_update), &preview);
+    corner_preview_update(NULL, &preview);
                      
     gtk_widget_show(dialog);
     
@@ -482,6 +5201,8 @@ static void run(const gchar      *name,
     static GimpParam  values[1];
     GimpPDBStatusType status = GIMP_PDB_SUCCESS;
     GimpRunMode       run_mode;
+    GArray           *corners;
+    gboolean          ok;
     gint32            image_id, vectors_id; 
 
     /* Setting mandatory output values */
@@ -491,24 +5212,128 @@ static void run(const gchar      *name,
     values[0].data.d_status = status;
     
     run_mode = param[0].data.d_int32;
+
+    if (strcmp(name, CALIBRATE_PROC) == 0) {
+        stats.enabled = (g_getenv("SMOOTH_PATH_STATS") != NULL);
+        model_load(TRUE);
+        model_report();
+        return;
+    }
+
     image_id = param[1].data.d_image;
     vectors_id = param[2].data.d_int32;
+
+    if (strcmp(name, REVERT_PROC) == 0) {
+        gimp_image_undo_group_start(image_id);
+        if (!revert_path(image_id, vectors_id)) {
+            if (run_mode == GIMP_RUN_INTERACTIVE)
+                g_message("This path has not been smoothed, or it has been "
+                          "edited since.");
+            status = GIMP_PDB_EXECUTION_ERROR;
+        }
+        gimp_image_undo_group_end(image_id);
+        if (run_mode != GIMP_RUN_NONINTERACTIVE)
+            gimp_displays_flush();
+        values[0].data.d_status = status;
+        return;
+    }
+
+    if (strcmp(name, REFINE_PROC) == 0) {
+        stats.enabled = (g_getenv("SMOOTH_PATH_STATS") != NULL);
+        stats.counters = (g_strcmp0(g_getenv("SMOOTH_PATH_STATS"),
+                                    "perf") == 0);
+        stats.total_time = g_get_monotonic_time();
+        gimp_image_undo_group_start(image_id);
+        if (!refine_path(image_id, vectors_id)) {
+            if (run_mode == GIMP_RUN_INTERACTIVE)
+                g_message("This path has no strokes left to refine, or it "
+                          "has been edited since.");
+            status = GIMP_PDB_EXECUTION_ERROR;
+        }
+        gimp_image_undo_group_end(image_id);
+        stats.total_time = g_get_monotonic_time() - stats.total_time;
+        stats_report();
+        if (run_mode != GIMP_RUN_NONINTERACTIVE)
+            gimp_displays_flush();
+        values[0].data.d_status = status;
+        return;
+    }
+
+    if (strcmp(name, FRAMES_PROC) == 0) {
+        if (nparams != 8 || param[2].data.d_int32 < 1) {
+            values[0].data.d_status = GIMP_PDB_CALLING_ERROR;
+            return;
+        }
+        svals.smooth_specified = param[4].data.d_int32;
+        svals.ang_min = param[5].data.d_float;
+        svals.ang_max = param[6].data.d_float;
+        svals.smoothing = MAX(param[7].data.d_float, 0.0);
+        svals.region = REGION_ALL;
+        svals.fill = FILL_NONE;
+        svals.merge = 0.0;
+        svals.join = JOIN_NONE;
+        svals.deadline = 0.0;
+
+        stats.enabled = (g_getenv("SMOOTH_PATH_STATS") != NULL);
+        stats.counters = (g_strcmp0(g_getenv("SMOOTH_PATH_STATS"),
+                                    "perf") == 0);
+        stats.total_time = g_get_monotonic_time();
+        gimp_image_undo_group_start(image_id);
+        smooth_frames(&svals, image_id, param[3].data.d_int32array,
+                      param[2].data.d_int32);
+        gimp_image_undo_group_end(image_id);
+        stats.total_time = g_get_monotonic_time() - stats.total_time;
+        stats_report();
+        if (run_mode != GIMP_RUN_NONINTERACTIVE)
+            gimp_displays_flush();
+        return;
+    }
     
     switch (run_mode) {
         case GIMP_RUN_INTERACTIVE:
             /* Get options last values if needed */
             gimp_get_data(PLUG_IN_PROC, &svals);
             /* Display the dialog */
-            if (!smooth_dialog())
+            corners = g_array_new(FALSE, FALSE, sizeof(gdouble));
+            path_corner_angles(image_id, vectors_id, corners);
+            ok = smooth_dialog(corners);
+            g_array_free(corners, TRUE);
+            if (!ok)
                 return;
             break;
         case GIMP_RUN_NONINTERACTIVE:
-            if (nparams != 6)
+            /* Scripts written before smoothing, regions, filling,
+             * merging, joining and deadlines existed pass 6, 7, 10, 11,
+             * 12 or 13 */
+            if (nparams != 6 && nparams != 7 && nparams != 10 &&
+                nparams != 11 && nparams != 12 && nparams != 13 &&
+                nparams != 14)
                 status = GIMP_PDB_CALLING_ERROR;
             if (status == GIMP_PDB_SUCCESS) {
                 svals.smooth_specified = param[3].data.d_int32;
                 svals.ang_min = param[4].data.d_float;
                 svals.ang_max = param[5].data.d_float;
+                svals.smoothing = (nparams >= 7) ?
+                                  MAX(param[6].data.d_float, 0.0) : 0.0;
+                svals.region = REGION_ALL;
+                svals.fill = (nparams >= 11) ? param[10].data.d_int32 :
+                                               FILL_NONE;
+                svals.merge = (nparams >= 12) ?
+                              MAX(param[11].data.d_float, 0.0) : 0.0;
+                svals.join = (nparams >= 13) ? param[12].data.d_int32 :
+                                               JOIN_NONE;
+                svals.deadline = (nparams >= 14) ?
+                                 MAX(param[13].data.d_float, 0.0) : 0.0;
+                if (nparams >= 10) {
+                    svals.region = param[7].data.d_int32;
+                    svals.first_anchor = param[8].data.d_int32;
+                    svals.last_anchor = param[9].data.d_int32;
+                }
+                if (svals.region < REGION_ALL ||
+                    svals.region > REGION_ANCHORS ||
+                    svals.fill < FILL_NONE || svals.fill > FILL_EVENODD ||
+                    svals.join < JOIN_NONE || svals.join > JOIN_SPLIT)
+                    status = GIMP_PDB_CALLING_ERROR;
             }
             break;
         case GIMP_RUN_WITH_LAST_VALS:
@@ -520,10 +5345,19 @@ static void run(const gchar      *name,
     }
     
     if (status == GIMP_PDB_SUCCESS) {
+        stats.enabled = (g_getenv("SMOOTH_PATH_STATS") != NULL);
+        stats.counters = (g_strcmp0(g_getenv("SMOOTH_PATH_STATS"),
+                                    "perf") == 0);
+        model_load(FALSE);
+        stats.total_time = g_get_monotonic_time();
+
         /* Bundle the smooth_path code inside an undo group */        
         gimp_image_undo_group_start(image_id);
-        smooth_path(image_id, vectors_id);
+        smooth_path(&svals, image_id, vectors_id);
         gimp_image_undo_group_end(image_id);
+
+        stats.total_time = g_get_monotonic_time() - stats.total_time;
+        stats_report();
       
         /* Refresh and clean up */
         if (run_mode != GIMP_RUN_NONINTERACTIVE)
@@ -536,3 +5370,650 @@ static void run(const gchar      *name,
     
     values[0].data.d_status = status;
 }
+#endif
+
+#ifdef SMOOTH_PATH_GIMP3
+#define SMOOTH_PATH_TYPE (smooth_path_plug_in_get_type())
+G_DECLARE_FINAL_TYPE(SmoothPathPlugIn, smooth_path_plug_in,
+                     SMOOTH_PATH, PLUG_IN, GimpPlugIn)
+
+struct _SmoothPathPlugIn
+{
+    GimpPlugIn parent_instance;
+};
+
+static GList         *smooth_query_procedures(GimpPlugIn *plug_in);
+static GimpProcedure *smooth_create_procedure(GimpPlugIn  *plug_in,
+                                              const gchar *name);
+static GimpValueArray *smooth_run(GimpProcedure        *procedure,
+                                  GimpRunMode           run_mode,
+                                  GimpImage            *image,
+                                  GimpDrawable        **drawables,
+                                  GimpProcedureConfig  *config,
+                                  gpointer              run_data);
+static GimpValueArray *refine_run(GimpProcedure        *procedure,
+                                  GimpRunMode           run_mode,
+                                  GimpImage            *image,
+                                  GimpDrawable        **drawables,
+                                  GimpProcedureConfig  *config,
+                                  gpointer              run_data);
+
+G_DEFINE_TYPE(SmoothPathPlugIn, smooth_path_plug_in, GIMP_TYPE_PLUG_IN)
+
+GIMP_MAIN(SMOOTH_PATH_TYPE)
+
+static void smooth_path_plug_in_class_init(SmoothPathPlugInClass *klass)
+{
+    GimpPlugInClass *plug_in_class = GIMP_PLUG_IN_CLASS(klass);
+
+    plug_in_class->query_procedures = smooth_query_procedures;
+    plug_in_class->create_procedure = smooth_create_procedure;
+}
+
+static void smooth_path_plug_in_init(SmoothPathPlugIn *plug_in)
+{
+}
+
+static GList *smooth_query_procedures(GimpPlugIn *plug_in)
+{
+    return g_list_append(g_list_append(NULL, g_strdup(PLUG_IN_PROC)),
+                         g_strdup(REFINE_PROC));
+}
+
+/*-----------------------------------------------------------------------------
+ *  smooth_create_procedure  --  tells GIMP 3 about the plugin; the same
+ *                               settings as the GIMP 2 version, but it works
+ *                               on all selected paths at once
+ *-----------------------------------------------------------------------------
+ */
+static GimpProcedure *smooth_create_procedure(GimpPlugIn  *plug_in,
+                                              const gchar *name)
+{
+    GimpProcedure *procedure;
+
+    if (strcmp(name, REFINE_PROC) == 0) {
+        procedure = gimp_image_procedure_new(plug_in, name,
+                                             GIMP_PDB_PROC_TYPE_PLUGIN,
+                                             refine_run, NULL, NULL);
+        gimp_procedure_set_sensitivity_mask(procedure,
+                                            GIMP_PROCEDURE_SENSITIVE_ALWAYS);
+        gimp_procedure_set_documentation(procedure,
+            "Finish smoothing the selected paths where they ran out of time",
+            "Solves the strokes that plug-in-smooth-path left unsolved when "
+            "it was given a deadline, with the settings it was given, on "
+            "all threads but, like that run, without joining touching "
+            "strokes",
+            name);
+        gimp_procedure_set_attribution(procedure, "agent", "agent",
+                                       "October 2026");
+        return procedure;
+    }
+    if (strcmp(name, PLUG_IN_PROC) != 0)
+        return NULL;
+
+    procedure = gimp_image_procedure_new(plug_in, name,
+                                         GIMP_PDB_PROC_TYPE_PLUGIN,
+                                         smooth_run, NULL, NULL);
+    gimp_procedure_set_sensitivity_mask(procedure,
+                                        GIMP_PROCEDURE_SENSITIVE_ALWAYS);
+    gimp_procedure_set_menu_label(procedure, "Smooth Path...");
+    gimp_procedure_add_menu_path(procedure, "<Paths>");
+    gimp_procedure_set_documentation(procedure,
+        "Smooth the selected paths using Bezier interpolation",
+        "An alternate name for this algorithm is cubic spline interpolation",
+        name);
+    gimp_procedure_set_attribution(procedure, "Marko Peric", "Marko Peric",
+                                   "October 2009");
+
+    gimp_procedure_add_boolean_argument(procedure, "smooth",
+                                        "_Smooth only specified corners",
+                                        "Smooth specified corners",
+                                        FALSE, G_PARAM_READWRITE);
+    gimp_procedure_add_double_argument(procedure, "angle-min",
+                                       "Mi_nimum angle",
+                                       "Minimum angle to be smoothed",
+                                       0.0, 180.0, 60.0, G_PARAM_READWRITE);
+    gimp_procedure_add_double_argument(procedure, "angle-max",
+                                       "Ma_ximum angle",
+                                       "Maximum angle to be smoothed",
+                                       0.0, 180.0, 120.0, G_PARAM_READWRITE);
+    gimp_procedure_add_double_argument(procedure, "smoothing",
+                                       "Smoo_thing",
+                                       "How far anchors may move to make "
+                                       "the path smoother, 0 to keep them",
+                                       0.0, 10000.0, 0.0, G_PARAM_READWRITE);
+    gimp_procedure_add_boolean_argument(procedure, "selection-only",
+                                        "Only _inside the selection",
+                                        "Leave anchors outside the "
+                                        "selection alone",
+                                        FALSE, G_PARAM_READWRITE);
+    gimp_procedure_add_double_argument(procedure, "merge",
+                                       "_Merge within",
+                                       "Replace runs of segments by a "
+                                       "single one where that stays this "
+                                       "many pixels from the path, 0 to "
+                                       "keep them all",
+                                       0.0, 100.0, 0.0, G_PARAM_READWRITE);
+    gimp_procedure_add_choice_argument(procedure, "fill",
+                                       "_Fill channel",
+                                       "Fill each smoothed path into a new "
+                                       "channel",
+                                       gimp_choice_new_with_values(
+                                           "none", FILL_NONE, "None", NULL,
+                                           "nonzero", FILL_NONZERO,
+                                           "Nonzero", NULL,
+                                           "even-odd", FILL_EVENODD,
+                                           "Even-odd", NULL,
+                                           NULL),
+                                       "none", G_PARAM_READWRITE);
+    gimp_procedure_add_choice_argument(procedure, "join",
+                                       "_Touching strokes",
+                                       "Smooth strokes whose ends touch "
+                                       "as one",
+                                       gimp_choice_new_with_values(
+                                           "none", JOIN_NONE,
+                                           "Keep apart", NULL,
+                                           "join", JOIN_KEEP, "Join", NULL,
+                                           "split", JOIN_SPLIT,
+                                           "Join, then split", NULL,
+                                           NULL),
+                                       "none", G_PARAM_READWRITE);
+    gimp_procedure_add_double_argument(procedure, "deadline",
+                                       "_Deadline (ms)",
+                                       "Milliseconds smoothing may take: "
+                                       "the largest strokes are solved "
+                                       "first, one at a time on one "
+                                       "thread and without joining, the "
+                                       "rest get quicker handles or none, "
+                                       "0 for no limit",
+                                       0.0, 60000.0, 0.0, G_PARAM_READWRITE);
+    gimp_procedure_add_boolean_argument(procedure, "frames",
+                                        "Paths are _frames of an animation",
+                                        "Smooth the paths in order, each "
+                                        "one starting from the one before",
+                                        FALSE, G_PARAM_READWRITE);
+
+    return procedure;
+}
+
+/*-----------------------------------------------------------------------------
+ *  smooth_dialog  --  dialog that allows user to set some algorithm parameters
+ *-----------------------------------------------------------------------------
+ */
+static gboolean smooth_dialog(GimpProcedure       *procedure,
+                              GimpProcedureConfig *config)
+{
+    GtkWidget *dialog;
+    gboolean   run;
+
+    gimp_ui_init(PLUG_IN_BINARY);
+    dialog = gimp_procedure_dialog_new(procedure, config, "Smooth Path");
+    gimp_procedure_dialog_fill(GIMP_PROCEDURE_DIALOG(dialog), NULL);
+    run = gimp_procedure_dialog_run(GIMP_PROCEDURE_DIALOG(dialog));
+    gtk_widget_destroy(dialog);
+
+    return run;
+}
+
+/*-----------------------------------------------------------------------------
+ *  selection_mask  --  marks the anchors of batch that lie inside the
+ *                      selection, one byte each; without a selection all
+ *                      of them are. The selection under the box around the
+ *                      anchors is read in one go rather than pixel by pixel
+ *-----------------------------------------------------------------------------
+ */
+static void selection_mask(GimpImage *image, const StrokeBatch *batch,
+                           GArray *mask)
+{
+    GeglBuffer    *buffer;
+    const gdouble *p;
+    guint8        *pixels;
+    gboolean       non_empty;
+    gdouble        ax1, ay1, ax2, ay2;
+    gint           x1, y1, x2, y2, x, y;
+    gint           n, len;
+
+    len = batch->points->len / 6;
+    g_array_set_size(mask, len);
+    memset(mask->data, 0, len);
+    gimp_selection_bounds(image, &non_empty, &x1, &y1, &x2, &y2);
+    stats.pdb_calls++;
+    if (!non_empty) {
+        memset(mask->data, 1, len);
+        return;
+    }
+    if (len == 0)
+        return;
+
+    /* Only the part of the selection's box that anchors fall in is read */
+    p = (const gdouble *) batch->points->data;
+    ax1 = ax2 = p[2];
+    ay1 = ay2 = p[3];
+    for (n = 1; n < len; n++) {
+        ax1 = MIN(ax1, p[n * 6 + 2]);
+        ax2 = MAX(ax2, p[n * 6 + 2]);
+        ay1 = MIN(ay1, p[n * 6 + 3]);
+        ay2 = MAX(ay2, p[n * 6 + 3]);
+    }
+    if (ax2 < x1 || ax1 >= x2 || ay2 < y1 || ay1 >= y2)
+        return;
+    ax1 = floor(MAX(ax1, x1));
+    ay1 = floor(MAX(ay1, y1));
+    x2 = (gint) MIN(x2, floor(ax2) + 1);
+    y2 = (gint) MIN(y2, floor(ay2) + 1);
+    x1 = (gint) ax1;
+    y1 = (gint) ay1;
+
+    pixels = g_new(guint8, (gsize) (x2 - x1) * (y2 - y1));
+    buffer = gimp_drawable_get_buffer(
+                 GIMP_DRAWABLE(gimp_image_get_selection(image)));
+    gegl_buffer_get(buffer, GEGL_RECTANGLE(x1, y1, x2 - x1, y2 - y1), 1.0,
+                    babl_format("Y u8"), pixels, GEGL_AUTO_ROWSTRIDE,
+                    GEGL_ABYSS_NONE);
+    g_object_unref(buffer);
+    stats.pdb_calls += 2;
+
+    for (n = 0; n < len; n++) {
+        x = (gint) floor(p[n * 6 + 2]);
+        y = (gint) floor(p[n * 6 + 3]);
+        if (x >= x1 && x < x2 && y >= y1 && y < y2)
+            g_array_index(mask, guint8, n) =
+                (pixels[(gsize) (y - y1) * (x2 - x1) + (x - x1)] > 127);
+    }
+    g_free(pixels);
+}
+
+/*-----------------------------------------------------------------------------
+ *  buffer_write  --  RasterWriter that copies coverage into a GEGL buffer
+ *-----------------------------------------------------------------------------
+ */
+static void buffer_write(const guint8 *coverage, gint x, gint y, gint width,
+                         gint height, gpointer data)
+{
+    gegl_buffer_set((GeglBuffer *) data, GEGL_RECTANGLE(x, y, width, height),
+                    0, babl_format("Y u8"), coverage, GEGL_AUTO_ROWSTRIDE);
+}
+
+/*-----------------------------------------------------------------------------
+ *  path_rasterize  --  fills strokes first .. last - 1 of batch into a new
+ *                      channel named after their path, anti-aliased
+ *-----------------------------------------------------------------------------
+ */
+static void path_rasterize(GimpImage *image, const gchar *name,
+                           const StrokeBatch *batch, gint first, gint last,
+                           gint fill)
+{
+    GimpChannel *channel;
+    GeglBuffer  *buffer;
+    GeglColor   *black;
+    gdouble      bx1, by1, bx2, by2;
+    gint         x1, y1, x2, y2, width, height;
+    gint64       start;
+
+    start = g_get_monotonic_time();
+    width = gimp_image_get_width(image);
+    height = gimp_image_get_height(image);
+    black = gegl_color_new("black");
+    channel = gimp_channel_new(image, name, width, height, 50.0, black);
+    gimp_image_insert_channel(image, channel, NULL, 0);
+    stats.pdb_calls += 4;
+    g_object_unref(black);
+
+    if (stroke_batch_bounds(batch, first, last, &bx1, &by1, &bx2, &by2)) {
+        x1 = CLAMP((gint) floor(bx1), 0, width);
+        y1 = CLAMP((gint) floor(by1), 0, height);
+        x2 = CLAMP((gint) ceil(bx2), 0, width);
+        y2 = CLAMP((gint) ceil(by2), 0, height);
+        if (x2 > x1 && y2 > y1) {
+            buffer = gimp_drawable_get_buffer(GIMP_DRAWABLE(channel));
+            rasterize_strokes(batch, first, last, fill, x1, y1,
+                              x2 - x1, y2 - y1, buffer_write, buffer);
+            g_object_unref(buffer);
+            gimp_drawable_update(GIMP_DRAWABLE(channel), x1, y1,
+                                 x2 - x1, y2 - y1);
+            stats.pdb_calls += 2;
+        }
+    }
+    stats.raster_time += g_get_monotonic_time() - start;
+}
+
+/*-----------------------------------------------------------------------------
+ *  path_fetch  --  appends the strokes of path to batch
+ *-----------------------------------------------------------------------------
+ */
+static void path_fetch(GimpPath *path, StrokeBatch *batch)
+{
+    gdouble  *ctlpts;
+    gint     *strokes;
+    gsize     num_strokes, num_points;
+    gboolean  closed;
+    gint      n;
+
+    strokes = gimp_path_get_strokes(path, &num_strokes);
+    for (n = 0; n < (gint) num_strokes; n++) {
+        gimp_path_stroke_get_points(path, strokes[n], &num_points, &ctlpts,
+                                    &closed);
+        stroke_batch_add(batch, ctlpts, num_points, closed);
+        g_free(ctlpts);
+    }
+    stats.pdb_calls += num_strokes + 1;
+    g_free(strokes);
+}
+
+/*-----------------------------------------------------------------------------
+ *  path_replace  --  puts a new path named name, with strokes first ..
+ *                    last - 1 of batch, in the place of path, and returns it
+ *-----------------------------------------------------------------------------
+ */
+static GimpPath *path_replace(GimpImage *image, GimpPath *path,
+                              const gchar *name, const StrokeBatch *batch,
+                              gint first, gint last)
+{
+    GimpPath *new_path;
+    gint      n;
+
+    /* We create a new path and delete the old one (undo doesn't work if
+     * you simply change the strokes of an existing path) */
+    new_path = gimp_path_new(image, name);
+    for (n = first; n < last; n++)
+        gimp_path_stroke_new_from_points(new_path,
+                                         GIMP_PATH_STROKE_TYPE_BEZIER,
+                                         stroke_batch_size(batch, n),
+                                         stroke_batch_points(batch, n),
+                                         stroke_batch_closed(batch, n));
+    gimp_image_insert_path(image, new_path, NULL,
+                           gimp_image_get_item_position(image,
+                                                        GIMP_ITEM(path)));
+    gimp_image_remove_path(image, path);
+    gimp_item_set_name(GIMP_ITEM(new_path), name);
+    stats.pdb_calls += last - first + 5;
+
+    return new_path;
+}
+
+/*-----------------------------------------------------------------------------
+ *  path_degraded  --  keeps what refine_run needs on path, the new path
+ *                     of strokes first .. last - 1 of a run with a
+ *                     deadline: their original points and angles, their
+ *                     QUALITY_ levels and their part of mask, as GIMP 2
+ *                     does for a single path
+ *-----------------------------------------------------------------------------
+ */
+static void path_degraded(const SmoothVals *vals, GimpPath *path,
+                          const StrokeBatch *batch,
+                          const StrokeBatch *original, const GArray *angles,
+                          const GArray *quality, const GArray *mask,
+                          gint first, gint last)
+{
+    StrokeBatch  kept_original, kept_result;
+    GArray      *kept_angles, *kept_quality, *kept_mask;
+    gint32       path_id;
+    gint         n, from, to;
+
+    stroke_batch_init(&kept_original);
+    stroke_batch_init(&kept_result);
+    for (n = first; n < last; n++) {
+        stroke_batch_add(&kept_original, stroke_batch_points(original, n),
+                         stroke_batch_size(original, n),
+                         stroke_batch_closed(original, n));
+        stroke_batch_add(&kept_result, stroke_batch_points(batch, n),
+                         stroke_batch_size(batch, n),
+                         stroke_batch_closed(batch, n));
+    }
+    from = g_array_index(original->offsets, gint, first) / 6;
+    to = g_array_index(original->offsets, gint, last) / 6;
+    kept_angles = g_array_new(FALSE, FALSE, sizeof(gdouble));
+    g_array_append_vals(kept_angles, &g_array_index(angles, gdouble, from),
+                        to - from);
+    kept_quality = g_array_new(FALSE, FALSE, sizeof(guint8));
+    g_array_append_vals(kept_quality,
+                        &g_array_index(quality, guint8, first),
+                        last - first);
+    kept_mask = g_array_new(FALSE, FALSE, sizeof(guint8));
+    if (mask->len > 0)
+        g_array_append_vals(kept_mask, &g_array_index(mask, guint8, from),
+                            to - from);
+
+    path_id = gimp_item_get_id(GIMP_ITEM(path));
+    original_attach(path_id, &kept_original, kept_angles,
+                    (vals->smoothing > 0 || vals->merge > 0 ||
+                     vals->join != JOIN_NONE) ? &kept_result : NULL);
+    degraded_attach(path_id, vals, &kept_original, kept_quality, kept_mask);
+
+    stroke_batch_free(&kept_original);
+    stroke_batch_free(&kept_result);
+    g_array_free(kept_angles, TRUE);
+    g_array_free(kept_quality, TRUE);
+    g_array_free(kept_mask, TRUE);
+}
+
+/*-----------------------------------------------------------------------------
+ *  smooth_run  --  smooths every selected path; all strokes of all paths go
+ *                  through the worker threads together, and the whole
+ *                  operation is a single undo step
+ *-----------------------------------------------------------------------------
+ */
+static GimpValueArray *smooth_run(GimpProcedure        *procedure,
+                                  GimpRunMode           run_mode,
+                                  GimpImage            *image,
+                                  GimpDrawable        **drawables,
+                                  GimpProcedureConfig  *config,
+                                  gpointer              run_data)
+{
+    SmoothScratch scratch = { NULL };
+    SmoothVals    vals = { 0 };
+    FrameState    state;
+    StrokeBatch   batch, original;
+    GArray       *angles;
+    GArray       *mask;
+    GArray       *path_ends;
+    GArray       *quality;
+    GimpPath    **paths;
+    gboolean      smooth_specified, selection_only, frames;
+    gint          fill;
+    gchar        *name;
+    gint          n, first, end;
+    gint64        start;
+
+    if (run_mode == GIMP_RUN_INTERACTIVE && !smooth_dialog(procedure, config))
+        return gimp_procedure_new_return_values(procedure, GIMP_PDB_CANCEL,
+                                                NULL);
+
+    g_object_get(config,
+                 "smooth",    &smooth_specified,
+                 "angle-min", &vals.ang_min,
+                 "angle-max", &vals.ang_max,
+                 "smoothing", &vals.smoothing,
+                 "selection-only", &selection_only,
+                 "frames",    &frames,
+                 "merge",     &vals.merge,
+                 "deadline",  &vals.deadline,
+                 NULL);
+    fill = gimp_procedure_config_get_choice_id(config, "fill");
+    vals.join = gimp_procedure_config_get_choice_id(config, "join");
+    vals.smooth_specified = smooth_specified;
+    vals.region = selection_only ? REGION_SELECTION : REGION_ALL;
+    vals.last_anchor = -1;
+
+    paths = gimp_image_get_selected_paths(image);
+    if (!paths || !paths[0]) {
+        g_free(paths);
+        return gimp_procedure_new_return_values(procedure,
+                   GIMP_PDB_CALLING_ERROR,
+                   g_error_new_literal(GIMP_PLUG_IN_ERROR, 0,
+                                       "No path is selected"));
+    }
+
+    stats.enabled = (g_getenv("SMOOTH_PATH_STATS") != NULL);
+    stats.counters = (g_strcmp0(g_getenv("SMOOTH_PATH_STATS"), "perf") == 0);
+    stats.total_time = g_get_monotonic_time();
+    stats.transport = "per-stroke";
+
+    /* Read all strokes of all paths into one batch, remembering where each
+     * path's strokes end */
+    stroke_batch_init(&batch);
+    path_ends = g_array_new(FALSE, FALSE, sizeof(gint));
+    for (n = 0; paths[n]; n++) {
+        path_fetch(paths[n], &batch);
+        end = stroke_batch_len(&batch);
+        g_array_append_val(path_ends, end);
+    }
+    stats.strokes = stroke_batch_len(&batch);
+    stats.anchors = batch.points->len / 6;
+
+    mask = g_array_new(FALSE, FALSE, sizeof(guint8));
+    if (selection_only)
+        selection_mask(image, &batch, mask);
+
+    /* Frames follow on from each other, so they go one at a time; with
+     * only the selection to smooth they are smoothed together as usual */
+    angles = g_array_new(FALSE, FALSE, sizeof(gdouble));
+    stroke_batch_init(&original);
+    quality = g_array_new(FALSE, FALSE, sizeof(guint8));
+    stats.engine = engine_name(&vals);
+    start = g_get_monotonic_time();
+    counters_start();
+    if (frames && !selection_only) {
+        frame_state_init(&state);
+        stats.threads = 1;
+        first = 0;
+        for (n = 0; paths[n]; n++) {
+            end = g_array_index(path_ends, gint, n);
+            smooth_frame(&vals, &state, &batch, first, end, &scratch);
+            first = end;
+        }
+        frame_state_free(&state);
+    } else if (vals.deadline > 0) {
+        /* Joining takes time that a deadline doesn't allow for; the
+         * strokes it leaves unsolved are kept for refine_run */
+        stroke_batch_copy(&original, &batch);
+        stroke_batch_angles(&batch, angles);
+        smooth_batch_deadline(&vals, &batch, (gdouble *) angles->data,
+                              selection_only ? (guint8 *) mask->data : NULL,
+                              &scratch, quality);
+    } else {
+        stroke_batch_angles(&batch, angles);
+        smooth_batch_joined(&vals, &batch, (gdouble *) angles->data, mask,
+                            path_ends, &scratch);
+    }
+    counters_stop();
+    stats.solve_time = g_get_monotonic_time() - start;
+    if (vals.merge > 0)
+        merge_batch(&vals, &batch,
+                    selection_only ? (guint8 *) mask->data : NULL);
+
+    gimp_image_undo_group_start(image);
+    first = 0;
+    for (n = 0; paths[n]; n++) {
+        name = gimp_item_get_name(GIMP_ITEM(paths[n]));
+        end = g_array_index(path_ends, gint, n);
+        paths[n] = path_replace(image, paths[n], name, &batch, first, end);
+        if (quality->len > 0)
+            path_degraded(&vals, paths[n], &batch, &original, angles,
+                          quality, mask, first, end);
+        if (fill != FILL_NONE)
+            path_rasterize(image, name, &batch, first, end, fill);
+        first = end;
+        g_free(name);
+    }
+    gimp_image_set_selected_paths(image, (const GimpPath **) paths);
+    gimp_image_undo_group_end(image);
+
+    if (run_mode != GIMP_RUN_NONINTERACTIVE)
+        gimp_displays_flush();
+
+    stats.total_time = g_get_monotonic_time() - stats.total_time;
+    stats_report();
+
+    stroke_batch_free(&batch);
+    stroke_batch_free(&original);
+    g_array_free(path_ends, TRUE);
+    g_array_free(angles, TRUE);
+    g_array_free(mask, TRUE);
+    g_array_free(quality, TRUE);
+    scratch_free(&scratch);
+    g_free(paths);
+
+    return gimp_procedure_new_return_values(procedure, GIMP_PDB_SUCCESS, NULL);
+}
+
+/*-----------------------------------------------------------------------------
+ *  refine_run  --  refine_batch on every selected path that a run with a
+ *                  deadline left strokes unsolved in, as a single undo
+ *                  step; the fill channel of that run is left as it was
+ *-----------------------------------------------------------------------------
+ */
+static GimpValueArray *refine_run(GimpProcedure        *procedure,
+                                  GimpRunMode           run_mode,
+                                  GimpImage            *image,
+                                  GimpDrawable        **drawables,
+                                  GimpProcedureConfig  *config,
+                                  gpointer              run_data)
+{
+    SmoothVals    vals;
+    StrokeBatch   batch, original, result;
+    GArray       *angles;
+    GimpPath    **paths;
+    gchar        *name;
+    gint          n, refined;
+
+    paths = gimp_image_get_selected_paths(image);
+    if (!paths || !paths[0]) {
+        g_free(paths);
+        return gimp_procedure_new_return_values(procedure,
+                   GIMP_PDB_CALLING_ERROR,
+                   g_error_new_literal(GIMP_PLUG_IN_ERROR, 0,
+                                       "No path is selected"));
+    }
+
+    stats.enabled = (g_getenv("SMOOTH_PATH_STATS") != NULL);
+    stats.counters = (g_strcmp0(g_getenv("SMOOTH_PATH_STATS"), "perf") == 0);
+    stats.total_time = g_get_monotonic_time();
+    stats.transport = "per-stroke";
+
+    stroke_batch_init(&batch);
+    stroke_batch_init(&original);
+    stroke_batch_init(&result);
+    angles = g_array_new(FALSE, FALSE, sizeof(gdouble));
+    gimp_image_undo_group_start(image);
+    refined = 0;
+    for (n = 0; paths[n]; n++) {
+        stroke_batch_clear(&batch);
+        path_fetch(paths[n], &batch);
+        if (!refine_batch(gimp_item_get_id(GIMP_ITEM(paths[n])), &batch,
+                          &vals, &original, angles, &result))
+            continue;
+        name = gimp_item_get_name(GIMP_ITEM(paths[n]));
+        paths[n] = path_replace(image, paths[n], name, &result, 0,
+                                stroke_batch_len(&result));
+        original_attach(gimp_item_get_id(GIMP_ITEM(paths[n])), &original,
+                        angles, (vals.smoothing > 0 || vals.merge > 0 ||
+                                 vals.join != JOIN_NONE) ? &result : NULL);
+        refined++;
+        g_free(name);
+    }
+    gimp_image_set_selected_paths(image, (const GimpPath **) paths);
+    gimp_image_undo_group_end(image);
+
+    if (run_mode != GIMP_RUN_NONINTERACTIVE)
+        gimp_displays_flush();
+
+    stats.total_time = g_get_monotonic_time() - stats.total_time;
+    stats_report();
+
+    stroke_batch_free(&batch);
+    stroke_batch_free(&original);
+    stroke_batch_free(&result);
+    g_array_free(angles, TRUE);
+    g_free(paths);
+
+    if (refined == 0)
+        return gimp_procedure_new_return_values(procedure,
+                   GIMP_PDB_EXECUTION_ERROR,
+                   g_error_new_literal(GIMP_PLUG_IN_ERROR, 0,
+                                       "The selected paths have no strokes "
+                                       "left to refine, or have been edited "
+                                       "since."));
+    return gimp_procedure_new_return_values(procedure, GIMP_PDB_SUCCESS, NULL);
+}
+#endif
@@ -0,0 +1,205 @@
+/*
+ *      bench-plugin.c - times whole runs of plug-in-smooth-path against the
+ *                       headless libgimp stand-in, with a set cost per PDB
+ *                       call, on paths of growing numbers of strokes;
+ *                       the stand-in parses imports its own way, so only
+ *                       the call counts carry over to GIMP, not the times.
+ *                       Then reads the hardware counters around solving,
+ *                       on one thread and on the pool, for strokes of
+ *                       growing numbers of anchors
+ *
+ *      Copyright 2026 agent
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ *      This program is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *
+ *      You should have received a copy of the GNU General Public License
+ *      along with this program; if not, write to the Free Software
+ *      Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ *      MA 02110-1301, USA.
+ */
+
+#include "../smooth-path.c"
+#include "gimp-stub.h"
+
+#define BENCH_ANCHORS 20
+#define BENCH_RUNS    5
+/* Anchors solved, in all, for each row of counters */
+#define BENCH_COUNTED 100000
+
+/*-----------------------------------------------------------------------------
+ *  bench_path  --  a path of num_strokes random open strokes, with the
+ *                  outer handles on the end anchors, in a new image
+ *-----------------------------------------------------------------------------
+ */
+static gint32 bench_path(GRand *rand, gint num_strokes, gint32 *image_id)
+{
+    gdouble ctlpts[BENCH_ANCHORS * 6];
+    gint32  vectors_id;
+    gint    n, k;
+
+    *image_id = gimp_image_new(1000, 1000, GIMP_RGB);
+    vectors_id = gimp_vectors_new(*image_id, "Bench");
+    for (n = 0; n < num_strokes; n++) {
+        for (k = 0; k < BENCH_ANCHORS * 6; k++)
+            ctlpts[k] = g_rand_double_range(rand, 0, 1000);
+        ctlpts[0] = ctlpts[2];
+        ctlpts[1] = ctlpts[3];
+        ctlpts[BENCH_ANCHORS * 6 - 2] = ctlpts[BENCH_ANCHORS * 6 - 4];
+        ctlpts[BENCH_ANCHORS * 6 - 1] = ctlpts[BENCH_ANCHORS * 6 - 3];
+        gimp_vectors_stroke_new_from_points(vectors_id,
+                                            GIMP_VECTORS_STROKE_TYPE_BEZIER,
+                                            BENCH_ANCHORS * 6, ctlpts, FALSE);
+    }
+    gimp_image_add_vectors(*image_id, vectors_id, 0);
+    return vectors_id;
+}
+
+/*-----------------------------------------------------------------------------
+ *  bench_run  --  the best of BENCH_RUNS smoothings of a fresh path of
+ *                 num_strokes, in microseconds, and the PDB calls it made
+ *-----------------------------------------------------------------------------
+ */
+static gint64 bench_run(GRand *rand, gint num_strokes, gulong latency,
+                        guint *calls)
+{
+    GimpParam  params[6];
+    GimpParam *return_vals;
+    gint32     image_id;
+    gint64     start, best;
+    gint       nreturn_vals, run;
+
+    best = G_MAXINT64;
+    for (run = 0; run < BENCH_RUNS; run++) {
+        gimp_stub_reset();
+        model_load(FALSE);
+        memset(params, 0, sizeof(params));
+        params[0].data.d_int32 = GIMP_RUN_NONINTERACTIVE;
+        params[2].data.d_vectors = bench_path(rand, num_strokes, &image_id);
+        params[1].data.d_image = image_id;
+        params[4].data.d_float = 60;
+        params[5].data.d_float = 120;
+
+        gimp_stub_set_latency(latency);
+        *calls = gimp_stub_calls();
+        start = g_get_monotonic_time();
+        PLUG_IN_INFO.run_proc(PLUG_IN_PROC, 6, params,
+                              &nreturn_vals, &return_vals);
+        best = MIN(best, g_get_monotonic_time() - start);
+        *calls = gimp_stub_calls() - *calls;
+        g_assert(return_vals[0].data.d_status == GIMP_PDB_SUCCESS);
+    }
+    return best;
+}
+
+/*-----------------------------------------------------------------------------
+ *  bench_counters  --  solves BENCH_COUNTED random anchors, cut into strokes
+ *                      of each size, with each engine, and prints the time
+ *                      and what the hardware counters counted per anchor
+ *-----------------------------------------------------------------------------
+ */
+static void bench_counters(GRand *rand)
+{
+    static const gint   sizes[] = { 10, 100, 1000 };
+    static const gchar *engines[] = { "one thread", "pool" };
+    SmoothVals     vals = { 0 };
+    SmoothScratch  scratch = { NULL };
+    SmoothTask     task;
+    StrokeBatch    batch;
+    GArray        *angles;
+    gdouble       *ctlpts;
+    gint64         start, time;
+    gint           size, engine, n, k;
+
+    vals.ang_min = 60;
+    vals.ang_max = 120;
+    vals.last_anchor = -1;
+    stroke_batch_init(&batch);
+    angles = g_array_new(FALSE, FALSE, sizeof(gdouble));
+    ctlpts = g_new(gdouble, sizes[G_N_ELEMENTS(sizes) - 1] * 6);
+    task.vals = &vals;
+    task.batch = &batch;
+    task.mask = NULL;
+    task.sizes = NULL;
+    stats.counters = TRUE;
+
+    g_print("\n%10s %8s %10s", "engine", "anchors", "ns");
+    for (n = 0; n < COUNTER_COUNT; n++)
+        g_print(" %13s", counter_names[n]);
+    g_print(" %6s\n", "IPC");
+    for (size = 0; size < (gint) G_N_ELEMENTS(sizes); size++)
+        for (engine = 0; engine < (gint) G_N_ELEMENTS(engines); engine++) {
+            stroke_batch_clear(&batch);
+            for (n = 0; n < BENCH_COUNTED / sizes[size]; n++) {
+                for (k = 0; k < sizes[size] * 6; k++)
+                    ctlpts[k] = g_rand_double_range(rand, 0, 1000);
+                stroke_batch_add(&batch, ctlpts, sizes[size] * 6, n % 2);
+            }
+            stroke_batch_angles(&batch, angles);
+            task.angles = (const gdouble *) angles->data;
+
+            memset(&stats.group, 0, sizeof(stats.group));
+            start = g_get_monotonic_time();
+            counters_start();
+            if (engine == 0)
+                smooth_batch(&vals, &batch, task.angles, NULL, &scratch);
+            else
+                batch_pool_run(&task, smooth_task);
+            counters_stop();
+            time = g_get_monotonic_time() - start;
+
+            g_print("%10s %8d %10.1f", engines[engine], sizes[size],
+                    time * 1000.0 / BENCH_COUNTED);
+            for (n = 0; n < COUNTER_COUNT; n++)
+                if (stats.group.counted[n])
+                    g_print(" %13.2f",
+                            (gdouble) stats.group.value[n] / BENCH_COUNTED);
+                else
+                    g_print(" %13s", "-");
+            if (stats.group.counted[0] && stats.group.counted[1] &&
+                stats.group.value[0] > 0)
+                g_print(" %6.2f\n", (gdouble) stats.group.value[1] /
+                                    stats.group.value[0]);
+            else
+                g_print(" %6s\n", "-");
+        }
+
+    stats.counters = FALSE;
+    stroke_batch_free(&batch);
+    g_array_free(angles, TRUE);
+    g_free(ctlpts);
+    scratch_free(&scratch);
+}
+
+int main(int argc, char **argv)
+{
+    static const gint   strokes[] = { 8, BULK_MIN_STROKES - 1,
+                                      BULK_MIN_STROKES, 256, 2048 };
+    static const gulong latencies[] = { 0, 50 };
+    GRand  *rand;
+    gint64  time;
+    guint   calls;
+    gint    n, l;
+
+    rand = g_rand_new_with_seed(53);
+    g_print("%8s %8s %10s %8s %12s %12s  %s\n", "strokes", "anchors",
+            "latency us", "calls", "time ms", "us/stroke", "transport");
+    for (l = 0; l < (gint) G_N_ELEMENTS(latencies); l++)
+        for (n = 0; n < (gint) G_N_ELEMENTS(strokes); n++) {
+            time = bench_run(rand, strokes[n], latencies[l], &calls);
+            g_print("%8d %8d %10lu %8u %12.2f %12.2f  %s\n", strokes[n],
+                    strokes[n] * BENCH_ANCHORS, latencies[l], calls,
+                    time / 1000.0, (gdouble) time / strokes[n],
+                    stats.transport);
+        }
+    bench_counters(rand);
+    g_rand_free(rand);
+    return 0;
+}
@@ -0,0 +1,1341 @@
+/*
+ *      gimp-stub.c - headless stand-in for libgimp, linked in place of it
+ *                    so that the plugin's run() can be tested and timed
+ *                    without GIMP: images, paths, channels and the
+ *                    selection live in memory, and every call that would be
+ *                    a PDB round trip is counted and can be slowed down
+ *
+ *      Copyright 2026 agent
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ *      This program is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *
+ *      You should have received a copy of the GNU General Public License
+ *      along with this program; if not, write to the Free Software
+ *      Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ *      MA 02110-1301, USA.
+ */
+
+#include <glib/gstdio.h>
+#include <libgimp/gimp.h>
+#include <libgimp/gimpui.h>
+#include <stdlib.h>
+#include <string.h>
+#include "gimp-stub.h"
+
+#define STUB_VECTORS 1
+#define STUB_CHANNEL 2
+
+typedef struct
+{
+    gint      id;
+    GArray   *points;
+    gboolean  closed;
+} StubStroke;
+
+/* A path or a channel; items of both kinds share one range of IDs */
+typedef struct
+{
+    gint       type;
+    gint32     image_id;
+    gboolean   attached;
+    gchar     *name;
+    GArray    *strokes;
+    gint       next_stroke;
+    GPtrArray *parasites;
+    gint       width, height;
+    guint8    *pixels;
+} StubItem;
+
+typedef struct
+{
+    gint    width, height;
+    gint32  selection;
+    GArray *vectors;
+    GArray *channels;
+    gint    undo_depth;
+} StubImage;
+
+typedef struct
+{
+    gchar  *identifier;
+    GArray *bytes;
+} StubData;
+
+/* Indexed by ID; 0 is never used, and removed ones are NULL */
+static GPtrArray *images = NULL;
+static GPtrArray *items = NULL;
+static GPtrArray *data_store = NULL;
+static GPtrArray *widgets = NULL;
+static gulong     latency = 0;
+static guint      calls = 0;
+/* Stands in for the user's GIMP directory, made when first asked for */
+static gchar     *directory = NULL;
+
+/*-----------------------------------------------------------------------------
+ *  stub_init  --  sets up the empty tables the first time they are needed
+ *-----------------------------------------------------------------------------
+ */
+static void stub_init(void)
+{
+    if (images)
+        return;
+    images = g_ptr_array_new();
+    items = g_ptr_array_new();
+    data_store = g_ptr_array_new();
+    widgets = g_ptr_array_new();
+    g_ptr_array_add(images, NULL);
+    g_ptr_array_add(items, NULL);
+}
+
+/*-----------------------------------------------------------------------------
+ *  pdb_call  --  counts a call that GIMP answers through the PDB, and waits
+ *                as long as that is set to take
+ *-----------------------------------------------------------------------------
+ */
+static void pdb_call(void)
+{
+    calls++;
+    if (latency > 0)
+        g_usleep(latency);
+}
+
+static StubImage *stub_image(gint32 image_ID)
+{
+    stub_init();
+    g_return_val_if_fail(image_ID > 0 && image_ID < (gint32) images->len &&
+                         g_ptr_array_index(images, image_ID) != NULL, NULL);
+    return g_ptr_array_index(images, image_ID);
+}
+
+static StubItem *stub_item(gint32 item_ID, gint type)
+{
+    StubItem *item;
+
+    stub_init();
+    g_return_val_if_fail(item_ID > 0 && item_ID < (gint32) items->len &&
+                         g_ptr_array_index(items, item_ID) != NULL, NULL);
+    item = g_ptr_array_index(items, item_ID);
+    g_return_val_if_fail(item->type == type, NULL);
+    return item;
+}
+
+static StubStroke *stub_stroke(StubItem *vectors, gint stroke_id)
+{
+    guint n;
+
+    for (n = 0; n < vectors->strokes->len; n++)
+        if (g_array_index(vectors->strokes, StubStroke, n).id == stroke_id)
+            return &g_array_index(vectors->strokes, StubStroke, n);
+    return NULL;
+}
+
+static gint32 stub_item_new(gint type, gint32 image_ID, const gchar *name,
+                            gint width, gint height)
+{
+    StubItem *item;
+
+    item = g_new0(StubItem, 1);
+    item->type = type;
+    item->image_id = image_ID;
+    item->name = g_strdup(name);
+    if (type == STUB_VECTORS) {
+        item->strokes = g_array_new(FALSE, FALSE, sizeof(StubStroke));
+        item->next_stroke = 1;
+        item->parasites = g_ptr_array_new();
+    } else {
+        item->width = width;
+        item->height = height;
+        item->pixels = g_new0(guint8, width * height);
+    }
+    g_ptr_array_add(items, item);
+    return items->len - 1;
+}
+
+static void stub_item_free(gint32 item_ID)
+{
+    StubItem *item = g_ptr_array_index(items, item_ID);
+    guint     n;
+
+    if (!item)
+        return;
+    if (item->strokes) {
+        for (n = 0; n < item->strokes->len; n++)
+            g_array_free(g_array_index(item->strokes, StubStroke, n).points,
+                         TRUE);
+        g_array_free(item->strokes, TRUE);
+    }
+    if (item->parasites) {
+        for (n = 0; n < item->parasites->len; n++)
+            gimp_parasite_free(g_ptr_array_index(item->parasites, n));
+        g_ptr_array_free(item->parasites, TRUE);
+    }
+    g_free(item->pixels);
+    g_free(item->name);
+    g_free(item);
+    g_ptr_array_index(items, item_ID) = NULL;
+}
+
+static gint stub_stroke_add(StubItem *vectors, const gdouble *ctlpts,
+                            gint num_points, gboolean closed)
+{
+    StubStroke stroke;
+
+    stroke.id = vectors->next_stroke++;
+    stroke.points = g_array_sized_new(FALSE, FALSE, sizeof(gdouble),
+                                      num_points);
+    g_array_append_vals(stroke.points, ctlpts, num_points);
+    stroke.closed = closed;
+    g_array_append_val(vectors->strokes, stroke);
+    return stroke.id;
+}
+
+/*-----------------------------------------------------------------------------
+ *  stub_stack_index  --  where an item is in a stack of IDs, or -1
+ *-----------------------------------------------------------------------------
+ */
+static gint stub_stack_index(const GArray *stack, gint32 item_ID)
+{
+    guint n;
+
+    for (n = 0; n < stack->len; n++)
+        if (g_array_index(stack, gint32, n) == item_ID)
+            return n;
+    return -1;
+}
+
+static void stub_stack_insert(GArray *stack, gint32 item_ID, gint position)
+{
+    if (position < 0 || position > (gint) stack->len)
+        position = (position < 0) ? 0 : stack->len;
+    g_array_set_size(stack, stack->len + 1);
+    memmove(&g_array_index(stack, gint32, position + 1),
+            &g_array_index(stack, gint32, position),
+            (stack->len - 1 - position) * sizeof(gint32));
+    g_array_index(stack, gint32, position) = item_ID;
+}
+
+/*-----------------------------------------------------------------------------
+ *  stub_directory_empty  --  removes every file the plugin left in the GIMP
+ *                            directory
+ *-----------------------------------------------------------------------------
+ */
+static void stub_directory_empty(void)
+{
+    GDir        *dir;
+    const gchar *name;
+    gchar       *filename;
+
+    dir = directory ? g_dir_open(directory, 0, NULL) : NULL;
+    if (!dir)
+        return;
+    while ((name = g_dir_read_name(dir))) {
+        filename = g_build_filename(directory, name, NULL);
+        g_remove(filename);
+        g_free(filename);
+    }
+    g_dir_close(dir);
+}
+
+static void stub_directory_remove(void)
+{
+    stub_directory_empty();
+    g_rmdir(directory);
+}
+
+void gimp_stub_reset(void)
+{
+    StubImage *image;
+    StubData  *data;
+    guint      n;
+
+    stub_init();
+    for (n = 1; n < items->len; n++)
+        stub_item_free(n);
+    g_ptr_array_set_size(items, 1);
+    for (n = 1; n < images->len; n++) {
+        image = g_ptr_array_index(images, n);
+        if (!image)
+            continue;
+        g_array_free(image->vectors, TRUE);
+        g_array_free(image->channels, TRUE);
+        g_free(image);
+    }
+    g_ptr_array_set_size(images, 1);
+    for (n = 0; n < data_store->len; n++) {
+        data = g_ptr_array_index(data_store, n);
+        g_free(data->identifier);
+        g_array_free(data->bytes, TRUE);
+        g_free(data);
+    }
+    g_ptr_array_set_size(data_store, 0);
+    for (n = 0; n < widgets->len; n++)
+        g_free(g_ptr_array_index(widgets, n));
+    g_ptr_array_set_size(widgets, 0);
+    stub_directory_empty();
+    latency = 0;
+    calls = 0;
+}
+
+void gimp_stub_set_latency(gulong usec)
+{
+    latency = usec;
+}
+
+guint gimp_stub_calls(void)
+{
+    return calls;
+}
+
+/*----- Procedures ----------------------------------------------------------*/
+
+void gimp_install_procedure(const gchar        *name,
+                            const gchar        *blurb,
+                            const gchar        *help,
+                            const gchar        *author,
+                            const gchar        *copyright,
+                            const gchar        *date,
+                            const gchar        *menu_label,
+                            const gchar        *image_types,
+                            GimpPDBProcType     type,
+                            gint                n_params,
+                            gint                n_return_vals,
+                            const GimpParamDef *params,
+                            const GimpParamDef *return_vals)
+{
+}
+
+gboolean gimp_plugin_menu_register(const gchar *procedure_name,
+                                   const gchar *menu_path)
+{
+    return TRUE;
+}
+
+static StubData *stub_data(const gchar *identifier)
+{
+    StubData *data;
+    guint     n;
+
+    stub_init();
+    for (n = 0; n < data_store->len; n++) {
+        data = g_ptr_array_index(data_store, n);
+        if (strcmp(data->identifier, identifier) == 0)
+            return data;
+    }
+    return NULL;
+}
+
+const gchar *gimp_directory(void)
+{
+    if (!directory) {
+        directory = g_dir_make_tmp("smooth-path-test-XXXXXX", NULL);
+        g_assert(directory);
+        atexit(stub_directory_remove);
+    }
+    return directory;
+}
+
+gboolean gimp_get_data(const gchar *identifier, gpointer data)
+{
+    StubData *stored;
+
+    pdb_call();
+    stored = stub_data(identifier);
+    if (!stored)
+        return FALSE;
+    memcpy(data, stored->bytes->data, stored->bytes->len);
+    return TRUE;
+}
+
+gint gimp_get_data_size(const gchar *identifier)
+{
+    StubData *stored;
+
+    pdb_call();
+    stored = stub_data(identifier);
+    return stored ? (gint) stored->bytes->len : 0;
+}
+
+gboolean gimp_set_data(const gchar *identifier, gconstpointer data,
+                       guint32 bytes)
+{
+    StubData *stored;
+
+    pdb_call();
+    stored = stub_data(identifier);
+    if (!stored) {
+        stored = g_new0(StubData, 1);
+        stored->identifier = g_strdup(identifier);
+        stored->bytes = g_array_new(FALSE, FALSE, sizeof(guint8));
+        g_ptr_array_add(data_store, stored);
+    }
+    g_array_set_size(stored->bytes, 0);
+    g_array_append_vals(stored->bytes, data, bytes);
+    return TRUE;
+}
+
+gboolean gimp_displays_flush(void)
+{
+    pdb_call();
+    return TRUE;
+}
+
+/*----- Images --------------------------------------------------------------*/
+
+gint32 gimp_image_new(gint width, gint height, GimpImageBaseType type)
+{
+    StubImage *image;
+
+    pdb_call();
+    stub_init();
+    g_return_val_if_fail(width > 0 && height > 0, -1);
+    image = g_new0(StubImage, 1);
+    image->width = width;
+    image->height = height;
+    image->vectors = g_array_new(FALSE, FALSE, sizeof(gint32));
+    image->channels = g_array_new(FALSE, FALSE, sizeof(gint32));
+    g_ptr_array_add(images, image);
+    image->selection = stub_item_new(STUB_CHANNEL, images->len - 1,
+                                     "Selection Mask", width, height);
+    return images->len - 1;
+}
+
+gboolean gimp_image_delete(gint32 image_ID)
+{
+    StubImage *image;
+    guint      n;
+
+    pdb_call();
+    image = stub_image(image_ID);
+    if (!image)
+        return FALSE;
+    for (n = 1; n < items->len; n++)
+        if (g_ptr_array_index(items, n) &&
+            ((StubItem *) g_ptr_array_index(items, n))->image_id == image_ID)
+            stub_item_free(n);
+    g_array_free(image->vectors, TRUE);
+    g_array_free(image->channels, TRUE);
+    g_free(image);
+    g_ptr_array_index(images, image_ID) = NULL;
+    return TRUE;
+}
+
+gint gimp_image_width(gint32 image_ID)
+{
+    StubImage *image;
+
+    pdb_call();
+    image = stub_image(image_ID);
+    return image ? image->width : -1;
+}
+
+gint gimp_image_height(gint32 image_ID)
+{
+    StubImage *image;
+
+    pdb_call();
+    image = stub_image(image_ID);
+    return image ? image->height : -1;
+}
+
+gboolean gimp_image_undo_group_start(gint32 image_ID)
+{
+    StubImage *image;
+
+    pdb_call();
+    image = stub_image(image_ID);
+    if (!image)
+        return FALSE;
+    image->undo_depth++;
+    return TRUE;
+}
+
+gboolean gimp_image_undo_group_end(gint32 image_ID)
+{
+    StubImage *image;
+
+    pdb_call();
+    image = stub_image(image_ID);
+    if (!image)
+        return FALSE;
+    g_return_val_if_fail(image->undo_depth > 0, FALSE);
+    image->undo_depth--;
+    return TRUE;
+}
+
+gint *gimp_image_get_vectors(gint32 image_ID, gint *num_vectors)
+{
+    StubImage *image;
+
+    pdb_call();
+    *num_vectors = 0;
+    image = stub_image(image_ID);
+    if (!image)
+        return NULL;
+    *num_vectors = image->vectors->len;
+    return g_memdup2(image->vectors->data,
+                     image->vectors->len * sizeof(gint32));
+}
+
+gint *gimp_image_get_channels(gint32 image_ID, gint *num_channels)
+{
+    StubImage *image;
+
+    pdb_call();
+    *num_channels = 0;
+    image = stub_image(image_ID);
+    if (!image)
+        return NULL;
+    *num_channels = image->channels->len;
+    return g_memdup2(image->channels->data,
+                     image->channels->len * sizeof(gint32));
+}
+
+gboolean gimp_image_add_vectors(gint32 image_ID, gint32 vectors_ID,
+                                gint position)
+{
+    StubImage *image;
+    StubItem  *vectors;
+
+    pdb_call();
+    image = stub_image(image_ID);
+    vectors = stub_item(vectors_ID, STUB_VECTORS);
+    if (!image || !vectors)
+        return FALSE;
+    g_return_val_if_fail(vectors->image_id == image_ID &&
+                         !vectors->attached, FALSE);
+    stub_stack_insert(image->vectors, vectors_ID, position);
+    vectors->attached = TRUE;
+    return TRUE;
+}
+
+gboolean gimp_image_remove_vectors(gint32 image_ID, gint32 vectors_ID)
+{
+    StubImage *image;
+    gint       n;
+
+    pdb_call();
+    image = stub_image(image_ID);
+    if (!image || !stub_item(vectors_ID, STUB_VECTORS))
+        return FALSE;
+    n = stub_stack_index(image->vectors, vectors_ID);
+    g_return_val_if_fail(n >= 0, FALSE);
+    g_array_remove_index(image->vectors, n);
+    stub_item_free(vectors_ID);
+    return TRUE;
+}
+
+gint gimp_image_get_vectors_position(gint32 image_ID, gint32 vectors_ID)
+{
+    StubImage *image;
+
+    pdb_call();
+    image = stub_image(image_ID);
+    if (!image || !stub_item(vectors_ID, STUB_VECTORS))
+        return -1;
+    return stub_stack_index(image->vectors, vectors_ID);
+}
+
+gboolean gimp_image_reorder_item(gint32 image_ID, gint32 item_ID,
+                                 gint32 parent_ID, gint position)
+{
+    StubImage *image;
+    gint       n;
+
+    pdb_call();
+    image = stub_image(image_ID);
+    if (!image || parent_ID != -1 || !stub_item(item_ID, STUB_VECTORS))
+        return FALSE;
+    n = stub_stack_index(image->vectors, item_ID);
+    if (n < 0)
+        return FALSE;
+    g_array_remove_index(image->vectors, n);
+    stub_stack_insert(image->vectors, item_ID, position);
+    return TRUE;
+}
+
+gboolean gimp_image_add_channel(gint32 image_ID, gint32 channel_ID,
+                                gint position)
+{
+    StubImage *image;
+    StubItem  *channel;
+
+    pdb_call();
+    image = stub_image(image_ID);
+    channel = stub_item(channel_ID, STUB_CHANNEL);
+    if (!image || !channel)
+        return FALSE;
+    g_return_val_if_fail(channel->image_id == image_ID &&
+                         !channel->attached, FALSE);
+    stub_stack_insert(image->channels, channel_ID, position);
+    channel->attached = TRUE;
+    return TRUE;
+}
+
+gint32 gimp_image_get_selection(gint32 image_ID)
+{
+    StubImage *image;
+
+    pdb_call();
+    image = stub_image(image_ID);
+    return image ? image->selection : -1;
+}
+
+gboolean gimp_image_select_rectangle(gint32 image_ID,
+                                     GimpChannelOps operation,
+                                     gdouble x, gdouble y,
+                                     gdouble width, gdouble height)
+{
+    StubImage *image;
+    StubItem  *selection;
+    gboolean   inside;
+    guint8    *pixel;
+    gint       px, py;
+
+    pdb_call();
+    image = stub_image(image_ID);
+    if (!image)
+        return FALSE;
+    selection = stub_item(image->selection, STUB_CHANNEL);
+    for (py = 0; py < selection->height; py++)
+        for (px = 0; px < selection->width; px++) {
+            pixel = selection->pixels + py * selection->width + px;
+            inside = (px >= x && px < x + width && py >= y && py < y + height);
+            switch (operation) {
+                case GIMP_CHANNEL_OP_ADD:
+                    *pixel = inside ? 255 : *pixel;
+                    break;
+                case GIMP_CHANNEL_OP_SUBTRACT:
+                    *pixel = inside ? 0 : *pixel;
+                    break;
+                case GIMP_CHANNEL_OP_REPLACE:
+                    *pixel = inside ? 255 : 0;
+                    break;
+                case GIMP_CHANNEL_OP_INTERSECT:
+                    *pixel = inside ? *pixel : 0;
+                    break;
+            }
+        }
+    return TRUE;
+}
+
+gboolean gimp_selection_bounds(gint32 image_ID, gboolean *non_empty,
+                               gint *x1, gint *y1, gint *x2, gint *y2)
+{
+    StubImage *image;
+    StubItem  *selection;
+    gint       px, py;
+
+    pdb_call();
+    image = stub_image(image_ID);
+    if (!image)
+        return FALSE;
+    selection = stub_item(image->selection, STUB_CHANNEL);
+    *x1 = selection->width;
+    *y1 = selection->height;
+    *x2 = *y2 = 0;
+    for (py = 0; py < selection->height; py++)
+        for (px = 0; px < selection->width; px++)
+            if (selection->pixels[py * selection->width + px]) {
+                *x1 = MIN(*x1, px);
+                *y1 = MIN(*y1, py);
+                *x2 = MAX(*x2, px + 1);
+                *y2 = MAX(*y2, py + 1);
+            }
+
+    /* As in GIMP, an empty selection is bounded by the whole image */
+    *non_empty = (*x2 > 0);
+    if (!*non_empty) {
+        *x1 = *y1 = 0;
+        *x2 = selection->width;
+        *y2 = selection->height;
+    }
+    return TRUE;
+}
+
+/*----- Vectors -------------------------------------------------------------*/
+
+gint32 gimp_vectors_new(gint32 image_ID, const gchar *name)
+{
+    pdb_call();
+    if (!stub_image(image_ID))
+        return -1;
+    return stub_item_new(STUB_VECTORS, image_ID, name, 0, 0);
+}
+
+gchar *gimp_vectors_get_name(gint32 vectors_ID)
+{
+    StubItem *vectors;
+
+    pdb_call();
+    vectors = stub_item(vectors_ID, STUB_VECTORS);
+    return vectors ? g_strdup(vectors->name) : NULL;
+}
+
+gboolean gimp_vectors_set_name(gint32 vectors_ID, const gchar *name)
+{
+    StubItem *vectors;
+
+    pdb_call();
+    vectors = stub_item(vectors_ID, STUB_VECTORS);
+    if (!vectors)
+        return FALSE;
+    g_free(vectors->name);
+    vectors->name = g_strdup(name);
+    return TRUE;
+}
+
+gint *gimp_vectors_get_strokes(gint32 vectors_ID, gint *num_strokes)
+{
+    StubItem *vectors;
+    gint     *strokes;
+    guint     n;
+
+    pdb_call();
+    *num_strokes = 0;
+    vectors = stub_item(vectors_ID, STUB_VECTORS);
+    if (!vectors)
+        return NULL;
+    strokes = g_new(gint, vectors->strokes->len);
+    for (n = 0; n < vectors->strokes->len; n++)
+        strokes[n] = g_array_index(vectors->strokes, StubStroke, n).id;
+    *num_strokes = vectors->strokes->len;
+    return strokes;
+}
+
+GimpVectorsStrokeType gimp_vectors_stroke_get_points(gint32     vectors_ID,
+                                                     gint       stroke_id,
+                                                     gint      *num_points,
+                                                     gdouble  **controlpoints,
+                                                     gboolean  *closed)
+{
+    StubItem   *vectors;
+    StubStroke *stroke;
+
+    pdb_call();
+    *num_points = 0;
+    *controlpoints = NULL;
+    *closed = FALSE;
+    vectors = stub_item(vectors_ID, STUB_VECTORS);
+    if (!vectors)
+        return GIMP_VECTORS_STROKE_TYPE_BEZIER;
+    stroke = stub_stroke(vectors, stroke_id);
+    g_return_val_if_fail(stroke != NULL, GIMP_VECTORS_STROKE_TYPE_BEZIER);
+    *num_points = stroke->points->len;
+    *controlpoints = g_memdup2(stroke->points->data,
+                               stroke->points->len * sizeof(gdouble));
+    *closed = stroke->closed;
+    return GIMP_VECTORS_STROKE_TYPE_BEZIER;
+}
+
+gint gimp_vectors_stroke_new_from_points(gint32                 vectors_ID,
+                                         GimpVectorsStrokeType  type,
+                                         gint                   num_points,
+                                         const gdouble         *controlpoints,
+                                         gboolean               closed)
+{
+    StubItem *vectors;
+
+    pdb_call();
+    vectors = stub_item(vectors_ID, STUB_VECTORS);
+    if (!vectors)
+        return -1;
+    /* GIMP only takes whole anchors, with both their handles */
+    g_return_val_if_fail(num_points > 0 && num_points % 6 == 0, -1);
+    return stub_stroke_add(vectors, controlpoints, num_points, closed);
+}
+
+/*-----------------------------------------------------------------------------
+ *  stub_path_close  --  closes the stroke being imported the way GIMP does:
+ *                       a last anchor on top of the first goes into it, and
+ *                       gives it its in-handle
+ *-----------------------------------------------------------------------------
+ */
+static void stub_path_close(GArray *stroke)
+{
+    gdouble *ctlpts = (gdouble *) stroke->data;
+    gint     last = stroke->len - 6;
+
+    if (last > 0 && ctlpts[last + 2] == ctlpts[2] &&
+        ctlpts[last + 3] == ctlpts[3]) {
+        ctlpts[0] = ctlpts[last];
+        ctlpts[1] = ctlpts[last + 1];
+        g_array_set_size(stroke, last);
+    }
+}
+
+/*-----------------------------------------------------------------------------
+ *  stub_path_parse  --  adds the strokes of SVG path data with absolute M,
+ *                       L, C and Z commands to vectors, as GIMP's import
+ *                       would; the handles SVG leaves out lie on their
+ *                       anchors. Returns FALSE on anything else
+ *-----------------------------------------------------------------------------
+ */
+static gboolean stub_path_parse(StubItem *vectors, const gchar *p,
+                                const gchar *end)
+{
+    GArray   *stroke;
+    gdouble   v[6], anchor[6];
+    gchar    *next;
+    gchar     command = 0;
+    gint      n, count;
+    gboolean  ok = TRUE;
+
+    stroke = g_array_new(FALSE, FALSE, sizeof(gdouble));
+    while (ok && p < end) {
+        if (g_ascii_isspace(*p) || *p == ',') {
+            p++;
+            continue;
+        }
+        if (g_ascii_isalpha(*p)) {
+            command = *p++;
+            if (command == 'Z' && stroke->len > 0) {
+                stub_path_close(stroke);
+                stub_stroke_add(vectors, (gdouble *) stroke->data,
+                                stroke->len, TRUE);
+                g_array_set_size(stroke, 0);
+            }
+            ok = (command == 'M' || command == 'L' || command == 'C' ||
+                  command == 'Z');
+            continue;
+        }
+
+        count = (command == 'C') ? 6 : 2;
+        for (n = 0; ok && n < count; n++) {
+            while (p < end && (g_ascii_isspace(*p) || *p == ','))
+                p++;
+            v[n] = g_ascii_strtod(p, &next);
+            ok = (next != p && next <= end);
+            p = next;
+        }
+        if (!ok || command == 'Z' || command == 0 ||
+            (command != 'M' && stroke->len == 0)) {
+            ok = FALSE;
+            break;
+        }
+
+        if (command == 'M') {
+            if (stroke->len > 0)
+                stub_stroke_add(vectors, (gdouble *) stroke->data,
+                                stroke->len, FALSE);
+            g_array_set_size(stroke, 0);
+            /* Further pairs after a moveto are linetos */
+            command = 'L';
+        }
+        if (count == 6) {
+            g_array_index(stroke, gdouble, stroke->len - 2) = v[0];
+            g_array_index(stroke, gdouble, stroke->len - 1) = v[1];
+            anchor[0] = v[2];
+            anchor[1] = v[3];
+            anchor[2] = anchor[4] = v[4];
+            anchor[3] = anchor[5] = v[5];
+        } else {
+            anchor[0] = anchor[2] = anchor[4] = v[0];
+            anchor[1] = anchor[3] = anchor[5] = v[1];
+        }
+        g_array_append_vals(stroke, anchor, 6);
+    }
+    if (ok && stroke->len > 0)
+        stub_stroke_add(vectors, (gdouble *) stroke->data, stroke->len, FALSE);
+    g_array_free(stroke, TRUE);
+    return ok;
+}
+
+gboolean gimp_vectors_import_from_string(gint32        image_ID,
+                                         const gchar  *string,
+                                         gint          length,
+                                         gboolean      merge,
+                                         gboolean      scale,
+                                         gint         *num_vectors,
+                                         gint32      **vectors_ids)
+{
+    StubImage   *image;
+    GArray      *created;
+    gchar       *text;
+    const gchar *p, *end;
+    gint32       vectors_ID = -1;
+    gboolean     ok = TRUE;
+    guint        n;
+
+    pdb_call();
+    *num_vectors = 0;
+    *vectors_ids = NULL;
+    image = stub_image(image_ID);
+    if (!image)
+        return FALSE;
+
+    text = g_strndup(string, (length < 0) ? strlen(string) : (gsize) length);
+    created = g_array_new(FALSE, FALSE, sizeof(gint32));
+    for (p = text; ok && (p = strstr(p, " d=\"")) != NULL; p = end + 1) {
+        p += 4;
+        end = strchr(p, '"');
+        if (!end) {
+            ok = FALSE;
+            break;
+        }
+        if (!merge || vectors_ID == -1) {
+            vectors_ID = stub_item_new(STUB_VECTORS, image_ID,
+                                       "Imported Path", 0, 0);
+            g_array_append_val(created, vectors_ID);
+        }
+        ok = stub_path_parse(g_ptr_array_index(items, vectors_ID), p, end);
+    }
+    g_free(text);
+
+    /* GIMP adds what it imported on top of the path stack */
+    ok = ok && created->len > 0;
+    for (n = 0; n < created->len; n++) {
+        vectors_ID = g_array_index(created, gint32, n);
+        if (ok) {
+            stub_stack_insert(image->vectors, vectors_ID, n);
+            ((StubItem *) g_ptr_array_index(items, vectors_ID))->attached =
+                TRUE;
+        } else {
+            stub_item_free(vectors_ID);
+        }
+    }
+    if (ok) {
+        *num_vectors = created->len;
+        *vectors_ids = g_memdup2(created->data, created->len * sizeof(gint32));
+    }
+    g_array_free(created, TRUE);
+    return ok;
+}
+
+static gint stub_parasite_index(StubItem *vectors, const gchar *name)
+{
+    GimpParasite *parasite;
+    guint         n;
+
+    for (n = 0; n < vectors->parasites->len; n++) {
+        parasite = g_ptr_array_index(vectors->parasites, n);
+        if (strcmp(parasite->name, name) == 0)
+            return n;
+    }
+    return -1;
+}
+
+GimpParasite *gimp_vectors_parasite_find(gint32 vectors_ID, const gchar *name)
+{
+    StubItem     *vectors;
+    GimpParasite *parasite;
+    gint          n;
+
+    pdb_call();
+    vectors = stub_item(vectors_ID, STUB_VECTORS);
+    if (!vectors)
+        return NULL;
+    n = stub_parasite_index(vectors, name);
+    if (n < 0)
+        return NULL;
+    parasite = g_ptr_array_index(vectors->parasites, n);
+    return gimp_parasite_new(parasite->name, parasite->flags, parasite->size,
+                             parasite->data);
+}
+
+gboolean gimp_vectors_parasite_attach(gint32 vectors_ID,
+                                      const GimpParasite *parasite)
+{
+    StubItem     *vectors;
+    GimpParasite *copy;
+    gint          n;
+
+    pdb_call();
+    vectors = stub_item(vectors_ID, STUB_VECTORS);
+    if (!vectors)
+        return FALSE;
+    copy = gimp_parasite_new(parasite->name, parasite->flags, parasite->size,
+                             parasite->data);
+    n = stub_parasite_index(vectors, parasite->name);
+    if (n >= 0) {
+        gimp_parasite_free(g_ptr_array_index(vectors->parasites, n));
+        g_ptr_array_index(vectors->parasites, n) = copy;
+    } else {
+        g_ptr_array_add(vectors->parasites, copy);
+    }
+    return TRUE;
+}
+
+gboolean gimp_vectors_parasite_detach(gint32 vectors_ID, const gchar *name)
+{
+    StubItem *vectors;
+    gint      n;
+
+    pdb_call();
+    vectors = stub_item(vectors_ID, STUB_VECTORS);
+    if (!vectors)
+        return FALSE;
+    n = stub_parasite_index(vectors, name);
+    if (n >= 0) {
+        gimp_parasite_free(g_ptr_array_index(vectors->parasites, n));
+        g_ptr_array_remove_index(vectors->parasites, n);
+    }
+    return TRUE;
+}
+
+/*----- Parasites -----------------------------------------------------------*/
+
+GimpParasite *gimp_parasite_new(const gchar *name, guint32 flags,
+                                guint32 size, gconstpointer data)
+{
+    GimpParasite *parasite;
+
+    parasite = g_new0(GimpParasite, 1);
+    parasite->name = g_strdup(name);
+    parasite->flags = flags;
+    parasite->size = size;
+    if (size > 0)
+        parasite->data = g_memdup2(data, size);
+    return parasite;
+}
+
+void gimp_parasite_free(GimpParasite *parasite)
+{
+    if (!parasite)
+        return;
+    g_free(parasite->name);
+    g_free(parasite->data);
+    g_free(parasite);
+}
+
+gconstpointer gimp_parasite_data(const GimpParasite *parasite)
+{
+    return parasite->data;
+}
+
+glong gimp_parasite_data_size(const GimpParasite *parasite)
+{
+    return parasite->size;
+}
+
+/*----- Channels and pixels -------------------------------------------------*/
+
+gint32 gimp_channel_new(gint32 image_ID, const gchar *name, gint width,
+                        gint height, gdouble opacity, const GimpRGB *color)
+{
+    pdb_call();
+    if (!stub_image(image_ID))
+        return -1;
+    g_return_val_if_fail(width > 0 && height > 0, -1);
+    return stub_item_new(STUB_CHANNEL, image_ID, name, width, height);
+}
+
+GimpDrawable *gimp_drawable_get(gint32 drawable_ID)
+{
+    GimpDrawable *drawable;
+    StubItem     *channel;
+
+    pdb_call();
+    channel = stub_item(drawable_ID, STUB_CHANNEL);
+    if (!channel)
+        return NULL;
+    drawable = g_new0(GimpDrawable, 1);
+    drawable->drawable_id = drawable_ID;
+    drawable->width = channel->width;
+    drawable->height = channel->height;
+    drawable->bpp = 1;
+    return drawable;
+}
+
+void gimp_drawable_detach(GimpDrawable *drawable)
+{
+    g_free(drawable);
+}
+
+void gimp_drawable_flush(GimpDrawable *drawable)
+{
+}
+
+gboolean gimp_drawable_update(gint32 drawable_ID, gint x, gint y, gint width,
+                              gint height)
+{
+    pdb_call();
+    return (stub_item(drawable_ID, STUB_CHANNEL) != NULL);
+}
+
+void gimp_pixel_rgn_init(GimpPixelRgn *pr, GimpDrawable *drawable, gint x,
+                         gint y, gint width, gint height, gint dirty,
+                         gint shadow)
+{
+    memset(pr, 0, sizeof(GimpPixelRgn));
+    pr->drawable = drawable;
+    pr->bpp = drawable->bpp;
+    pr->rowstride = width * drawable->bpp;
+    pr->x = x;
+    pr->y = y;
+    pr->w = width;
+    pr->h = height;
+    pr->dirty = dirty;
+    pr->shadow = shadow;
+}
+
+/*-----------------------------------------------------------------------------
+ *  stub_pixels  --  the pixels of a region's drawable, if x, y, width,
+ *                   height lies within the drawable
+ *-----------------------------------------------------------------------------
+ */
+static guint8 *stub_pixels(GimpPixelRgn *pr, gint x, gint y, gint width,
+                           gint height)
+{
+    StubItem *channel;
+
+    channel = stub_item(pr->drawable->drawable_id, STUB_CHANNEL);
+    if (!channel)
+        return NULL;
+    g_return_val_if_fail(x >= 0 && y >= 0 && width >= 0 && height >= 0 &&
+                         x + width <= channel->width &&
+                         y + height <= channel->height, NULL);
+    return channel->pixels;
+}
+
+void gimp_pixel_rgn_get_pixel(GimpPixelRgn *pr, guchar *buf, gint x, gint y)
+{
+    guint8 *pixels = stub_pixels(pr, x, y, 1, 1);
+
+    if (pixels)
+        buf[0] = pixels[y * pr->drawable->width + x];
+}
+
+void gimp_pixel_rgn_get_rect(GimpPixelRgn *pr, guchar *buf, gint x, gint y,
+                             gint width, gint height)
+{
+    guint8 *pixels = stub_pixels(pr, x, y, width, height);
+    gint    row;
+
+    for (row = 0; pixels && row < height; row++)
+        memcpy(buf + row * width,
+               pixels + (y + row) * pr->drawable->width + x, width);
+}
+
+void gimp_pixel_rgn_set_rect(GimpPixelRgn *pr, const guchar *buf, gint x,
+                             gint y, gint width, gint height)
+{
+    guint8 *pixels = stub_pixels(pr, x, y, width, height);
+    gint    row;
+
+    g_return_if_fail(pr->dirty);
+    for (row = 0; pixels && row < height; row++)
+        memcpy(pixels + (y + row) * pr->drawable->width + x,
+               buf + row * width, width);
+}
+
+void gimp_tile_cache_ntiles(gulong ntiles)
+{
+}
+
+guint gimp_tile_width(void)
+{
+    return 64;
+}
+
+guint gimp_tile_height(void)
+{
+    return 64;
+}
+
+/*----- User interface ------------------------------------------------------*/
+
+static GtkWidget *stub_widget(void)
+{
+    GtkDialog *widget;
+
+    stub_init();
+    widget = g_new0(GtkDialog, 1);
+    g_ptr_array_add(widgets, widget);
+    return (GtkWidget *) widget;
+}
+
+gulong g_signal_connect_data(gpointer instance, const gchar *detailed_signal,
+                             GCallback c_handler, gpointer data,
+                             gpointer destroy_data, gint connect_flags)
+{
+    return 1;
+}
+
+void gimp_ui_init(const gchar *prog_name, gboolean preview)
+{
+}
+
+GtkWidget *gimp_dialog_new(const gchar *title, const gchar *role,
+                           GtkWidget *parent, gint flags,
+                           GimpHelpFunc help_func, const gchar *help_id, ...)
+{
+    GtkWidget *dialog = stub_widget();
+
+    GTK_DIALOG(dialog)->vbox = stub_widget();
+    return dialog;
+}
+
+gint gimp_dialog_run(GimpDialog *dialog)
+{
+    return GTK_RESPONSE_OK;
+}
+
+void gimp_standard_help_func(const gchar *help_id, gpointer help_data)
+{
+}
+
+GtkObject *gimp_scale_entry_new(GtkTable *table, gint column, gint row,
+                                const gchar *text, gint scale_width,
+                                gint spinbutton_width, gdouble value,
+                                gdouble lower, gdouble upper,
+                                gdouble step_increment,
+                                gdouble page_increment, guint digits,
+                                gboolean constrain,
+                                gdouble unconstrained_lower,
+                                gdouble unconstrained_upper,
+                                const gchar *tooltip, const gchar *help_id)
+{
+    return stub_widget();
+}
+
+GtkWidget *gimp_int_combo_box_new(const gchar *first_label, gint first_value,
+                                  ...)
+{
+    return stub_widget();
+}
+
+gboolean gimp_int_combo_box_set_active(GimpIntComboBox *combo_box, gint value)
+{
+    return TRUE;
+}
+
+gboolean gimp_int_combo_box_get_active(GimpIntComboBox *combo_box,
+                                       gint *value)
+{
+    return FALSE;
+}
+
+GtkWidget *gimp_table_attach_aligned(GtkTable *table, gint column, gint row,
+                                     const gchar *label_text, gfloat xalign,
+                                     gfloat yalign, GtkWidget *widget,
+                                     gint colspan, gboolean left_align)
+{
+    return stub_widget();
+}
+
+void gimp_toggle_button_update(GtkWidget *widget, gpointer data)
+{
+}
+
+void gimp_double_adjustment_update(GtkAdjustment *adjustment, gpointer data)
+{
+}
+
+void gtk_dialog_set_alternative_button_order(GtkDialog *dialog,
+                                             gint first_response_id, ...)
+{
+}
+
+void gtk_window_set_resizable(GtkWindow *window, gboolean resizable)
+{
+}
+
+GtkWidget *gtk_vbox_new(gboolean homogeneous, gint spacing)
+{
+    return stub_widget();
+}
+
+GtkWidget *gtk_table_new(guint rows, guint columns, gboolean homogeneous)
+{
+    return stub_widget();
+}
+
+void gtk_table_set_col_spacings(GtkTable *table, guint spacing)
+{
+}
+
+void gtk_table_set_row_spacings(GtkTable *table, guint spacing)
+{
+}
+
+void gtk_table_set_row_spacing(GtkTable *table, guint row, guint spacing)
+{
+}
+
+void gtk_container_set_border_width(GtkContainer *container,
+                                    guint border_width)
+{
+}
+
+void gtk_container_add(GtkContainer *container, GtkWidget *widget)
+{
+}
+
+void gtk_box_pack_start(GtkBox *box, GtkWidget *child, gboolean expand,
+                        gboolean fill, guint padding)
+{
+}
+
+GtkWidget *gtk_check_button_new_with_mnemonic(const gchar *label)
+{
+    return stub_widget();
+}
+
+void gtk_toggle_button_set_active(GtkToggleButton *toggle_button,
+                                  gboolean is_active)
+{
+}
+
+GtkWidget *gtk_label_new(const gchar *str)
+{
+    return stub_widget();
+}
+
+void gtk_label_set_text(GtkLabel *label, const gchar *str)
+{
+}
+
+void gtk_misc_set_alignment(GtkMisc *misc, gfloat xalign, gfloat yalign)
+{
+}
+
+GtkWidget *gtk_drawing_area_new(void)
+{
+    return stub_widget();
+}
+
+void gtk_widget_set_size_request(GtkWidget *widget, gint width, gint height)
+{
+}
+
+void gtk_widget_show(GtkWidget *widget)
+{
+}
+
+void gtk_widget_queue_draw(GtkWidget *widget)
+{
+}
+
+void gtk_widget_destroy(GtkWidget *widget)
+{
+}
+
+cairo_t *gdk_cairo_create(GdkWindow *drawable)
+{
+    return NULL;
+}
+
+void gdk_cairo_set_source_color(cairo_t *cr, const GdkColor *color)
+{
+}
+
+void cairo_rectangle(cairo_t *cr, double x, double y, double width,
+                     double height)
+{
+}
+
+void cairo_fill(cairo_t *cr)
+{
+}
+
+void cairo_destroy(cairo_t *cr)
+{
+}
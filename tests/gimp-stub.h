@@ -0,0 +1,39 @@
+/*
+ *      gimp-stub.h - controls of the headless libgimp stand-in that go
+ *                    beyond what GIMP itself offers
+ *
+ *      Copyright 2026 agent
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ *      This program is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *
+ *      You should have received a copy of the GNU General Public License
+ *      along with this program; if not, write to the Free Software
+ *      Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ *      MA 02110-1301, USA.
+ */
+
+#ifndef __GIMP_STUB_H__
+#define __GIMP_STUB_H__
+
+#include <libgimp/gimp.h>
+
+/* Forgets every image, path, channel, stored setting and file in the
+ * GIMP directory, and resets the call count and latency */
+void  gimp_stub_reset(void);
+
+/* Makes every call that would be a PDB round trip in GIMP wait this many
+ * microseconds, to model the cost of talking to the core */
+void  gimp_stub_set_latency(gulong usec);
+
+/* PDB calls made since the last reset */
+guint gimp_stub_calls(void);
+
+#endif
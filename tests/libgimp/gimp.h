@@ -0,0 +1,362 @@
+/*
+ *      gimp.h - headless stand-in for the parts of libgimp 2.8 that the
+ *               Smooth Path plugin uses, so that it can be built and run
+ *               without GIMP; see gimp-stub.c
+ *
+ *      Copyright 2026 agent
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ *      This program is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *
+ *      You should have received a copy of the GNU General Public License
+ *      along with this program; if not, write to the Free Software
+ *      Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ *      MA 02110-1301, USA.
+ */
+
+#ifndef __GIMP_STUB_GIMP_H__
+#define __GIMP_STUB_GIMP_H__
+
+#include <glib.h>
+
+/* The declarations below follow libgimp 2.8, so the plugin takes its
+ * GIMP 2 code path */
+#define GIMP_MAJOR_VERSION 2
+#define GIMP_MINOR_VERSION 8
+#define GIMP_MICRO_VERSION 0
+
+#define GIMP_CHECK_VERSION(major, minor, micro) \
+    (GIMP_MAJOR_VERSION > (major) || \
+     (GIMP_MAJOR_VERSION == (major) && GIMP_MINOR_VERSION > (minor)) || \
+     (GIMP_MAJOR_VERSION == (major) && GIMP_MINOR_VERSION == (minor) && \
+      GIMP_MICRO_VERSION >= (micro)))
+
+typedef enum
+{
+    GIMP_PDB_INT32,
+    GIMP_PDB_INT16,
+    GIMP_PDB_INT8,
+    GIMP_PDB_FLOAT,
+    GIMP_PDB_STRING,
+    GIMP_PDB_INT32ARRAY,
+    GIMP_PDB_INT16ARRAY,
+    GIMP_PDB_INT8ARRAY,
+    GIMP_PDB_FLOATARRAY,
+    GIMP_PDB_STRINGARRAY,
+    GIMP_PDB_COLOR,
+    GIMP_PDB_ITEM,
+    GIMP_PDB_DISPLAY,
+    GIMP_PDB_IMAGE,
+    GIMP_PDB_LAYER,
+    GIMP_PDB_CHANNEL,
+    GIMP_PDB_DRAWABLE,
+    GIMP_PDB_SELECTION,
+    GIMP_PDB_COLORARRAY,
+    GIMP_PDB_VECTORS,
+    GIMP_PDB_PARASITE,
+    GIMP_PDB_STATUS
+} GimpPDBArgType;
+
+typedef enum
+{
+    GIMP_PDB_EXECUTION_ERROR,
+    GIMP_PDB_CALLING_ERROR,
+    GIMP_PDB_PASS_THROUGH,
+    GIMP_PDB_SUCCESS,
+    GIMP_PDB_CANCEL
+} GimpPDBStatusType;
+
+typedef enum
+{
+    GIMP_RUN_INTERACTIVE,
+    GIMP_RUN_NONINTERACTIVE,
+    GIMP_RUN_WITH_LAST_VALS
+} GimpRunMode;
+
+typedef enum
+{
+    GIMP_INTERNAL,
+    GIMP_PLUGIN,
+    GIMP_EXTENSION,
+    GIMP_TEMPORARY
+} GimpPDBProcType;
+
+typedef enum
+{
+    GIMP_RGB,
+    GIMP_GRAY,
+    GIMP_INDEXED
+} GimpImageBaseType;
+
+typedef enum
+{
+    GIMP_CHANNEL_OP_ADD,
+    GIMP_CHANNEL_OP_SUBTRACT,
+    GIMP_CHANNEL_OP_REPLACE,
+    GIMP_CHANNEL_OP_INTERSECT
+} GimpChannelOps;
+
+typedef enum
+{
+    GIMP_VECTORS_STROKE_TYPE_BEZIER
+} GimpVectorsStrokeType;
+
+#define GIMP_PARASITE_PERSISTENT 1
+#define GIMP_PARASITE_UNDOABLE   2
+
+typedef struct
+{
+    gchar    *name;
+    guint32   flags;
+    guint32   size;
+    gpointer  data;
+} GimpParasite;
+
+typedef struct
+{
+    gdouble r, g, b, a;
+} GimpRGB;
+
+typedef union
+{
+    gint32             d_int32;
+    gint16             d_int16;
+    guint8             d_int8;
+    gdouble            d_float;
+    gchar             *d_string;
+    gint32            *d_int32array;
+    gint16            *d_int16array;
+    guint8            *d_int8array;
+    gdouble           *d_floatarray;
+    gchar            **d_stringarray;
+    GimpRGB            d_color;
+    gint32             d_display;
+    gint32             d_image;
+    gint32             d_item;
+    gint32             d_layer;
+    gint32             d_channel;
+    gint32             d_drawable;
+    gint32             d_selection;
+    gint32             d_vectors;
+    GimpParasite       d_parasite;
+    GimpPDBStatusType  d_status;
+} GimpParamData;
+
+typedef struct
+{
+    GimpPDBArgType type;
+    GimpParamData  data;
+} GimpParam;
+
+typedef struct
+{
+    GimpPDBArgType  type;
+    gchar          *name;
+    gchar          *description;
+} GimpParamDef;
+
+typedef void (*GimpInitProc)  (void);
+typedef void (*GimpQuitProc)  (void);
+typedef void (*GimpQueryProc) (void);
+typedef void (*GimpRunProc)   (const gchar      *name,
+                               gint              nparams,
+                               const GimpParam  *param,
+                               gint             *nreturn_vals,
+                               GimpParam       **return_vals);
+
+typedef struct
+{
+    GimpInitProc  init_proc;
+    GimpQuitProc  quit_proc;
+    GimpQueryProc query_proc;
+    GimpRunProc   run_proc;
+} GimpPlugInInfo;
+
+/* The tests call PLUG_IN_INFO themselves, so there is no main() to add */
+#define MAIN()
+
+typedef struct
+{
+    gint32 drawable_id;
+    guint  width;
+    guint  height;
+    guint  bpp;
+} GimpDrawable;
+
+typedef struct
+{
+    guchar       *data;
+    GimpDrawable *drawable;
+    gint          bpp;
+    gint          rowstride;
+    gint          x, y;
+    gint          w, h;
+    guint         dirty : 1;
+    guint         shadow : 1;
+    gint          process_count;
+} GimpPixelRgn;
+
+/* Procedures */
+void      gimp_install_procedure          (const gchar        *name,
+                                           const gchar        *blurb,
+                                           const gchar        *help,
+                                           const gchar        *author,
+                                           const gchar        *copyright,
+                                           const gchar        *date,
+                                           const gchar        *menu_label,
+                                           const gchar        *image_types,
+                                           GimpPDBProcType     type,
+                                           gint                n_params,
+                                           gint                n_return_vals,
+                                           const GimpParamDef *params,
+                                           const GimpParamDef *return_vals);
+gboolean  gimp_plugin_menu_register       (const gchar        *procedure_name,
+                                           const gchar        *menu_path);
+gboolean  gimp_get_data                   (const gchar        *identifier,
+                                           gpointer            data);
+gint      gimp_get_data_size              (const gchar        *identifier);
+gboolean  gimp_set_data                   (const gchar        *identifier,
+                                           gconstpointer       data,
+                                           guint32             bytes);
+gboolean  gimp_displays_flush             (void);
+const gchar *gimp_directory               (void);
+
+/* Images */
+gint32    gimp_image_new                  (gint                width,
+                                           gint                height,
+                                           GimpImageBaseType   type);
+gboolean  gimp_image_delete               (gint32              image_ID);
+gint      gimp_image_width                (gint32              image_ID);
+gint      gimp_image_height               (gint32              image_ID);
+gboolean  gimp_image_undo_group_start     (gint32              image_ID);
+gboolean  gimp_image_undo_group_end       (gint32              image_ID);
+gint     *gimp_image_get_vectors          (gint32              image_ID,
+                                           gint               *num_vectors);
+gint     *gimp_image_get_channels         (gint32              image_ID,
+                                           gint               *num_channels);
+gboolean  gimp_image_add_vectors          (gint32              image_ID,
+                                           gint32              vectors_ID,
+                                           gint                position);
+gboolean  gimp_image_remove_vectors       (gint32              image_ID,
+                                           gint32              vectors_ID);
+gint      gimp_image_get_vectors_position (gint32              image_ID,
+                                           gint32              vectors_ID);
+gboolean  gimp_image_reorder_item         (gint32              image_ID,
+                                           gint32              item_ID,
+                                           gint32              parent_ID,
+                                           gint                position);
+gboolean  gimp_image_add_channel          (gint32              image_ID,
+                                           gint32              channel_ID,
+                                           gint                position);
+gint32    gimp_image_get_selection        (gint32              image_ID);
+gboolean  gimp_image_select_rectangle     (gint32              image_ID,
+                                           GimpChannelOps      operation,
+                                           gdouble             x,
+                                           gdouble             y,
+                                           gdouble             width,
+                                           gdouble             height);
+gboolean  gimp_selection_bounds           (gint32              image_ID,
+                                           gboolean           *non_empty,
+                                           gint               *x1,
+                                           gint               *y1,
+                                           gint               *x2,
+                                           gint               *y2);
+
+/* Vectors */
+gint32    gimp_vectors_new                (gint32              image_ID,
+                                           const gchar        *name);
+gchar    *gimp_vectors_get_name           (gint32              vectors_ID);
+gboolean  gimp_vectors_set_name           (gint32              vectors_ID,
+                                           const gchar        *name);
+gint     *gimp_vectors_get_strokes        (gint32              vectors_ID,
+                                           gint               *num_strokes);
+GimpVectorsStrokeType
+          gimp_vectors_stroke_get_points  (gint32              vectors_ID,
+                                           gint                stroke_id,
+                                           gint               *num_points,
+                                           gdouble           **controlpoints,
+                                           gboolean           *closed);
+gint      gimp_vectors_stroke_new_from_points
+                                          (gint32              vectors_ID,
+                                           GimpVectorsStrokeType type,
+                                           gint                num_points,
+                                           const gdouble      *controlpoints,
+                                           gboolean            closed);
+gboolean  gimp_vectors_import_from_string (gint32              image_ID,
+                                           const gchar        *string,
+                                           gint                length,
+                                           gboolean            merge,
+                                           gboolean            scale,
+                                           gint               *num_vectors,
+                                           gint32            **vectors_ids);
+GimpParasite *
+          gimp_vectors_parasite_find      (gint32              vectors_ID,
+                                           const gchar        *name);
+gboolean  gimp_vectors_parasite_attach    (gint32              vectors_ID,
+                                           const GimpParasite *parasite);
+gboolean  gimp_vectors_parasite_detach    (gint32              vectors_ID,
+                                           const gchar        *name);
+
+/* Parasites, local to the plugin */
+GimpParasite *
+          gimp_parasite_new               (const gchar        *name,
+                                           guint32             flags,
+                                           guint32             size,
+                                           gconstpointer       data);
+void      gimp_parasite_free              (GimpParasite       *parasite);
+gconstpointer
+          gimp_parasite_data              (const GimpParasite *parasite);
+glong     gimp_parasite_data_size         (const GimpParasite *parasite);
+
+/* Channels and pixels */
+gint32    gimp_channel_new                (gint32              image_ID,
+                                           const gchar        *name,
+                                           gint                width,
+                                           gint                height,
+                                           gdouble             opacity,
+                                           const GimpRGB      *color);
+GimpDrawable *
+          gimp_drawable_get               (gint32              drawable_ID);
+void      gimp_drawable_detach            (GimpDrawable       *drawable);
+void      gimp_drawable_flush             (GimpDrawable       *drawable);
+gboolean  gimp_drawable_update            (gint32              drawable_ID,
+                                           gint                x,
+                                           gint                y,
+                                           gint                width,
+                                           gint                height);
+void      gimp_pixel_rgn_init             (GimpPixelRgn       *pr,
+                                           GimpDrawable       *drawable,
+                                           gint                x,
+                                           gint                y,
+                                           gint                width,
+                                           gint                height,
+                                           gint                dirty,
+                                           gint                shadow);
+void      gimp_pixel_rgn_get_pixel        (GimpPixelRgn       *pr,
+                                           guchar             *buf,
+                                           gint                x,
+                                           gint                y);
+void      gimp_pixel_rgn_get_rect         (GimpPixelRgn       *pr,
+                                           guchar             *buf,
+                                           gint                x,
+                                           gint                y,
+                                           gint                width,
+                                           gint                height);
+void      gimp_pixel_rgn_set_rect         (GimpPixelRgn       *pr,
+                                           const guchar       *buf,
+                                           gint                x,
+                                           gint                y,
+                                           gint                width,
+                                           gint                height);
+void      gimp_tile_cache_ntiles          (gulong              ntiles);
+guint     gimp_tile_width                 (void);
+guint     gimp_tile_height                (void);
+
+#endif
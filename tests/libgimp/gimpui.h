@@ -0,0 +1,240 @@
+/*
+ *      gimpui.h - headless stand-in for the parts of libgimpui 2.8, GTK+ 2
+ *                 and GDK that the Smooth Path dialog uses; the widgets do
+ *                 nothing, and the dialog is answered with OK straight away
+ *
+ *      Copyright 2026 agent
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ *      This program is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *
+ *      You should have received a copy of the GNU General Public License
+ *      along with this program; if not, write to the Free Software
+ *      Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ *      MA 02110-1301, USA.
+ */
+
+#ifndef __GIMP_STUB_GIMPUI_H__
+#define __GIMP_STUB_GIMPUI_H__
+
+#include "gimp.h"
+
+typedef void (*GCallback) (void);
+#define G_CALLBACK(f) ((GCallback) (f))
+
+gulong g_signal_connect_data(gpointer       instance,
+                             const gchar   *detailed_signal,
+                             GCallback      c_handler,
+                             gpointer       data,
+                             gpointer       destroy_data,
+                             gint           connect_flags);
+#define g_signal_connect(instance, detailed_signal, c_handler, data) \
+    g_signal_connect_data((instance), (detailed_signal), (c_handler), \
+                          (data), NULL, 0)
+
+typedef struct _GdkWindow GdkWindow;
+typedef struct _cairo     cairo_t;
+
+typedef struct
+{
+    guint32 pixel;
+    guint16 red;
+    guint16 green;
+    guint16 blue;
+} GdkColor;
+
+typedef struct
+{
+    gint type;
+} GdkEventExpose;
+
+typedef struct
+{
+    gint x, y;
+    gint width, height;
+} GtkAllocation;
+
+typedef enum
+{
+    GTK_STATE_NORMAL,
+    GTK_STATE_ACTIVE,
+    GTK_STATE_PRELIGHT,
+    GTK_STATE_SELECTED,
+    GTK_STATE_INSENSITIVE
+} GtkStateType;
+
+typedef struct
+{
+    GdkColor fg[5];
+    GdkColor bg[5];
+    GdkColor light[5];
+    GdkColor dark[5];
+    GdkColor mid[5];
+    GdkColor text[5];
+    GdkColor base[5];
+} GtkStyle;
+
+typedef struct _GtkWidget GtkWidget;
+
+struct _GtkWidget
+{
+    GdkWindow     *window;
+    GtkAllocation  allocation;
+    GtkStyle      *style;
+};
+
+/* Every widget is a dialog underneath, so any of them can be cast to one */
+typedef struct
+{
+    GtkWidget  widget;
+    GtkWidget *vbox;
+} GtkDialog;
+
+typedef GtkWidget GtkWindow;
+typedef GtkWidget GtkContainer;
+typedef GtkWidget GtkBox;
+typedef GtkWidget GtkTable;
+typedef GtkWidget GtkToggleButton;
+typedef GtkWidget GtkLabel;
+typedef GtkWidget GtkMisc;
+typedef GtkWidget GimpDialog;
+typedef GtkWidget GimpIntComboBox;
+typedef GtkWidget GtkObject;
+typedef GtkWidget GtkAdjustment;
+
+#define GTK_DIALOG(w)         ((GtkDialog *) (w))
+#define GTK_WINDOW(w)         ((GtkWindow *) (w))
+#define GTK_CONTAINER(w)      ((GtkContainer *) (w))
+#define GTK_BOX(w)            ((GtkBox *) (w))
+#define GTK_TABLE(w)          ((GtkTable *) (w))
+#define GTK_TOGGLE_BUTTON(w)  ((GtkToggleButton *) (w))
+#define GTK_LABEL(w)          ((GtkLabel *) (w))
+#define GTK_MISC(w)           ((GtkMisc *) (w))
+#define GIMP_DIALOG(w)        ((GimpDialog *) (w))
+#define GIMP_INT_COMBO_BOX(w) ((GimpIntComboBox *) (w))
+
+typedef enum
+{
+    GTK_RESPONSE_OK     = -5,
+    GTK_RESPONSE_CANCEL = -6
+} GtkResponseType;
+
+#define GTK_STOCK_CANCEL "gtk-cancel"
+#define GTK_STOCK_OK     "gtk-ok"
+
+typedef void (*GimpHelpFunc) (const gchar *help_id, gpointer help_data);
+
+void       gimp_ui_init                    (const gchar     *prog_name,
+                                            gboolean         preview);
+GtkWidget *gimp_dialog_new                 (const gchar     *title,
+                                            const gchar     *role,
+                                            GtkWidget       *parent,
+                                            gint             flags,
+                                            GimpHelpFunc     help_func,
+                                            const gchar     *help_id,
+                                            ...);
+gint       gimp_dialog_run                 (GimpDialog      *dialog);
+void       gimp_standard_help_func         (const gchar     *help_id,
+                                            gpointer         help_data);
+GtkObject *gimp_scale_entry_new            (GtkTable        *table,
+                                            gint             column,
+                                            gint             row,
+                                            const gchar     *text,
+                                            gint             scale_width,
+                                            gint             spinbutton_width,
+                                            gdouble          value,
+                                            gdouble          lower,
+                                            gdouble          upper,
+                                            gdouble          step_increment,
+                                            gdouble          page_increment,
+                                            guint            digits,
+                                            gboolean         constrain,
+                                            gdouble          unconstrained_lower,
+                                            gdouble          unconstrained_upper,
+                                            const gchar     *tooltip,
+                                            const gchar     *help_id);
+GtkWidget *gimp_int_combo_box_new          (const gchar     *first_label,
+                                            gint             first_value,
+                                            ...);
+gboolean   gimp_int_combo_box_set_active   (GimpIntComboBox *combo_box,
+                                            gint             value);
+gboolean   gimp_int_combo_box_get_active   (GimpIntComboBox *combo_box,
+                                            gint            *value);
+GtkWidget *gimp_table_attach_aligned       (GtkTable        *table,
+                                            gint             column,
+                                            gint             row,
+                                            const gchar     *label_text,
+                                            gfloat           xalign,
+                                            gfloat           yalign,
+                                            GtkWidget       *widget,
+                                            gint             colspan,
+                                            gboolean         left_align);
+void       gimp_toggle_button_update       (GtkWidget       *widget,
+                                            gpointer         data);
+void       gimp_double_adjustment_update   (GtkAdjustment   *adjustment,
+                                            gpointer         data);
+
+void       gtk_dialog_set_alternative_button_order
+                                           (GtkDialog       *dialog,
+                                            gint             first_response_id,
+                                            ...);
+void       gtk_window_set_resizable        (GtkWindow       *window,
+                                            gboolean         resizable);
+GtkWidget *gtk_vbox_new                    (gboolean         homogeneous,
+                                            gint             spacing);
+GtkWidget *gtk_table_new                   (guint            rows,
+                                            guint            columns,
+                                            gboolean         homogeneous);
+void       gtk_table_set_col_spacings      (GtkTable        *table,
+                                            guint            spacing);
+void       gtk_table_set_row_spacings      (GtkTable        *table,
+                                            guint            spacing);
+void       gtk_table_set_row_spacing       (GtkTable        *table,
+                                            guint            row,
+                                            guint            spacing);
+void       gtk_container_set_border_width  (GtkContainer    *container,
+                                            guint            border_width);
+void       gtk_container_add               (GtkContainer    *container,
+                                            GtkWidget       *widget);
+void       gtk_box_pack_start              (GtkBox          *box,
+                                            GtkWidget       *child,
+                                            gboolean         expand,
+                                            gboolean         fill,
+                                            guint            padding);
+GtkWidget *gtk_check_button_new_with_mnemonic
+                                           (const gchar     *label);
+void       gtk_toggle_button_set_active    (GtkToggleButton *toggle_button,
+                                            gboolean         is_active);
+GtkWidget *gtk_label_new                   (const gchar     *str);
+void       gtk_label_set_text              (GtkLabel        *label,
+                                            const gchar     *str);
+void       gtk_misc_set_alignment          (GtkMisc         *misc,
+                                            gfloat           xalign,
+                                            gfloat           yalign);
+GtkWidget *gtk_drawing_area_new            (void);
+void       gtk_widget_set_size_request     (GtkWidget       *widget,
+                                            gint             width,
+                                            gint             height);
+void       gtk_widget_show                 (GtkWidget       *widget);
+void       gtk_widget_queue_draw           (GtkWidget       *widget);
+void       gtk_widget_destroy              (GtkWidget       *widget);
+
+cairo_t   *gdk_cairo_create                (GdkWindow       *drawable);
+void       gdk_cairo_set_source_color      (cairo_t         *cr,
+                                            const GdkColor  *color);
+void       cairo_rectangle                 (cairo_t         *cr,
+                                            double           x,
+                                            double           y,
+                                            double           width,
+                                            double           height);
+void       cairo_fill                      (cairo_t         *cr);
+void       cairo_destroy                   (cairo_t         *cr);
+
+#endif
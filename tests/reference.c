@@ -0,0 +1,285 @@
+/*
+ *      reference.c - the smoothing of the first release of Smooth Path,
+ *                    as it was but for taking the control points as an
+ *                    array; the plugin has to give the same result to the
+ *                    last bit
+ *
+ *      Copyright 2009 Marko Peric
+ *      Copyright 2026 agent
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ *      This program is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *
+ *      You should have received a copy of the GNU General Public License
+ *      along with this program; if not, write to the Free Software
+ *      Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ *      MA 02110-1301, USA.
+ */
+
+#include <math.h>
+#include "reference.h"
+
+#define rad_to_deg(angle) ((angle) * 360.0 / (2.0 * G_PI))
+
+static ReferenceVals svals;
+
+/*-----------------------------------------------------------------------------
+ *  angle_between  --  determines the abs(angle) between two vectors formed by
+ *                     the points va, vb, vc (i.e. va-->vb, vb-->vc) in degrees
+ *-----------------------------------------------------------------------------
+ */
+static gboolean angle_between(gdouble vax, gdouble vay, gdouble vbx,
+                              gdouble vby, gdouble vcx, gdouble vcy)
+{
+    gdouble v1x, v1y, v2x, v2y, ret;
+    /* Ugly I know, but laziness comes before beauty */
+    if (!svals.smooth_specified) return -1;
+    v1x = vbx - vax;
+    v1y = vby - vay;
+    v2x = vcx - vbx;
+    v2y = vcy - vby;
+    ret = 180 - ABS(rad_to_deg(atan2(-v1y*v2x + v1x*v2y, v1x*v2x + v1y*v2y)));
+    if (svals.ang_max > svals.ang_min)
+        return (ret < svals.ang_max && ret > svals.ang_min);
+    else
+        return (ret < svals.ang_max || ret > svals.ang_min);
+}
+
+/*-----------------------------------------------------------------------------
+ *  triagonal_solve  --  solves a tridiagonal system of simultaneous equations
+ *-----------------------------------------------------------------------------
+ */
+static void triagonal_solve(GArray *asb, GArray *asd)
+{
+    gdouble x = 1.0;
+    gdouble id;
+    gint i;
+    GArray *asc;
+    asc = g_array_new(FALSE, FALSE, sizeof(gdouble));
+    for (i = 0; i < asb->len; i++)
+        g_array_append_val(asc, x);
+    g_array_index(asc, gdouble, 0) *= 0.25;
+    g_array_index(asd, gdouble, 0) *= 0.25;
+    for (i = 1; i < asb->len; i++) {
+        id = 4.0 - g_array_index(asc, gdouble, i - 1);
+        g_array_index(asc, gdouble, i) /= id;
+        g_array_index(asd, gdouble, i) = (g_array_index(asd, gdouble, i) -
+                                      g_array_index(asd, gdouble, i - 1)) / id;
+    }
+    g_array_index(asb, gdouble, asb->len - 1) = g_array_index(asd, gdouble,
+                                                           asb->len - 1);
+    for (i = asb->len - 2; i >= 0; i--)
+        g_array_index(asb, gdouble, i) = g_array_index(asd, gdouble, i) -
+                                      g_array_index(asc, gdouble, i) *
+                                      g_array_index(asb, gdouble, i + 1);
+    g_array_free(asc, TRUE);
+}
+
+/*-----------------------------------------------------------------------------
+ *  reference_smooth_stroke  --  set_bezier_path, taking the control points
+ *                               of a stroke and smoothing them in place
+ *                               instead of going through GIMP
+ *-----------------------------------------------------------------------------
+ */
+void reference_smooth_stroke(const ReferenceVals *vals, gdouble *ctlpts,
+                             gint num_points, gboolean closed)
+{
+    GArray *asd;
+    GArray *asb;
+    GArray *acx;
+    GArray *acy;
+    GArray *aconx1;
+    GArray *aconx2;
+    GArray *acony1;
+    GArray *acony2;
+    gint n, len;
+    gdouble hx, hy;
+
+    svals = *vals;
+
+    /* Must have at least 3 anchor points, i.e. 18 array entries */
+    if (num_points < 18)
+        return;
+
+    /* Look how many arrays we create, very wasteful! */
+    asd = g_array_new(FALSE, TRUE, sizeof(gdouble));
+    asb = g_array_new(FALSE, TRUE, sizeof(gdouble));
+    acx = g_array_new(FALSE, TRUE, sizeof(gdouble));
+    acy = g_array_new(FALSE, TRUE, sizeof(gdouble));
+    aconx1 = g_array_new(FALSE, TRUE, sizeof(gdouble));
+    aconx2 = g_array_new(FALSE, TRUE, sizeof(gdouble));
+    acony1 = g_array_new(FALSE, TRUE, sizeof(gdouble));
+    acony2 = g_array_new(FALSE, TRUE, sizeof(gdouble));
+
+    /* Initialise anchor point array */
+    len = num_points / 6;
+    g_array_set_size(acx, len);
+    g_array_set_size(acy, len);
+    for (n = 0; n < acx->len; n++) {
+        g_array_index(acx, gdouble, n) = ctlpts[n * 6 + 2];
+        g_array_index(acy, gdouble, n) = ctlpts[n * 6 + 3];
+    }
+
+    /* Prepend last point, and append first two points if closed */
+    if (closed) {
+        g_array_prepend_val(acx, ctlpts[num_points - 4]);
+        g_array_prepend_val(acy, ctlpts[num_points - 3]);
+        g_array_append_val(acx, ctlpts[2]);
+        g_array_append_val(acy, ctlpts[3]);
+        g_array_append_val(acx, ctlpts[8]);
+        g_array_append_val(acy, ctlpts[9]);
+    }
+
+    /* First for x */
+    g_array_set_size(asd, acx->len - 2);
+    g_array_set_size(asb, acx->len - 2);
+    if (asd->len == 1) {
+        g_array_index(asb, gdouble, 0) = 1.50 * g_array_index(acx, gdouble, 1)
+                                    - 0.25 * g_array_index(acx, gdouble, 0)
+                                    - 0.25 * g_array_index(acx, gdouble, 2);
+    } else {
+        g_array_index(asd, gdouble, 0) = 6 * g_array_index(acx, gdouble, 1) -
+                                       g_array_index(acx, gdouble, 0);
+        for (n = 1; n < acx->len - 3; n++)
+            g_array_index(asd, gdouble, n) = 6 * g_array_index(acx, gdouble,
+                                                               n + 1);
+        g_array_index(asd, gdouble, acx->len - 3)
+                = 6 * g_array_index(acx, gdouble, acx->len - 2) -
+                  g_array_index(acx, gdouble, acx->len - 1);
+        triagonal_solve(asb, asd);
+    }
+    g_array_prepend_val(asb, g_array_index(acx, gdouble, 0));
+    g_array_append_val(asb, g_array_index(acx, gdouble, acx->len - 1));
+
+    /* These will hold the interior control points, for x */
+    for (n = 1; n < acx->len; n++) {
+        hx = 2 * g_array_index(asb, gdouble, n - 1) / 3 +
+             g_array_index(asb, gdouble, n) / 3;
+        g_array_append_val(aconx1, hx);
+        hx = g_array_index(asb, gdouble, n - 1) / 3 +
+             2 * g_array_index(asb, gdouble, n) / 3;
+        g_array_append_val(aconx2, hx);
+    }
+
+    /* Now for y */
+    g_array_set_size(asd, acy->len - 2);
+    g_array_set_size(asb, acy->len - 2);
+    if (asd->len == 1) {
+        g_array_index(asb, gdouble, 0) = 1.50 * g_array_index(acy, gdouble, 1)
+                                    - 0.25 * g_array_index(acy, gdouble, 0)
+                                    - 0.25 * g_array_index(acy, gdouble, 2);
+    } else {
+        g_array_index(asd, gdouble, 0) = 6 * g_array_index(acy, gdouble, 1) -
+                                       g_array_index(acy, gdouble, 0);
+        for (n = 1; n < acy->len - 3; n++)
+            g_array_index(asd, gdouble, n) = 6 * g_array_index(acy, gdouble,
+                                                               n + 1);
+        g_array_index(asd, gdouble, acy->len - 3)
+                = 6 * g_array_index(acy, gdouble, acy->len - 2) -
+                  g_array_index(acy, gdouble, acy->len - 1);
+        triagonal_solve(asb, asd);
+    }
+    g_array_prepend_val(asb, g_array_index(acy, gdouble, 0));
+    g_array_append_val(asb, g_array_index(acy, gdouble, acy->len - 1));
+
+    /* These will hold the interior control points, for y */
+    for (n = 1; n < acy->len; n++) {
+        hy = 2 * g_array_index(asb, gdouble, n - 1) / 3 +
+             g_array_index(asb, gdouble, n) / 3;
+        g_array_append_val(acony1, hy);
+        hy = g_array_index(asb, gdouble, n - 1) / 3 +
+             2 * g_array_index(asb, gdouble, n) / 3;
+        g_array_append_val(acony2, hy);
+    }
+
+    /* Remove first two and last two control points if closed */
+    if (closed) {
+        g_array_remove_index(aconx1, aconx1->len - 1);
+        g_array_remove_index(aconx1, 0);
+        g_array_remove_index(aconx2, aconx2->len - 1);
+        g_array_remove_index(aconx2, 0);
+        g_array_remove_index(acony1, acony1->len - 1);
+        g_array_remove_index(acony1, 0);
+        g_array_remove_index(acony2, acony2->len - 1);
+        g_array_remove_index(acony2, 0);
+    }
+
+    /* Now update our original ctlpts array */
+    /* First two points are last aconx,y2 if closed, otherwise stay the same */
+    if (closed) {
+        if (angle_between(ctlpts[num_points-4], ctlpts[num_points-3],
+                          ctlpts[2], ctlpts[3], ctlpts[8], ctlpts[9])) {
+            ctlpts[0] = g_array_index(aconx2, gdouble, aconx2->len - 1);
+            ctlpts[1] = g_array_index(acony2, gdouble, acony2->len - 1);
+        }
+    }
+    /* The interior points */
+    for (n = 0; n < len - 1; n++) {
+        if (n == 0) {
+            if (closed && angle_between(ctlpts[num_points-4],
+                                        ctlpts[num_points-3],
+                                        ctlpts[2], ctlpts[3],
+                                        ctlpts[8], ctlpts[9])) {
+                ctlpts[n * 6 + 4] = g_array_index(aconx1, gdouble, n);
+                ctlpts[n * 6 + 5] = g_array_index(acony1, gdouble, n);
+            } else if (!closed && !svals.smooth_specified) {
+                ctlpts[n * 6 + 4] = g_array_index(aconx1, gdouble, n);
+                ctlpts[n * 6 + 5] = g_array_index(acony1, gdouble, n);
+            }
+        } else {
+            if (angle_between(ctlpts[n * 6 - 4], ctlpts[n * 6 - 3],
+                              ctlpts[n * 6 + 2], ctlpts[n * 6 + 3],
+                              ctlpts[n * 6 + 8], ctlpts[n * 6 + 9])) {
+                ctlpts[n * 6 + 4] = g_array_index(aconx1, gdouble, n);
+                ctlpts[n * 6 + 5] = g_array_index(acony1, gdouble, n);
+            }
+        }
+        if (n == len - 2) {
+            if (closed && angle_between(ctlpts[num_points-10],
+                                        ctlpts[num_points-9],
+                                        ctlpts[num_points-4],
+                                        ctlpts[num_points-3],
+                                        ctlpts[2], ctlpts[3])) {
+                ctlpts[n * 6 + 6] = g_array_index(aconx2, gdouble, n);
+                ctlpts[n * 6 + 7] = g_array_index(acony2, gdouble, n);
+            } else if (!closed && !svals.smooth_specified) {
+                ctlpts[n * 6 + 6] = g_array_index(aconx2, gdouble, n);
+                ctlpts[n * 6 + 7] = g_array_index(acony2, gdouble, n);
+            }
+        } else {
+            if (angle_between(ctlpts[n * 6 + 2], ctlpts[n * 6 + 3],
+                              ctlpts[n * 6 + 8], ctlpts[n * 6 + 9],
+                              ctlpts[n * 6 + 14], ctlpts[n * 6 + 15])) {
+                ctlpts[n * 6 + 6] = g_array_index(aconx2, gdouble, n);
+                ctlpts[n * 6 + 7] = g_array_index(acony2, gdouble, n);
+            }
+        }
+    }
+    /* Last two points are last aconx,y1 if closed, otherwise stay the same */
+    if (closed) {
+        if (angle_between(ctlpts[num_points-10], ctlpts[num_points-9],
+                          ctlpts[num_points-4], ctlpts[num_points-3],
+                          ctlpts[2], ctlpts[3])) {
+            ctlpts[num_points-2] = g_array_index(aconx1, gdouble,
+                                                 aconx1->len - 1);
+            ctlpts[num_points-1] = g_array_index(acony1, gdouble,
+                                                 acony1->len - 1);
+        }
+    }
+
+    g_array_free(asd, TRUE);
+    g_array_free(asb, TRUE);
+    g_array_free(acx, TRUE);
+    g_array_free(acy, TRUE);
+    g_array_free(aconx1, TRUE);
+    g_array_free(aconx2, TRUE);
+    g_array_free(acony1, TRUE);
+    g_array_free(acony2, TRUE);
+}
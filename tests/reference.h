@@ -0,0 +1,41 @@
+/*
+ *      reference.h - the smoothing of the first release of Smooth Path, kept
+ *                    as it was to check the plugin against
+ *
+ *      Copyright 2026 agent
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ *      This program is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *
+ *      You should have received a copy of the GNU General Public License
+ *      along with this program; if not, write to the Free Software
+ *      Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ *      MA 02110-1301, USA.
+ */
+
+#ifndef __REFERENCE_H__
+#define __REFERENCE_H__
+
+#include <glib.h>
+
+/* The settings the first release had */
+typedef struct
+{
+    gint32   smooth_specified;
+    gdouble  ang_min;
+    gdouble  ang_max;
+} ReferenceVals;
+
+/* Smooths the num_points control points of a stroke in place, the way
+ * set_bezier_path did */
+void reference_smooth_stroke(const ReferenceVals *vals, gdouble *ctlpts,
+                             gint num_points, gboolean closed);
+
+#endif
@@ -0,0 +1,722 @@
+/*
+ *      test-plugin.c - tests of whole runs of the Smooth Path procedures,
+ *                      made through run() as GIMP would make them, against
+ *                      the headless libgimp stand-in
+ *
+ *      Copyright 2026 agent
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ *      This program is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *
+ *      You should have received a copy of the GNU General Public License
+ *      along with this program; if not, write to the Free Software
+ *      Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ *      MA 02110-1301, USA.
+ */
+
+#include "../smooth-path.c"
+#include "gimp-stub.h"
+#include "reference.h"
+
+/*-----------------------------------------------------------------------------
+ *  test_run  --  calls procedure name of the plugin with nparams of params,
+ *                whose first is the run mode, and returns its status
+ *-----------------------------------------------------------------------------
+ */
+static GimpPDBStatusType test_run(const gchar *name, gint nparams,
+                                  const GimpParam *params)
+{
+    GimpParam *return_vals;
+    gint       nreturn_vals;
+
+    PLUG_IN_INFO.run_proc(name, nparams, params, &nreturn_vals, &return_vals);
+    g_assert_cmpint(nreturn_vals, ==, 1);
+    g_assert_cmpint(return_vals[0].type, ==, GIMP_PDB_STATUS);
+    return return_vals[0].data.d_status;
+}
+
+/*-----------------------------------------------------------------------------
+ *  smooth_params  --  the arguments of plug-in-smooth-path for image and
+ *                     path, all 14 of them, smoothing every corner as
+ *                     the first release did
+ *-----------------------------------------------------------------------------
+ */
+static void smooth_params(GimpParam *params, gint32 image_id,
+                          gint32 vectors_id)
+{
+    memset(params, 0, 14 * sizeof(GimpParam));
+    params[0].data.d_int32 = GIMP_RUN_NONINTERACTIVE;
+    params[1].data.d_image = image_id;
+    params[2].data.d_vectors = vectors_id;
+    params[3].data.d_int32 = FALSE;
+    params[4].data.d_float = 60;
+    params[5].data.d_float = 120;
+    params[7].data.d_int32 = REGION_ALL;
+    params[9].data.d_int32 = -1;
+    params[10].data.d_int32 = FILL_NONE;
+    params[12].data.d_int32 = JOIN_NONE;
+}
+
+/*-----------------------------------------------------------------------------
+ *  test_path  --  adds a path with the strokes of batch at position in the
+ *                 path stack of image
+ *-----------------------------------------------------------------------------
+ */
+static gint32 test_path(gint32 image_id, const StrokeBatch *batch,
+                        const gchar *name, gint position)
+{
+    gint32 vectors_id;
+    gint   n;
+
+    vectors_id = gimp_vectors_new(image_id, name);
+    for (n = 0; n < stroke_batch_len(batch); n++)
+        gimp_vectors_stroke_new_from_points(vectors_id,
+                                            GIMP_VECTORS_STROKE_TYPE_BEZIER,
+                                            stroke_batch_size(batch, n),
+                                            stroke_batch_points(batch, n),
+                                            stroke_batch_closed(batch, n));
+    g_assert_true(gimp_image_add_vectors(image_id, vectors_id, position));
+    return vectors_id;
+}
+
+/*-----------------------------------------------------------------------------
+ *  path_at  --  the path at position in the path stack of image, which has
+ *               to hold num_paths, read into batch if that isn't NULL
+ *-----------------------------------------------------------------------------
+ */
+static gint32 path_at(gint32 image_id, gint position, gint num_paths,
+                      StrokeBatch *batch)
+{
+    gint32 *paths, vectors_id;
+    gint   *strokes;
+    gint    num, num_strokes;
+
+    paths = gimp_image_get_vectors(image_id, &num);
+    g_assert_cmpint(num, ==, num_paths);
+    vectors_id = paths[position];
+    g_free(paths);
+    if (batch) {
+        stroke_batch_clear(batch);
+        strokes = gimp_vectors_get_strokes(vectors_id, &num_strokes);
+        path_fetch(vectors_id, strokes, num_strokes, batch);
+        g_free(strokes);
+    }
+    return vectors_id;
+}
+
+/*-----------------------------------------------------------------------------
+ *  test_strokes  --  num_strokes random strokes, every other one closed;
+ *                    with ends set, open ones have their outer handles on
+ *                    their anchors, as GIMP draws them and an import can
+ *                    give them back
+ *-----------------------------------------------------------------------------
+ */
+static void test_strokes(GRand *rand, StrokeBatch *batch, gint num_strokes,
+                         gint max_len, gboolean ends)
+{
+    gdouble ctlpts[100 * 6];
+    gint    n, k, len;
+
+    for (n = 0; n < num_strokes; n++) {
+        len = g_rand_int_range(rand, 1, max_len + 1);
+        for (k = 0; k < len * 6; k++)
+            ctlpts[k] = g_rand_double_range(rand, 0, 400);
+        if (ends && n % 2 == 0) {
+            ctlpts[0] = ctlpts[2];
+            ctlpts[1] = ctlpts[3];
+            ctlpts[len * 6 - 2] = ctlpts[len * 6 - 4];
+            ctlpts[len * 6 - 1] = ctlpts[len * 6 - 3];
+        }
+        stroke_batch_add(batch, ctlpts, len * 6, n % 2);
+    }
+}
+
+static void reference_batch(const ReferenceVals *vals, StrokeBatch *batch)
+{
+    gint n;
+
+    for (n = 0; n < stroke_batch_len(batch); n++)
+        reference_smooth_stroke(vals, stroke_batch_points(batch, n),
+                                stroke_batch_size(batch, n),
+                                stroke_batch_closed(batch, n));
+}
+
+static void assert_batch_equal(const StrokeBatch *a, const StrokeBatch *b)
+{
+    g_assert_cmpmem(a->offsets->data, a->offsets->len * sizeof(gint),
+                    b->offsets->data, b->offsets->len * sizeof(gint));
+    g_assert_cmpmem(a->closed->data, a->closed->len * sizeof(gboolean),
+                    b->closed->data, b->closed->len * sizeof(gboolean));
+    g_assert_cmpmem(a->points->data, a->points->len * sizeof(gdouble),
+                    b->points->data, b->points->len * sizeof(gdouble));
+}
+
+/*-----------------------------------------------------------------------------
+ *  test_smooth_revert  --  a path smoothed by the procedure is the one the
+ *                          first release made, in the same place and with
+ *                          the same name; smoothing it again with other
+ *                          settings starts from the original, reverting
+ *                          gives that back exactly, and an edited path
+ *                          can't be reverted
+ *-----------------------------------------------------------------------------
+ */
+static void test_smooth_revert(void)
+{
+    static const ReferenceVals all = { FALSE, 60, 120 };
+    static const ReferenceVals some = { TRUE, 100, 170 };
+    GimpParam    params[14];
+    StrokeBatch  original, expected, result, other;
+    GRand       *rand;
+    gint32       image_id, vectors_id;
+    gchar       *name;
+
+    gimp_stub_reset();
+    rand = g_rand_new_with_seed(55);
+    stroke_batch_init(&original);
+    stroke_batch_init(&expected);
+    stroke_batch_init(&result);
+    stroke_batch_init(&other);
+    test_strokes(rand, &original, 12, 40, FALSE);
+    test_strokes(rand, &other, 2, 5, FALSE);
+
+    image_id = gimp_image_new(400, 400, GIMP_RGB);
+    test_path(image_id, &other, "Above", 0);
+    vectors_id = test_path(image_id, &original, "Traced", 1);
+    test_path(image_id, &other, "Below", 2);
+
+    smooth_params(params, image_id, vectors_id);
+    g_assert_cmpint(test_run(PLUG_IN_PROC, 6, params), ==, GIMP_PDB_SUCCESS);
+    vectors_id = path_at(image_id, 1, 3, &result);
+    name = gimp_vectors_get_name(vectors_id);
+    g_assert_cmpstr(name, ==, "Traced");
+    g_free(name);
+    stroke_batch_copy(&expected, &original);
+    reference_batch(&all, &expected);
+    assert_batch_equal(&result, &expected);
+
+    /* Only the corners in range, from the original rather than from what
+     * the first run left */
+    params[2].data.d_vectors = vectors_id;
+    params[3].data.d_int32 = some.smooth_specified;
+    params[4].data.d_float = some.ang_min;
+    params[5].data.d_float = some.ang_max;
+    g_assert_cmpint(test_run(PLUG_IN_PROC, 6, params), ==, GIMP_PDB_SUCCESS);
+    vectors_id = path_at(image_id, 1, 3, &result);
+    stroke_batch_copy(&expected, &original);
+    reference_batch(&some, &expected);
+    assert_batch_equal(&result, &expected);
+
+    params[2].data.d_vectors = vectors_id;
+    g_assert_cmpint(test_run(REVERT_PROC, 3, params), ==, GIMP_PDB_SUCCESS);
+    vectors_id = path_at(image_id, 1, 3, &result);
+    assert_batch_equal(&result, &original);
+
+    /* A reverted path has nothing to revert, and neither has one that was
+     * edited after smoothing */
+    params[2].data.d_vectors = vectors_id;
+    g_assert_cmpint(test_run(REVERT_PROC, 3, params), ==,
+                    GIMP_PDB_EXECUTION_ERROR);
+    g_assert_cmpint(test_run(PLUG_IN_PROC, 6, params), ==, GIMP_PDB_SUCCESS);
+    vectors_id = path_at(image_id, 1, 3, &result);
+    gimp_vectors_stroke_new_from_points(vectors_id,
+                                        GIMP_VECTORS_STROKE_TYPE_BEZIER,
+                                        stroke_batch_size(&other, 0),
+                                        stroke_batch_points(&other, 0),
+                                        FALSE);
+    params[2].data.d_vectors = vectors_id;
+    g_assert_cmpint(test_run(REVERT_PROC, 3, params), ==,
+                    GIMP_PDB_EXECUTION_ERROR);
+    path_at(image_id, 1, 3, NULL);
+
+    stroke_batch_free(&original);
+    stroke_batch_free(&expected);
+    stroke_batch_free(&result);
+    stroke_batch_free(&other);
+    g_rand_free(rand);
+}
+
+/*-----------------------------------------------------------------------------
+ *  test_bulk  --  a path with enough strokes to be written back with one
+ *                 import comes out exactly as one written stroke by
+ *                 stroke, in its place, with its name, with far fewer
+ *                 calls, and can be reverted the same way
+ *-----------------------------------------------------------------------------
+ */
+static void test_bulk(void)
+{
+    static const ReferenceVals all = { FALSE, 60, 120 };
+    GimpParam    params[14];
+    StrokeBatch  original, expected, result;
+    GRand       *rand;
+    gint32       image_id, vectors_id;
+    gchar       *name;
+    guint        calls;
+
+    gimp_stub_reset();
+    rand = g_rand_new_with_seed(52);
+    stroke_batch_init(&original);
+    stroke_batch_init(&expected);
+    stroke_batch_init(&result);
+    test_strokes(rand, &original, 4 * BULK_MIN_STROKES, 30, TRUE);
+    stroke_batch_copy(&expected, &original);
+    reference_batch(&all, &expected);
+
+    image_id = gimp_image_new(400, 400, GIMP_RGB);
+    test_path(image_id, &expected, "Above", 0);
+    vectors_id = test_path(image_id, &original, "Traced", 1);
+    test_path(image_id, &expected, "Below", 2);
+    smooth_params(params, image_id, vectors_id);
+
+    /* The first run calibrates, which isn't what is counted */
+    model_load(FALSE);
+    calls = gimp_stub_calls();
+    g_assert_cmpint(test_run(PLUG_IN_PROC, 6, params), ==, GIMP_PDB_SUCCESS);
+    calls = gimp_stub_calls() - calls;
+    g_assert_cmpstr(stats.transport, ==, "per-stroke read, bulk write");
+    g_assert_cmpuint(calls, <, stroke_batch_len(&original) + 32);
+    vectors_id = path_at(image_id, 1, 3, &result);
+    name = gimp_vectors_get_name(vectors_id);
+    g_assert_cmpstr(name, ==, "Traced");
+    g_free(name);
+    assert_batch_equal(&result, &expected);
+
+    /* And back */
+    params[2].data.d_vectors = vectors_id;
+    g_assert_cmpint(test_run(REVERT_PROC, 3, params), ==, GIMP_PDB_SUCCESS);
+    path_at(image_id, 1, 3, &result);
+    assert_batch_equal(&result, &original);
+
+    stroke_batch_free(&original);
+    stroke_batch_free(&expected);
+    stroke_batch_free(&result);
+    g_rand_free(rand);
+}
+
+/*-----------------------------------------------------------------------------
+ *  test_region  --  with the selection as the region, anchors outside it
+ *                   keep every bit, and so do the ones outside a range of
+ *                   anchors; without a selection everything is smoothed
+ *-----------------------------------------------------------------------------
+ */
+static void test_region(void)
+{
+    static const ReferenceVals all = { FALSE, 60, 120 };
+    GimpParam    params[14];
+    StrokeBatch  original, expected, result;
+    GRand       *rand;
+    const gdouble *a, *b;
+    gint32       image_id, vectors_id;
+    gint         n, inside, changed;
+
+    gimp_stub_reset();
+    rand = g_rand_new_with_seed(60);
+    stroke_batch_init(&original);
+    stroke_batch_init(&expected);
+    stroke_batch_init(&result);
+    test_strokes(rand, &original, 6, 100, FALSE);
+    stroke_batch_copy(&expected, &original);
+    reference_batch(&all, &expected);
+
+    image_id = gimp_image_new(400, 400, GIMP_RGB);
+    vectors_id = test_path(image_id, &original, "Traced", 0);
+    smooth_params(params, image_id, vectors_id);
+    params[7].data.d_int32 = REGION_SELECTION;
+    g_assert_cmpint(test_run(PLUG_IN_PROC, 10, params), ==, GIMP_PDB_SUCCESS);
+    vectors_id = path_at(image_id, 0, 1, &result);
+    assert_batch_equal(&result, &expected);
+
+    gimp_image_select_rectangle(image_id, GIMP_CHANNEL_OP_REPLACE,
+                                100, 50, 200, 250);
+    params[2].data.d_vectors = vectors_id;
+    g_assert_cmpint(test_run(PLUG_IN_PROC, 10, params), ==, GIMP_PDB_SUCCESS);
+    vectors_id = path_at(image_id, 0, 1, &result);
+    a = (const gdouble *) result.points->data;
+    b = (const gdouble *) original.points->data;
+    inside = changed = 0;
+    for (n = 0; n < (gint) original.points->len; n += 6) {
+        if (b[n + 2] >= 100 && b[n + 2] < 300 &&
+            b[n + 3] >= 50 && b[n + 3] < 300) {
+            inside++;
+            changed += (memcmp(a + n, b + n, 6 * sizeof(gdouble)) != 0);
+        } else {
+            g_assert_cmpmem(a + n, 6 * sizeof(gdouble),
+                            b + n, 6 * sizeof(gdouble));
+        }
+    }
+    g_assert_cmpint(changed, >, inside / 2);
+
+    params[2].data.d_vectors = vectors_id;
+    params[7].data.d_int32 = REGION_ANCHORS;
+    params[8].data.d_int32 = 30;
+    params[9].data.d_int32 = 90;
+    g_assert_cmpint(test_run(PLUG_IN_PROC, 10, params), ==, GIMP_PDB_SUCCESS);
+    path_at(image_id, 0, 1, &result);
+    a = (const gdouble *) result.points->data;
+    for (n = 0; n < (gint) original.points->len / 6; n++)
+        if (n < 30 || n > 90)
+            g_assert_cmpmem(a + n * 6, 6 * sizeof(gdouble),
+                            b + n * 6, 6 * sizeof(gdouble));
+
+    stroke_batch_free(&original);
+    stroke_batch_free(&expected);
+    stroke_batch_free(&result);
+    g_rand_free(rand);
+}
+
+/*-----------------------------------------------------------------------------
+ *  parasite_replace  --  attaches size bytes of data to vectors_id as its
+ *                        original parasite, in place of the one it has
+ *-----------------------------------------------------------------------------
+ */
+static void parasite_replace(gint32 vectors_id, const guint8 *data,
+                             glong size)
+{
+    GimpParasite *parasite;
+
+    parasite = gimp_parasite_new(ORIGINAL_PARASITE, GIMP_PARASITE_PERSISTENT,
+                                 size, data);
+    gimp_vectors_parasite_attach(vectors_id, parasite);
+    gimp_parasite_free(parasite);
+}
+
+/*-----------------------------------------------------------------------------
+ *  test_parasite  --  the original parasite is little-endian with fixed
+ *                     sizes, a damaged one is refused rather than trusted,
+ *                     and the strokes of a merged path have to match the
+ *                     ones smoothing gave it, not just its anchors
+ *-----------------------------------------------------------------------------
+ */
+static void test_parasite(void)
+{
+    GimpParam     params[14];
+    GimpParasite *parasite;
+    StrokeBatch   original, result;
+    guint8       *data, *damaged;
+    gdouble       ctlpts[40 * 6];
+    glong         size;
+    gint32        image_id, vectors_id, split_id;
+    gint          n, half;
+
+    gimp_stub_reset();
+    stroke_batch_init(&original);
+    stroke_batch_init(&result);
+    for (n = 0; n < 40; n++) {
+        ctlpts[n * 6 + 2] = 200 + 150 * cos(n * G_PI / 40);
+        ctlpts[n * 6 + 3] = 200 + 150 * sin(n * G_PI / 40);
+        ctlpts[n * 6 + 0] = ctlpts[n * 6 + 4] = ctlpts[n * 6 + 2];
+        ctlpts[n * 6 + 1] = ctlpts[n * 6 + 5] = ctlpts[n * 6 + 3];
+    }
+    stroke_batch_add(&original, ctlpts, 40 * 6, FALSE);
+    stroke_batch_add(&original, ctlpts, 20 * 6, FALSE);
+
+    image_id = gimp_image_new(400, 400, GIMP_RGB);
+    vectors_id = test_path(image_id, &original, "Arcs", 0);
+    smooth_params(params, image_id, vectors_id);
+    params[11].data.d_float = 0.5;
+    g_assert_cmpint(test_run(PLUG_IN_PROC, 12, params), ==, GIMP_PDB_SUCCESS);
+    vectors_id = path_at(image_id, 0, 1, &result);
+    g_assert_cmpint(result.points->len, <, original.points->len / 2);
+
+    parasite = gimp_vectors_parasite_find(vectors_id, ORIGINAL_PARASITE);
+    g_assert_nonnull(parasite);
+    size = gimp_parasite_data_size(parasite);
+    data = g_malloc(size);
+    memcpy(data, gimp_parasite_data(parasite), size);
+    gimp_parasite_free(parasite);
+    damaged = g_malloc(size);
+
+    /* Header, then the offsets of the two strokes and their closed flags */
+    g_assert_cmpint(data[0], ==, ORIGINAL_MAGIC & 0xff);
+    g_assert_cmpint(data[3], ==, ORIGINAL_MAGIC >> 24);
+    g_assert_cmpint(data[4], ==, 2);
+    g_assert_cmpint(data[24], ==, 40 * 6);
+    g_assert_cmpint(data[28], ==, 60 * 6 & 0xff);
+    g_assert_cmpint(data[29], ==, 60 * 6 >> 8);
+
+    params[2].data.d_vectors = vectors_id;
+    for (n = 0; n < 4; n++) {
+        memcpy(damaged, data, size);
+        switch (n) {
+        case 0:  damaged[24] += 1;   break;  /* not a whole anchor */
+        case 1:  damaged[25] = 2;    break;  /* beyond the next offset */
+        case 2:  damaged[20] = 6;    break;  /* not starting at 0 */
+        default: damaged[33] = 2;    break;  /* closed neither 0 nor 1 */
+        }
+        parasite_replace(vectors_id, damaged, size);
+        g_assert_cmpint(test_run(REVERT_PROC, 3, params), ==,
+                        GIMP_PDB_EXECUTION_ERROR);
+    }
+    parasite_replace(vectors_id, data, size - 1);
+    g_assert_cmpint(test_run(REVERT_PROC, 3, params), ==,
+                    GIMP_PDB_EXECUTION_ERROR);
+
+    /* The same anchors, with the first stroke cut in two */
+    half = stroke_batch_size(&result, 0) / 12 * 6;
+    split_id = gimp_vectors_new(image_id, "Split");
+    gimp_vectors_stroke_new_from_points(split_id,
+                                        GIMP_VECTORS_STROKE_TYPE_BEZIER,
+                                        half, stroke_batch_points(&result, 0),
+                                        FALSE);
+    gimp_vectors_stroke_new_from_points(split_id,
+                                        GIMP_VECTORS_STROKE_TYPE_BEZIER,
+                                        stroke_batch_size(&result, 0) - half,
+                                        stroke_batch_points(&result, 0) + half,
+                                        FALSE);
+    gimp_vectors_stroke_new_from_points(split_id,
+                                        GIMP_VECTORS_STROKE_TYPE_BEZIER,
+                                        stroke_batch_size(&result, 1),
+                                        stroke_batch_points(&result, 1),
+                                        FALSE);
+    gimp_image_add_vectors(image_id, split_id, 1);
+    parasite_replace(split_id, data, size);
+    params[2].data.d_vectors = split_id;
+    g_assert_cmpint(test_run(REVERT_PROC, 3, params), ==,
+                    GIMP_PDB_EXECUTION_ERROR);
+
+    parasite_replace(vectors_id, data, size);
+    params[2].data.d_vectors = vectors_id;
+    g_assert_cmpint(test_run(REVERT_PROC, 3, params), ==, GIMP_PDB_SUCCESS);
+    path_at(image_id, 0, 2, &result);
+    assert_batch_equal(&result, &original);
+
+    g_free(damaged);
+    g_free(data);
+    stroke_batch_free(&original);
+    stroke_batch_free(&result);
+}
+
+/*-----------------------------------------------------------------------------
+ *  test_refine  --  a path smoothed against a deadline that left it as it
+ *                   was is refined into what smoothing it without one gives,
+ *                   inside the selection the first run had, whatever the
+ *                   selection is by then
+ *-----------------------------------------------------------------------------
+ */
+static void test_refine(void)
+{
+    GimpParam    params[14];
+    StrokeBatch  original, expected, result;
+    GRand       *rand;
+    gint32       image_id, late_id, direct_id;
+
+    gimp_stub_reset();
+    rand = g_rand_new_with_seed(68);
+    stroke_batch_init(&original);
+    stroke_batch_init(&expected);
+    stroke_batch_init(&result);
+    test_strokes(rand, &original, 8, 60, FALSE);
+
+    image_id = gimp_image_new(400, 400, GIMP_RGB);
+    late_id = test_path(image_id, &original, "Late", 0);
+    direct_id = test_path(image_id, &original, "Direct", 1);
+    gimp_image_select_rectangle(image_id, GIMP_CHANNEL_OP_REPLACE,
+                                50, 100, 250, 200);
+
+    smooth_params(params, image_id, direct_id);
+    params[7].data.d_int32 = REGION_SELECTION;
+    g_assert_cmpint(test_run(PLUG_IN_PROC, 14, params), ==, GIMP_PDB_SUCCESS);
+    path_at(image_id, 1, 2, &expected);
+    g_assert_true(memcmp(expected.points->data, original.points->data,
+                         original.points->len * sizeof(gdouble)) != 0);
+
+    /* No time at all leaves every stroke as it was */
+    params[2].data.d_vectors = late_id;
+    params[13].data.d_float = 1e-9;
+    g_assert_cmpint(test_run(PLUG_IN_PROC, 14, params), ==, GIMP_PDB_SUCCESS);
+    late_id = path_at(image_id, 0, 2, &result);
+    assert_batch_equal(&result, &original);
+
+    gimp_image_select_rectangle(image_id, GIMP_CHANNEL_OP_REPLACE,
+                                0, 0, 120, 120);
+    params[2].data.d_vectors = late_id;
+    g_assert_cmpint(test_run(REFINE_PROC, 3, params), ==, GIMP_PDB_SUCCESS);
+    late_id = path_at(image_id, 0, 2, &result);
+    assert_batch_equal(&result, &expected);
+
+    /* Nothing is left to refine, and revert still works */
+    params[2].data.d_vectors = late_id;
+    g_assert_cmpint(test_run(REFINE_PROC, 3, params), ==,
+                    GIMP_PDB_EXECUTION_ERROR);
+    g_assert_cmpint(test_run(REVERT_PROC, 3, params), ==, GIMP_PDB_SUCCESS);
+    path_at(image_id, 0, 2, &result);
+    assert_batch_equal(&result, &original);
+
+    stroke_batch_free(&original);
+    stroke_batch_free(&expected);
+    stroke_batch_free(&result);
+    g_rand_free(rand);
+}
+
+/*-----------------------------------------------------------------------------
+ *  test_fill  --  the fill channel is added, the path keeps its name, and
+ *                 the channel holds the filled path
+ *-----------------------------------------------------------------------------
+ */
+static void test_fill(void)
+{
+    static const gdouble square[] =
+    {
+        40, 30, 40, 30, 40, 30,  240, 30, 240, 30, 240, 30,
+        240, 130, 240, 130, 240, 130,  40, 130, 40, 130, 40, 130
+    };
+    GimpParam     params[14];
+    GimpDrawable *drawable;
+    GimpPixelRgn  rgn;
+    StrokeBatch   batch;
+    guint8       *pixels;
+    gint32       *channels, image_id, vectors_id;
+    gchar        *name;
+    gdouble       area;
+    gint          n, num_channels;
+
+    gimp_stub_reset();
+    stroke_batch_init(&batch);
+    stroke_batch_add(&batch, square, G_N_ELEMENTS(square), TRUE);
+    image_id = gimp_image_new(300, 200, GIMP_RGB);
+    vectors_id = test_path(image_id, &batch, "Box", 0);
+    smooth_params(params, image_id, vectors_id);
+    params[3].data.d_int32 = TRUE;
+    params[4].data.d_float = 100;
+    params[5].data.d_float = 170;
+    params[10].data.d_int32 = FILL_EVENODD;
+    g_assert_cmpint(test_run(PLUG_IN_PROC, 11, params), ==, GIMP_PDB_SUCCESS);
+
+    channels = gimp_image_get_channels(image_id, &num_channels);
+    g_assert_cmpint(num_channels, ==, 1);
+    name = gimp_vectors_get_name(path_at(image_id, 0, 1, NULL));
+    g_assert_cmpstr(name, ==, "Box");
+    g_free(name);
+
+    /* Right angles are left alone, and the square lies on pixel edges */
+    drawable = gimp_drawable_get(channels[0]);
+    pixels = g_new(guint8, 300 * 200);
+    gimp_pixel_rgn_init(&rgn, drawable, 0, 0, 300, 200, FALSE, FALSE);
+    gimp_pixel_rgn_get_rect(&rgn, pixels, 0, 0, 300, 200);
+    area = 0;
+    for (n = 0; n < 300 * 200; n++)
+        area += pixels[n] / 255.0;
+    g_assert_cmpfloat_with_epsilon(area, 200 * 100, 1e-6);
+    g_assert_cmpint(pixels[30 * 300 + 40], ==, 255);
+    g_assert_cmpint(pixels[129 * 300 + 239], ==, 255);
+    g_assert_cmpint(pixels[130 * 300 + 239], ==, 0);
+    g_assert_cmpint(pixels[10 * 300 + 10], ==, 0);
+    gimp_drawable_detach(drawable);
+
+    g_free(pixels);
+    g_free(channels);
+    stroke_batch_free(&batch);
+}
+
+/*-----------------------------------------------------------------------------
+ *  test_interactive  --  the dialog, answered with OK, smooths with the
+ *                        settings of the last run and keeps them; wrong
+ *                        numbers of arguments are refused
+ *-----------------------------------------------------------------------------
+ */
+static void test_interactive(void)
+{
+    static const ReferenceVals some = { TRUE, 100, 170 };
+    GimpParam    params[14];
+    StrokeBatch  original, expected, result;
+    SmoothVals   kept;
+    GRand       *rand;
+    gint32       image_id, vectors_id;
+
+    gimp_stub_reset();
+    rand = g_rand_new_with_seed(57);
+    stroke_batch_init(&original);
+    stroke_batch_init(&expected);
+    stroke_batch_init(&result);
+    test_strokes(rand, &original, 5, 30, FALSE);
+    stroke_batch_copy(&expected, &original);
+    reference_batch(&some, &expected);
+
+    image_id = gimp_image_new(400, 400, GIMP_RGB);
+    vectors_id = test_path(image_id, &original, "Traced", 0);
+    smooth_params(params, image_id, vectors_id);
+    g_assert_cmpint(test_run(PLUG_IN_PROC, 8, params), ==,
+                    GIMP_PDB_CALLING_ERROR);
+    params[10].data.d_int32 = 3;
+    g_assert_cmpint(test_run(PLUG_IN_PROC, 11, params), ==,
+                    GIMP_PDB_CALLING_ERROR);
+    params[10].data.d_int32 = FILL_NONE;
+
+    memset(&kept, 0, sizeof(kept));
+    kept.smooth_specified = some.smooth_specified;
+    kept.ang_min = some.ang_min;
+    kept.ang_max = some.ang_max;
+    kept.last_anchor = -1;
+    gimp_set_data(PLUG_IN_PROC, &kept, sizeof(kept));
+
+    params[0].data.d_int32 = GIMP_RUN_INTERACTIVE;
+    g_assert_cmpint(test_run(PLUG_IN_PROC, 3, params), ==, GIMP_PDB_SUCCESS);
+    path_at(image_id, 0, 1, &result);
+    assert_batch_equal(&result, &expected);
+    g_assert_cmpint(gimp_get_data_size(PLUG_IN_PROC), ==, sizeof(SmoothVals));
+
+    stroke_batch_free(&original);
+    stroke_batch_free(&expected);
+    stroke_batch_free(&result);
+    g_rand_free(rand);
+}
+
+/*-----------------------------------------------------------------------------
+ *  test_calibrate  --  the cost model is measured once and read back from
+ *                      its file by later runs, until the calibrate
+ *                      procedure measures it again
+ *-----------------------------------------------------------------------------
+ */
+static void test_calibrate(void)
+{
+    GimpParam   params[1];
+    SmoothModel measured;
+
+    gimp_stub_reset();
+    memset(&model, 0, sizeof(model));
+    stats.calibrated = FALSE;
+    model_load(FALSE);
+    g_assert(stats.calibrated);
+    measured = model;
+
+    /* A later run starts from nothing, as a new plugin process does */
+    memset(&model, 0, sizeof(model));
+    stats.calibrated = FALSE;
+    model_load(FALSE);
+    g_assert(!stats.calibrated);
+    g_assert(memcmp(&model, &measured, sizeof(model)) == 0);
+
+    params[0].data.d_int32 = GIMP_RUN_NONINTERACTIVE;
+    g_assert_cmpint(test_run(CALIBRATE_PROC, 1, params), ==,
+                    GIMP_PDB_SUCCESS);
+    g_assert(stats.calibrated);
+
+    /* Without the file, the next run measures again */
+    gimp_stub_reset();
+    memset(&model, 0, sizeof(model));
+    stats.calibrated = FALSE;
+    model_load(FALSE);
+    g_assert(stats.calibrated);
+}
+
+int main(int argc, char **argv)
+{
+    g_test_init(&argc, &argv, NULL);
+
+    g_test_add_func("/plugin/smooth-revert", test_smooth_revert);
+    g_test_add_func("/plugin/bulk", test_bulk);
+    g_test_add_func("/plugin/region", test_region);
+    g_test_add_func("/plugin/parasite", test_parasite);
+    g_test_add_func("/plugin/refine", test_refine);
+    g_test_add_func("/plugin/fill", test_fill);
+    g_test_add_func("/plugin/interactive", test_interactive);
+    g_test_add_func("/plugin/calibrate", test_calibrate);
+
+    return g_test_run();
+}
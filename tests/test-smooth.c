@@ -0,0 +1,958 @@
+/*
+ *      test-smooth.c - tests of the smoothing, merging, joining, collapsing
+ *                      and rasterising of Smooth Path, on strokes in memory
+ *
+ *      Copyright 2026 agent
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ *      This program is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *
+ *      You should have received a copy of the GNU General Public License
+ *      along with this program; if not, write to the Free Software
+ *      Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ *      MA 02110-1301, USA.
+ */
+
+#include "../smooth-path.c"
+#include "reference.h"
+
+/* Corner angle ranges the tests smooth with, the second wrapping round */
+static const gdouble test_ranges[][2] =
+{
+    { 60.0, 120.0 },
+    {150.0,  30.0 },
+    {  0.0, 180.0 },
+    { 90.0,  90.0 }
+};
+
+/*-----------------------------------------------------------------------------
+ *  test_vals  --  settings for test t, cycling through the corner options
+ *-----------------------------------------------------------------------------
+ */
+static SmoothVals test_vals(gint t)
+{
+    SmoothVals vals = { 0 };
+
+    vals.smooth_specified = (t / 2) % 2;
+    vals.ang_min = test_ranges[(t / 4) % G_N_ELEMENTS(test_ranges)][0];
+    vals.ang_max = test_ranges[(t / 4) % G_N_ELEMENTS(test_ranges)][1];
+    vals.last_anchor = -1;
+    return vals;
+}
+
+static void random_stroke(GRand *rand, gdouble *ctlpts, gint len)
+{
+    gint n;
+
+    for (n = 0; n < len * 6; n++)
+        ctlpts[n] = g_rand_double_range(rand, 0, 500);
+}
+
+/*-----------------------------------------------------------------------------
+ *  random_batch  --  a batch of num_strokes random strokes of 1 .. max_len
+ *                    anchors, every other one closed
+ *-----------------------------------------------------------------------------
+ */
+static void random_batch(GRand *rand, StrokeBatch *batch, gint num_strokes,
+                         gint max_len)
+{
+    gdouble *ctlpts;
+    gint     n, len;
+
+    ctlpts = g_new(gdouble, max_len * 6);
+    for (n = 0; n < num_strokes; n++) {
+        len = g_rand_int_range(rand, 1, max_len + 1);
+        random_stroke(rand, ctlpts, len);
+        stroke_batch_add(batch, ctlpts, len * 6, n % 2);
+    }
+    g_free(ctlpts);
+}
+
+/*-----------------------------------------------------------------------------
+ *  circle_stroke  --  a closed stroke of len anchors around a circle, with
+ *                     handles along its tangents
+ *-----------------------------------------------------------------------------
+ */
+static void circle_stroke(gdouble *ctlpts, gint len, gdouble cx, gdouble cy,
+                          gdouble r)
+{
+    gdouble a, h;
+    gint    n;
+
+    h = 4.0 / 3.0 * tan(G_PI / (2 * len)) * r;
+    for (n = 0; n < len; n++) {
+        a = 2 * G_PI * n / len;
+        ctlpts[n * 6 + 2] = cx + r * cos(a);
+        ctlpts[n * 6 + 3] = cy + r * sin(a);
+        ctlpts[n * 6 + 0] = ctlpts[n * 6 + 2] + h * sin(a);
+        ctlpts[n * 6 + 1] = ctlpts[n * 6 + 3] - h * cos(a);
+        ctlpts[n * 6 + 4] = ctlpts[n * 6 + 2] - h * sin(a);
+        ctlpts[n * 6 + 5] = ctlpts[n * 6 + 3] + h * cos(a);
+    }
+}
+
+/*-----------------------------------------------------------------------------
+ *  polygon_stroke  --  a stroke through the num corners, with the handles
+ *                      on their anchors so that every segment is a line
+ *-----------------------------------------------------------------------------
+ */
+static void polygon_stroke(gdouble *ctlpts, const gdouble *corners, gint num)
+{
+    gint n;
+
+    for (n = 0; n < num; n++) {
+        ctlpts[n * 6 + 0] = ctlpts[n * 6 + 2] = ctlpts[n * 6 + 4] =
+            corners[n * 2];
+        ctlpts[n * 6 + 1] = ctlpts[n * 6 + 3] = ctlpts[n * 6 + 5] =
+            corners[n * 2 + 1];
+    }
+}
+
+/*-----------------------------------------------------------------------------
+ *  curve_distance  --  how far the point pt is from a stroke, measured to
+ *                      the lines between 256 points along each segment
+ *-----------------------------------------------------------------------------
+ */
+static gdouble curve_distance(const gdouble *ctlpts, gint num_points,
+                              gboolean closed, const gdouble *pt)
+{
+    gdouble seg[8], a[2], b[2], dx, dy, t, best;
+    gint    len, n, k;
+
+    len = num_points / 6;
+    best = G_MAXDOUBLE;
+    for (n = 0; n < (closed ? len : len - 1); n++) {
+        memcpy(seg, ctlpts + n * 6 + 2, 4 * sizeof(gdouble));
+        memcpy(seg + 4, ctlpts + ((n + 1) % len) * 6, 4 * sizeof(gdouble));
+        bezier_point(seg, 0, a, NULL, NULL);
+        for (k = 1; k <= 256; k++, a[0] = b[0], a[1] = b[1]) {
+            bezier_point(seg, k / 256.0, b, NULL, NULL);
+            dx = b[0] - a[0];
+            dy = b[1] - a[1];
+            t = (dx * dx + dy * dy > 0) ?
+                CLAMP(((pt[0] - a[0]) * dx + (pt[1] - a[1]) * dy) /
+                      (dx * dx + dy * dy), 0, 1) : 0;
+            best = MIN(best, hypot(a[0] + t * dx - pt[0],
+                                   a[1] + t * dy - pt[1]));
+        }
+    }
+    return best;
+}
+
+/*-----------------------------------------------------------------------------
+ *  test_baseline  --  smooth_stroke gives what the first release gave, to
+ *                     the last bit, for any corner settings
+ *-----------------------------------------------------------------------------
+ */
+static void test_baseline(void)
+{
+    SmoothScratch  scratch = { NULL };
+    SmoothVals     vals;
+    ReferenceVals  ref;
+    GRand         *rand;
+    gdouble       *a, *b;
+    gint           t, len;
+    gboolean       closed;
+
+    rand = g_rand_new_with_seed(51);
+    a = g_new(gdouble, 6 * 80);
+    b = g_new(gdouble, 6 * 80);
+    for (t = 0; t < 400; t++) {
+        vals = test_vals(t);
+        ref.smooth_specified = vals.smooth_specified;
+        ref.ang_min = vals.ang_min;
+        ref.ang_max = vals.ang_max;
+        len = g_rand_int_range(rand, 1, 81);
+        closed = t % 2;
+        random_stroke(rand, a, len);
+        memcpy(b, a, len * 6 * sizeof(gdouble));
+
+        reference_smooth_stroke(&ref, a, len * 6, closed);
+        smooth_stroke(&vals, b, len * 6, closed, NULL, &scratch);
+        g_assert_cmpmem(a, len * 6 * sizeof(gdouble),
+                        b, len * 6 * sizeof(gdouble));
+    }
+    g_free(a);
+    g_free(b);
+    scratch_free(&scratch);
+    g_rand_free(rand);
+}
+
+/*-----------------------------------------------------------------------------
+ *  test_baseline_batch  --  the same through smooth_strokes on a batch, with
+ *                           the corner angles measured beforehand, and over
+ *                           the thread pool on one big enough to use it
+ *-----------------------------------------------------------------------------
+ */
+static void test_baseline_batch(void)
+{
+    SmoothScratch  scratch = { NULL };
+    SmoothVals     vals;
+    ReferenceVals  ref;
+    StrokeBatch    batch, expected;
+    GArray        *angles;
+    GRand         *rand;
+    gint           t, n, num_strokes, max_len;
+
+    rand = g_rand_new_with_seed(52);
+    stroke_batch_init(&batch);
+    stroke_batch_init(&expected);
+    angles = g_array_new(FALSE, FALSE, sizeof(gdouble));
+    for (t = 0; t < 16; t++) {
+        vals = test_vals(t);
+        ref.smooth_specified = vals.smooth_specified;
+        ref.ang_min = vals.ang_min;
+        ref.ang_max = vals.ang_max;
+        num_strokes = (t < 8) ? 40 : 100;
+        max_len = (t < 8) ? 50 : 4 * POOL_MIN_ANCHORS / num_strokes;
+        stroke_batch_clear(&batch);
+        random_batch(rand, &batch, num_strokes, max_len);
+        stroke_batch_copy(&expected, &batch);
+        for (n = 0; n < num_strokes; n++)
+            reference_smooth_stroke(&ref, stroke_batch_points(&expected, n),
+                                    stroke_batch_size(&expected, n),
+                                    stroke_batch_closed(&expected, n));
+
+        stroke_batch_angles(&batch, angles);
+        if (t < 8)
+            smooth_batch(&vals, &batch, (gdouble *) angles->data, NULL,
+                         &scratch);
+        else
+            smooth_batch_threaded(&vals, &batch, (gdouble *) angles->data,
+                                  NULL, &scratch);
+        g_assert_cmpmem(batch.points->data,
+                        batch.points->len * sizeof(gdouble),
+                        expected.points->data,
+                        expected.points->len * sizeof(gdouble));
+    }
+    g_array_free(angles, TRUE);
+    stroke_batch_free(&batch);
+    stroke_batch_free(&expected);
+    scratch_free(&scratch);
+    g_rand_free(rand);
+}
+
+/*-----------------------------------------------------------------------------
+ *  test_region  --  with a mask, anchors outside it keep every bit, a full
+ *                   mask changes nothing against smoothing without one, and
+ *                   the windows come within 1e-6 pixels of solving the
+ *                   whole stroke with only the masked anchors smoothed
+ *-----------------------------------------------------------------------------
+ */
+static void test_region(void)
+{
+    SmoothScratch  scratch = { NULL };
+    SmoothVals     vals, whole_vals;
+    StrokeBatch    batch, region, whole;
+    GArray        *angles, *mask;
+    GRand         *rand;
+    gdouble       *window_angles, *a, *b;
+    guint8        *keep;
+    gint           t, n, k, len, anchors;
+    gdouble        worst;
+
+    rand = g_rand_new_with_seed(55);
+    stroke_batch_init(&batch);
+    stroke_batch_init(&region);
+    stroke_batch_init(&whole);
+    angles = g_array_new(FALSE, FALSE, sizeof(gdouble));
+    mask = g_array_new(FALSE, FALSE, sizeof(guint8));
+    for (t = 0; t < 60; t++) {
+        vals = test_vals(t);
+        vals.smoothing = (t % 3 == 0) ? 0 : (t % 3 == 1) ? 2 : 300;
+        vals.region = REGION_SELECTION;
+        stroke_batch_clear(&batch);
+        random_batch(rand, &batch, 8, 300);
+        stroke_batch_angles(&batch, angles);
+        anchors = batch.points->len / 6;
+        g_array_set_size(mask, anchors);
+        keep = (guint8 *) mask->data;
+        for (n = 0; n < anchors; n++)
+            keep[n] = (t % 5 == 0) ||
+                      (n / 40) % 3 == 1 || g_rand_int_range(rand, 0, 50) == 0;
+
+        stroke_batch_copy(&region, &batch);
+        smooth_batch(&vals, &region, (gdouble *) angles->data, keep,
+                     &scratch);
+        for (n = 0; n < anchors; n++)
+            if (!keep[n])
+                g_assert_cmpmem(&g_array_index(region.points, gdouble, n * 6),
+                                6 * sizeof(gdouble),
+                                &g_array_index(batch.points, gdouble, n * 6),
+                                6 * sizeof(gdouble));
+
+        /* Anchors the mask takes in are smoothed as if the rest were
+         * corners that aren't */
+        stroke_batch_copy(&whole, &batch);
+        if (t % 5 == 0) {
+            smooth_batch(&vals, &whole, (gdouble *) angles->data, NULL,
+                         &scratch);
+            g_assert_cmpmem(region.points->data,
+                            region.points->len * sizeof(gdouble),
+                            whole.points->data,
+                            whole.points->len * sizeof(gdouble));
+            continue;
+        }
+        whole_vals = vals;
+        whole_vals.smooth_specified = TRUE;
+        whole_vals.ang_min = 0;
+        whole_vals.ang_max = 180;
+        window_angles = g_new(gdouble, anchors);
+        for (n = 0; n < anchors; n++)
+            window_angles[n] = (keep[n] &&
+                                anchor_smoothed(&vals,
+                                    g_array_index(angles, gdouble, n))) ?
+                               90 : -1;
+        smooth_batch(&whole_vals, &whole, window_angles, NULL, &scratch);
+        g_free(window_angles);
+
+        worst = 0;
+        for (n = 0; n < stroke_batch_len(&batch); n++) {
+            a = stroke_batch_points(&region, n);
+            b = stroke_batch_points(&whole, n);
+            len = stroke_batch_size(&batch, n);
+            for (k = 0; k < len; k++)
+                worst = MAX(worst, ABS(a[k] - b[k]));
+        }
+        g_assert_cmpfloat(worst, <, 1e-6);
+    }
+    g_array_free(angles, TRUE);
+    g_array_free(mask, TRUE);
+    stroke_batch_free(&batch);
+    stroke_batch_free(&region);
+    stroke_batch_free(&whole);
+    scratch_free(&scratch);
+    g_rand_free(rand);
+}
+
+/*-----------------------------------------------------------------------------
+ *  test_merge  --  merging a smoothed circle leaves far fewer anchors, with
+ *                  every point along the old curve within vals->merge of
+ *                  the new one, and keeps the corners of a polygon
+ *-----------------------------------------------------------------------------
+ */
+static void test_merge(void)
+{
+    static const gdouble corners[] =
+    {
+        0, 0,  10, 0,  20, 0,  30, 0,  40, 0,
+        40, 10,  40, 20,  40, 30,
+        30, 30,  20, 30,  10, 30,  0, 30,
+        0, 20,  0, 10
+    };
+    SmoothScratch  scratch = { NULL };
+    SmoothVals     vals = { 0 };
+    gdouble        dense[200 * 6], merged[200 * 6], seg[8], pt[2];
+    gdouble        worst;
+    gint           t, n, k, len, size;
+    gboolean       closed;
+
+    vals.last_anchor = -1;
+    vals.merge = 0.05;
+    for (t = 0; t < 2; t++) {
+        /* A whole circle, and an open arc of one */
+        closed = (t == 0);
+        circle_stroke(dense, 200, 250, 250, 100);
+        len = closed ? 200 : 150;
+        smooth_stroke(&vals, dense, len * 6, closed, NULL, &scratch);
+        memcpy(merged, dense, len * 6 * sizeof(gdouble));
+        size = merge_stroke(&vals, merged, len * 6, closed, NULL);
+        g_assert_cmpint(size % 6, ==, 0);
+        g_assert_cmpint(size, <, len * 6 / 4);
+
+        /* The anchors that are left are anchors that were there */
+        g_assert_cmpmem(merged + 2, 2 * sizeof(gdouble),
+                        dense + 2, 2 * sizeof(gdouble));
+        if (!closed)
+            g_assert_cmpmem(merged + size - 4, 2 * sizeof(gdouble),
+                            dense + len * 6 - 4, 2 * sizeof(gdouble));
+
+        worst = 0;
+        for (n = 0; n < (closed ? len : len - 1); n++) {
+            memcpy(seg, dense + n * 6 + 2, 4 * sizeof(gdouble));
+            memcpy(seg + 4, dense + ((n + 1) % len) * 6,
+                   4 * sizeof(gdouble));
+            for (k = 0; k < 32; k++) {
+                bezier_point(seg, k / 32.0, pt, NULL, NULL);
+                worst = MAX(worst, curve_distance(merged, size, closed, pt));
+            }
+        }
+        g_assert_cmpfloat(worst, <=, vals.merge);
+    }
+
+    /* Segments along each side go, the corners stay */
+    len = G_N_ELEMENTS(corners) / 2;
+    polygon_stroke(dense, corners, len);
+    for (n = 0; n < len; n++) {
+        k = (n + 1) % len;
+        dense[n * 6 + 4] += (dense[k * 6 + 2] - dense[n * 6 + 2]) / 3;
+        dense[n * 6 + 5] += (dense[k * 6 + 3] - dense[n * 6 + 3]) / 3;
+        dense[k * 6 + 0] -= (dense[k * 6 + 2] - dense[n * 6 + 2]) / 3;
+        dense[k * 6 + 1] -= (dense[k * 6 + 3] - dense[n * 6 + 3]) / 3;
+    }
+    size = merge_stroke(&vals, dense, len * 6, TRUE, NULL);
+    g_assert_cmpint(size, ==, 4 * 6);
+    for (n = 0; n < 4; n++) {
+        g_assert_cmpfloat(dense[n * 6 + 2], ==,
+                          (n == 1 || n == 2) ? 40 : 0);
+        g_assert_cmpfloat(dense[n * 6 + 3], ==, (n >= 2) ? 30 : 0);
+    }
+    scratch_free(&scratch);
+}
+
+/*-----------------------------------------------------------------------------
+ *  reverse_stroke  --  the same stroke run backwards
+ *-----------------------------------------------------------------------------
+ */
+static void reverse_stroke(gdouble *ctlpts, gint len)
+{
+    gdouble anchor[6];
+    gint    n, k;
+
+    for (n = 0; n < len / 2; n++) {
+        memcpy(anchor, ctlpts + n * 6, sizeof(anchor));
+        memcpy(ctlpts + n * 6, ctlpts + (len - 1 - n) * 6, sizeof(anchor));
+        memcpy(ctlpts + (len - 1 - n) * 6, anchor, sizeof(anchor));
+    }
+    for (n = 0; n < len; n++)
+        for (k = 0; k < 2; k++) {
+            anchor[0] = ctlpts[n * 6 + k];
+            ctlpts[n * 6 + k] = ctlpts[n * 6 + 4 + k];
+            ctlpts[n * 6 + 4 + k] = anchor[0];
+        }
+}
+
+/*-----------------------------------------------------------------------------
+ *  test_join_split  --  open pieces cut from a closed stroke, some of them
+ *                       run backwards, join into that one stroke; splitting
+ *                       it again gives back every bit of the pieces, and
+ *                       after smoothing the pieces still meet smoothly
+ *-----------------------------------------------------------------------------
+ */
+static void test_join_split(void)
+{
+    static const gint cuts[] = { 0, 7, 19, 20, 33, 48, 60 };
+    SmoothScratch  scratch = { NULL };
+    SmoothVals     vals = { 0 };
+    StrokeBatch    batch, joined, pieces_before;
+    GArray        *map, *pieces;
+    GRand         *rand;
+    gdouble        circle[60 * 6], piece[61 * 6];
+    const gdouble *from, *a, *b;
+    gint           n, k, len, joins, num_pieces;
+
+    vals.last_anchor = -1;
+    rand = g_rand_new_with_seed(67);
+    circle_stroke(circle, 60, 200, 200, 80);
+    for (n = 0; n < 60 * 6; n++)
+        circle[n] += g_rand_double_range(rand, -3, 3);
+
+    stroke_batch_init(&batch);
+    stroke_batch_init(&joined);
+    stroke_batch_init(&pieces_before);
+    num_pieces = G_N_ELEMENTS(cuts) - 1;
+    for (n = 0; n < num_pieces; n++) {
+        len = cuts[n + 1] - cuts[n] + 1;
+        for (k = 0; k < len; k++)
+            memcpy(piece + k * 6, circle + ((cuts[n] + k) % 60) * 6,
+                   6 * sizeof(gdouble));
+        if (n % 2)
+            reverse_stroke(piece, len);
+        stroke_batch_add(&batch, piece, len * 6, FALSE);
+    }
+    stroke_batch_copy(&pieces_before, &batch);
+
+    map = g_array_new(FALSE, FALSE, sizeof(gint));
+    pieces = g_array_new(FALSE, FALSE, sizeof(gint));
+    joins = join_batch(&batch, NULL, &joined, map, pieces, NULL);
+    g_assert_cmpint(joins, ==, num_pieces);
+    g_assert_cmpint(stroke_batch_len(&joined), ==, 1);
+    g_assert_true(stroke_batch_closed(&joined, 0));
+    g_assert_cmpint(stroke_batch_size(&joined, 0), ==, 60 * 6);
+
+    split_batch(&batch, &joined, map, pieces, NULL);
+    g_assert_cmpmem(batch.points->data, batch.points->len * sizeof(gdouble),
+                    pieces_before.points->data,
+                    pieces_before.points->len * sizeof(gdouble));
+
+    /* Each piece takes the smoothed anchors, and the handles on its own
+     * side of where it meets the next */
+    smooth_batch(&vals, &joined, NULL, NULL, &scratch);
+    split_batch(&batch, &joined, map, pieces, NULL);
+    for (n = 0; n < num_pieces; n++) {
+        len = stroke_batch_size(&batch, n) / 6;
+        a = stroke_batch_points(&batch, n);
+        for (k = 0; k < len; k++) {
+            from = &g_array_index(joined.points, gdouble,
+                        g_array_index(map, gint,
+                            g_array_index(batch.offsets, gint, n) / 6 + k) * 6);
+            g_assert_cmpmem(a + k * 6 + 2, 2 * sizeof(gdouble),
+                            from + 2, 2 * sizeof(gdouble));
+        }
+        /* Where this piece meets the next, each has the handle of the
+         * joined stroke on its own side; that runs the way piece 0 does */
+        b = stroke_batch_points(&batch, (n + 1) % num_pieces);
+        k = g_array_index(batch.offsets, gint, n) / 6;
+        if (n % 2 == 0) {
+            a += (len - 1) * 6;
+            k += len - 1;
+        }
+        if ((n + 1) % 2)
+            b += stroke_batch_size(&batch, (n + 1) % num_pieces) - 6;
+        from = &g_array_index(joined.points, gdouble,
+                              g_array_index(map, gint, k) * 6);
+        g_assert_cmpmem(a + 2, 2 * sizeof(gdouble), b + 2, 2 * sizeof(gdouble));
+        g_assert_cmpmem(a + ((n % 2) ? 4 : 0), 2 * sizeof(gdouble),
+                        from, 2 * sizeof(gdouble));
+        g_assert_cmpmem(b + (((n + 1) % 2) ? 0 : 4), 2 * sizeof(gdouble),
+                        from + 4, 2 * sizeof(gdouble));
+    }
+
+    g_array_free(map, TRUE);
+    g_array_free(pieces, TRUE);
+    stroke_batch_free(&batch);
+    stroke_batch_free(&joined);
+    stroke_batch_free(&pieces_before);
+    scratch_free(&scratch);
+    g_rand_free(rand);
+}
+
+/*-----------------------------------------------------------------------------
+ *  test_collapse_expand  --  anchors repeated on top of each other collapse
+ *                            back into the stroke they were added to, and
+ *                            once that is smoothed, expand into a stroke
+ *                            that collapses into it again
+ *-----------------------------------------------------------------------------
+ */
+static void test_collapse_expand(void)
+{
+    SmoothScratch  scratch = { NULL };
+    SmoothVals     vals;
+    StrokeBatch    clean, dirty, reduced, again;
+    GArray        *map, *map_again;
+    GRand         *rand;
+    gdouble        ctlpts[40 * 6], copies[121 * 6];
+    gdouble       *anchor;
+    gdouble        worst;
+    gint           t, n, m, k, len, size, repeats, removed, total;
+
+    rand = g_rand_new_with_seed(66);
+    stroke_batch_init(&clean);
+    stroke_batch_init(&dirty);
+    stroke_batch_init(&reduced);
+    stroke_batch_init(&again);
+    map = g_array_new(FALSE, FALSE, sizeof(gint));
+    map_again = g_array_new(FALSE, FALSE, sizeof(gint));
+    for (t = 0; t < 40; t++) {
+        vals = test_vals(t);
+        stroke_batch_clear(&clean);
+        stroke_batch_clear(&dirty);
+        total = 0;
+        for (n = 0; n < 6; n++) {
+            /* Quarter pixels, so that moving handles with their anchors is
+             * exact */
+            len = g_rand_int_range(rand, 3, 41);
+            for (k = 0; k < len * 6; k++)
+                ctlpts[k] = g_rand_int_range(rand, 0, 2000) / 4.0;
+            stroke_batch_add(&clean, ctlpts, len * 6, n % 2);
+
+            /* Repeat some anchors, the first copy keeping the in-handle
+             * and the last the out-handle; in a closed stroke the last
+             * anchor may also come again first, so that its run goes
+             * round the end */
+            size = 0;
+            for (k = 0; k < len; k++) {
+                repeats = (g_rand_int_range(rand, 0, 4) == 0) ?
+                          g_rand_int_range(rand, 1, 3) : 0;
+                for (m = 0; m <= repeats; m++, size += 6) {
+                    anchor = copies + size;
+                    memcpy(anchor, ctlpts + k * 6, 6 * sizeof(gdouble));
+                    if (m > 0) {
+                        anchor[0] = anchor[2];
+                        anchor[1] = anchor[3];
+                    }
+                    if (m < repeats) {
+                        anchor[4] = anchor[2];
+                        anchor[5] = anchor[3];
+                    }
+                }
+                total += repeats;
+            }
+            if (n % 2 && g_rand_int_range(rand, 0, 2)) {
+                memmove(copies + 6, copies, size * sizeof(gdouble));
+                anchor = copies + size;
+                memcpy(copies, anchor, 6 * sizeof(gdouble));
+                copies[0] = copies[2];
+                copies[1] = copies[3];
+                anchor[4] = anchor[2];
+                anchor[5] = anchor[3];
+                size += 6;
+                total++;
+            }
+            stroke_batch_add(&dirty, copies, size, n % 2);
+        }
+
+        removed = collapse_batch(&dirty, &reduced, map);
+        g_assert_cmpint(removed, ==, total);
+        g_assert_cmpint(stroke_batch_len(&reduced), ==,
+                        stroke_batch_len(&clean));
+        for (n = 0; n < stroke_batch_len(&clean); n++) {
+            /* A closed stroke may come out starting somewhere else */
+            len = stroke_batch_size(&clean, n) / 6;
+            g_assert_cmpint(stroke_batch_size(&reduced, n), ==, len * 6);
+            for (k = 0; k < len; k++)
+                if (memcmp(stroke_batch_points(&reduced, n),
+                           stroke_batch_points(&clean, n) + k * 6,
+                           6 * sizeof(gdouble)) == 0)
+                    break;
+            g_assert_cmpint(k, <, len);
+            memcpy(ctlpts, stroke_batch_points(&clean, n) + k * 6,
+                   (len - k) * 6 * sizeof(gdouble));
+            memcpy(ctlpts + (len - k) * 6, stroke_batch_points(&clean, n),
+                   k * 6 * sizeof(gdouble));
+            g_assert_cmpmem(stroke_batch_points(&reduced, n),
+                            len * 6 * sizeof(gdouble),
+                            ctlpts, len * 6 * sizeof(gdouble));
+        }
+
+        smooth_batch(&vals, &reduced, NULL, NULL, &scratch);
+        expand_batch(&dirty, &reduced, map, NULL);
+        g_assert_cmpint(collapse_batch(&dirty, &again, map_again), ==, total);
+        g_assert_cmpint(again.points->len, ==, reduced.points->len);
+        worst = 0;
+        for (k = 0; k < (gint) again.points->len; k++)
+            worst = MAX(worst, ABS(g_array_index(again.points, gdouble, k) -
+                                   g_array_index(reduced.points, gdouble, k)));
+        g_assert_cmpfloat(worst, <, 1e-9);
+
+        /* The copies in between have their handles on their anchors */
+        for (n = 0; n < (gint) dirty.points->len / 6; n++) {
+            anchor = &g_array_index(dirty.points, gdouble, n * 6);
+            k = g_array_index(map, gint, n);
+            if (n > 0 && n + 1 < (gint) map->len &&
+                g_array_index(map, gint, n - 1) == k &&
+                g_array_index(map, gint, n + 1) == k) {
+                g_assert_cmpmem(anchor, 2 * sizeof(gdouble),
+                                anchor + 2, 2 * sizeof(gdouble));
+                g_assert_cmpmem(anchor + 4, 2 * sizeof(gdouble),
+                                anchor + 2, 2 * sizeof(gdouble));
+            }
+        }
+    }
+    g_array_free(map, TRUE);
+    g_array_free(map_again, TRUE);
+    stroke_batch_free(&clean);
+    stroke_batch_free(&dirty);
+    stroke_batch_free(&reduced);
+    stroke_batch_free(&again);
+    scratch_free(&scratch);
+    g_rand_free(rand);
+}
+
+/* Coverage written back by rasterize_strokes, over the whole image */
+typedef struct
+{
+    guint8 *pixels;
+    gint    width, height;
+    gint    rows;
+} TestCanvas;
+
+static void canvas_write(const guint8 *coverage, gint x, gint y, gint width,
+                         gint height, gpointer data)
+{
+    TestCanvas *canvas = data;
+    gint        row;
+
+    g_assert_cmpint(x, >=, 0);
+    g_assert_cmpint(y, >=, 0);
+    g_assert_cmpint(x + width, <=, canvas->width);
+    g_assert_cmpint(y + height, <=, canvas->height);
+    for (row = 0; row < height; row++)
+        memcpy(canvas->pixels + (y + row) * canvas->width + x,
+               coverage + row * width, width);
+    canvas->rows += height;
+}
+
+/*-----------------------------------------------------------------------------
+ *  canvas_area  --  the area rasterised inside the box, in pixels
+ *-----------------------------------------------------------------------------
+ */
+static gdouble canvas_area(const TestCanvas *canvas, gint x, gint y, gint w,
+                           gint h)
+{
+    gdouble area = 0;
+    gint    px, py;
+
+    for (py = y; py < y + h; py++)
+        for (px = x; px < x + w; px++)
+            area += canvas->pixels[py * canvas->width + px] / 255.0;
+    return area;
+}
+
+static void canvas_fill(TestCanvas *canvas, const StrokeBatch *batch,
+                        gint fill, gint x, gint y, gint w, gint h)
+{
+    memset(canvas->pixels, 0, canvas->width * canvas->height);
+    canvas->rows = 0;
+    rasterize_strokes(batch, 0, stroke_batch_len(batch), fill, x, y, w, h,
+                      canvas_write, canvas);
+    g_assert_cmpint(canvas->rows, ==, h);
+}
+
+/*-----------------------------------------------------------------------------
+ *  repeated_polygon  --  a closed regular polygon of num corners around
+ *                        cx, cy whose first corner comes three times, with
+ *                        random handles on every copy
+ *-----------------------------------------------------------------------------
+ */
+static void repeated_polygon(GRand *rand, StrokeBatch *batch, gint num,
+                             gdouble cx, gdouble cy)
+{
+    gdouble ctlpts[(8 + 2) * 6];
+    gint    n, k;
+
+    for (n = 0; n < num + 2; n++) {
+        k = MAX(n - 2, 0);
+        ctlpts[n * 6 + 2] = cx + 100 * cos(2 * G_PI * k / num);
+        ctlpts[n * 6 + 3] = cy + 100 * sin(2 * G_PI * k / num);
+        ctlpts[n * 6 + 0] = ctlpts[n * 6 + 2] + g_rand_double_range(rand, -9, 9);
+        ctlpts[n * 6 + 1] = ctlpts[n * 6 + 3] + g_rand_double_range(rand, -9, 9);
+        ctlpts[n * 6 + 4] = ctlpts[n * 6 + 2] + g_rand_double_range(rand, -9, 9);
+        ctlpts[n * 6 + 5] = ctlpts[n * 6 + 3] + g_rand_double_range(rand, -9, 9);
+    }
+    stroke_batch_add(batch, ctlpts, (num + 2) * 6, TRUE);
+}
+
+/*-----------------------------------------------------------------------------
+ *  test_collapse_kept  --  a run of anchors whose corner the settings leave
+ *                          alone keeps every handle, as one anchor would;
+ *                          under a deadline runs are collapsed as well, and
+ *                          strokes the deadline leaves alone keep theirs
+ *-----------------------------------------------------------------------------
+ */
+static void test_collapse_kept(void)
+{
+    SmoothScratch  scratch = { NULL };
+    SmoothVals     vals = test_vals(0);
+    StrokeBatch    dirty, collapsed, deadline;
+    GArray        *angles, *quality;
+    GRand         *rand;
+    gint           n;
+
+    rand = g_rand_new_with_seed(660);
+    stroke_batch_init(&dirty);
+    stroke_batch_init(&collapsed);
+    stroke_batch_init(&deadline);
+    angles = g_array_new(FALSE, FALSE, sizeof(gdouble));
+    quality = g_array_new(FALSE, FALSE, sizeof(guint8));
+
+    /* Square corners are left alone, hexagon ones smoothed */
+    vals.smooth_specified = TRUE;
+    vals.ang_min = 100;
+    vals.ang_max = 170;
+    repeated_polygon(rand, &dirty, 4, 150, 150);
+    repeated_polygon(rand, &dirty, 6, 400, 150);
+    stroke_batch_angles(&dirty, angles);
+
+    stroke_batch_copy(&collapsed, &dirty);
+    smooth_batch_collapsed(&vals, &collapsed, (gdouble *) angles->data, NULL,
+                           &scratch);
+    g_assert_cmpmem(stroke_batch_points(&collapsed, 0),
+                    stroke_batch_size(&collapsed, 0) * sizeof(gdouble),
+                    stroke_batch_points(&dirty, 0),
+                    stroke_batch_size(&dirty, 0) * sizeof(gdouble));
+    g_assert_true(memcmp(stroke_batch_points(&collapsed, 1),
+                         stroke_batch_points(&dirty, 1),
+                         stroke_batch_size(&dirty, 1) *
+                         sizeof(gdouble)) != 0);
+
+    /* With all the time in the world a deadline changes nothing */
+    vals.deadline = 1e9;
+    stroke_batch_copy(&deadline, &dirty);
+    smooth_batch_deadline(&vals, &deadline, (gdouble *) angles->data, NULL,
+                          &scratch, quality);
+    for (n = 0; n < (gint) quality->len; n++)
+        g_assert_cmpint(g_array_index(quality, guint8, n), ==, QUALITY_EXACT);
+    g_assert_cmpmem(deadline.points->data,
+                    deadline.points->len * sizeof(gdouble),
+                    collapsed.points->data,
+                    collapsed.points->len * sizeof(gdouble));
+
+    /* And with none at all the strokes stay exactly as they were */
+    vals.deadline = 1e-12;
+    vals.smooth_specified = FALSE;
+    stroke_batch_copy(&deadline, &dirty);
+    smooth_batch_deadline(&vals, &deadline, (gdouble *) angles->data, NULL,
+                          &scratch, quality);
+    for (n = 0; n < (gint) quality->len; n++)
+        g_assert_cmpint(g_array_index(quality, guint8, n), ==, QUALITY_NONE);
+    g_assert_cmpmem(deadline.points->data,
+                    deadline.points->len * sizeof(gdouble),
+                    dirty.points->data, dirty.points->len * sizeof(gdouble));
+
+    stroke_batch_free(&dirty);
+    stroke_batch_free(&collapsed);
+    stroke_batch_free(&deadline);
+    g_array_free(angles, TRUE);
+    g_array_free(quality, TRUE);
+    scratch_free(&scratch);
+    g_rand_free(rand);
+}
+
+/*-----------------------------------------------------------------------------
+ *  test_raster  --  rectangles fill exactly, a circle to its area, nothing
+ *                   lands outside the box, and a hole is only left by the
+ *                   even-odd rule
+ *-----------------------------------------------------------------------------
+ */
+static void test_raster(void)
+{
+    static const gdouble outer[] = { 10, 10,  110, 10,  110, 90,  10, 90 };
+    static const gdouble inner[] = { 30, 30,  70, 30,  70, 60,  30, 60 };
+    static const gdouble tall[] = { 3, 2,  203, 2,  203, 1002,  3, 1002 };
+    TestCanvas   canvas;
+    StrokeBatch  batch;
+    gdouble      ctlpts[64 * 6];
+
+    canvas.width = 256;
+    canvas.height = 1024;
+    canvas.pixels = g_new(guint8, canvas.width * canvas.height);
+    stroke_batch_init(&batch);
+
+    polygon_stroke(ctlpts, outer, 4);
+    stroke_batch_add(&batch, ctlpts, 4 * 6, TRUE);
+    canvas_fill(&canvas, &batch, FILL_NONZERO, 5, 7, 120, 100);
+    g_assert_cmpfloat(canvas_area(&canvas, 0, 0, 256, 1024), ==, 100 * 80);
+    g_assert_cmpfloat(canvas_area(&canvas, 10, 10, 100, 80), ==, 100 * 80);
+
+    /* The box cuts the rectangle */
+    canvas_fill(&canvas, &batch, FILL_NONZERO, 60, 0, 100, 50);
+    g_assert_cmpfloat(canvas_area(&canvas, 0, 0, 256, 1024), ==, 50 * 40);
+
+    polygon_stroke(ctlpts, inner, 4);
+    stroke_batch_add(&batch, ctlpts, 4 * 6, TRUE);
+    canvas_fill(&canvas, &batch, FILL_NONZERO, 0, 0, 128, 128);
+    g_assert_cmpfloat(canvas_area(&canvas, 0, 0, 256, 1024), ==, 100 * 80);
+    canvas_fill(&canvas, &batch, FILL_EVENODD, 0, 0, 128, 128);
+    g_assert_cmpfloat(canvas_area(&canvas, 0, 0, 256, 1024), ==,
+                      100 * 80 - 40 * 30);
+    g_assert_cmpint(canvas.pixels[45 * canvas.width + 50], ==, 0);
+
+    /* Tall enough for the bands to go over the thread pool */
+    stroke_batch_clear(&batch);
+    polygon_stroke(ctlpts, tall, 4);
+    stroke_batch_add(&batch, ctlpts, 4 * 6, TRUE);
+    canvas_fill(&canvas, &batch, FILL_NONZERO, 0, 0, 256, 1024);
+    g_assert_cmpfloat(canvas_area(&canvas, 0, 0, 256, 1024), ==, 200 * 1000);
+
+    /* Curves are flattened to within FLATTEN_TOLERANCE */
+    stroke_batch_clear(&batch);
+    circle_stroke(ctlpts, 64, 128, 128, 100);
+    stroke_batch_add(&batch, ctlpts, 64 * 6, TRUE);
+    canvas_fill(&canvas, &batch, FILL_EVENODD, 0, 0, 256, 256);
+    g_assert_cmpfloat(ABS(canvas_area(&canvas, 0, 0, 256, 1024) -
+                          G_PI * 100 * 100), <,
+                      2 * G_PI * 100 * FLATTEN_TOLERANCE);
+
+    stroke_batch_free(&batch);
+    g_free(canvas.pixels);
+}
+
+/*-----------------------------------------------------------------------------
+ *  significant_digits  --  the digits of a number written out, without its
+ *                          sign, point, exponent and the zeros around them
+ *-----------------------------------------------------------------------------
+ */
+static gint significant_digits(const gchar *text)
+{
+    const gchar *point;
+    gint         first, last, n;
+
+    first = -1;
+    last = -1;
+    for (n = 0; text[n] && text[n] != 'e'; n++)
+        if (text[n] >= '1' && text[n] <= '9') {
+            if (first < 0)
+                first = n;
+            last = n;
+        }
+    if (first < 0)
+        return 0;
+    point = strchr(text, '.');
+    n = last - first + 1;
+    return point > text + first && point < text + last ? n - 1 : n;
+}
+
+static void test_writer(void)
+{
+    static const gdouble special[] = { 0.0, -0.0, 1.0, 0.1, 1e-4, 1e-5,
+                                       1e16, 1e17, 123456789012345678.0,
+                                       5e-324, 2.2250738585072014e-308,
+                                       1.7976931348623157e308, 0.3,
+                                       2.0 / 3.0, 1e23, 9007199254740993.0 };
+    PathWriter writer;
+    GString   *out;
+    GRand     *rand;
+    gchar      buf[G_ASCII_DTOSTR_BUF_SIZE];
+    gchar      format[8];
+    gdouble    value;
+    guint64    bits;
+    gint       n, p;
+
+    rand = g_rand_new_with_seed(51);
+    out = g_string_new(NULL);
+    path_writer_init(&writer, out, -1);
+    for (n = 0; n < 200000; n++) {
+        if (n < (gint) G_N_ELEMENTS(special)) {
+            value = special[n];
+        } else if (n % 2) {
+            /* Coordinates as they come from smoothing */
+            value = g_rand_double_range(rand, -1000, 5000);
+        } else {
+            do {
+                bits = (guint64) g_rand_int(rand) << 32 | g_rand_int(rand);
+                memcpy(&value, &bits, sizeof(value));
+            } while (isnan(value) || isinf(value));
+        }
+
+        /* Reads back exactly, with as few digits as any %g */
+        g_string_truncate(out, 0);
+        path_writer_number(&writer, value);
+        g_assert_cmpfloat(g_ascii_strtod(out->str, NULL), ==, value);
+        g_assert(strcmp(out->str, "-0") != 0);
+        for (p = 1; p < 17; p++) {
+            g_snprintf(format, sizeof(format), "%%.%dg", p);
+            g_ascii_formatd(buf, sizeof(buf), format, value);
+            if (g_ascii_strtod(buf, NULL) == value)
+                break;
+        }
+        g_assert_cmpint(significant_digits(out->str), <=, p);
+    }
+
+    g_string_free(out, TRUE);
+    g_rand_free(rand);
+}
+
+int main(int argc, char **argv)
+{
+    g_test_init(&argc, &argv, NULL);
+
+    g_test_add_func("/smooth/baseline", test_baseline);
+    g_test_add_func("/smooth/baseline-batch", test_baseline_batch);
+    g_test_add_func("/smooth/region", test_region);
+    g_test_add_func("/merge/stroke", test_merge);
+    g_test_add_func("/join/split", test_join_split);
+    g_test_add_func("/collapse/expand", test_collapse_expand);
+    g_test_add_func("/collapse/kept", test_collapse_kept);
+    g_test_add_func("/raster/coverage", test_raster);
+    g_test_add_func("/writer/number", test_writer);
+
+    return g_test_run();
+}